@@ -0,0 +1,728 @@
+/*
+ * devv_bench.cpp benchmarks the primitives and consensus hot paths.
+ *
+ * Inputs are built from the test keys in devv_constants.h with fixed seeds,
+ * so runs are comparable (ECDSA signatures themselves are randomized).
+ * Track results over time with the JSON reporter:
+ *
+ *   devv_bench --benchmark_out=devv_bench.json --benchmark_out_format=json
+ *
+ * @copywrite  2018 Devvio Inc
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <random>
+
+#include <benchmark/benchmark.h>
+#include <boost/asio.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include "common/hash_batch.h"
+#include "common/logger.h"
+#include "concurrency/DevvMPMCQueue.h"
+#include "concurrency/DevvSPSCQueue.h"
+#include "concurrency/WorkStealingExecutor.h"
+#include "consensus/UnrecordedTransactionPool.h"
+#include "consensus/chainstate.h"
+#include "gtest/test_tools.h"
+#include "pbuf/devv_pbuf.h"
+#include "primitives/FinalBlock.h"
+#include "primitives/ProposedBlock.h"
+#include "primitives/Summary.h"
+#include "primitives/Tier2Transaction.h"
+
+/// Heap allocations of the whole process, to report allocations per item
+static std::atomic<uint64_t> bench_allocations(0);
+
+void* operator new(size_t size) {
+  bench_allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void* ptr = std::malloc(size == 0 ? 1 : size)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+  std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+  std::free(ptr);
+}
+
+namespace Devv {
+namespace {
+
+/// Seed of every pseudo-random input
+static const uint64_t kBENCH_SEED = 42;
+
+/// Coins given to every wallet before transactions are applied
+static const int64_t kBENCH_BALANCE = 1000000000;
+
+/**
+ * A KeyRing holding the test keys
+ */
+const KeyRing& BenchKeys() {
+  static KeyRing* keys = []() {
+    KeyRing* ring = new KeyRing();
+    for (size_t i = 0; i < kADDRs.size(); ++i) {
+      ring->addWalletKeyPair(kADDRs.at(i), kADDR_KEYs.at(i), "password");
+    }
+    ring->setInnKeyPair(kINN_ADDR, kINN_KEY, "password");
+    for (size_t i = 0; i < kNODE_ADDRs.size(); ++i) {
+      ring->addNodeKeyPair(kNODE_ADDRs.at(i), kNODE_KEYs.at(i), "password");
+    }
+    return ring;
+  }();
+  return *keys;
+}
+
+/**
+ * A ChainState where every test wallet holds kBENCH_BALANCE coins
+ */
+ChainState FundedState() {
+  const KeyRing& keys = BenchKeys();
+  ChainState state;
+  for (size_t i = 0; i < keys.CountWallets(); ++i) {
+    state.addCoin(SmartCoin(keys.getWalletAddr(i), 0, kBENCH_BALANCE));
+  }
+  return state;
+}
+
+/**
+ * Sign count exchanges of one coin between random test wallets
+ * @param count - the number of transactions
+ * @param hot_every - if not 0, every hot_every-th transaction has wallet 0 spend
+ *   more than half its balance, so only one of them fits in a block
+ */
+std::vector<Tier2Transaction> MakeTransactions(size_t count, size_t hot_every = 0) {
+  const KeyRing& keys = BenchKeys();
+  std::mt19937_64 rng(kBENCH_SEED);
+  size_t wallets = keys.CountWallets();
+  std::vector<Tier2Transaction> txs;
+  txs.reserve(count);
+  for (size_t n = 0; n < count; ++n) {
+    size_t i = rng() % wallets;
+    size_t j = (i + 1 + rng() % (wallets - 1)) % wallets;
+    int64_t amount = 1;
+    if (hot_every > 0 && n % hot_every == 0) {
+      i = 0;
+      j = 1;
+      amount = kBENCH_BALANCE / 2 + 1;
+    }
+    std::vector<Transfer> xfers;
+    xfers.push_back(Transfer(keys.getWalletAddr(i), 0, -amount, 0));
+    xfers.push_back(Transfer(keys.getWalletAddr(j), 0, amount, 0));
+    std::vector<byte> nonce;
+    Uint64ToBin(kBENCH_SEED + n, nonce);
+    txs.emplace_back(eOpType::Exchange, xfers, nonce, keys.getWalletKey(i));
+  }
+  return txs;
+}
+
+std::vector<byte> Serialize(const std::vector<Tier2Transaction>& txs) {
+  std::vector<byte> serial;
+  for (auto const& tx : txs) {
+    const std::vector<byte>& canonical = tx.getCanonical();
+    serial.insert(serial.end(), canonical.begin(), canonical.end());
+  }
+  return serial;
+}
+
+/**
+ * Synthetic wallet addresses
+ */
+std::vector<Address> MakeAddresses(size_t count) {
+  std::mt19937_64 rng(kBENCH_SEED);
+  std::vector<Address> addrs;
+  for (size_t n = 0; n < count; ++n) {
+    std::vector<byte> bin(kWALLET_ADDR_SIZE);
+    for (auto& b : bin) {
+      b = static_cast<byte>(rng());
+    }
+    addrs.push_back(Address(bin));
+  }
+  return addrs;
+}
+
+/**
+ * Tier2Transaction
+ */
+void BM_Tier2Transaction_Sign(benchmark::State& state) {
+  const KeyRing& keys = BenchKeys();
+  std::vector<Transfer> xfers;
+  xfers.push_back(Transfer(keys.getWalletAddr(0), 0, -1, 0));
+  xfers.push_back(Transfer(keys.getWalletAddr(1), 0, 1, 0));
+  std::vector<byte> nonce;
+  Uint64ToBin(kBENCH_SEED, nonce);
+  for (auto _ : state) {
+    Tier2Transaction tx(eOpType::Exchange, xfers, nonce, keys.getWalletKey(0));
+    benchmark::DoNotOptimize(tx.getCanonical().data());
+  }
+}
+BENCHMARK(BM_Tier2Transaction_Sign);
+
+void BM_Tier2Transaction_Parse(benchmark::State& state) {
+  std::vector<byte> serial(Serialize(MakeTransactions(1)));
+  for (auto _ : state) {
+    InputBuffer buffer(serial);
+    Tier2Transaction tx(Tier2Transaction::QuickCreate(buffer));
+    benchmark::DoNotOptimize(tx.getCanonical().data());
+  }
+}
+BENCHMARK(BM_Tier2Transaction_Parse);
+
+void BM_Tier2Transaction_ParseSound(benchmark::State& state) {
+  const KeyRing& keys = BenchKeys();
+  std::vector<byte> serial(Serialize(MakeTransactions(1)));
+  for (auto _ : state) {
+    InputBuffer buffer(serial);
+    Tier2Transaction tx(Tier2Transaction::Create(buffer, keys, true));
+    benchmark::DoNotOptimize(tx.getCanonical().data());
+  }
+}
+BENCHMARK(BM_Tier2Transaction_ParseSound);
+
+void BM_Tier2Transaction_Serialize(benchmark::State& state) {
+  std::vector<Tier2Transaction> txs(MakeTransactions(state.range(0)));
+  for (auto _ : state) {
+    std::vector<byte> serial(Serialize(txs));
+    benchmark::DoNotOptimize(serial.data());
+  }
+  state.SetItemsProcessed(state.iterations() * txs.size());
+}
+BENCHMARK(BM_Tier2Transaction_Serialize)->Arg(1)->Arg(100)->Arg(1000);
+
+void BM_Tier2Transaction_isSound(benchmark::State& state) {
+  const KeyRing& keys = BenchKeys();
+  std::vector<Tier2Transaction> txs(MakeTransactions(1));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(txs[0].isSound(keys));
+  }
+}
+BENCHMARK(BM_Tier2Transaction_isSound);
+
+/**
+ * Hashing the canonical form of Transactions
+ */
+void BM_DevvHashBatch_Serial(benchmark::State& state) {
+  std::vector<Tier2Transaction> txs(MakeTransactions(state.range(0)));
+  std::vector<const std::vector<byte>*> msgs;
+  for (auto const& tx : txs) {
+    msgs.push_back(&tx.getCanonical());
+  }
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(DevvHashBatchSerial(msgs).data());
+  }
+  state.SetItemsProcessed(state.iterations() * msgs.size());
+}
+BENCHMARK(BM_DevvHashBatch_Serial)->Arg(1000);
+
+void BM_DevvHashBatch_MultiBuffer(benchmark::State& state) {
+  std::vector<Tier2Transaction> txs(MakeTransactions(state.range(0)));
+  std::vector<const std::vector<byte>*> msgs;
+  for (auto const& tx : txs) {
+    msgs.push_back(&tx.getCanonical());
+  }
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(DevvHashBatchMultiBuffer(msgs).data());
+  }
+  state.SetItemsProcessed(state.iterations() * msgs.size());
+}
+BENCHMARK(BM_DevvHashBatch_MultiBuffer)->Arg(1000);
+
+/**
+ * Summary
+ */
+void BM_Summary_addItem(benchmark::State& state) {
+  std::vector<Address> addrs(MakeAddresses(state.range(0)));
+  for (auto _ : state) {
+    Summary summary = Summary::Create();
+    for (size_t n = 0; n < addrs.size(); ++n) {
+      summary.addItem(addrs[n], 0, DelayedItem(0, (n % 2) ? 1 : -1));
+    }
+    benchmark::DoNotOptimize(summary.getSummaryMap().size());
+  }
+  state.SetItemsProcessed(state.iterations() * addrs.size());
+}
+BENCHMARK(BM_Summary_addItem)->Arg(16)->Arg(256)->Arg(4096);
+
+void BM_Summary_getCanonical(benchmark::State& state) {
+  std::vector<Address> addrs(MakeAddresses(state.range(0)));
+  Summary summary = Summary::Create();
+  for (size_t n = 0; n < addrs.size(); ++n) {
+    summary.addItem(addrs[n], 0, DelayedItem(0, (n % 2) ? 1 : -1));
+  }
+  for (auto _ : state) {
+    std::vector<byte> canonical(summary.getCanonical());
+    benchmark::DoNotOptimize(canonical.data());
+  }
+}
+BENCHMARK(BM_Summary_getCanonical)->Arg(16)->Arg(256)->Arg(4096);
+
+/**
+ * ChainState
+ */
+void BM_ChainState_getAmount(benchmark::State& state) {
+  std::vector<Address> addrs(MakeAddresses(state.range(0)));
+  ChainState chain_state;
+  for (auto const& addr : addrs) {
+    chain_state.addCoin(SmartCoin(addr, 0, kBENCH_BALANCE));
+  }
+  std::mt19937_64 rng(kBENCH_SEED);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(chain_state.getAmount(0, addrs[rng() % addrs.size()]));
+  }
+}
+BENCHMARK(BM_ChainState_getAmount)->Arg(16)->Arg(4096)->Arg(65536);
+
+void BM_ChainState_addCoin(benchmark::State& state) {
+  std::vector<Address> addrs(MakeAddresses(state.range(0)));
+  for (auto _ : state) {
+    ChainState chain_state;
+    for (auto const& addr : addrs) {
+      chain_state.addCoin(SmartCoin(addr, 0, 1));
+    }
+    benchmark::DoNotOptimize(chain_state.getStateMap().size());
+  }
+  state.SetItemsProcessed(state.iterations() * addrs.size());
+}
+BENCHMARK(BM_ChainState_addCoin)->Arg(16)->Arg(4096);
+
+/**
+ * UnrecordedTransactionPool and blocks
+ */
+DevvContext BenchContext() {
+  return DevvContext(0, 0, eAppMode::T2, "", "", "");
+}
+
+void BM_UnrecordedTransactionPool_addTransactions(benchmark::State& state) {
+  const KeyRing& keys = BenchKeys();
+  ChainState prior(FundedState());
+  std::vector<byte> serial(Serialize(MakeTransactions(state.range(0))));
+  for (auto _ : state) {
+    state.PauseTiming();
+    UnrecordedTransactionPool pool(prior, eAppMode::T2, state.range(0));
+    state.ResumeTiming();
+    pool.addTransactions(serial, keys);
+    benchmark::DoNotOptimize(pool.numPendingTransactions());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_UnrecordedTransactionPool_addTransactions)->Arg(100)->Arg(1000)->Unit(benchmark::kMillisecond);
+
+void BM_UnrecordedTransactionPool_proposeBlock(benchmark::State& state) {
+  const KeyRing& keys = BenchKeys();
+  DevvContext context(BenchContext());
+  ChainState prior(FundedState());
+  std::vector<byte> serial(Serialize(MakeTransactions(state.range(0))));
+  Hash prev_hash = {};
+  for (auto _ : state) {
+    state.PauseTiming();
+    UnrecordedTransactionPool pool(prior, eAppMode::T2, state.range(0));
+    pool.addTransactions(serial, keys);
+    state.ResumeTiming();
+    benchmark::DoNotOptimize(pool.proposeBlock(prev_hash, prior, keys, context));
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_UnrecordedTransactionPool_proposeBlock)->Arg(100)->Arg(1000)->Unit(benchmark::kMillisecond);
+
+/// One in this many transactions conflicts with an earlier one from the same sender
+static const size_t kBENCH_CONFLICT_EVERY = 10;
+
+/**
+ * The packing rule CollectValidTransactions used before it packed around conflicts,
+ * kept as a baseline: transactions in signature order until the first one that fails
+ * @return the number of transactions packed
+ */
+size_t GreedyPack(const std::map<Signature, const Tier2Transaction*>& txs,
+                  const ChainState& prior,
+                  size_t max_txs) {
+  const KeyRing& keys = BenchKeys();
+  ChainState post_state(ChainState::Copy(prior));
+  Summary summary(Summary::Create());
+  std::map<Address, SmartCoin> aggregate;
+  size_t packed = 0;
+  for (const auto& entry : txs) {
+    if (entry.second->isValidInAggregate(post_state, keys, summary, aggregate, prior)) {
+      if (++packed >= max_txs) { break; }
+    } else if (packed > 0) {
+      break;
+    }
+  }
+  return packed;
+}
+
+void BM_UnrecordedTransactionPool_packConflicts(benchmark::State& state) {
+  const KeyRing& keys = BenchKeys();
+  DevvContext context(BenchContext());
+  ChainState prior(FundedState());
+  size_t count = state.range(0);
+  std::vector<byte> serial(Serialize(MakeTransactions(count, kBENCH_CONFLICT_EVERY)));
+  Hash prev_hash = {};
+  size_t packed = 0;
+  for (auto _ : state) {
+    state.PauseTiming();
+    UnrecordedTransactionPool pool(prior, eAppMode::T2, count);
+    pool.addTransactions(serial, keys);
+    state.ResumeTiming();
+    pool.proposeBlock(prev_hash, prior, keys, context);
+    state.PauseTiming();
+    std::vector<byte> proposal(pool.getProposal());
+    InputBuffer buffer(proposal);
+    packed = ProposedBlock::Create(buffer, prior, keys, pool.get_transaction_creation_manager())
+        .getNumTransactions();
+    state.ResumeTiming();
+  }
+  state.counters["fill"] = static_cast<double>(packed) / count;
+  state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_UnrecordedTransactionPool_packConflicts)->Arg(100)->Arg(1000)->Unit(benchmark::kMillisecond);
+
+void BM_UnrecordedTransactionPool_packConflictsGreedy(benchmark::State& state) {
+  ChainState prior(FundedState());
+  size_t count = state.range(0);
+  std::vector<Tier2Transaction> txs(MakeTransactions(count, kBENCH_CONFLICT_EVERY));
+  std::map<Signature, const Tier2Transaction*> pending;
+  for (const auto& tx : txs) {
+    pending.insert(std::make_pair(tx.getSignature(), &tx));
+  }
+  size_t packed = 0;
+  for (auto _ : state) {
+    packed = GreedyPack(pending, prior, count);
+    benchmark::DoNotOptimize(packed);
+  }
+  state.counters["fill"] = static_cast<double>(packed) / count;
+  state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_UnrecordedTransactionPool_packConflictsGreedy)->Arg(100)->Arg(1000)->Unit(benchmark::kMillisecond);
+
+/**
+ * Create a proposal of count transactions, signed by node 1
+ */
+std::vector<byte> MakeProposal(UnrecordedTransactionPool& pool, const ChainState& prior, size_t count) {
+  const KeyRing& keys = BenchKeys();
+  DevvContext context(BenchContext());
+  pool.addTransactions(Serialize(MakeTransactions(count)), keys);
+  Hash prev_hash = {};
+  pool.proposeBlock(prev_hash, prior, keys, context);
+  return pool.getProposal();
+}
+
+void BM_ProposedBlock_Create(benchmark::State& state) {
+  const KeyRing& keys = BenchKeys();
+  ChainState prior(FundedState());
+  UnrecordedTransactionPool pool(prior, eAppMode::T2, state.range(0));
+  std::vector<byte> proposal(MakeProposal(pool, prior, state.range(0)));
+  for (auto _ : state) {
+    InputBuffer buffer(proposal);
+    ProposedBlock block(ProposedBlock::Create(buffer, prior, keys, pool.get_transaction_creation_manager()));
+    benchmark::DoNotOptimize(block.getNumTransactions());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ProposedBlock_Create)->Arg(100)->Arg(1000)->Unit(benchmark::kMillisecond);
+
+void BM_ProposedBlock_validate(benchmark::State& state) {
+  const KeyRing& keys = BenchKeys();
+  ChainState prior(FundedState());
+  UnrecordedTransactionPool pool(prior, eAppMode::T2, state.range(0));
+  std::vector<byte> proposal(MakeProposal(pool, prior, state.range(0)));
+  InputBuffer buffer(proposal);
+  ProposedBlock block(ProposedBlock::Create(buffer, prior, keys, pool.get_transaction_creation_manager()));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(block.validate(keys));
+  }
+}
+BENCHMARK(BM_ProposedBlock_validate)->Arg(100)->Unit(benchmark::kMillisecond);
+
+/**
+ * Validate a proposal signed by state.range(0) validators
+ * @param parallel check the signatures on the worker threads of the pool
+ */
+void ValidateValidators(benchmark::State& state, bool parallel) {
+  ChainState prior(FundedState());
+  UnrecordedTransactionPool pool(prior, eAppMode::T2, 100);
+  std::vector<byte> proposal(MakeProposal(pool, prior, 100));
+  InputBuffer buffer(proposal);
+  ProposedBlock block(ProposedBlock::Create(buffer, prior, BenchKeys(), pool.get_transaction_creation_manager()));
+  KeyRing validators;
+  AddValidators(block, validators, state.range(0) - 1, BenchContext());
+  TransactionCreationManager& tcm = pool.get_transaction_creation_manager();
+  for (auto _ : state) {
+    if (parallel) {
+      benchmark::DoNotOptimize(block.validate(validators, tcm));
+    } else {
+      benchmark::DoNotOptimize(block.validate(validators));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * block.getNumValidations());
+}
+
+void BM_ProposedBlock_validateValidators(benchmark::State& state) {
+  ValidateValidators(state, false);
+}
+BENCHMARK(BM_ProposedBlock_validateValidators)->RangeMultiplier(2)->Range(4, 64)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+void BM_ProposedBlock_validateValidatorsParallel(benchmark::State& state) {
+  ValidateValidators(state, true);
+}
+BENCHMARK(BM_ProposedBlock_validateValidatorsParallel)->RangeMultiplier(2)->Range(4, 64)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+void BM_FinalBlock_FromProposal(benchmark::State& state) {
+  const KeyRing& keys = BenchKeys();
+  ChainState prior(FundedState());
+  UnrecordedTransactionPool pool(prior, eAppMode::T2, state.range(0));
+  std::vector<byte> proposal(MakeProposal(pool, prior, state.range(0)));
+  InputBuffer buffer(proposal);
+  ProposedBlock block(ProposedBlock::Create(buffer, prior, keys, pool.get_transaction_creation_manager()));
+  for (auto _ : state) {
+    FinalBlock final_block(block);
+    benchmark::DoNotOptimize(final_block.getCanonical().data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_FinalBlock_FromProposal)->Arg(100)->Arg(1000)->Unit(benchmark::kMillisecond);
+
+void BM_FinalBlock_Create(benchmark::State& state) {
+  const KeyRing& keys = BenchKeys();
+  ChainState prior(FundedState());
+  UnrecordedTransactionPool pool(prior, eAppMode::T2, state.range(0));
+  std::vector<byte> proposal(MakeProposal(pool, prior, state.range(0)));
+  InputBuffer buffer(proposal);
+  ProposedBlock block(ProposedBlock::Create(buffer, prior, keys, pool.get_transaction_creation_manager()));
+  std::vector<byte> canonical(FinalBlock(block).getCanonical());
+  for (auto _ : state) {
+    InputBuffer final_buffer(canonical);
+    FinalBlock final_block(FinalBlock::Create(final_buffer, prior));
+    benchmark::DoNotOptimize(final_block.getNumTransactions());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_FinalBlock_Create)->Arg(100)->Arg(1000)->Unit(benchmark::kMillisecond);
+
+/**
+ * Oracles, an envelope of proposals cycling through dcash,
+ * DoTransaction and CoinRequest
+ */
+std::string MakeOracleEnvelope(size_t count) {
+  const KeyRing& keys = BenchKeys();
+  std::vector<Tier2Transaction> txs(MakeTransactions(count));
+  proto::Envelope envelope;
+  for (size_t n = 0; n < count; ++n) {
+    proto::Proposal* proposal = envelope.add_proposals();
+    switch (n % 3) {
+      case 0:
+        proposal->set_oraclename(dcash::GetOracleName());
+        proposal->set_data(Bin2Str(txs[n].getCanonical()));
+        break;
+      case 1:
+        proposal->set_oraclename(DoTransaction::GetOracleName());
+        proposal->set_data(ToHex(txs[n].getCanonical()));
+        break;
+      default: {
+        std::vector<byte> request;
+        Uint64ToBin(0, request);
+        Int64ToBin(1 + n, request);
+        std::vector<byte> addr(keys.getWalletAddr(n % keys.CountWallets()).getCanonical());
+        request.insert(request.end(), addr.begin(), addr.end());
+        proposal->set_oraclename(CoinRequest::GetOracleName());
+        proposal->set_data(Bin2Str(request));
+      }
+    }
+  }
+  std::string serial;
+  envelope.SerializeToString(&serial);
+  return serial;
+}
+
+void BM_Oracle_MixedEnvelope(benchmark::State& state) {
+  const KeyRing& keys = BenchKeys();
+  std::string envelope(MakeOracleEnvelope(state.range(0)));
+  for (auto _ : state) {
+    std::vector<TransactionPtr> txs(DeserializeEnvelopeProtobufString(envelope, keys));
+    benchmark::DoNotOptimize(txs.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_Oracle_MixedEnvelope)->Arg(30)->Arg(300)->Unit(benchmark::kMillisecond);
+
+void BM_Oracle_dcashIsValid(benchmark::State& state) {
+  auto chain_state = std::make_shared<ChainState>(FundedState());
+  for (const auto& addr : MakeAddresses(state.range(0))) {
+    chain_state->addCoin(SmartCoin(addr, 0, kBENCH_BALANCE));
+  }
+  ChainStateView view(chain_state);
+  std::vector<Tier2Transaction> txs(MakeTransactions(1));
+  dcash oracle(Bin2Str(txs[0].getCanonical()));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(oracle.isValid(view));
+  }
+}
+BENCHMARK(BM_Oracle_dcashIsValid)->Arg(16)->Arg(65536);
+
+void BM_OracleRegistry_find(benchmark::State& state) {
+  const OracleRegistry& registry = OracleRegistry::Get();
+  std::vector<std::string> names{vote::GetOracleName(), dcash::GetOracleName(),
+                                 CoinRequest::GetOracleName(), "io.devv.unknown"};
+  size_t n = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(registry.find(names[n++ % names.size()]));
+  }
+}
+BENCHMARK(BM_OracleRegistry_find);
+
+/**
+ * Envelopes, Transactions from clients converted to Tier2Transactions
+ */
+std::string MakeEnvelope(size_t count) {
+  proto::Envelope envelope;
+  for (const auto& tx : MakeTransactions(count)) {
+    SerializeTransaction(tx, *envelope.add_txs());
+  }
+  std::string serial;
+  envelope.SerializeToString(&serial);
+  return serial;
+}
+
+void BM_Envelope_Transactions(benchmark::State& state) {
+  const KeyRing& keys = BenchKeys();
+  std::string envelope(MakeEnvelope(state.range(0)));
+  uint64_t allocations = 0;
+  for (auto _ : state) {
+    uint64_t before = bench_allocations.load(std::memory_order_relaxed);
+    std::vector<TransactionPtr> txs(DeserializeEnvelopeProtobufString(envelope, keys));
+    allocations += bench_allocations.load(std::memory_order_relaxed) - before;
+    benchmark::DoNotOptimize(txs.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  state.counters["envelopes/s"] = benchmark::Counter(state.iterations(), benchmark::Counter::kIsRate);
+  state.counters["allocs/tx"] = static_cast<double>(allocations) / (state.iterations() * state.range(0));
+}
+BENCHMARK(BM_Envelope_Transactions)->Arg(1)->Arg(100)->Arg(1000)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+/**
+ * Executors, parallel loops of small hashes on 1 to 64 threads. The
+ * baselines are the thread per call loop of ThreadPool::ParallelFor and
+ * the task per index io_service of TransactionCreationManager that
+ * WorkStealingExecutor replaced. p50_us and p99_us are loop latencies.
+ */
+static const size_t kBENCH_LOOP_TASKS = 1024;
+
+template <typename Loop>
+void BenchLoop(benchmark::State& state, Loop loop) {
+  std::vector<byte> input(64, 7);
+  std::vector<Hash> out(kBENCH_LOOP_TASKS);
+  auto task = [&](size_t i) { out[i] = DevvHash(input); };
+  std::vector<double> latencies;
+  for (auto _ : state) {
+    auto start = std::chrono::steady_clock::now();
+    loop(task);
+    latencies.push_back(std::chrono::duration<double, std::micro>(
+        std::chrono::steady_clock::now() - start).count());
+  }
+  std::sort(latencies.begin(), latencies.end());
+  state.SetItemsProcessed(state.iterations() * kBENCH_LOOP_TASKS);
+  state.counters["p50_us"] = latencies[latencies.size() / 2];
+  state.counters["p99_us"] = latencies[latencies.size() * 99 / 100];
+}
+
+void BM_Executor_WorkStealing(benchmark::State& state) {
+  // the calling thread runs chunks too, so n threads are n - 1 workers
+  WorkStealingExecutor executor(state.range(0) - 1);
+  BenchLoop(state, [&](const std::function<void(size_t)>& task) {
+    executor.ParallelFor(size_t(0), kBENCH_LOOP_TASKS, task);
+  });
+}
+BENCHMARK(BM_Executor_WorkStealing)->RangeMultiplier(4)->Range(1, 64)->UseRealTime();
+
+void BM_Executor_ThreadPerCall(benchmark::State& state) {
+  const size_t threads = state.range(0);
+  BenchLoop(state, [&](const std::function<void(size_t)>& task) {
+    size_t slice = (kBENCH_LOOP_TASKS + threads - 1) / threads;
+    std::vector<std::thread> pool;
+    for (size_t begin = 0; begin < kBENCH_LOOP_TASKS; begin += slice) {
+      pool.emplace_back([&task, begin, slice]() {
+        for (size_t i = begin; i < std::min(begin + slice, kBENCH_LOOP_TASKS); ++i) {
+          task(i);
+        }
+      });
+    }
+    for (auto& thread : pool) {
+      thread.join();
+    }
+  });
+}
+BENCHMARK(BM_Executor_ThreadPerCall)->RangeMultiplier(4)->Range(1, 64)->UseRealTime();
+
+void BM_Executor_AsioTaskPerIndex(benchmark::State& state) {
+  typedef boost::packaged_task<bool> task_t;
+  boost::asio::io_service io_service;
+  boost::asio::io_service::work work(io_service);
+  boost::thread_group threads;
+  for (int i = 0; i < state.range(0); ++i) {
+    threads.create_thread(boost::bind(&boost::asio::io_service::run, &io_service));
+  }
+  BenchLoop(state, [&](const std::function<void(size_t)>& task) {
+    std::vector<boost::shared_future<bool>> pending;
+    pending.reserve(kBENCH_LOOP_TASKS);
+    for (size_t i = 0; i < kBENCH_LOOP_TASKS; ++i) {
+      auto packaged = boost::make_shared<task_t>([&task, i]() {
+        task(i);
+        return true;
+      });
+      pending.push_back(boost::shared_future<bool>(packaged->get_future()));
+      io_service.post(boost::bind(&task_t::operator(), packaged));
+    }
+    boost::wait_for_all(pending.begin(), pending.end());
+  });
+  io_service.stop();
+  threads.join_all();
+}
+BENCHMARK(BM_Executor_AsioTaskPerIndex)->RangeMultiplier(4)->Range(1, 64)->UseRealTime();
+
+/**
+ * Queues, a push and a pop of one message from the same thread
+ */
+DevvMessageUniquePtr MakeMessage() {
+  return std::make_unique<DevvMessage>("bench", TRANSACTION_ANNOUNCEMENT, std::vector<byte>(64), 0);
+}
+
+void BM_DevvSPSCQueue_RoundTrip(benchmark::State& state) {
+  DevvSPSCQueue queue;
+  for (auto _ : state) {
+    queue.push(MakeMessage());
+    benchmark::DoNotOptimize(queue.pop());
+  }
+}
+BENCHMARK(BM_DevvSPSCQueue_RoundTrip);
+
+void BM_DevvMPMCQueue_RoundTrip(benchmark::State& state) {
+  DevvMPMCQueue queue;
+  for (auto _ : state) {
+    queue.push(MakeMessage());
+    benchmark::DoNotOptimize(queue.pop());
+  }
+}
+BENCHMARK(BM_DevvMPMCQueue_RoundTrip);
+
+} // namespace
+} // namespace Devv
+
+int main(int argc, char** argv) {
+  // Keep the logs out of the measurements unless a level was requested
+  setenv("DEVV_OUTPUT_LOGLEVEL", "error", 0);
+  init_log();
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
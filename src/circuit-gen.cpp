@@ -25,6 +25,7 @@
 #include "common/devv_context.h"
 #include "common/logger.h"
 
+#include "concurrency/TransactionGenerator.h"
 #include "modules/BlockchainModule.h"
 
 using namespace Devv;
@@ -40,6 +41,8 @@ struct circuit_options {
   std::string key_pass;
   unsigned int generate_count;
   uint64_t tx_amount;
+  unsigned int num_threads = 0;
+  uint64_t seed = 0;
   eDebugMode debug_mode;
   bool clear_state;
 };
@@ -62,13 +65,6 @@ int main(int argc, char* argv[]) {
     KeyRing keys(this_context);
     keys.LoadWallets(options->wallet_keys, options->key_pass);
 
-    std::vector<byte> out;
-    EVP_MD_CTX* ctx;
-    if (!(ctx = EVP_MD_CTX_create())) {
-      std::string err("Could not create signature context!");
-      throw std::runtime_error(err);
-    }
-
     Address inn_addr = keys.getInnAddr();
 
     if (options->generate_count < 2) {
@@ -83,88 +79,86 @@ int main(int argc, char* argv[]) {
     }
 
     size_t addr_count = std::min(keys.CountWallets(), static_cast<size_t>(need_addrs));
+    if (addr_count < 2) {
+      LOG_FATAL << "At least 2 wallets are needed to generate peer transactions.";
+      CASH_THROW("Not enough wallets.");
+    }
 
-    size_t counter = 0;
-
-    std::vector<Transfer> xfers;
-    Transfer inn_transfer(inn_addr, 0, -1l * addr_count * (addr_count - 1) * options->tx_amount, 0);
-    xfers.push_back(inn_transfer);
+    // Fetch the addresses and keys once, they are shared by all generating threads
+    std::vector<Address> addrs;
+    std::vector<EC_KEY*> wallet_keys;
     for (size_t i = 0; i < addr_count; ++i) {
-      Transfer transfer(keys.getWalletAddr(i), 0, options->tx_amount * (addr_count - 1), 0);
-      xfers.push_back(transfer);
+      addrs.push_back(keys.getWalletAddr(i));
+      wallet_keys.push_back(keys.getWalletKey(i));
     }
-    uint64_t nonce = GetMillisecondsSinceEpoch() + (1000000
-                     * (options->node_index + 1) * (options->tx_amount + 1));
-	std::vector<byte> nonce_bin;
-    Uint64ToBin(nonce, nonce_bin);
-    Tier2Transaction inn_tx(eOpType::Create, xfers, nonce_bin,
-                            keys.getKey(inn_addr), keys);
-    std::vector<byte> inn_canon(inn_tx.getCanonical());
-    out.insert(out.end(), inn_canon.begin(), inn_canon.end());
-    LOG_DEBUG << "Circuit test generated inn_tx with sig: " << inn_tx.getSignature().getJSON();
-    counter++;
-
-    while (counter < options->generate_count) {
-      for (size_t i = 0; i < addr_count; ++i) {
-        for (size_t j = 0; j < addr_count; ++j) {
-          if (i == j) { continue; }
-          std::vector<Transfer> peer_xfers;
-          Transfer sender(keys.getWalletAddr(i), 0, -1l * options->tx_amount, 0);
-          peer_xfers.push_back(sender);
-          Transfer receiver(keys.getWalletAddr(j), 0, options->tx_amount, 0);
-          peer_xfers.push_back(receiver);
-          nonce_bin.clear();
-          nonce = GetMillisecondsSinceEpoch() + (1000000
-                     * (options->node_index + 1) * (i + 1) * (j + 1));
-          Uint64ToBin(nonce, nonce_bin);
-          Tier2Transaction peer_tx(
-              eOpType::Exchange, peer_xfers, nonce_bin,
-              keys.getWalletKey(i), keys);
-          std::vector<byte> peer_canon(peer_tx.getCanonical());
-          out.insert(out.end(), peer_canon.begin(), peer_canon.end());
-          LOG_TRACE << "Circuit test generated tx with sig: " << peer_tx.getSignature().getJSON();
-          counter++;
-          if (counter >= options->generate_count) { break; }
-        }  // end inner for
-        if (counter >= options->generate_count) { break; }
-      }  // end outer for
-      if (counter >= options->generate_count) { break; }
-      if (options->clear_state) {
+    EC_KEY* inn_key = keys.getKey(inn_addr);
+
+    // A circuit sends from every peer address to every other address,
+    // then optionally returns the coins of every peer to the INN
+    size_t peer_count = addr_count * (addr_count - 1);
+    size_t circuit_size = peer_count + (options->clear_state ? addr_count : 0);
+
+    uint64_t tx_amount = options->tx_amount;
+    uint64_t seed = options->seed;
+    uint64_t node_factor = 1000000 * (options->node_index + 1);
+    auto make = [&](size_t index, std::vector<byte>& out) {
+      std::vector<byte> nonce_bin;
+      if (index == 0) {
+        std::vector<Transfer> xfers;
+        Transfer inn_transfer(inn_addr, 0, -1l * addr_count * (addr_count - 1) * tx_amount, 0);
+        xfers.push_back(inn_transfer);
         for (size_t i = 0; i < addr_count; ++i) {
-          std::vector<Transfer> peer_xfers;
-          Transfer sender(keys.getWalletAddr(i), 0, -1l * (addr_count - 1) * options->tx_amount, 0);
-          peer_xfers.push_back(sender);
-          Transfer receiver(inn_addr, 0, (addr_count - 1) * options->tx_amount, 0);
-          peer_xfers.push_back(receiver);
-          nonce = GetMillisecondsSinceEpoch() + (1000000
-                       * (options->node_index + 1) * (i + 1) * (addr_count + 2));
-          Uint64ToBin(nonce, nonce_bin);
-          Tier2Transaction peer_tx(
-              eOpType::Exchange, peer_xfers, nonce_bin,
-              keys.getWalletKey(i), keys);
-          std::vector<byte> peer_canon(peer_tx.getCanonical());
-          out.insert(out.end(), peer_canon.begin(), peer_canon.end());
-          LOG_TRACE << "GenerateTransactions(): generated tx with sig: " << peer_tx.getSignature().getJSON();
-          counter++;
-          if (counter >= options->generate_count) { break; }
-        }  // end outer for
+          Transfer transfer(addrs[i], 0, tx_amount * (addr_count - 1), 0);
+          xfers.push_back(transfer);
+        }
+        Uint64ToBin(seed + node_factor * (tx_amount + 1), nonce_bin);
+        Tier2Transaction inn_tx(eOpType::Create, xfers, nonce_bin, inn_key);
+        const std::vector<byte>& inn_canon = inn_tx.getCanonical();
+        out.insert(out.end(), inn_canon.begin(), inn_canon.end());
+        return;
       }
-      if (counter >= options->generate_count) { break; }
-    }  // end counter while
-
-    LOG_INFO << "Generated " << counter << " transactions.";
+      size_t position = (index - 1) % circuit_size;
+      std::vector<Transfer> peer_xfers;
+      size_t i;
+      if (position < peer_count) {
+        i = position / (addr_count - 1);
+        size_t j = position % (addr_count - 1);
+        if (j >= i) { ++j; }
+        Transfer sender(addrs[i], 0, -1l * tx_amount, 0);
+        peer_xfers.push_back(sender);
+        Transfer receiver(addrs[j], 0, tx_amount, 0);
+        peer_xfers.push_back(receiver);
+        Uint64ToBin(seed + node_factor * (i + 1) * (j + 1) + index, nonce_bin);
+      } else {
+        i = position - peer_count;
+        Transfer sender(addrs[i], 0, -1l * (addr_count - 1) * tx_amount, 0);
+        peer_xfers.push_back(sender);
+        Transfer receiver(inn_addr, 0, (addr_count - 1) * tx_amount, 0);
+        peer_xfers.push_back(receiver);
+        Uint64ToBin(seed + node_factor * (i + 1) * (addr_count + 2) + index, nonce_bin);
+      }
+      Tier2Transaction peer_tx(eOpType::Exchange, peer_xfers, nonce_bin, wallet_keys[i]);
+      const std::vector<byte>& peer_canon = peer_tx.getCanonical();
+      out.insert(out.end(), peer_canon.begin(), peer_canon.end());
+    };
 
+    std::ofstream out_file;
     if (!options->write_file.empty()) {
-      std::ofstream out_file(options->write_file, std::ios::out | std::ios::binary);
-      if (out_file.is_open()) {
-        out_file.write((const char*) out.data(), out.size());
-        out_file.close();
-      } else {
+      out_file.open(options->write_file, std::ios::out | std::ios::binary);
+      if (!out_file.is_open()) {
         LOG_FATAL << "Failed to open output file '" << options->write_file << "'.";
         return (false);
       }
     }
 
+    TransactionGenerator generator(options->num_threads);
+    size_t bytes = generator.generate(options->generate_count, make
+                                      , out_file.is_open() ? &out_file : nullptr);
+    EC_KEY_free(inn_key);
+
+    LOG_INFO << "Generated " << options->generate_count << " transactions (" << bytes << " bytes) in "
+             << generator.getElapsedMillis() << " ms, " << generator.getRate() << " tx/s.";
+
     return (true);
   }
   CASH_CATCH(...) {
@@ -212,6 +206,8 @@ Required parameters");
     po::options_description d2("Optional parameters");
     d2.add_options()
         ("help", "produce help message")
+        ("num-threads", po::value<unsigned int>(), "Number of threads generating transactions (0 for one per core)")
+        ("seed", po::value<uint64_t>(), "Seed of the nonces and random choices, the same seed generates the same output")
         ("clear-state", po::value<bool>(), "Return coins to INN address?")
         ("debug-mode", po::value<std::string>(), "Debug mode (on|off|perf) for testing")
         ;
@@ -323,6 +319,21 @@ Required parameters");
       LOG_INFO << "Transaction amount was not set, defaulting to " << options->tx_amount;
     }
 
+    if (vm.count("num-threads")) {
+      options->num_threads = vm["num-threads"].as<unsigned int>();
+      LOG_INFO << "Generator threads: " << options->num_threads;
+    } else {
+      LOG_INFO << "Generator threads were not set (default to one per core).";
+    }
+
+    if (vm.count("seed")) {
+      options->seed = vm["seed"].as<uint64_t>();
+      LOG_INFO << "Seed: " << options->seed;
+    } else {
+      options->seed = GetMillisecondsSinceEpoch();
+      LOG_INFO << "Seed was not set, defaulting to the current time " << options->seed;
+    }
+
     if (vm.count("clear-state")) {
       options->clear_state = vm["clear-state"].as<bool>();
       LOG_INFO << "Clear state: " << options->clear_state;
@@ -50,6 +50,18 @@ struct devv_options {
   std::string stop_file;
   std::string syslog_host;
   eDebugMode debug_mode = off;
+  eBlockEncoding block_encoding = CanonicalBlocks;
+  bool thin_blocks = false;
+  std::string metrics_file;
+  unsigned int metrics_interval = 0;
+  unsigned int key_load_threads = 0;
+  bool verify_keys = true;
+  std::string key_cache_dir;
+  size_t pool_max_txs = kDEFAULT_POOL_MAX_TXS;
+  size_t pool_max_bytes = kDEFAULT_POOL_MAX_BYTES;
+  uint64_t pool_tx_ttl_ms = kDEFAULT_POOL_TX_TTL_MS;
+  size_t min_block_txs = kDEFAULT_MIN_BLOCK_TXS;
+  uint64_t target_latency_ms = kDEFAULT_TARGET_LATENCY_MS;
 };
 
 inline std::unique_ptr<struct devv_options> ParseDevvOptions(int argc, char** argv) {
@@ -78,6 +90,9 @@ inline std::unique_ptr<struct devv_options> ParseDevvOptions(int argc, char** ar
         ("inn-keys", po::value<std::string>(), "Path to INN key file")
         ("node-keys", po::value<std::string>(), "Path to Node key file")
         ("key-pass", po::value<std::string>(), "Password for private keys")
+        ("key-load-threads", po::value<unsigned int>(), "Number of threads decoding key files (0 for one per core)")
+        ("skip-key-check", "Do not sign and verify a test message with every loaded key (trusted key files only)")
+        ("key-cache-dir", po::value<std::string>(), "Directory where decoded keys are cached, encrypted with key-pass")
         ;
 
     po::options_description debugging("Debugging and Performance Options");
@@ -92,6 +107,19 @@ inline std::unique_ptr<struct devv_options> ParseDevvOptions(int argc, char** ar
         ("max-wait", po::value<unsigned int>(), "Maximum number of millis to wait for transactions")
         ("syslog-host", po::value<std::string>(), "The syslog host name")
         ("syslog-port", po::value<unsigned int>(), "The syslog port number")
+        ("block-encoding", po::value<std::string>(), "Encoding of blocks sent to peers (canonical|compact|deflate)")
+        ("thin-blocks", "Send proposals and final blocks as transaction signatures that peers resolve from "
+                        "their transaction pools. Complete final blocks are also published on the archive topic "
+                        "(\"archive-\" + shard URI), readers without a pool (devv-query, devv-psql, "
+                        "devv-announcer) must subscribe to it.")
+        ("metrics-file", po::value<std::string>(), "File the metrics are written to (Prometheus text format)")
+        ("metrics-interval", po::value<unsigned int>(), "Seconds between metrics reports (0 disables reporting)")
+        ("pool-max-txs", po::value<size_t>(), "Maximum number of pending transactions, the oldest are evicted first")
+        ("pool-max-mb", po::value<size_t>(), "Maximum megabytes of pending transactions, the oldest are evicted first")
+        ("pool-tx-ttl", po::value<unsigned int>(), "Seconds a transaction may wait to be recorded (0 never expires)")
+        ("target-latency", po::value<unsigned int>(), "Millis from proposal to finality that block sizes adapt to, "
+                                                      "up to tx-batch-size and max-wait (0 keeps blocks at tx-batch-size)")
+        ("min-block-txs", po::value<size_t>(), "Smallest block size when target-latency is set")
         ;
 
     po::options_description all_options;
@@ -276,6 +304,97 @@ inline std::unique_ptr<struct devv_options> ParseDevvOptions(int argc, char** ar
       std::cout << "Syslog port not set (default to " << options->syslog_port << ")." << std::endl;
     }
 
+    if (vm.count("block-encoding")) {
+      std::string encoding = vm["block-encoding"].as<std::string>();
+      if (encoding == "compact") {
+        options->block_encoding = CompactBlocks;
+      } else if (encoding == "deflate") {
+        options->block_encoding = DeflatedBlocks;
+      } else if (encoding == "canonical") {
+        options->block_encoding = CanonicalBlocks;
+      } else {
+        std::cerr << "unknown block encoding: " << encoding << std::endl;
+      }
+      std::cout << "Block encoding: " << encoding << std::endl;
+    } else {
+      std::cout << "Block encoding was not set (default to canonical)." << std::endl;
+    }
+
+    if (vm.count("thin-blocks")) {
+      options->thin_blocks = true;
+      std::cout << "Thin blocks enabled." << std::endl;
+    } else {
+      std::cout << "Thin blocks were not set (default to full blocks)." << std::endl;
+    }
+
+    if (vm.count("metrics-file")) {
+      options->metrics_file = vm["metrics-file"].as<std::string>();
+      std::cout << "Metrics file: " << options->metrics_file << std::endl;
+    } else {
+      std::cout << "Metrics file was not set." << std::endl;
+    }
+
+    if (vm.count("metrics-interval")) {
+      options->metrics_interval = vm["metrics-interval"].as<unsigned int>();
+      std::cout << "Metrics interval: " << options->metrics_interval << std::endl;
+    } else {
+      std::cout << "Metrics interval was not set (default to no reports)." << std::endl;
+    }
+
+    if (vm.count("key-load-threads")) {
+      options->key_load_threads = vm["key-load-threads"].as<unsigned int>();
+      std::cout << "Key load threads: " << options->key_load_threads << std::endl;
+    } else {
+      std::cout << "Key load threads were not set (default to one per core)." << std::endl;
+    }
+
+    if (vm.count("skip-key-check")) {
+      options->verify_keys = false;
+      std::cout << "Key self-test disabled." << std::endl;
+    }
+
+    if (vm.count("key-cache-dir")) {
+      options->key_cache_dir = vm["key-cache-dir"].as<std::string>();
+      std::cout << "Key cache dir: " << options->key_cache_dir << std::endl;
+    } else {
+      std::cout << "Key cache dir was not set (keys are not cached)." << std::endl;
+    }
+
+    if (vm.count("pool-max-txs")) {
+      options->pool_max_txs = vm["pool-max-txs"].as<size_t>();
+      std::cout << "Pool max transactions: " << options->pool_max_txs << std::endl;
+    } else {
+      std::cout << "Pool max transactions was not set (default to " << options->pool_max_txs << ")." << std::endl;
+    }
+
+    if (vm.count("pool-max-mb")) {
+      options->pool_max_bytes = vm["pool-max-mb"].as<size_t>() * 1024 * 1024;
+      std::cout << "Pool max bytes: " << options->pool_max_bytes << std::endl;
+    } else {
+      std::cout << "Pool max bytes was not set (default to " << options->pool_max_bytes << ")." << std::endl;
+    }
+
+    if (vm.count("pool-tx-ttl")) {
+      options->pool_tx_ttl_ms = vm["pool-tx-ttl"].as<unsigned int>() * 1000ull;
+      std::cout << "Pool transaction TTL (ms): " << options->pool_tx_ttl_ms << std::endl;
+    } else {
+      std::cout << "Pool transaction TTL was not set (default to " << options->pool_tx_ttl_ms << " ms)." << std::endl;
+    }
+
+    if (vm.count("target-latency")) {
+      options->target_latency_ms = vm["target-latency"].as<unsigned int>();
+      std::cout << "Target latency (ms): " << options->target_latency_ms << std::endl;
+    } else {
+      std::cout << "Target latency was not set (block size is fixed)." << std::endl;
+    }
+
+    if (vm.count("min-block-txs")) {
+      options->min_block_txs = vm["min-block-txs"].as<size_t>();
+      std::cout << "Min block transactions: " << options->min_block_txs << std::endl;
+    } else {
+      std::cout << "Min block transactions was not set (default to " << options->min_block_txs << ")." << std::endl;
+    }
+
   }
   catch(std::exception& e) {
     std::cerr << "error: " << e.what() << std::endl;
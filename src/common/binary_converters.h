@@ -99,6 +99,62 @@ static std::vector<byte> Int64ToBin(const int64_t& source, std::vector<byte>& de
   return dest;
 }
 
+/** Maximum number of bytes in an encoded 64-bit varint */
+static const size_t kMAX_VARINT_SIZE = 10;
+
+/**
+ * Append an unsigned 64-bit integer to dest as a LEB128 varint
+ * (7 bits per byte, high bit set on all but the last byte).
+ * @param[in] source
+ * @param[out] dest
+ */
+static void VarintToBin(uint64_t source, std::vector<byte>& dest) {
+  while (source >= 0x80) {
+    dest.push_back(static_cast<byte>((source & 0x7F) | 0x80));
+    source >>= 7;
+  }
+  dest.push_back(static_cast<byte>(source));
+}
+
+/**
+ * Read a LEB128 varint from bytes and advance offset past it.
+ * Throws std::out_of_range if the varint is truncated and
+ * std::runtime_error if it is longer than kMAX_VARINT_SIZE.
+ * @param[in] bytes
+ * @param[in, out] offset position of the varint
+ * @return deserialized 64-bit integer
+ */
+static uint64_t BinToVarint(const std::vector<byte>& bytes, size_t& offset) {
+  uint64_t dest = 0;
+  for (unsigned int i = 0; i < kMAX_VARINT_SIZE; ++i) {
+    byte next = bytes.at(offset++);
+    dest |= (uint64_t(next & 0x7F) << (i * 7));
+    if ((next & 0x80) == 0) {
+      return dest;
+    }
+  }
+  throw std::runtime_error("Invalid varint, too long!");
+}
+
+/**
+ * Map a signed integer onto an unsigned one so that values
+ * of small magnitude produce short varints (0,-1,1,-2 -> 0,1,2,3).
+ * @param source
+ * @return zigzag encoded value
+ */
+static uint64_t ZigZagEncode(int64_t source) {
+  return (static_cast<uint64_t>(source) << 1) ^ static_cast<uint64_t>(source >> 63);
+}
+
+/**
+ * Inverse of ZigZagEncode
+ * @param source
+ * @return decoded signed value
+ */
+static int64_t ZigZagDecode(uint64_t source) {
+  return static_cast<int64_t>(source >> 1) ^ -static_cast<int64_t>(source & 1);
+}
+
 /**
  * Maps a hex digit to an int value.
  * @param hex digit to get the int value for
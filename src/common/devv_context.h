@@ -19,6 +19,16 @@ namespace Devv {
 static const int kACTIVATION_ROUNDS = 334;
 static const unsigned int kPROPOSAL_TIMEOUT = 60000;
 static const int kVALIDATION_PERCENT = 51;
+static const unsigned int kDEFAULT_PEER_COUNT = 3;
+
+//Transaction pool limits
+static const size_t kDEFAULT_POOL_MAX_TXS = 1000000;
+static const size_t kDEFAULT_POOL_MAX_BYTES = 512 * 1024 * 1024;
+static const uint64_t kDEFAULT_POOL_TX_TTL_MS = 10 * 60 * 1000;
+
+//Adaptive block sizing, a target latency of 0 keeps the block size at batch_size
+static const size_t kDEFAULT_MIN_BLOCK_TXS = 100;
+static const uint64_t kDEFAULT_TARGET_LATENCY_MS = 0;
 
 static const unsigned int kSYNC_PORT_BASE = 55330;
 static const std::string kURI_PREFIX ="RemoteURI-";
@@ -42,8 +52,10 @@ struct DevvContext {
               const std::string& node_key_path,
               const std::string& key_pass,
               unsigned int batch_size=10000,
-              unsigned int max_wait=0)
-      : current_node_(current_node)
+              unsigned int max_wait=0,
+              unsigned int peer_count=kDEFAULT_PEER_COUNT)
+      : peer_count_(peer_count)
+      , current_node_(current_node)
       , current_shard_(current_shard)
       , app_mode_(mode)
       , uri_(get_uri_from_index(current_node+current_shard*peer_count_))
@@ -78,10 +90,30 @@ struct DevvContext {
   std::string get_key_password() const { return key_pass_; }
   unsigned int get_batch_size() const {return batch_size_; }
   unsigned int get_max_wait() const {return max_wait_; }
+  eBlockEncoding get_block_encoding() const { return block_encoding_; }
+  void set_block_encoding(eBlockEncoding encoding) { block_encoding_ = encoding; }
+  bool get_thin_blocks() const { return thin_blocks_; }
+  void set_thin_blocks(bool thin_blocks) { thin_blocks_ = thin_blocks; }
+  unsigned int get_key_load_threads() const { return key_load_threads_; }
+  void set_key_load_threads(unsigned int num_threads) { key_load_threads_ = num_threads; }
+  bool get_verify_keys() const { return verify_keys_; }
+  void set_verify_keys(bool verify_keys) { verify_keys_ = verify_keys; }
+  std::string get_key_cache_dir() const { return key_cache_dir_; }
+  void set_key_cache_dir(const std::string& cache_dir) { key_cache_dir_ = cache_dir; }
+  size_t get_pool_max_txs() const { return pool_max_txs_; }
+  void set_pool_max_txs(size_t max_txs) { pool_max_txs_ = max_txs; }
+  size_t get_pool_max_bytes() const { return pool_max_bytes_; }
+  void set_pool_max_bytes(size_t max_bytes) { pool_max_bytes_ = max_bytes; }
+  uint64_t get_pool_tx_ttl_ms() const { return pool_tx_ttl_ms_; }
+  void set_pool_tx_ttl_ms(uint64_t ttl_ms) { pool_tx_ttl_ms_ = ttl_ms; }
+  size_t get_min_block_txs() const { return min_block_txs_; }
+  void set_min_block_txs(size_t min_txs) { min_block_txs_ = min_txs; }
+  uint64_t get_target_latency_ms() const { return target_latency_ms_; }
+  void set_target_latency_ms(uint64_t latency_ms) { target_latency_ms_ = latency_ms; }
 
 private:
-  /** Number of connected peers */
-  const size_t peer_count_ = 3;
+  /** Number of validators in a shard */
+  const size_t peer_count_;
 
   // Node index of this process
   unsigned int current_node_;
@@ -104,6 +136,30 @@ private:
 
   unsigned int batch_size_;
   unsigned int max_wait_;
+
+  // Encoding of outgoing FINAL_BLOCK and BLOCKS_SINCE messages
+  eBlockEncoding block_encoding_ = CanonicalBlocks;
+
+  // Send PROPOSAL_BLOCK and FINAL_BLOCK as thin blocks
+  bool thin_blocks_ = false;
+
+  // Threads used to decode key files, 0 for one per core
+  unsigned int key_load_threads_ = 0;
+
+  // Sign and verify a test message with every loaded key
+  bool verify_keys_ = true;
+
+  // Directory of decoded key caches, empty to disable caching
+  std::string key_cache_dir_;
+
+  // Limits of the unrecorded transaction pool, a TTL of 0 never expires
+  size_t pool_max_txs_ = kDEFAULT_POOL_MAX_TXS;
+  size_t pool_max_bytes_ = kDEFAULT_POOL_MAX_BYTES;
+  uint64_t pool_tx_ttl_ms_ = kDEFAULT_POOL_TX_TTL_MS;
+
+  // Bounds of adaptive block sizing, batch_size_ and max_wait_ are the upper bounds
+  size_t min_block_txs_ = kDEFAULT_MIN_BLOCK_TXS;
+  uint64_t target_latency_ms_ = kDEFAULT_TARGET_LATENCY_MS;
 };
 
 } /* namespace Devv */
@@ -24,4 +24,13 @@ enum eAppMode {
   scan = 2
 };
 
+/**
+ * Encoding used when sending blocks to other nodes
+ */
+enum eBlockEncoding : byte {
+  CanonicalBlocks = 0,
+  CompactBlocks = 1,
+  DeflatedBlocks = 2
+};
+
 } // namespace Devv
\ No newline at end of file
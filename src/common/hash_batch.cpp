@@ -0,0 +1,278 @@
+/*
+ * hash_batch.cpp hashes many independent messages with SHA-256.
+ *
+ * @copywrite  2018 Devvio Inc
+ */
+
+#include "common/hash_batch.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define DEVV_HASH_AVX2 1
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+#include "common/ossladapter.h"
+
+namespace Devv {
+
+namespace {
+
+/// Number of messages hashed together by the multi-buffer path
+static const size_t kHASH_LANES = 8;
+
+static const size_t kSHA256_BLOCK_SIZE = 64;
+
+/**
+ * @return the number of SHA-256 blocks of a padded message of len bytes
+ */
+size_t PaddedBlockCount(size_t len) {
+  return (len + 9 + kSHA256_BLOCK_SIZE - 1) / kSHA256_BLOCK_SIZE;
+}
+
+#ifdef DEVV_HASH_AVX2
+
+static const uint32_t kSHA256_K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+static const uint32_t kSHA256_IV[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+
+bool CpuHasAvx2() {
+  return __builtin_cpu_supports("avx2");
+}
+
+bool CpuHasShaNi() {
+  unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+  if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+    return false;
+  }
+  return ((ebx >> 29) & 1) != 0;
+}
+
+/**
+ * Write block b of the padded message to out
+ */
+void PaddedBlock(const std::vector<byte>& msg, size_t b, byte* out) {
+  size_t len = msg.size();
+  size_t begin = b * kSHA256_BLOCK_SIZE;
+  size_t n = 0;
+  if (begin < len) {
+    n = std::min(kSHA256_BLOCK_SIZE, len - begin);
+    std::memcpy(out, msg.data() + begin, n);
+  }
+  std::memset(out + n, 0, kSHA256_BLOCK_SIZE - n);
+  if (len >= begin && len < begin + kSHA256_BLOCK_SIZE) {
+    out[len - begin] = 0x80;
+  }
+  if (b + 1 == PaddedBlockCount(len)) {
+    uint64_t bits = static_cast<uint64_t>(len) * 8;
+    for (size_t i = 0; i < 8; ++i) {
+      out[kSHA256_BLOCK_SIZE - 1 - i] = static_cast<byte>(bits >> (8 * i));
+    }
+  }
+}
+
+#define DEVV_ROTR(x, n) _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - (n)))
+#define DEVV_XOR3(x, y, z) _mm256_xor_si256(_mm256_xor_si256(x, y), z)
+#define DEVV_ADD3(x, y, z) _mm256_add_epi32(_mm256_add_epi32(x, y), z)
+
+/**
+ * Hash up to kHASH_LANES messages of nblocks padded blocks each
+ * @param msgs - the messages, lanes past count repeat the first message
+ * @param count - the number of messages
+ * @param nblocks - the number of padded blocks of every message
+ * @param out - the hash of each message
+ */
+__attribute__((target("avx2")))
+void HashLanesAvx2(const std::vector<byte>* const* msgs, size_t count, size_t nblocks, Hash* const* out) {
+  const std::vector<byte>* lanes[kHASH_LANES];
+  for (size_t l = 0; l < kHASH_LANES; ++l) {
+    lanes[l] = msgs[l < count ? l : 0];
+  }
+
+  __m256i state[8];
+  for (size_t i = 0; i < 8; ++i) {
+    state[i] = _mm256_set1_epi32(static_cast<int>(kSHA256_IV[i]));
+  }
+
+  alignas(32) uint32_t words[16][kHASH_LANES];
+  byte tail[kSHA256_BLOCK_SIZE];
+  __m256i w[64];
+  for (size_t b = 0; b < nblocks; ++b) {
+    for (size_t l = 0; l < kHASH_LANES; ++l) {
+      const std::vector<byte>& msg = *lanes[l];
+      const byte* block;
+      if ((b + 1) * kSHA256_BLOCK_SIZE <= msg.size()) {
+        block = msg.data() + b * kSHA256_BLOCK_SIZE;
+      } else {
+        PaddedBlock(msg, b, tail);
+        block = tail;
+      }
+      for (size_t t = 0; t < 16; ++t) {
+        uint32_t word;
+        std::memcpy(&word, block + 4 * t, sizeof(word));
+        words[t][l] = __builtin_bswap32(word);
+      }
+    }
+
+    for (size_t t = 0; t < 16; ++t) {
+      w[t] = _mm256_load_si256(reinterpret_cast<const __m256i*>(words[t]));
+    }
+    for (size_t t = 16; t < 64; ++t) {
+      __m256i s0 = DEVV_XOR3(DEVV_ROTR(w[t - 15], 7), DEVV_ROTR(w[t - 15], 18), _mm256_srli_epi32(w[t - 15], 3));
+      __m256i s1 = DEVV_XOR3(DEVV_ROTR(w[t - 2], 17), DEVV_ROTR(w[t - 2], 19), _mm256_srli_epi32(w[t - 2], 10));
+      w[t] = _mm256_add_epi32(DEVV_ADD3(w[t - 16], s0, w[t - 7]), s1);
+    }
+
+    __m256i a = state[0], b_ = state[1], c = state[2], d = state[3];
+    __m256i e = state[4], f = state[5], g = state[6], h = state[7];
+    for (size_t t = 0; t < 64; ++t) {
+      __m256i s1 = DEVV_XOR3(DEVV_ROTR(e, 6), DEVV_ROTR(e, 11), DEVV_ROTR(e, 25));
+      __m256i ch = _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+      __m256i k = _mm256_set1_epi32(static_cast<int>(kSHA256_K[t]));
+      __m256i t1 = _mm256_add_epi32(DEVV_ADD3(h, s1, ch), _mm256_add_epi32(k, w[t]));
+      __m256i s0 = DEVV_XOR3(DEVV_ROTR(a, 2), DEVV_ROTR(a, 13), DEVV_ROTR(a, 22));
+      __m256i maj = _mm256_or_si256(_mm256_and_si256(a, b_), _mm256_and_si256(c, _mm256_or_si256(a, b_)));
+      __m256i t2 = _mm256_add_epi32(s0, maj);
+      h = g;
+      g = f;
+      f = e;
+      e = _mm256_add_epi32(d, t1);
+      d = c;
+      c = b_;
+      b_ = a;
+      a = _mm256_add_epi32(t1, t2);
+    }
+    state[0] = _mm256_add_epi32(state[0], a);
+    state[1] = _mm256_add_epi32(state[1], b_);
+    state[2] = _mm256_add_epi32(state[2], c);
+    state[3] = _mm256_add_epi32(state[3], d);
+    state[4] = _mm256_add_epi32(state[4], e);
+    state[5] = _mm256_add_epi32(state[5], f);
+    state[6] = _mm256_add_epi32(state[6], g);
+    state[7] = _mm256_add_epi32(state[7], h);
+  }
+
+  alignas(32) uint32_t digest[8][kHASH_LANES];
+  for (size_t i = 0; i < 8; ++i) {
+    _mm256_store_si256(reinterpret_cast<__m256i*>(digest[i]), state[i]);
+  }
+  for (size_t l = 0; l < count; ++l) {
+    for (size_t i = 0; i < 8; ++i) {
+      uint32_t word = __builtin_bswap32(digest[i][l]);
+      std::memcpy(out[l]->data() + 4 * i, &word, sizeof(word));
+    }
+  }
+}
+
+#undef DEVV_ROTR
+#undef DEVV_XOR3
+#undef DEVV_ADD3
+
+#else
+
+bool CpuHasAvx2() {
+  return false;
+}
+
+bool CpuHasShaNi() {
+  return false;
+}
+
+#endif /* DEVV_HASH_AVX2 */
+
+} // namespace
+
+std::vector<Hash> DevvHashBatchSerial(const std::vector<const std::vector<byte>*>& msgs) {
+  std::vector<Hash> hashes;
+  hashes.reserve(msgs.size());
+  for (auto msg : msgs) {
+    hashes.push_back(DevvHash(*msg));
+  }
+  return hashes;
+}
+
+std::vector<Hash> DevvHashBatchMultiBuffer(const std::vector<const std::vector<byte>*>& msgs) {
+#ifdef DEVV_HASH_AVX2
+  if (!HasMultiBufferHash()) {
+    return DevvHashBatchSerial(msgs);
+  }
+  std::vector<Hash> hashes(msgs.size());
+
+  // Group the messages by padded length, each group is hashed in passes of kHASH_LANES
+  std::vector<std::pair<size_t, size_t>> order;
+  order.reserve(msgs.size());
+  for (size_t i = 0; i < msgs.size(); ++i) {
+    order.emplace_back(PaddedBlockCount(msgs[i]->size()), i);
+  }
+  std::sort(order.begin(), order.end());
+
+  const std::vector<byte>* lanes[kHASH_LANES];
+  Hash* outs[kHASH_LANES];
+  size_t begin = 0;
+  while (begin < order.size()) {
+    size_t nblocks = order[begin].first;
+    size_t end = begin;
+    while (end < order.size() && end - begin < kHASH_LANES && order[end].first == nblocks) {
+      ++end;
+    }
+    size_t count = end - begin;
+    if (count < kHASH_BATCH_MIN_MULTI_BUFFER) {
+      // too few lanes to beat hashing them one at a time
+      for (size_t i = begin; i < end; ++i) {
+        hashes[order[i].second] = DevvHash(*msgs[order[i].second]);
+      }
+    } else {
+      for (size_t l = 0; l < count; ++l) {
+        lanes[l] = msgs[order[begin + l].second];
+        outs[l] = &hashes[order[begin + l].second];
+      }
+      HashLanesAvx2(lanes, count, nblocks, outs);
+    }
+    begin = end;
+  }
+  return hashes;
+#else
+  return DevvHashBatchSerial(msgs);
+#endif
+}
+
+std::vector<Hash> DevvHashBatch(const std::vector<const std::vector<byte>*>& msgs) {
+  if (msgs.size() >= kHASH_BATCH_MIN_MULTI_BUFFER && PrefersMultiBufferHash()) {
+    return DevvHashBatchMultiBuffer(msgs);
+  }
+  return DevvHashBatchSerial(msgs);
+}
+
+std::vector<Hash> DevvHashBatch(const std::vector<std::vector<byte>>& msgs) {
+  std::vector<const std::vector<byte>*> pointers;
+  pointers.reserve(msgs.size());
+  for (auto const& msg : msgs) {
+    pointers.push_back(&msg);
+  }
+  return DevvHashBatch(pointers);
+}
+
+bool HasMultiBufferHash() {
+  static const bool has_avx2 = CpuHasAvx2();
+  return has_avx2;
+}
+
+bool PrefersMultiBufferHash() {
+  // OpenSSL hashes a single message faster with SHA-NI than AVX2 hashes eight
+  static const bool prefers = HasMultiBufferHash() && !CpuHasShaNi();
+  return prefers;
+}
+
+} // namespace Devv
@@ -0,0 +1,66 @@
+/*
+ * hash_batch.h hashes many independent messages with SHA-256.
+ *
+ * DevvHash() hashes one message at a time through OpenSSL, which uses
+ * the SHA extensions (SHA-NI) when the CPU has them. Without SHA-NI,
+ * a batch is hashed eight messages at once in the lanes of AVX2 registers.
+ * Messages with the same number of SHA-256 blocks share a pass, so the
+ * multi-buffer path pays off for runs of similar Transactions.
+ *
+ * @copywrite  2018 Devvio Inc
+ */
+
+#ifndef COMMON_HASH_BATCH_H_
+#define COMMON_HASH_BATCH_H_
+
+#include <vector>
+
+#include "common/devv_types.h"
+
+namespace Devv {
+
+/// Smallest batch hashed with the multi-buffer path
+static const size_t kHASH_BATCH_MIN_MULTI_BUFFER = 4;
+
+/**
+ * Hash messages with SHA-256, choosing the fastest path for this CPU.
+ * @param msgs - pointers to the messages to hash, none may be null
+ * @return the hash of each message, in the order of msgs
+ */
+std::vector<Hash> DevvHashBatch(const std::vector<const std::vector<byte>*>& msgs);
+
+/**
+ * Hash messages with SHA-256, choosing the fastest path for this CPU.
+ * @param msgs - the messages to hash
+ * @return the hash of each message, in the order of msgs
+ */
+std::vector<Hash> DevvHashBatch(const std::vector<std::vector<byte>>& msgs);
+
+/**
+ * Hash messages one at a time with DevvHash().
+ * @param msgs - pointers to the messages to hash, none may be null
+ * @return the hash of each message, in the order of msgs
+ */
+std::vector<Hash> DevvHashBatchSerial(const std::vector<const std::vector<byte>*>& msgs);
+
+/**
+ * Hash messages eight at a time with AVX2.
+ * Falls back to DevvHashBatchSerial() if the CPU does not support AVX2.
+ * @param msgs - pointers to the messages to hash, none may be null
+ * @return the hash of each message, in the order of msgs
+ */
+std::vector<Hash> DevvHashBatchMultiBuffer(const std::vector<const std::vector<byte>*>& msgs);
+
+/**
+ * @return true iff this CPU can run the multi-buffer path
+ */
+bool HasMultiBufferHash();
+
+/**
+ * @return true iff DevvHashBatch() uses the multi-buffer path on this CPU
+ */
+bool PrefersMultiBufferHash();
+
+} // namespace Devv
+
+#endif /* COMMON_HASH_BATCH_H_ */
@@ -14,6 +14,102 @@ BOOST_LOG_GLOBAL_LOGGER_INIT(logger, src::severity_logger_mt) {
   return logger;
 }
 
+// Everything is enabled until init_log() reads the configured level
+std::atomic<int> devv_log_level(boost::log::trivial::trace);
+
+namespace {
+
+// Records are queued by the caller and written by the sink's own thread
+typedef sinks::bounded_fifo_queue<kLOG_QUEUE_SIZE, sinks::block_on_overflow> log_queue_t;
+typedef sinks::asynchronous_sink<sinks::text_ostream_backend, log_queue_t> ostream_sink_t;
+typedef sinks::asynchronous_sink<sinks::syslog_backend, log_queue_t> syslog_sink_t;
+
+boost::shared_ptr<ostream_sink_t> ostream_sink;
+boost::shared_ptr<syslog_sink_t> syslog_sink;
+
+} // namespace
+
+void init_log(const LoggerContext& context) {
+  /* init boost log
+   * 1. Add common attributes
+   * 2. set log filter to trace
+   */
+  boost::shared_ptr< logging::core > core = logging::core::get();
+
+  bool add_ostream_sink = true;
+  if (add_ostream_sink && !ostream_sink) {
+    // Create a backend and attach a couple of streams to it
+    boost::shared_ptr<sinks::text_ostream_backend> backend =
+        boost::make_shared<sinks::text_ostream_backend>();
+
+    typedef boost::shared_ptr<std::ostream> OStreamPtr;
+    backend->add_stream(OStreamPtr(&std::clog, boost::null_deleter()));
+    //backend->add_stream(OStreamPtr(new std::ofstream(LOGFILE)));
+
+    // Enable auto-flushing after each log record written
+    backend->auto_flush(true);
+
+    // Wrap it into the frontend and register in the core.
+    ostream_sink = boost::make_shared<ostream_sink_t>(backend);
+
+    ostream_sink->set_formatter
+        (
+            expr::stream
+                << Devv::Version::GIT_SHA1
+                << " " << std::hex << std::setw(6) << std::setfill('0') << line_id << std::dec << std::setfill(' ')
+                << " " << timestamp
+                << " " << severity
+                << " " << std::hex << std::setw(6) << thread_id
+                << " " << expr::smessage
+        );
+
+    core->add_sink(ostream_sink);
+  }
+
+  // Add syslog sink
+  if (context.syslog_hostname.size() > 1 && !syslog_sink) {
+    // Create a new backend
+    boost::shared_ptr< sinks::syslog_backend > backend(new sinks::syslog_backend(
+        logging::keywords::facility = sinks::syslog::local0,
+        logging::keywords::use_impl = sinks::syslog::udp_socket_based
+    ));
+
+    // Setup the target address and port to send syslog messages to
+    backend->set_target_address(context.syslog_hostname, context.syslog_port);
+
+    // Wrap it into the frontend and register in the core.
+    syslog_sink = boost::make_shared<syslog_sink_t>(backend);
+
+    core->add_sink(syslog_sink);
+  }
+  boost::log::add_common_attributes();
+  boost::log::trivial::severity_level level = GetLogLevel();
+  devv_log_level.store(level);
+  boost::log::core::get()->set_filter(boost::log::trivial::severity >= level);
+
+  static bool stop_registered = false;
+  if (!stop_registered) {
+    stop_registered = true;
+    std::atexit(stop_log);
+  }
+}
+
+void stop_log() {
+  boost::shared_ptr< logging::core > core = logging::core::get();
+  if (ostream_sink) {
+    core->remove_sink(ostream_sink);
+    ostream_sink->stop();
+    ostream_sink->flush();
+    ostream_sink.reset();
+  }
+  if (syslog_sink) {
+    core->remove_sink(syslog_sink);
+    syslog_sink->stop();
+    syslog_sink->flush();
+    syslog_sink.reset();
+  }
+}
+
 void init_log() {
   LoggerContext context;
   init_log(context);
@@ -7,7 +7,9 @@
 #ifndef DEVV_LOGGER_H
 #define DEVV_LOGGER_H
 
+#include <atomic>
 #include <cstdlib>
+#include <cstring>
 #include <thread>
 
 #define BOOST_LOG_DYN_LINK \
@@ -24,6 +26,9 @@
 #include <boost/log/utility/setup/console.hpp>
 #include <boost/log/utility/setup/common_attributes.hpp>
 #include <boost/log/support/date_time.hpp>
+#include <boost/log/sinks/async_frontend.hpp>
+#include <boost/log/sinks/bounded_fifo_queue.hpp>
+#include <boost/log/sinks/block_on_overflow.hpp>
 #include <boost/log/sinks/sync_frontend.hpp>
 #include <boost/log/sinks/text_file_backend.hpp>
 #include <boost/log/sinks/text_ostream_backend.hpp>
@@ -94,80 +99,52 @@ BOOST_LOG_ATTRIBUTE_KEYWORD(timestamp, "TimeStamp", boost::posix_time::ptime)
 BOOST_LOG_ATTRIBUTE_KEYWORD(severity, "Severity", logging::trivial::severity_level)
 BOOST_LOG_ATTRIBUTE_KEYWORD(thread_id, "ThreadID", attrs::current_thread_id::value_type)
 
-static void init_log(const LoggerContext& context) {
-  /* init boost log
-   * 1. Add common attributes
-   * 2. set log filter to trace
-   */
-  logger_t logger;
-
-  boost::shared_ptr< logging::core > core = logging::core::get();
-
-  bool add_ostream_sink = true;
-  if (add_ostream_sink) {
-    // Create a backend and attach a couple of streams to it
-    boost::shared_ptr<sinks::text_ostream_backend> backend =
-        boost::make_shared<sinks::text_ostream_backend>();
-
-    typedef boost::shared_ptr<std::ostream> OStreamPtr;
-    backend->add_stream(OStreamPtr(&std::clog, boost::null_deleter()));
-    //backend->add_stream(OStreamPtr(new std::ofstream(LOGFILE)));
-
-    // Enable auto-flushing after each log record written
-    backend->auto_flush(true);
-
-    // Wrap it into the frontend and register in the core.
-    // The backend requires synchronization in the frontend.
-    typedef sinks::synchronous_sink<sinks::text_ostream_backend> sink_t;
-    boost::shared_ptr<sink_t> sink(new sink_t(backend));
-
-    sink->set_formatter
-        (
-            expr::stream
-                << Devv::Version::GIT_SHA1
-                << " " << std::hex << std::setw(6) << std::setfill('0') << line_id << std::dec << std::setfill(' ')
-                << " " << timestamp
-                << " " << severity
-                << " " << std::hex << std::setw(6) << thread_id
-                << " " << expr::smessage
-        );
-
-    core->add_sink(sink);
-  }
+/// Number of records the asynchronous sinks hold before callers block
+static const unsigned int kLOG_QUEUE_SIZE = 65536;
 
-  // Add syslog sink
-  if (context.syslog_hostname.size() > 1) {
-    // Create a new backend
-    boost::shared_ptr< sinks::syslog_backend > backend(new sinks::syslog_backend(
-        logging::keywords::facility = sinks::syslog::local0,
-        logging::keywords::use_impl = sinks::syslog::udp_socket_based
-    ));
+/**
+ * Lowest severity compiled into the binary. Records below it are
+ * removed by the compiler, so their arguments are never evaluated.
+ * Set with -DDEVV_LOG_MIN_LEVEL=<0..5> (trace..fatal).
+ */
+#ifndef DEVV_LOG_MIN_LEVEL
+#define DEVV_LOG_MIN_LEVEL 0
+#endif
 
-    // Setup the target address and port to send syslog messages to
-    backend->set_target_address(context.syslog_hostname, context.syslog_port);
+/**
+ * Lowest severity accepted at runtime, set by init_log().
+ * Checked before a record is opened so filtered records cost one load.
+ */
+extern std::atomic<int> devv_log_level;
 
-    // Wrap it into the frontend and register in the core.
-    // The backend requires synchronization in the frontend.
-    typedef sinks::synchronous_sink<sinks::syslog_backend> sink_t;
-    boost::shared_ptr<sink_t> sink(new sink_t(backend));
+/**
+ * Initialize logging. Records are formatted and written by
+ * the sinks' own threads, callers only queue them.
+ * @param context
+ */
+void init_log(const LoggerContext& context);
 
-    core->add_sink(sink);
-  }
-  boost::log::add_common_attributes();
-  boost::log::core::get()->set_filter(boost::log::trivial::severity >= GetLogLevel());
-}
+/**
+ * Write the queued records and stop the logging threads.
+ * Registered with atexit() by init_log().
+ */
+void stop_log();
 
 void init_log();
 
-static inline std::string file_cut(const char* file) {
-  std::string s(file);
-  auto p = s.rfind("src");
-  auto st = s.substr(p);
-  return st;
+static inline const char* file_cut(const char* file) {
+  const char* src = std::strstr(file, "src/");
+  return (src == nullptr) ? file : src;
 }
 
+#define LOG_ENABLED(severity) \
+  ((boost::log::trivial::severity >= DEVV_LOG_MIN_LEVEL) \
+   && (boost::log::trivial::severity >= devv_log_level.load(std::memory_order_relaxed)))
+
 // just a helper macro used by the macros below - don't use it in your code
+// The streamed arguments are only evaluated if the record is enabled.
 #define LOG(severity) \
+  if (!LOG_ENABLED(severity)) {} else \
   BOOST_LOG_SEV(logger::get(), boost::log::trivial::severity) \
   << file_cut(__FILE__) << ":" << __LINE__ << " " << __FUNCTION__ << " -> "
 
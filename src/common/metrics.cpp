@@ -0,0 +1,178 @@
+/*
+ * metrics.cpp implements counters, gauges and histograms for Devv.
+ *
+ * @copywrite  2018 Devvio Inc
+ */
+
+#include "common/metrics.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#include "common/logger.h"
+
+namespace Devv {
+
+namespace {
+
+/**
+ * Convert a hierarchical metric name to a Prometheus name
+ */
+std::string ExportName(const std::string& name) {
+  std::string out("devv_");
+  for (char c : name) {
+    out.push_back(std::isalnum(static_cast<unsigned char>(c)) ? c : '_');
+  }
+  return out;
+}
+
+size_t BucketIndex(uint64_t value) {
+  size_t index = 0;
+  while (value > 0 && index < Histogram::kNUM_BUCKETS - 1) {
+    value >>= 1;
+    ++index;
+  }
+  return index;
+}
+
+} // namespace
+
+void Histogram::record(uint64_t value) {
+  buckets_[BucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+  sum_.fetch_add(value, std::memory_order_relaxed);
+  uint64_t prev_max = max_.load(std::memory_order_relaxed);
+  while (value > prev_max
+      && !max_.compare_exchange_weak(prev_max, value, std::memory_order_relaxed)) {
+  }
+}
+
+uint64_t Histogram::quantile(double q) const {
+  uint64_t total = count();
+  if (total == 0) {
+    return 0;
+  }
+  uint64_t rank = static_cast<uint64_t>(q * total);
+  if (rank >= total) {
+    rank = total - 1;
+  }
+  uint64_t seen = 0;
+  for (size_t i = 0; i < kNUM_BUCKETS; ++i) {
+    seen += buckets_[i].load(std::memory_order_relaxed);
+    if (seen > rank) {
+      uint64_t upper = (i == 0) ? 0 : ((uint64_t(1) << i) - 1);
+      return std::min(upper, max());
+    }
+  }
+  return max();
+}
+
+MetricsRegistry& MetricsRegistry::Get() {
+  static MetricsRegistry registry;
+  return registry;
+}
+
+Counter& MetricsRegistry::counter(const std::string& name) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  auto& metric = counters_[name];
+  if (!metric) {
+    metric = std::make_unique<Counter>();
+  }
+  return *metric;
+}
+
+Gauge& MetricsRegistry::gauge(const std::string& name) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  auto& metric = gauges_[name];
+  if (!metric) {
+    metric = std::make_unique<Gauge>();
+  }
+  return *metric;
+}
+
+Histogram& MetricsRegistry::histogram(const std::string& name) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  auto& metric = histograms_[name];
+  if (!metric) {
+    metric = std::make_unique<Histogram>();
+  }
+  return *metric;
+}
+
+std::string MetricsRegistry::getText() const {
+  std::lock_guard<std::mutex> guard(mutex_);
+  std::stringstream out;
+  for (auto const& item : counters_) {
+    std::string name(ExportName(item.first));
+    out << "# TYPE " << name << " counter\n";
+    out << name << " " << item.second->value() << "\n";
+  }
+  for (auto const& item : gauges_) {
+    std::string name(ExportName(item.first));
+    out << "# TYPE " << name << " gauge\n";
+    out << name << " " << item.second->value() << "\n";
+  }
+  for (auto const& item : histograms_) {
+    std::string name(ExportName(item.first));
+    const Histogram& histogram = *item.second;
+    out << "# TYPE " << name << " summary\n";
+    out << name << "{quantile=\"0.5\"} " << histogram.quantile(0.5) << "\n";
+    out << name << "{quantile=\"0.9\"} " << histogram.quantile(0.9) << "\n";
+    out << name << "{quantile=\"0.99\"} " << histogram.quantile(0.99) << "\n";
+    out << name << "{quantile=\"1\"} " << histogram.max() << "\n";
+    out << name << "_sum " << histogram.sum() << "\n";
+    out << name << "_count " << histogram.count() << "\n";
+  }
+  return out.str();
+}
+
+MetricsReporter::MetricsReporter(const std::string& path, unsigned int interval_secs)
+    : path_(path)
+    , interval_secs_(interval_secs) {
+  if (interval_secs_ > 0) {
+    do_run_ = true;
+    thread_ = std::thread(&MetricsReporter::loop, this);
+  }
+}
+
+MetricsReporter::~MetricsReporter() {
+  if (do_run_) {
+    {
+      std::lock_guard<std::mutex> guard(mutex_);
+      do_run_ = false;
+    }
+    cv_.notify_all();
+    thread_.join();
+  }
+}
+
+void MetricsReporter::report() {
+  std::string text(MetricsRegistry::Get().getText());
+  if (!path_.empty()) {
+    // write a temporary file and rename it so scrapers never see a partial report
+    std::string tmp_path(path_ + ".tmp");
+    {
+      std::ofstream file(tmp_path, std::ios::trunc);
+      file << text;
+    }
+    if (std::rename(tmp_path.c_str(), path_.c_str()) != 0) {
+      LOG_WARNING << "MetricsReporter: failed to write " << path_;
+    }
+  }
+  LOG_INFO << "Metrics:\n" << text;
+}
+
+void MetricsReporter::loop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (do_run_) {
+    cv_.wait_for(lock, std::chrono::seconds(interval_secs_), [this]() { return !do_run_; });
+    if (do_run_) {
+      report();
+    }
+  }
+}
+
+} // namespace Devv
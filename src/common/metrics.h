@@ -0,0 +1,196 @@
+/*
+ * metrics.h counters, gauges and histograms for Devv.
+ *
+ * Metrics are registered by name in the process wide MetricsRegistry.
+ * Names are hierarchical, with '.' separating the levels
+ * (i.e. consensus.proposal.build_us), so a dump groups related metrics.
+ * Recording a value is lock-free; only registration takes a lock,
+ * so hot paths should keep a reference to their metric:
+ *
+ *   static Histogram& build = MetricsRegistry::Get().histogram("consensus.proposal.build_us");
+ *   ScopedTimer timer(build);
+ *
+ * A MetricsReporter periodically writes the registry in the
+ * Prometheus text format to a file and to the log.
+ *
+ * @copywrite  2018 Devvio Inc
+ */
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace Devv {
+
+/**
+ * A monotonically increasing count
+ */
+class Counter {
+ public:
+  void add(uint64_t n = 1) { value_.fetch_add(n, std::memory_order_relaxed); }
+
+  uint64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+ private:
+  std::atomic<uint64_t> value_ = ATOMIC_VAR_INIT(0);
+};
+
+/**
+ * A value that may go up and down, such as a queue depth
+ */
+class Gauge {
+ public:
+  void set(int64_t value) { value_.store(value, std::memory_order_relaxed); }
+
+  void add(int64_t n) { value_.fetch_add(n, std::memory_order_relaxed); }
+
+  int64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+ private:
+  std::atomic<int64_t> value_ = ATOMIC_VAR_INIT(0);
+};
+
+/**
+ * A distribution of values in power of two buckets.
+ * Bucket i counts the values v with 2^(i-1) <= v < 2^i.
+ */
+class Histogram {
+ public:
+  static const size_t kNUM_BUCKETS = 64;
+
+  /**
+   * Record one value
+   * @param value
+   */
+  void record(uint64_t value);
+
+  uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+
+  uint64_t sum() const { return sum_.load(std::memory_order_relaxed); }
+
+  uint64_t max() const { return max_.load(std::memory_order_relaxed); }
+
+  /**
+   * Estimate a quantile from the buckets
+   * @param q the quantile in [0, 1]
+   * @return an upper bound of the quantile, 0 if nothing was recorded
+   */
+  uint64_t quantile(double q) const;
+
+ private:
+  std::array<std::atomic<uint64_t>, kNUM_BUCKETS> buckets_ = {};
+  std::atomic<uint64_t> count_ = ATOMIC_VAR_INIT(0);
+  std::atomic<uint64_t> sum_ = ATOMIC_VAR_INIT(0);
+  std::atomic<uint64_t> max_ = ATOMIC_VAR_INIT(0);
+};
+
+/**
+ * Records the microseconds between construction and destruction in a Histogram
+ */
+class ScopedTimer {
+ public:
+  explicit ScopedTimer(Histogram& histogram)
+      : histogram_(histogram)
+      , start_(std::chrono::steady_clock::now()) {}
+
+  ~ScopedTimer() {
+    auto elapsed = std::chrono::steady_clock::now() - start_;
+    histogram_.record(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+  }
+
+  ScopedTimer(const ScopedTimer&) = delete;
+  ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+ private:
+  Histogram& histogram_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+/**
+ * The process wide directory of metrics
+ */
+class MetricsRegistry {
+ public:
+  /**
+   * @return the registry of this process
+   */
+  static MetricsRegistry& Get();
+
+  /**
+   * Get or create a Counter. The reference stays valid for the life of the process.
+   * @param name hierarchical name of the metric
+   * @return the Counter
+   */
+  Counter& counter(const std::string& name);
+
+  /**
+   * Get or create a Gauge. The reference stays valid for the life of the process.
+   * @param name hierarchical name of the metric
+   * @return the Gauge
+   */
+  Gauge& gauge(const std::string& name);
+
+  /**
+   * Get or create a Histogram. The reference stays valid for the life of the process.
+   * @param name hierarchical name of the metric
+   * @return the Histogram
+   */
+  Histogram& histogram(const std::string& name);
+
+  /**
+   * Get every metric in the Prometheus text format.
+   * Names are prefixed with devv_ and '.' becomes '_'.
+   * @return the metrics, sorted by name
+   */
+  std::string getText() const;
+
+ private:
+  MetricsRegistry() = default;
+
+  std::map<std::string, std::unique_ptr<Counter>> counters_;
+  std::map<std::string, std::unique_ptr<Gauge>> gauges_;
+  std::map<std::string, std::unique_ptr<Histogram>> histograms_;
+  mutable std::mutex mutex_;
+};
+
+/**
+ * Periodically writes the MetricsRegistry to a file and to the log
+ */
+class MetricsReporter {
+ public:
+  /**
+   * Constructor
+   * @param path file to write, replaced on every report; empty to only log
+   * @param interval_secs seconds between reports, 0 disables reporting
+   */
+  MetricsReporter(const std::string& path, unsigned int interval_secs);
+
+  ~MetricsReporter();
+
+  MetricsReporter(const MetricsReporter&) = delete;
+  MetricsReporter& operator=(const MetricsReporter&) = delete;
+
+  /**
+   * Write one report now
+   */
+  void report();
+
+ private:
+  void loop();
+
+  const std::string path_;
+  const unsigned int interval_secs_;
+  std::atomic<bool> do_run_ = ATOMIC_VAR_INIT(false);
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::thread thread_;
+};
+
+} // namespace Devv
@@ -11,6 +11,7 @@
 #ifndef DEVV_UTIL_H
 #define DEVV_UTIL_H
 
+#include <algorithm>
 #include <atomic>
 #include <chrono>
 #include <exception>
@@ -28,6 +29,7 @@
 #include "common/devv_constants.h"
 #include "common/logger.h"
 #include "common/minitrace.h"
+#include "concurrency/WorkStealingExecutor.h"
 
 namespace Devv
 {
@@ -229,50 +231,32 @@ private:
 };
 
 /**
- * Threadpool. A simple ThreadPool class.
+ * Threadpool. Parallel loops on the shared WorkStealingExecutor.
  */
 class ThreadPool {
 
 public:
 
+  /**
+   * Call func(i) for every i in [start, end) and wait for all calls.
+   * @param max_threads - the most threads calling func at once, 0 for every
+   *   thread of the shared executor and the calling thread
+   */
   template<typename Index, typename Callable>
-  static void ParallelFor(Index start, Index end, Callable func, unsigned n_cpu_factor = 1) {
-    // Estimate number of threads in the pool
-    const static unsigned nb_threads_hint = unsigned (std::thread::hardware_concurrency()/n_cpu_factor);
-    const static unsigned nb_threads = (nb_threads_hint == 0u ? 8u : nb_threads_hint);
-
-    // Size of a slice for the range functions
-    Index n = end - start + 1;
-    Index slice = (Index) std::round(n / static_cast<double> (nb_threads));
-    slice = std::max(slice, Index(1));
-
-    // [Helper] Inner loop
-    auto launchRange = [&func] (int k1, int k2) {
-      for (Index k = k1; k < k2; k++) {
-        func(k);
-      }
-    };
-
-    // Create pool and launch jobs
-    std::vector<std::thread> pool;
-    pool.reserve(nb_threads);
-    Index i1 = start;
-    Index i2 = std::min(start + slice, end);
-    for (unsigned i = 0; i + 1 < nb_threads && i1 < end; ++i) {
-      pool.emplace_back(launchRange, i1, i2);
-      i1 = i2;
-      i2 = std::min(i2 + slice, end);
-    }
-    if (i1 < end) {
-      pool.emplace_back(launchRange, i1, end);
+  static void ParallelFor(Index start, Index end, Callable func, size_t max_threads = 0) {
+    WorkStealingExecutor& executor = WorkStealingExecutor::Get();
+    if (max_threads == 0 || max_threads > executor.size()) {
+      executor.ParallelFor(start, end, func);
+      return;
     }
-
-    // Wait for jobs to finish
-    for (std::thread &t : pool) {
-      if (t.joinable()) {
-        t.join();
+    // each of max_threads lanes takes the next index until none are left
+    size_t count = end > start ? static_cast<size_t>(end - start) : 0;
+    std::atomic<size_t> next(0);
+    executor.ParallelFor(size_t(0), std::min(max_threads, count), [&](size_t) {
+      for (size_t i = next++; i < count; i = next++) {
+        func(static_cast<Index>(start + i));
       }
-    }
+    }, 1);
   }
 
   // Serial version for easy comparison
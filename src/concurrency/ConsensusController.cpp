@@ -23,6 +23,7 @@ ConsensusController::ConsensusController(const KeyRing &keys,
     , final_block_cb_(HandleFinalBlock)
     , proposal_block_cb_(HandleProposalBlock)
     , validation_block_cb_(HandleValidationBlock)
+    , transaction_request_cb_(HandleTransactionRequest)
 {
 }
 void ConsensusController::consensusCallback(DevvMessageUniquePtr ptr) {
@@ -47,7 +48,7 @@ void ConsensusController::consensusCallback(DevvMessageUniquePtr ptr) {
                                              context_,
                                              keys_,
                                              final_chain_,
-                                             utx_pool_.get_transaction_creation_manager(),
+                                             utx_pool_,
                                              [this](DevvMessageUniquePtr p) { this->outgoing_callback_(std::move(p)); });
         break;
       case eMessageType::VALID:LOG_DEBUG << "ConsensusController()::consensusCallback(): VALIDATION";
@@ -59,6 +60,15 @@ void ConsensusController::consensusCallback(DevvMessageUniquePtr ptr) {
                                                  this->outgoing_callback_(std::move(p));
                                                });
         break;
+      case eMessageType::REQUEST_TRANSACTIONS:LOG_DEBUG << "ConsensusController()::consensusCallback(): REQUEST_TRANSACTIONS";
+        transaction_request_cb_(std::move(ptr),
+                                context_,
+                                final_chain_,
+                                utx_pool_,
+                                [this](DevvMessageUniquePtr p) {
+                                  this->outgoing_callback_(std::move(p));
+                                });
+        break;
       default:
         throw DevvMessageError("consensusCallback(): Unexpected message type:"
                                       + std::to_string(ptr->message_type));
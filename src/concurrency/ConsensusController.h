@@ -25,7 +25,7 @@ typedef std::function<bool(DevvMessageUniquePtr ptr,
                            const DevvContext &context,
                            const KeyRing &keys,
                            Blockchain &final_chain,
-                           TransactionCreationManager &tcm,
+                           UnrecordedTransactionPool &utx_pool,
                            std::function<void(DevvMessageUniquePtr)> callback)> ProposalBlockCallback;
 
 typedef std::function<bool(DevvMessageUniquePtr ptr,
@@ -33,6 +33,12 @@ typedef std::function<bool(DevvMessageUniquePtr ptr,
                            Blockchain &final_chain,
                            UnrecordedTransactionPool &utx_pool,
                            std::function<void(DevvMessageUniquePtr)> callback)> ValidationBlockCallback;
+
+typedef std::function<bool(DevvMessageUniquePtr ptr,
+                           const DevvContext &context,
+                           Blockchain &final_chain,
+                           UnrecordedTransactionPool &utx_pool,
+                           std::function<void(DevvMessageUniquePtr)> callback)> TransactionRequestCallback;
  public:
   ConsensusController(const KeyRing& keys,
                       DevvContext& context,
@@ -64,6 +70,7 @@ typedef std::function<bool(DevvMessageUniquePtr ptr,
   FinalBlockCallback final_block_cb_;
   ProposalBlockCallback proposal_block_cb_;
   ValidationBlockCallback validation_block_cb_;
+  TransactionRequestCallback transaction_request_cb_;
 
 };
 
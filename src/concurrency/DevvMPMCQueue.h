@@ -71,6 +71,13 @@ class DevvMPMCQueue {
     return pointer;
   }
 
+  /**
+   * @return the approximate number of queued messages
+   */
+  size_t size() const {
+    return queue_.size_approx();
+  }
+
   void ClearBlockers() {
     keep_popping_ = false;
   }
@@ -8,8 +8,9 @@
 
 namespace Devv {
 
-ThreadGroup::ThreadGroup(size_t num_threads)
-  : num_threads_(num_threads) {
+ThreadGroup::ThreadGroup(size_t num_threads, const std::string& name)
+  : num_threads_(num_threads)
+  , queue_depth_(MetricsRegistry::Get().gauge(name + ".queue_depth")) {
   /// @todo mckenney - magic number
   if (num_threads > 32) {
     LOG_WARNING << "ThreadGroup created with " << num_threads_ << " threads!";
@@ -28,6 +29,7 @@ void ThreadGroup::pushMessage(DevvMessageUniquePtr message) {
   if (message == nullptr) {
     throw std::runtime_error("pushMessage(): cannot push a nullptr to the input queue");
   }
+  queue_depth_.add(1);
   thread_queue_.push(std::move(message));
 }
 
@@ -68,8 +70,14 @@ void ThreadGroup::loop() {
                              "a callback function is set. Call attachCallback() first please");
     }
     while (do_run_) {
-      message_callback_(std::move(thread_queue_.pop()));
-      LOG_INFO << "ThreadGroup::loop() - popped a message";
+      auto message = thread_queue_.pop();
+      if (message == nullptr) {
+        // the queue was cleared by stop()
+        continue;
+      }
+      queue_depth_.add(-1);
+      message_callback_(std::move(message));
+      LOG_DEBUG << "ThreadGroup::loop() - popped a message";
     }
     LOG_INFO << "ThreadGroup::loop() exit";
   } catch (const std::exception& e) {
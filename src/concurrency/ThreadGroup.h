@@ -7,6 +7,7 @@
 #include <boost/thread/thread.hpp>
 #include "types/DevvMessage.h"
 #include "common/devv_constants.h"
+#include "common/metrics.h"
 #include "concurrency/DevvMPMCQueue.h"
 
 namespace Devv {
@@ -17,7 +18,13 @@ namespace Devv {
  */
 class ThreadGroup {
  public:
-  explicit ThreadGroup(size_t num_threads = kDEFAULT_WORKERS);
+  /**
+   * Constructor
+   * @param num_threads
+   * @param name prefix of this group's metrics
+   */
+  explicit ThreadGroup(size_t num_threads = kDEFAULT_WORKERS,
+                       const std::string& name = "thread_group");
 
   /**
    * Attach a function to be called when an message arrives
@@ -63,6 +70,8 @@ class ThreadGroup {
   DevvMessageCallback message_callback_ = nullptr;
   /// True when running - false signals all threads to stop gracefully
   std::atomic<bool> do_run_ = ATOMIC_VAR_INIT(false);
+  /// Number of messages waiting in thread_queue_
+  Gauge& queue_depth_;
 };
 
 } // namespace Devv
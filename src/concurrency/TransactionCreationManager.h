@@ -9,57 +9,33 @@
 #ifndef CONCURRENCY_TRANSACTIONCREATIONMANAGER_H_
 #define CONCURRENCY_TRANSACTIONCREATIONMANAGER_H_
 
-#include <boost/bind.hpp>
-#include <boost/asio.hpp>
-#include <boost/thread/thread_pool.hpp>
-#include <boost/thread.hpp>
+#include <thread>
 
+#include "common/hash_batch.h"
+#include "concurrency/VerifiedTransactionCache.h"
+#include "concurrency/WorkStealingExecutor.h"
 #include "primitives/buffers.h"
 #include "primitives/factories.h"
 
 namespace Devv
 {
 
-typedef boost::packaged_task<bool> task_t;
-typedef boost::shared_ptr<task_t> ptask_t;
-
-static inline void push_job(Transaction& x
-              , const KeyRing& keyring
-              , boost::asio::io_service& io_service
-              , std::vector<boost::shared_future<bool>>& pending_data) {
-  ptask_t task = boost::make_shared<task_t>([&x, &keyring]() {
-      x.setIsSound(keyring);
-      return(true);
-    });
-  boost::shared_future<bool> fut(task->get_future());
-  pending_data.push_back(fut);
-  io_service.post(boost::bind(&task_t::operator(), task));
-}
-
 class TransactionCreationManager {
 public:
   TransactionCreationManager(TransactionCreationManager&) = delete;
 
   TransactionCreationManager(eAppMode mode, int num_threads = -1)
-    : io_service_()
-    , threads_()
-    , work_(io_service_)
-    , app_mode_(mode)
-    , num_threads_(num_threads)
+    : app_mode_(mode)
+    , num_threads_(num_threads < 0 ? std::thread::hardware_concurrency() : num_threads)
+    , executor_(num_threads_)
+    , verified_()
   {
-    if (num_threads_ < 0) {
-      num_threads_ = boost::thread::hardware_concurrency();
-    }
     LOG_DEBUG << "TransactionCreationManager: setting thread count to " << num_threads_;
-    for (int i = 0; i < num_threads_; ++i)
-    {
-        threads_.create_thread(boost::bind(&boost::asio::io_service::run,
-                                          &io_service_));
-    }
   }
 
   /**
    * Create Transactions objects from serialized binary data.
+   * Transactions found in the verified cache skip signature verification.
    * @param buffer - buffer containing a binary series of Transactions
    * @param vtx - (out) target vector for pointers to the Transaction objects
    * @param start_size - the starting offset of Transaction bytes in the buffer
@@ -83,23 +59,32 @@ public:
       vtx.push_back(std::move(tx));
     }
 
-    if (num_threads_ > 0) {
-      std::vector<boost::shared_future<bool>> pending_data; // vector of futures
-
-      for (auto& tx : vtx) {
-        push_job(*tx, *keys_p_, io_service_, pending_data);
-      }
-
-      boost::wait_for_all(pending_data.begin(), pending_data.end());
-    } else {
-      for (auto& tx : vtx) {
-        tx->isSound(*keys_p_);
-      }
-
+    // The cache ids of all Transactions are hashed together
+    std::vector<const std::vector<byte>*> canonicals;
+    canonicals.reserve(vtx.size());
+    for (auto const& tx : vtx) {
+      canonicals.push_back(&tx->getCanonical());
     }
+    std::vector<Hash> ids(DevvHashBatch(canonicals));
+
+    executor_.ParallelFor(size_t(0), vtx.size(), [&](size_t i) {
+      verified_.setIsSound(*vtx[i], *keys_p_, ids[i]);
+    });
     return raw_txs;
   }
 
+  /**
+   * Call fn(i) for every i in [0, count) on the worker threads and wait for all calls.
+   * @note the calling thread runs calls too, so this may be called from fn
+   * @param count - the number of calls
+   * @param fn - the function to call
+   * @param chunk_size - calls per task, 0 to let the executor choose
+   */
+  template <typename Function>
+  void ParallelFor(size_t count, Function fn, size_t chunk_size = 0) {
+    executor_.ParallelFor(size_t(0), count, fn, chunk_size);
+  }
+
   /**
    * Set a pointer to the directory of keys and address.
    * @param keys - a pointer to the directory of keys and addresses.
@@ -108,13 +93,19 @@ public:
     keys_p_ = keys;
   }
 
+  /**
+   * @return the cache of Transactions already proven sound
+   */
+  VerifiedTransactionCache& get_verified_cache() {
+    return verified_;
+  }
+
  private:
   const KeyRing* keys_p_ = nullptr;
-  boost::asio::io_service io_service_;
-  boost::thread_group threads_;
-  boost::asio::io_service::work work_;
   const eAppMode app_mode_;
   int num_threads_;
+  WorkStealingExecutor executor_;
+  VerifiedTransactionCache verified_;
 };
 
 }
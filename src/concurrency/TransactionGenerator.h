@@ -0,0 +1,153 @@
+/*
+ * TransactionGenerator.h generates test Transactions on a pool of threads.
+ *
+ * The generators (laminar-gen, turbulent-gen, circuit-gen, devv-loadgen)
+ * describe the Transaction at every index of their output. The indexes are
+ * split into chunks, each chunk is built in parts on the shared
+ * WorkStealingExecutor and written to the output in index order while
+ * the next chunk is built. The output only depends on the index, never
+ * on the number of threads.
+ *
+ * @copywrite  2018 Devvio Inc
+ */
+
+#ifndef CONCURRENCY_TRANSACTIONGENERATOR_H_
+#define CONCURRENCY_TRANSACTIONGENERATOR_H_
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+#include "common/devv_types.h"
+#include "concurrency/WorkStealingExecutor.h"
+
+namespace Devv
+{
+
+/// Default number of Transactions in a chunk of output
+static const size_t kGENERATOR_CHUNK_SIZE = 10000;
+
+class TransactionGenerator {
+ public:
+  /**
+   * Appends the canonical form of the Transaction at an index to a buffer.
+   * Called concurrently from several threads.
+   */
+  typedef std::function<void(size_t index, std::vector<byte>& out)> MakeFunction;
+
+  /**
+   * Constructor
+   * @param num_threads - the number of parts built at once, 0 for one per core
+   * @param chunk_size - the number of Transactions written at once
+   */
+  explicit TransactionGenerator(unsigned int num_threads, size_t chunk_size = kGENERATOR_CHUNK_SIZE)
+    : num_threads_(num_threads > 0 ? num_threads : std::max(1u, std::thread::hardware_concurrency()))
+    , chunk_size_(std::max<size_t>(1, chunk_size))
+  {
+  }
+
+  /**
+   * Generate Transactions and stream them to out
+   * @param count - the number of Transactions to generate
+   * @param make - builds the Transaction at an index
+   * @param out - the output stream, or nullptr to discard the Transactions
+   * @return the number of bytes generated
+   * @throw the first exception thrown by make
+   */
+  size_t generate(size_t count, const MakeFunction& make, std::ostream* out) {
+    auto start = std::chrono::steady_clock::now();
+    size_t total_bytes = 0;
+    std::vector<std::vector<byte>> building(num_threads_);
+    std::vector<std::vector<byte>> writing(num_threads_);
+    std::future<void> pending_write;
+
+    for (size_t begin = 0; begin < count; begin += chunk_size_) {
+      size_t end = std::min(count, begin + chunk_size_);
+      buildChunk(begin, end, make, building);
+      if (pending_write.valid()) {
+        pending_write.get();
+      }
+      std::swap(building, writing);
+      for (auto const& buffer : writing) {
+        total_bytes += buffer.size();
+      }
+      if (out == nullptr) {
+        continue;
+      }
+      auto write = [out, &writing]() {
+        for (auto const& buffer : writing) {
+          out->write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+        }
+      };
+      if (end < count) {
+        pending_write = std::async(std::launch::async, write);
+      } else {
+        write();
+      }
+    }
+    if (pending_write.valid()) {
+      pending_write.get();
+    }
+
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    elapsed_ms_ = std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count();
+    generated_ = count;
+    return total_bytes;
+  }
+
+  /**
+   * @return the Transactions per second of the last call to generate()
+   */
+  double getRate() const {
+    return (elapsed_ms_ > 0) ? (generated_ * 1000.0 / elapsed_ms_) : 0.0;
+  }
+
+  /**
+   * @return the milliseconds taken by the last call to generate()
+   */
+  uint64_t getElapsedMillis() const { return elapsed_ms_; }
+
+  /**
+   * A pseudo-random value determined by a seed and an index (splitmix64).
+   * Lets every thread draw the same values for an index.
+   * @param seed
+   * @param index
+   * @return a pseudo-random value
+   */
+  static uint64_t Random(uint64_t seed, uint64_t index) {
+    uint64_t z = seed + (index + 1) * 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+  }
+
+ private:
+  /**
+   * Build [begin, end) into one buffer per part, in index order
+   */
+  void buildChunk(size_t begin, size_t end, const MakeFunction& make
+                  , std::vector<std::vector<byte>>& buffers) {
+    size_t per_part = (end - begin + num_threads_ - 1) / num_threads_;
+    WorkStealingExecutor::Get().ParallelFor(0u, num_threads_, [&](unsigned int t) {
+      buffers[t].clear();
+      size_t first = std::min(end, begin + t * per_part);
+      size_t last = std::min(end, first + per_part);
+      for (size_t i = first; i < last; ++i) {
+        make(i, buffers[t]);
+      }
+    }, 1);
+  }
+
+  const unsigned int num_threads_;
+  const size_t chunk_size_;
+  uint64_t elapsed_ms_ = 0;
+  size_t generated_ = 0;
+};
+
+} // namespace Devv
+
+#endif /* CONCURRENCY_TRANSACTIONGENERATOR_H_ */
@@ -51,6 +51,24 @@ ValidatorController::~ValidatorController() {
   LOG_DEBUG << "~ValidatorController()";
 }
 
+void ValidatorController::publishLoadReport() {
+  if (load_report_timer_.elapsed() < kLOAD_REPORT_INTERVAL_MS) {
+    return;
+  }
+  load_report_timer_.reset();
+  LoadReport report(utx_pool_.getLoadReport());
+  report.node_index = context_.get_current_node();
+  if (queue_depth_cb_) {
+    report.queue_depth = queue_depth_cb_();
+  }
+  LOG_DEBUG << "Load report: occupancy " << report.getOccupancy()
+            << " queue depth " << report.queue_depth;
+  outgoing_callback_(std::make_unique<DevvMessage>(GetLoadReportUri(context_.get_shard_uri()),
+                                                   LOAD_REPORT,
+                                                   EncodeLoadReport(report),
+                                                   report.node_index));
+}
+
 void ValidatorController::validatorCallback(DevvMessageUniquePtr ptr) {
   LOG_DEBUG << "ValidatorController::validatorCallback()";
   //Do not remove lock_guard, function may use atomic<bool> as concurrency signal
@@ -65,6 +83,7 @@ void ValidatorController::validatorCallback(DevvMessageUniquePtr ptr) {
   if (ptr->message_type == TRANSACTION_ANNOUNCEMENT) {
     DevvMessage msg(*ptr.get());
     utx_pool_.addTransactions(msg.data, keys_);
+    publishLoadReport();
     size_t block_height = final_chain_.size();
     LOG_DEBUG << "current_node(" << context_.get_current_node() << ")" \
               <<" peer_count(" << context_.get_peer_count() << ")" \
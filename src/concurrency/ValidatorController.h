@@ -36,6 +36,14 @@ class ValidatorController {
   void registerOutgoingCallback(DevvMessageCallback callback) {
     outgoing_callback_ = callback;
   }
+
+  /**
+   * Register the source of the outgoing queue depth included in load reports.
+   * @param callback - returns the number of queued outgoing messages
+   */
+  void registerQueueDepthCallback(std::function<size_t()> callback) {
+    queue_depth_cb_ = callback;
+  }
   /**
    * Process a validator worker message.
    */
@@ -55,6 +63,17 @@ class ValidatorController {
   DevvMessageCallback outgoing_callback_;
 
   TransactionAnnouncementCallback tx_announcement_cb_;
+
+  /// Returns the number of queued outgoing messages
+  std::function<size_t()> queue_depth_cb_;
+
+  /// Time since the last load report
+  Timer load_report_timer_;
+
+  /**
+   * Publish the load of this validator, at most every kLOAD_REPORT_INTERVAL_MS
+   */
+  void publishLoadReport();
 };
 
 } /* namespace Devv */
@@ -0,0 +1,130 @@
+/*
+ * VerifiedTransactionCache.h remembers which Transactions have
+ * already been proven sound so that their signatures are not
+ * verified again when they reappear in a ProposedBlock or FinalBlock.
+ *
+ * Entries are keyed by the hash of the canonical Transaction,
+ * so a cached result only applies to byte-identical Transactions.
+ * The cache is bounded; the oldest entries are evicted first.
+ *
+ * @copywrite  2018 Devvio Inc
+ */
+
+#ifndef CONCURRENCY_VERIFIEDTRANSACTIONCACHE_H_
+#define CONCURRENCY_VERIFIEDTRANSACTIONCACHE_H_
+
+#include <deque>
+#include <mutex>
+#include <set>
+
+#include "common/metrics.h"
+#include "common/ossladapter.h"
+#include "primitives/Transaction.h"
+
+namespace Devv
+{
+
+/// Default number of Transactions remembered by a VerifiedTransactionCache
+static const size_t kDEFAULT_VERIFIED_CACHE_SIZE = 200000;
+
+class VerifiedTransactionCache {
+public:
+  VerifiedTransactionCache(const VerifiedTransactionCache&) = delete;
+
+  /**
+   * Constructor
+   * @param max_size - the maximum number of Transactions to remember
+   */
+  explicit VerifiedTransactionCache(size_t max_size = kDEFAULT_VERIFIED_CACHE_SIZE)
+    : max_size_(max_size)
+    , verified_counter_(MetricsRegistry::Get().counter("transactions.signatures.verified"))
+    , hit_counter_(MetricsRegistry::Get().counter("transactions.signatures.cache_hits"))
+  {
+  }
+
+  /**
+   * Checks if a Transaction is sound, consulting the cache first.
+   * A cached Transaction is marked sound without verifying its signature,
+   * otherwise it is verified and remembered if it is sound.
+   * @param tx - the Transaction to check
+   * @param keys - a KeyRing that provides keys for signature verification
+   * @return true iff the Transaction is sound
+   */
+  bool setIsSound(Transaction& tx, const KeyRing& keys) {
+    return setIsSound(tx, keys, DevvHash(tx.getCanonical()));
+  }
+
+  /**
+   * Checks if a Transaction is sound, consulting the cache first.
+   * @param tx - the Transaction to check
+   * @param keys - a KeyRing that provides keys for signature verification
+   * @param id - the hash of the canonical Transaction, i.e. from DevvHashBatch()
+   * @return true iff the Transaction is sound
+   */
+  bool setIsSound(Transaction& tx, const KeyRing& keys, const Hash& id) {
+    if (contains(id)) {
+      tx.setIsSoundVerified();
+      hit_counter_.add();
+      return true;
+    }
+    verified_counter_.add();
+    if (!tx.setIsSound(keys)) {
+      return false;
+    }
+    insert(id);
+    return true;
+  }
+
+  /**
+   * Remember a Transaction that has been proven sound.
+   * @param tx - a sound Transaction
+   */
+  void insert(const Transaction& tx) {
+    insert(DevvHash(tx.getCanonical()));
+  }
+
+  /**
+   * @param tx - a Transaction
+   * @return true iff this Transaction was proven sound before
+   */
+  bool contains(const Transaction& tx) const {
+    return contains(DevvHash(tx.getCanonical()));
+  }
+
+  /**
+   * @return the number of Transactions remembered
+   */
+  size_t size() const {
+    std::lock_guard<std::mutex> guard(mutex_);
+    return verified_.size();
+  }
+
+ private:
+  bool contains(const Hash& id) const {
+    std::lock_guard<std::mutex> guard(mutex_);
+    return (verified_.count(id) > 0);
+  }
+
+  void insert(const Hash& id) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    if (max_size_ == 0 || !verified_.insert(id).second) {
+      return;
+    }
+    order_.push_back(id);
+    while (order_.size() > max_size_) {
+      verified_.erase(order_.front());
+      order_.pop_front();
+    }
+  }
+
+  const size_t max_size_;
+  std::set<Hash> verified_;
+  std::deque<Hash> order_;
+  mutable std::mutex mutex_;
+  Counter& verified_counter_;
+  Counter& hit_counter_;
+};
+
+}
+
+#endif /* CONCURRENCY_VERIFIEDTRANSACTIONCACHE_H_ */
@@ -0,0 +1,313 @@
+/*
+ * WorkStealingExecutor.h runs loops over index ranges on a set of
+ * long-lived worker threads.
+ *
+ * A range is split into chunks. Each worker has its own deque of chunks.
+ * A worker takes the newest chunk from its own deque and, when that is
+ * empty, steals the oldest chunk of another worker. The thread that
+ * submits a range runs chunks too until the whole range is done, so a
+ * range may be submitted from a worker thread.
+ *
+ * @copywrite  2018 Devvio Inc
+ */
+
+#ifndef CONCURRENCY_WORKSTEALINGEXECUTOR_H_
+#define CONCURRENCY_WORKSTEALINGEXECUTOR_H_
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Devv {
+
+/// Chunks a range is split into per thread, so threads that finish early can steal
+static const size_t kEXECUTOR_CHUNKS_PER_THREAD = 4;
+/// Worker threads of the shared executor when the hardware concurrency is unknown
+static const size_t kEXECUTOR_DEFAULT_THREADS = 8;
+
+class WorkStealingExecutor {
+ public:
+  /**
+   * @return the executor shared by the whole process, with one worker
+   *   per hardware thread besides the calling thread
+   */
+  static WorkStealingExecutor& Get() {
+    static WorkStealingExecutor* shared = []() {
+      size_t hardware = std::thread::hardware_concurrency();
+      return new WorkStealingExecutor(hardware == 0 ? kEXECUTOR_DEFAULT_THREADS : hardware - 1);
+    }();
+    return *shared;
+  }
+
+  /**
+   * Constructor, starts the worker threads
+   * @param num_threads - the number of worker threads, with 0 every range
+   *   runs on the thread that submits it
+   */
+  explicit WorkStealingExecutor(size_t num_threads) {
+    for (size_t i = 0; i < num_threads; ++i) {
+      workers_.emplace_back(new Worker());
+      workers_.back()->index = i;
+    }
+    threads_.reserve(num_threads);
+    for (size_t i = 0; i < num_threads; ++i) {
+      threads_.emplace_back(&WorkStealingExecutor::run, this, i);
+    }
+  }
+
+  WorkStealingExecutor(const WorkStealingExecutor&) = delete;
+  WorkStealingExecutor& operator=(const WorkStealingExecutor&) = delete;
+
+  /**
+   * Stops the worker threads once the ranges already submitted are done
+   */
+  ~WorkStealingExecutor() {
+    {
+      std::lock_guard<std::mutex> guard(wake_mutex_);
+      stop_ = true;
+    }
+    wake_.notify_all();
+    for (auto& thread : threads_) {
+      thread.join();
+    }
+  }
+
+  /**
+   * @return the number of worker threads
+   */
+  size_t size() const { return workers_.size(); }
+
+  /**
+   * Call fn(i) for every i in [begin, end) and wait for all calls.
+   * @param begin - the first index
+   * @param end - one past the last index
+   * @param fn - the function to call
+   * @param chunk_size - indexes per chunk, 0 to split the range into
+   *   kEXECUTOR_CHUNKS_PER_THREAD chunks per thread
+   * @throw the first exception thrown by fn, after the other calls are done
+   */
+  template <typename Index, typename Function>
+  void ParallelFor(Index begin, Index end, Function fn, size_t chunk_size = 0) {
+    if (end <= begin) {
+      return;
+    }
+    const size_t count = static_cast<size_t>(end - begin);
+    if (chunk_size == 0) {
+      size_t chunks = (workers_.size() + 1) * kEXECUTOR_CHUNKS_PER_THREAD;
+      chunk_size = std::max<size_t>((count + chunks - 1) / chunks, 1);
+    }
+    if (workers_.empty() || count <= chunk_size) {
+      for (Index i = begin; i < end; ++i) {
+        fn(i);
+      }
+      return;
+    }
+
+    const size_t chunks = (count + chunk_size - 1) / chunk_size;
+    RangeJob<Index, Function> job(begin, fn, chunks);
+    size_t first = next_worker_.fetch_add(1, std::memory_order_relaxed);
+    Worker* self = currentWorker();
+    for (size_t offset = 0; offset < count; offset += chunk_size) {
+      Worker& worker = self != nullptr ? *self : *workers_[first++ % workers_.size()];
+      std::lock_guard<std::mutex> guard(worker.mutex);
+      worker.chunks.push_back(Chunk{&job, offset, std::min(offset + chunk_size, count)});
+    }
+    {
+      std::lock_guard<std::mutex> guard(wake_mutex_);
+      queued_ += chunks;
+    }
+    wake_.notify_all();
+
+    // Help with any chunk until the last chunk of this range is done
+    Chunk chunk;
+    while (!job.isDone()) {
+      if (take(self != nullptr ? self->index : first, chunk)) {
+        chunk.job->execute(chunk.begin, chunk.end);
+      } else {
+        job.wait();
+      }
+    }
+    job.rethrow();
+  }
+
+ private:
+  /**
+   * A range submitted to ParallelFor()
+   */
+  class Job {
+   public:
+    explicit Job(size_t chunks) : remaining_(chunks) {}
+    virtual ~Job() = default;
+
+    /**
+     * Runs the indexes [begin, end) of the range and marks the chunk done
+     */
+    void execute(size_t begin, size_t end) {
+      try {
+        run(begin, end);
+      } catch (...) {
+        std::lock_guard<std::mutex> guard(mutex_);
+        if (!error_) {
+          error_ = std::current_exception();
+        }
+      }
+      std::lock_guard<std::mutex> guard(mutex_);
+      if (--remaining_ == 0) {
+        done_.notify_all();
+      }
+    }
+
+    bool isDone() {
+      std::lock_guard<std::mutex> guard(mutex_);
+      return remaining_ == 0;
+    }
+
+    /**
+     * Waits until the last chunk is done
+     */
+    void wait() {
+      std::unique_lock<std::mutex> lock(mutex_);
+      done_.wait(lock, [this]() { return remaining_ == 0; });
+    }
+
+    void rethrow() {
+      if (error_) {
+        std::rethrow_exception(error_);
+      }
+    }
+
+   protected:
+    virtual void run(size_t begin, size_t end) = 0;
+
+   private:
+    std::mutex mutex_;
+    std::condition_variable done_;
+    /// Chunks not done yet
+    size_t remaining_;
+    /// First exception thrown by a chunk
+    std::exception_ptr error_;
+  };
+
+  template <typename Index, typename Function>
+  class RangeJob : public Job {
+   public:
+    RangeJob(Index begin, Function& fn, size_t chunks) : Job(chunks), begin_(begin), fn_(fn) {}
+
+   protected:
+    void run(size_t begin, size_t end) override {
+      for (size_t i = begin; i < end; ++i) {
+        fn_(static_cast<Index>(begin_ + i));
+      }
+    }
+
+   private:
+    Index begin_;
+    Function& fn_;
+  };
+
+  /**
+   * The offsets [begin, end) of a range
+   */
+  struct Chunk {
+    Job* job;
+    size_t begin;
+    size_t end;
+  };
+
+  struct Worker {
+    size_t index = 0;
+    std::mutex mutex;
+    /// Newest chunks at the back, the owner pops the back and thieves the front
+    std::deque<Chunk> chunks;
+  };
+
+  /**
+   * @return the worker of this executor running on the calling thread,
+   *   nullptr on other threads
+   */
+  Worker* currentWorker() const {
+    const Worker* current = CurrentWorker();
+    for (const auto& worker : workers_) {
+      if (worker.get() == current) {
+        return worker.get();
+      }
+    }
+    return nullptr;
+  }
+
+  /**
+   * @return the worker running on the calling thread, of any executor
+   */
+  static const Worker*& CurrentWorker() {
+    static thread_local const Worker* current = nullptr;
+    return current;
+  }
+
+  /**
+   * Takes the newest chunk of one worker or steals the oldest chunk of another
+   * @param first - the worker to look at first
+   * @param chunk - (out) the chunk taken
+   * @return true iff a chunk was taken
+   */
+  bool take(size_t first, Chunk& chunk) {
+    for (size_t n = 0; n < workers_.size(); ++n) {
+      Worker& worker = *workers_[(first + n) % workers_.size()];
+      std::lock_guard<std::mutex> guard(worker.mutex);
+      if (worker.chunks.empty()) {
+        continue;
+      }
+      if (n == 0) {
+        chunk = worker.chunks.back();
+        worker.chunks.pop_back();
+      } else {
+        chunk = worker.chunks.front();
+        worker.chunks.pop_front();
+      }
+      queued_--;
+      return true;
+    }
+    return false;
+  }
+
+  /**
+   * The loop of a worker thread
+   * @param index - the index of the worker
+   */
+  void run(size_t index) {
+    CurrentWorker() = workers_[index].get();
+    Chunk chunk;
+    for (;;) {
+      if (take(index, chunk)) {
+        chunk.job->execute(chunk.begin, chunk.end);
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(wake_mutex_);
+      wake_.wait(lock, [this]() { return stop_ || queued_ > 0; });
+      if (stop_ && queued_ == 0) {
+        return;
+      }
+    }
+  }
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::vector<std::thread> threads_;
+  /// Worker that receives the first chunk of the next range from another thread
+  std::atomic<size_t> next_worker_{0};
+
+  /// Guards stop_ and waking idle workers
+  std::mutex wake_mutex_;
+  std::condition_variable wake_;
+  /// Chunks in the deques of all workers, briefly negative while a range is queued
+  std::atomic<int64_t> queued_{0};
+  bool stop_ = false;
+};
+
+} // namespace Devv
+
+#endif /* CONCURRENCY_WORKSTEALINGEXECUTOR_H_ */
@@ -5,12 +5,259 @@
  */
 
 #include "KeyRing.h"
+#include "common/util.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <fstream>
 #include <map>
 #include <string>
 
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 namespace Devv {
 
+namespace {
+
+/// Marks the start of a decoded key cache, before and after encryption
+static const std::string kKEY_CACHE_MAGIC = "DEVVKEY2";
+static const size_t kKEY_CACHE_SALT_SIZE = 16;
+static const int kKEY_CACHE_ITERATIONS = 100000;
+/// Bytes of the random nonce before the encrypted keys
+static const size_t kKEY_CACHE_IV_SIZE = 12;
+/// Bytes of the GCM tag after the encrypted keys
+static const size_t kKEY_CACHE_TAG_SIZE = 16;
+
+/**
+ * Sign and verify a test message to check that a private key matches its address
+ */
+bool SelfTest(EC_KEY* key) {
+  std::vector<byte> msg = {'h', 'e', 'l', 'l', 'o'};
+  Hash test_hash = DevvHash(msg);
+  Signature sig = SignBinary(key, test_hash);
+  return VerifyByteSig(key, test_hash, sig);
+}
+
+EC_KEY* NewKey(size_t addr_size) {
+  if (addr_size == kWALLET_ADDR_SIZE) {
+    return GetWalletKey();
+  }
+  return GetNodeKey();
+}
+
+/**
+ * Derive the AES-256 key of a key cache from the key file password
+ */
+std::vector<byte> CacheKey(const std::string& password, const std::vector<byte>& salt) {
+  std::vector<byte> key(32);
+  if (PKCS5_PBKDF2_HMAC(password.c_str(), password.size(), salt.data(), salt.size()
+                        , kKEY_CACHE_ITERATIONS, EVP_sha256(), key.size(), key.data()) != 1) {
+    throw std::runtime_error("PKCS5_PBKDF2_HMAC failed");
+  }
+  return key;
+}
+
+/**
+ * AES-256-GCM encrypt or decrypt, the nonce is before the ciphertext and
+ * the tag after it. Decryption fails if the ciphertext, the tag or the
+ * authenticated data were modified.
+ * @param aad - bytes authenticated but not encrypted, the cache header
+ */
+bool CacheCipher(const std::vector<byte>& key, const std::vector<byte>& aad
+                 , const std::vector<byte>& in, std::vector<byte>& out, bool encrypt) {
+  std::vector<byte> iv(kKEY_CACHE_IV_SIZE);
+  std::vector<byte> tag(kKEY_CACHE_TAG_SIZE);
+  const byte* data = in.data();
+  size_t size = in.size();
+  if (encrypt) {
+    if (RAND_bytes(iv.data(), iv.size()) != 1) {
+      return false;
+    }
+    out = iv;
+  } else {
+    if (in.size() < kKEY_CACHE_IV_SIZE + kKEY_CACHE_TAG_SIZE) {
+      return false;
+    }
+    std::copy_n(in.begin(), kKEY_CACHE_IV_SIZE, iv.begin());
+    std::copy(in.end() - kKEY_CACHE_TAG_SIZE, in.end(), tag.begin());
+    data += kKEY_CACHE_IV_SIZE;
+    size -= kKEY_CACHE_IV_SIZE + kKEY_CACHE_TAG_SIZE;
+    out.clear();
+  }
+  EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+  if (ctx == nullptr) {
+    return false;
+  }
+  size_t out_offset = out.size();
+  out.resize(out_offset + size);
+  int aad_len = 0;
+  int len1 = 0;
+  int len2 = 0;
+  int mode = encrypt ? 1 : 0;
+  bool ok = (EVP_CipherInit_ex(ctx, EVP_aes_256_gcm(), nullptr, nullptr, nullptr, mode) == 1)
+      && (EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IVLEN, iv.size(), nullptr) == 1)
+      && (EVP_CipherInit_ex(ctx, nullptr, nullptr, key.data(), iv.data(), mode) == 1)
+      && (EVP_CipherUpdate(ctx, nullptr, &aad_len, aad.data(), aad.size()) == 1)
+      && (EVP_CipherUpdate(ctx, out.data() + out_offset, &len1, data, size) == 1)
+      && (encrypt || EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, tag.size(), tag.data()) == 1)
+      && (EVP_CipherFinal_ex(ctx, out.data() + out_offset + len1, &len2) == 1)
+      && (!encrypt || EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, tag.size(), tag.data()) == 1);
+  EVP_CIPHER_CTX_free(ctx);
+  out.resize(out_offset + len1 + len2);
+  if (!ok) {
+    std::fill(out.begin(), out.end(), 0);
+    out.clear();
+    return false;
+  }
+  if (encrypt) {
+    out.insert(out.end(), tag.begin(), tag.end());
+  }
+  return true;
+}
+
+std::string CachePath(const std::string& cache_dir, const std::string& keys) {
+  return cache_dir + "/" + ToHex(DevvHash(Str2Bin(keys)), 16) + kKEY_CACHE_EXTENSION;
+}
+
+/**
+ * Read the decoded keys of a key file from its cache.
+ * Entries that fail to decode are skipped, a corrupt tail is ignored.
+ * @param[out] entries - the keys read, by hex address
+ * @return true iff the cache exists, matches the password and was not modified
+ */
+bool ReadKeyCache(const std::string& path, const std::string& password, size_t addr_size
+                  , std::map<std::string, EcKeyPtr>& entries) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file.is_open()) {
+    return false;
+  }
+  std::vector<byte> raw((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  size_t header_size = kKEY_CACHE_MAGIC.size() + kKEY_CACHE_SALT_SIZE;
+  if (raw.size() < header_size
+      || !std::equal(kKEY_CACHE_MAGIC.begin(), kKEY_CACHE_MAGIC.end(), raw.begin())) {
+    LOG_WARNING << "Ignoring invalid key cache " << path;
+    return false;
+  }
+  std::vector<byte> header(raw.begin(), raw.begin() + header_size);
+  std::vector<byte> salt(raw.begin() + kKEY_CACHE_MAGIC.size(), raw.begin() + header_size);
+  std::vector<byte> encrypted(raw.begin() + header_size, raw.end());
+  std::vector<byte> plain;
+  if (!CacheCipher(CacheKey(password, salt), header, encrypted, plain, false)
+      || plain.size() < kKEY_CACHE_MAGIC.size()
+      || !std::equal(kKEY_CACHE_MAGIC.begin(), kKEY_CACHE_MAGIC.end(), plain.begin())) {
+    LOG_WARNING << "Key cache " << path << " does not match the key password or was modified";
+    return false;
+  }
+
+  size_t offset = kKEY_CACHE_MAGIC.size();
+  try {
+    uint64_t count = BinToVarint(plain, offset);
+    for (uint64_t i = 0; i < count; ++i) {
+      uint64_t addr_len = BinToVarint(plain, offset);
+      if (addr_len != addr_size*2 || offset + addr_len >= plain.size()) {
+        LOG_WARNING << "Key cache " << path << " is truncated";
+        break;
+      }
+      std::string addr(plain.begin() + offset, plain.begin() + offset + addr_len);
+      offset += addr_len;
+      uint64_t priv_len = BinToVarint(plain, offset);
+      if (offset + priv_len > plain.size()) {
+        LOG_WARNING << "Key cache " << path << " is truncated";
+        break;
+      }
+      BIGNUM* priv = BN_bin2bn(&plain[offset], priv_len, nullptr);
+      offset += priv_len;
+
+      EcKeyPtr key(NewKey(addr_size));
+      EC_POINT* pub = EC_POINT_hex2point(EC_KEY_get0_group(key.get()), addr.c_str(), nullptr, nullptr);
+      bool ok = (priv != nullptr) && (pub != nullptr)
+          && (EC_KEY_set_private_key(key.get(), priv) == 1)
+          && (EC_KEY_set_public_key(key.get(), pub) == 1);
+      BN_clear_free(priv);
+      EC_POINT_free(pub);
+      if (ok) {
+        entries[addr] = std::move(key);
+      } else {
+        LOG_WARNING << "Key cache " << path << " has a corrupt key[" << addr << "]";
+      }
+    }
+  } catch (const std::exception& e) {
+    LOG_WARNING << FormatException(&e, "Key cache " + path + " is corrupt");
+  }
+  std::fill(plain.begin(), plain.end(), 0);
+  return true;
+}
+
+/**
+ * Write decoded keys to a cache, readable only by this user
+ */
+void WriteKeyCache(const std::string& path, const std::string& password
+                   , const std::vector<std::pair<std::string, EcKeyPtr>>& entries) {
+  std::vector<byte> plain(Str2Bin(kKEY_CACHE_MAGIC));
+  VarintToBin(entries.size(), plain);
+  for (auto const& entry : entries) {
+    VarintToBin(entry.first.size(), plain);
+    plain.insert(plain.end(), entry.first.begin(), entry.first.end());
+    const BIGNUM* priv = EC_KEY_get0_private_key(entry.second.get());
+    std::vector<byte> priv_bin(BN_num_bytes(priv));
+    BN_bn2bin(priv, priv_bin.data());
+    VarintToBin(priv_bin.size(), plain);
+    plain.insert(plain.end(), priv_bin.begin(), priv_bin.end());
+  }
+
+  std::vector<byte> salt(kKEY_CACHE_SALT_SIZE);
+  if (RAND_bytes(salt.data(), salt.size()) != 1) {
+    std::fill(plain.begin(), plain.end(), 0);
+    LOG_WARNING << "Failed to encrypt key cache " << path;
+    return;
+  }
+  std::vector<byte> contents(Str2Bin(kKEY_CACHE_MAGIC));
+  contents.insert(contents.end(), salt.begin(), salt.end());
+  std::vector<byte> encrypted;
+  bool ok = CacheCipher(CacheKey(password, salt), contents, plain, encrypted, true);
+  std::fill(plain.begin(), plain.end(), 0);
+  if (!ok) {
+    LOG_WARNING << "Failed to encrypt key cache " << path;
+    return;
+  }
+  contents.insert(contents.end(), encrypted.begin(), encrypted.end());
+
+  // write a temporary file and rename it so a reader never sees a partial cache,
+  // the file is readable only by this user from the moment it is created
+  std::string tmp_path(path + ".tmp");
+  std::remove(tmp_path.c_str());
+  int fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
+  if (fd < 0) {
+    LOG_WARNING << "Failed to create key cache " << tmp_path;
+    return;
+  }
+  size_t written = 0;
+  while (written < contents.size()) {
+    ssize_t n = write(fd, contents.data() + written, contents.size() - written);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      break;
+    }
+    written += n;
+  }
+  bool closed = (close(fd) == 0);
+  if (written != contents.size() || !closed
+      || std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+    std::remove(tmp_path.c_str());
+    LOG_WARNING << "Failed to write key cache " << path;
+  }
+}
+
+} // namespace
+
 Address KeyRing::InsertAddress(std::string hex, EC_KEY* key) {
   std::vector<byte> addr(Hex2Bin(hex));
   Address to_insert(addr);
@@ -19,8 +266,79 @@ Address KeyRing::InsertAddress(std::string hex, EC_KEY* key) {
   return to_insert;
 }
 
+std::vector<Address> KeyRing::insertKeys(std::vector<DecodedKey>& entries) {
+  std::vector<Address> addrs;
+  addrs.reserve(entries.size());
+  for (auto& entry : entries) {
+    addrs.push_back(InsertAddress(entry.first, entry.second.get()));
+    entry.second.release();
+  }
+  return addrs;
+}
+
+std::vector<KeyRing::DecodedKey> KeyRing::decodeKeys(const std::string& keys
+    , size_t addr_size, size_t key_size, const std::string& password) const {
+  MTR_SCOPE_FUNC();
+  std::map<std::string, EcKeyPtr> cached;
+  std::string cache_path;
+  if (!cache_dir_.empty()) {
+    cache_path = CachePath(cache_dir_, keys);
+    if (ReadKeyCache(cache_path, password, addr_size, cached)) {
+      LOG_INFO << "Read " << cached.size() << " keys from cache " << cache_path;
+    }
+  }
+
+  size_t entry_size = addr_size*2 + key_size;
+  size_t count = keys.size()/entry_size;
+  std::vector<DecodedKey> entries(count);
+  for (size_t i = 0; i < count && !cached.empty(); ++i) {
+    std::string addr = keys.substr(i*entry_size, addr_size*2);
+    auto it = cached.find(addr);
+    if (it != cached.end()) {
+      entries[i] = std::make_pair(addr, std::move(it->second));
+      cached.erase(it);
+    }
+  }
+
+  std::atomic<size_t> decoded(0);
+  ThreadPool::ParallelFor(size_t(0), count, [&](size_t i) {
+    std::string addr = keys.substr(i*entry_size, addr_size*2);
+    if (entries[i].second) {
+      if (!verify_keys_ || SelfTest(entries[i].second.get())) {
+        return;
+      }
+      LOG_WARNING << "Invalid cached key[" << addr << "], decoding it from the key file";
+      entries[i].second.reset();
+    }
+    std::string key = keys.substr(i*entry_size + addr_size*2, key_size);
+    try {
+      EcKeyPtr ec_key(LoadEcKey(addr, key, password));
+      if (verify_keys_ && !SelfTest(ec_key.get())) {
+        throw std::runtime_error("Invalid address[" + addr + "] key!");
+      }
+      entries[i] = std::make_pair(addr, std::move(ec_key));
+      decoded++;
+    } catch (const std::exception& e) {
+      LOG_ERROR << FormatException(&e, "Key");
+    }
+  }, load_threads_);
+  entries.erase(std::remove_if(entries.begin(), entries.end(),
+                               [](const DecodedKey& entry) {
+                                 return !entry.second;
+                               }), entries.end());
+
+  // only cache complete key files, a wrong password must not replace a good cache
+  if (!cache_path.empty() && decoded > 0 && entries.size() == count) {
+    WriteKeyCache(cache_path, password, entries);
+  }
+  return entries;
+}
+
 KeyRing::KeyRing(const DevvContext& context)
   : key_map_(), node_list_(), inn_addr_()
+  , load_threads_(context.get_key_load_threads())
+  , verify_keys_(context.get_verify_keys())
+  , cache_dir_(context.get_key_cache_dir())
 {
   CASH_TRY {
     EVP_MD_CTX* ctx;
@@ -36,17 +354,14 @@ KeyRing::KeyRing(const DevvContext& context)
     if (!inn_keys.empty()) {
       size_t size = inn_keys.size();
       if (size%(kFILE_NODEKEY_SIZE+(kNODE_ADDR_SIZE*2)) == 0) {
-        size_t counter = 0;
-        while (counter < (size-1)) {
-          std::string addr = inn_keys.substr(counter, kNODE_ADDR_SIZE*2);
-          counter += (kNODE_ADDR_SIZE*2);
-          std::string key = inn_keys.substr(counter, kFILE_NODEKEY_SIZE);
-          counter += kFILE_NODEKEY_SIZE;
-          try {
-            setInnKeyPair(addr, key, context.get_key_password());
-          } catch (const std::exception& e) {
-            LOG_ERROR << FormatException(&e, "INN Key");
+        try {
+          std::vector<DecodedKey> entries(decodeKeys(inn_keys, kNODE_ADDR_SIZE, kFILE_NODEKEY_SIZE
+                                                     , context.get_key_password()));
+          for (auto const& addr : insertKeys(entries)) {
+            inn_addr_ = addr;
           }
+        } catch (const std::exception& e) {
+          LOG_ERROR << FormatException(&e, "INN Key");
         }
       } else {
         LOG_FATAL << "Invalid INN key file size ("+std::to_string(size)+")";
@@ -62,18 +377,15 @@ KeyRing::KeyRing(const DevvContext& context)
     if (!node_keys.empty()) {
       size_t size = node_keys.size();
       if (size%(kFILE_NODEKEY_SIZE+(kNODE_ADDR_SIZE*2)) == 0) {
-        size_t counter = 0;
-          while (counter < (size-1)) {
-          std::string addr = node_keys.substr(counter, (kNODE_ADDR_SIZE*2));
-          counter += (kNODE_ADDR_SIZE*2);
-          std::string key = node_keys.substr(counter, kFILE_NODEKEY_SIZE);
-          counter += kFILE_NODEKEY_SIZE;
-          try {
-            addNodeKeyPair(addr,key,context.get_key_password());
-          } catch (const std::exception& e) {
-            LOG_ERROR << FormatException(&e, "Node Key");
+        try {
+          std::vector<DecodedKey> entries(decodeKeys(node_keys, kNODE_ADDR_SIZE, kFILE_NODEKEY_SIZE
+                                                     , context.get_key_password()));
+          for (auto const& addr : insertKeys(entries)) {
+            node_list_.push_back(addr);
           }
-         }
+        } catch (const std::exception& e) {
+          LOG_ERROR << FormatException(&e, "Node Key");
+        }
        } else {
          LOG_FATAL << "Invalid node key file size ("+std::to_string(size)+")";
          return;
@@ -102,17 +414,13 @@ bool KeyRing::LoadWallets(const std::string& file_path, const std::string& file_
   if (!wallet_keys.empty()) {
     size_t size = wallet_keys.size();
     if (size % (kFILE_KEY_SIZE + (kWALLET_ADDR_SIZE * 2)) == 0) {
-      size_t counter = 0;
-      while (counter < (size - 1)) {
-        std::string addr = wallet_keys.substr(counter, (kWALLET_ADDR_SIZE * 2));
-        counter += (kWALLET_ADDR_SIZE * 2);
-        std::string key = wallet_keys.substr(counter, kFILE_KEY_SIZE);
-        counter += kFILE_KEY_SIZE;
-        try {
-          addWalletKeyPair(addr, key, file_pass);
-        } catch (const std::exception& e) {
-          LOG_ERROR << FormatException(&e, "Wallet Key");
+      try {
+        std::vector<DecodedKey> entries(decodeKeys(wallet_keys, kWALLET_ADDR_SIZE, kFILE_KEY_SIZE, file_pass));
+        for (auto const& addr : insertKeys(entries)) {
+          wallet_list_.push_back(addr);
         }
+      } catch (const std::exception& e) {
+        LOG_ERROR << FormatException(&e, "Wallet Key");
       }
     } else {
       LOG_FATAL << "Invalid key file size (" + std::to_string(size) + ")";
@@ -7,11 +7,25 @@
 #ifndef CONSENSUS_KEYRING_H_
 #define CONSENSUS_KEYRING_H_
 
+#include <memory>
+
 #include "common/devv_context.h"
 #include "primitives/Transfer.h"
 
 namespace Devv {
 
+/// Extension of the decoded key cache files written by a KeyRing
+static const std::string kKEY_CACHE_EXTENSION = ".keycache";
+
+/**
+ * Frees an EC_KEY
+ */
+struct EcKeyDeleter {
+  void operator()(EC_KEY* key) const { EC_KEY_free(key); }
+};
+
+/// An EC_KEY freed when it goes out of scope
+typedef std::unique_ptr<EC_KEY, EcKeyDeleter> EcKeyPtr;
 
 class KeyRing {
  public:
@@ -147,10 +161,40 @@ class KeyRing {
   KeyRing& operator=(const KeyRing&);
   KeyRing(const KeyRing&);
 
+  /// A hex address and its key, owned until it is inserted into key_map_
+  typedef std::pair<std::string, EcKeyPtr> DecodedKey;
+
+  /**
+   * Decode the keys of a key file, from the cache if possible.
+   * The cache is encrypted and authenticated with AES-256-GCM under a key
+   * derived from the password, and is named after the hash of the key file.
+   * Keys missing from the cache or failing the self test are decoded from
+   * the key file.
+   * @param keys - the contents of the key file
+   * @param addr_size - the size of an address in bytes
+   * @param key_size - the size of an encrypted key in the file
+   * @param password - the password of the keys
+   * @return the hex addresses and keys in file order, skipping invalid keys
+   */
+  std::vector<DecodedKey> decodeKeys(const std::string& keys
+      , size_t addr_size, size_t key_size, const std::string& password) const;
+
+  /**
+   * Add the decoded keys of a key file to this directory.
+   * @param entries - the decoded keys, released once inserted
+   * @return the binary addresses in file order
+   */
+  std::vector<Address> insertKeys(std::vector<DecodedKey>& entries);
+
   std::map<Address, EC_KEY*> key_map_;
   std::vector<Address> node_list_;
   std::vector<Address> wallet_list_;
   Address inn_addr_;
+
+  /// threads decoding a key file at once, 0 for every thread of the shared executor
+  unsigned int load_threads_ = 0;
+  bool verify_keys_ = true;
+  std::string cache_dir_;
 };
 
 } /* namespace Devv */
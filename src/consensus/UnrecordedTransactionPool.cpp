@@ -18,14 +18,12 @@ bool UnrecordedTransactionPool::addAndVerifyTransactions(std::vector<Transaction
   for (TransactionPtr& item : txs) {
     Signature sig = item->getSignature();
     auto it = txs_.find(sig);
-    bool valid = it->second.second->isValid(state, keys, summary);
+    bool valid = it->second.tx->isValid(state, keys, summary);
     if (!valid) { return false; } //tx is invalid
     if (it != txs_.end()) {
-      it->second.first++;
+      it->second.refs++;
     } else if (item->isSound(keys)) {
-      SharedTransaction pair((uint8_t) 0, std::move(item));
-      pair.first++;
-      txs_.insert(std::pair<Signature, SharedTransaction>(sig, std::move(pair)));
+      admitTransaction(sig, std::move(item), 1);
       if (num_cum_txs_ == 0) {
         LOG_NOTICE << "addTransactions(): First transaction added to transaction map";
         timer_.reset();
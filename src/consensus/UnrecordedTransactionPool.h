@@ -6,21 +6,53 @@
  */
 #pragma once
 
+#include <algorithm>
 #include <atomic>
+#include <chrono>
+#include <deque>
 #include <map>
+#include <set>
+#include <thread>
 #include <vector>
 
+#include "common/hash_batch.h"
 #include "concurrency/TransactionCreationManager.h"
+#include "consensus/block_size_controller.h"
+#include "consensus/load_report.h"
 #include "primitives/FinalBlock.h"
 #include "primitives/factories.h"
+#include "primitives/thin_block.h"
 #include "common/logger.h"
+#include "common/metrics.h"
 
 namespace Devv
 {
 
-typedef std::pair<uint8_t, TransactionPtr> SharedTransaction;
+/**
+ * A Transaction waiting in the pool
+ */
+struct SharedTransaction {
+  SharedTransaction(uint8_t ref_count, TransactionPtr transaction, uint64_t admission)
+      : refs(ref_count), tx(std::move(transaction)), sequence(admission) {}
+
+  /// Number of times the Transaction was submitted or collected for a proposal
+  uint8_t refs;
+  /// The Transaction
+  TransactionPtr tx;
+  /// Admission number, matches this entry to its place in the admission queue
+  uint64_t sequence;
+};
 typedef std::map<Signature, SharedTransaction> TxMap;
 
+/// Milliseconds between checks of the pool while waiting for a fuller block
+static const uint64_t kBLOCK_FILL_POLL_MS = 5;
+/// Admissions of departed Transactions tolerated before the admission queue is compacted
+static const size_t kMIN_STALE_ADMISSIONS = 4096;
+/// Number of recently finalized Transaction signatures remembered to drop resubmissions
+static const size_t kRECENT_FINALIZED_SIGNATURES = 100000;
+/// FinalBlocks held at most while a thin FinalBlock waits on missing Transactions
+static const size_t kMAX_DEFERRED_BLOCKS = 256;
+
 class UnrecordedTransactionPool {
  public:
 
@@ -29,15 +61,56 @@ class UnrecordedTransactionPool {
      , size_t max_tx_per_block)
      : txs_()
     , pending_proposal_(ProposedBlock::Create(prior))
-    , max_tx_per_block_(max_tx_per_block)
     , tcm_(mode)
     , mode_(mode)
+    , pending_gauge_(MetricsRegistry::Get().gauge("utx_pool.pending"))
+    , added_counter_(MetricsRegistry::Get().counter("utx_pool.added"))
+    , pending_duplicates_(MetricsRegistry::Get().counter("utx_pool.duplicates.pending"))
+    , finalized_duplicates_(MetricsRegistry::Get().counter("utx_pool.duplicates.finalized"))
+    , finalize_latency_(MetricsRegistry::Get().histogram("consensus.final.latency_ms"))
+    , block_sizer_(StaticBlockSize(max_tx_per_block))
+    , bytes_gauge_(MetricsRegistry::Get().gauge("utx_pool.bytes"))
+    , expired_counter_(MetricsRegistry::Get().counter("utx_pool.expired"))
+    , evicted_counter_(MetricsRegistry::Get().counter("utx_pool.evicted"))
   {
     LOG_DEBUG << "UnrecordedTransactionPool(const ChainState& prior)";
   }
 
   UnrecordedTransactionPool(const UnrecordedTransactionPool& other) = delete;
 
+  /** Sets how many Transactions proposals hold and how long to wait for them.
+   *  @param bounds - the bounds of the block size and wait
+   */
+  void setBlockSizing(const BlockSizeBounds& bounds) {
+    LOG_INFO << "UnrecordedTransactionPool block size: " << bounds.min_txs << " to "
+             << bounds.max_txs << " transactions, wait up to " << bounds.max_wait_ms
+             << " ms, target latency " << bounds.target_latency_ms << " ms";
+    block_sizer_.setBounds(bounds);
+  }
+
+  /**
+   *  @return the number of Transactions the next proposal should hold
+   */
+  size_t getTargetBlockTxs() const {
+    return block_sizer_.getTargetTxs();
+  }
+
+  /** Sets the limits of this pool.
+   *  @note Transactions over a limit are evicted oldest first
+   *  @param max_txs - the maximum number of Transactions
+   *  @param max_bytes - the maximum number of serialized Transaction bytes
+   *  @param tx_ttl_ms - milliseconds a Transaction may wait, 0 to never expire
+   */
+  void setLimits(size_t max_txs, size_t max_bytes, uint64_t tx_ttl_ms) {
+    std::lock_guard<std::mutex> guard(txs_mutex_);
+    max_txs_ = max_txs;
+    max_bytes_ = max_bytes;
+    tx_ttl_ms_ = tx_ttl_ms;
+    LOG_INFO << "UnrecordedTransactionPool limits: " << max_txs_ << " transactions, "
+             << max_bytes_ << " bytes, " << tx_ttl_ms_ << " ms";
+    evictTransactions();
+  }
+
   /** Adds Transactions to this pool.
    *  @note if the Transaction is invalid it will not be added,
    *    but other valid transactions will be added.
@@ -53,9 +126,22 @@ class UnrecordedTransactionPool {
     std::vector<TransactionPtr> temp;
     InputBuffer buffer(serial);
     while (buffer.getOffset() < buffer.size()) {
-      auto tx = CreateTransaction(buffer, keys, mode_);
+      // T2 duplicates are dropped by signature before the Transaction is copied
+      if (mode_ == eAppMode::T2) {
+        size_t tx_size = 0;
+        Signature sig = Tier2Transaction::PeekSignature(buffer, tx_size);
+        if (dropDuplicate(sig)) {
+          buffer.increment(tx_size);
+          continue;
+        }
+      }
+      // soundness is checked against the verified cache when the Transaction is added
+      auto tx = CreateTransaction(buffer, keys, mode_, false);
       temp.push_back(std::move(tx));
     }
+    if (temp.empty()) {
+      return true;
+    }
     return addTransactions(temp, keys);
   }
 
@@ -73,16 +159,36 @@ class UnrecordedTransactionPool {
     std::lock_guard<std::mutex> guard(txs_mutex_);
     bool all_good = true;
     CASH_TRY {
+      // Hash the cache ids of the Transactions new to this pool together
+      std::vector<const std::vector<byte>*> canonicals;
+      std::vector<size_t> new_txs;
+      for (size_t i = 0; i < txs.size(); ++i) {
+        Signature sig = txs[i]->getSignature();
+        if (txs_.find(sig) == txs_.end() && !isRecentlyFinalized(sig)) {
+          canonicals.push_back(&txs[i]->getCanonical());
+          new_txs.push_back(i);
+        }
+      }
+      std::vector<Hash> new_ids(DevvHashBatch(canonicals));
+      std::vector<Hash> ids(txs.size());
+      for (size_t n = 0; n < new_txs.size(); ++n) {
+        ids[new_txs[n]] = new_ids[n];
+      }
+
       int counter = 0;
-      for (TransactionPtr& item : txs) {
+      for (size_t i = 0; i < txs.size(); ++i) {
+        TransactionPtr& item = txs[i];
         Signature sig = item->getSignature();
         auto it = txs_.find(sig);
         if (it != txs_.end()) {
-          it->second.first++;
+          it->second.refs++;
+          pending_duplicates_.add(1);
           LOG_DEBUG << "Transaction already in UTX pool, increment reference count.";
-        } else if (item->isSound(keys)) {
-          SharedTransaction pair((uint8_t) 1, std::move(item));
-          txs_.insert(std::pair<Signature, SharedTransaction>(sig, std::move(pair)));
+        } else if (isRecentlyFinalized(sig)) {
+          finalized_duplicates_.add(1);
+          LOG_DEBUG << "Transaction already finalized, dropped.";
+        } else if (tcm_.get_verified_cache().setIsSound(*item, keys, ids[i])) {
+          admitTransaction(sig, std::move(item), 1);
           if (num_cum_txs_ == 0) {
             LOG_NOTICE << "addTransactions(): First transaction added to TxMap";
             timer_.reset();
@@ -97,8 +203,13 @@ class UnrecordedTransactionPool {
           all_good = false;
         }
       }
+      expireTransactions(NowMillis());
+      evictTransactions();
       LOG_INFO << "Added "+std::to_string(counter)+" sound transactions.";
       LOG_INFO << std::to_string(txs_.size())+" transactions pending.";
+      added_counter_.add(counter);
+      pending_gauge_.set(txs_.size());
+      bytes_gauge_.set(pool_bytes_);
     } CASH_CATCH (const std::exception& e) {
       LOG_FATAL << FormatException(&e, "UnrecordedTransactionPool.addTransactions()");
       all_good = false;
@@ -138,7 +249,7 @@ class UnrecordedTransactionPool {
       } else {
         out += ",";
       }
-      out += item.second.second->getJSON();
+      out += item.second.tx->getJSON();
     }
     out += "]";
     return out;
@@ -153,7 +264,7 @@ class UnrecordedTransactionPool {
     std::vector<byte> serial;
     std::lock_guard<std::mutex> guard(txs_mutex_);
     for (auto const& item : txs_) {
-      std::vector<byte> temp(item.second.second->getCanonical());
+      std::vector<byte> temp(item.second.tx->getCanonical());
       serial.insert(serial.end(), temp.begin(), temp.end());
     }
     return serial;
@@ -180,7 +291,7 @@ class UnrecordedTransactionPool {
 
   /**
    *  Create a new ProposedBlock based on pending Transaction in this pool.
-   *  Locks this pool for proposals.
+   *  Locks this pool for proposals. Expired Transactions are removed first.
    *  @param prev_hash - the hash of the previous block
    *  @param prior_state - the chainstate prior to this proposal
    *  @param keys - the directory of Addresses and EC keys
@@ -192,7 +303,9 @@ class UnrecordedTransactionPool {
                     const ChainState& prior_state,
                     const KeyRing& keys,
                     const DevvContext& context) {
+    waitForTransactions();
     std::lock_guard<std::mutex> guard(txs_mutex_);
+    GarbageCollect_Internal();
     return proposeBlock_Internal(prev_hash, prior_state, keys, context);
   }
 
@@ -214,6 +327,35 @@ class UnrecordedTransactionPool {
     return pending_proposal_.getCanonical();
   }
 
+  /**
+   *  @param origin - the index of this node
+   *  @return a thin block representation of this pool's ProposedBlock
+   */
+  std::vector<byte> getThinProposal(uint32_t origin) {
+    LOG_DEBUG << "getThinProposal()";
+    std::lock_guard<std::mutex> proposal_guard(pending_proposal_mutex_);
+    return EncodeThinBlock(pending_proposal_, origin);
+  }
+
+  /**
+   *  Answer a request for Transactions missing from this pool's ProposedBlock
+   *  @param prev_hash - the previous hash of the requested proposal
+   *  @param origin - the index of this node
+   *  @param inline_txs - Signatures of the Transactions to send inline
+   *  @return a thin block representation of this pool's ProposedBlock
+   *  @return an empty vector if this pool has no proposal following prev_hash
+   */
+  std::vector<byte> getThinProposal(const Hash& prev_hash,
+                                    uint32_t origin,
+                                    const std::set<Signature>& inline_txs) {
+    LOG_DEBUG << "getThinProposal(prev_hash)";
+    std::lock_guard<std::mutex> proposal_guard(pending_proposal_mutex_);
+    if (pending_proposal_.isNull() || pending_proposal_.getPrevHash() != prev_hash) {
+      return std::vector<byte>();
+    }
+    return EncodeThinBlock(pending_proposal_, origin, inline_txs);
+  }
+
   /**
    *  Update this pool's ProposedBlock based on a new FinalBlock.
    *  @note a new proposal may be generated
@@ -272,6 +414,9 @@ class UnrecordedTransactionPool {
     MTR_SCOPE_FUNC();
     std::lock_guard<std::mutex> proposal_guard(pending_proposal_mutex_);
     const FinalBlock final_block(FinalizeBlock(pending_proposal_));
+    double rtt_ms = proposal_timer_.elapsed();
+    finalize_latency_.record(rtt_ms);
+    block_sizer_.recordValidation(pending_proposal_.getNumTransactions(), rtt_ms);
     pending_proposal_.setNull();
     has_proposal_ = false;
     return final_block;
@@ -295,13 +440,207 @@ class UnrecordedTransactionPool {
     return final;
   }
 
-  /** Remove unreferenced Transactions from the pool.
+  /**
+   *  Create a new FinalBlock based on a remote block reassembled from this pool
+   *  @param buffer - the canonical FinalBlock
+   *  @param prior - the chain state prior to this new FinalBlock
+   *  @param keys - the directory of Addresses and EC keys
+   *  @param verified - the block's Transactions from ReconstructThinBlock()
+   *  @return a FinalBlock based on the remote data provided
+   */
+  const FinalBlock FinalizeRemoteBlock(InputBuffer& buffer,
+                                       const ChainState prior,
+                                       const KeyRing& keys,
+                                       std::vector<TransactionPtr>& verified) {
+    LOG_DEBUG << "FinalizeRemoteBlock(verified)";
+    MTR_SCOPE_FUNC();
+    FinalBlock final(buffer, prior, keys, verified);
+    RemoveTransactions(final);
+    return final;
+  }
+
+  /**
+   *  Reassemble a thin block from the Transactions in this pool.
+   *  Pooled Transactions were checked for soundness when they were added,
+   *  so only Transactions carried inline are verified.
+   *  @param thin - the decoded thin block
+   *  @param keys - the directory of Addresses and EC keys
+   *  @param[out] canonical - the canonical block, if complete
+   *  @param[out] txs - the Transactions of the block in block order, if complete
+   *  @return Signatures of the Transactions this pool is missing,
+   *          empty if the block was reassembled
+   */
+  std::vector<Signature> ReconstructThinBlock(const ThinBlock& thin,
+                                              const KeyRing& keys,
+                                              std::vector<byte>& canonical,
+                                              std::vector<TransactionPtr>& txs) {
+    LOG_DEBUG << "ReconstructThinBlock()";
+    MTR_SCOPE_FUNC();
+    std::vector<Signature> missing;
+    canonical = thin.header;
+    txs.clear();
+    std::lock_guard<std::mutex> guard(txs_mutex_);
+    for (auto const& entry : thin.txs) {
+      if (!entry.canonical.empty()) {
+        InputBuffer buffer(entry.canonical);
+        auto tx = CreateTransaction(buffer, keys, mode_, false);
+        if (buffer.getOffset() != buffer.size() || !(tx->getSignature() == entry.sig)) {
+          throw DeserializationError("ReconstructThinBlock(): inline transaction does not match its signature");
+        }
+        if (!tcm_.get_verified_cache().setIsSound(*tx, keys)) {
+          throw DeserializationError("ReconstructThinBlock(): inline transaction is unsound");
+        }
+        canonical.insert(canonical.end(), entry.canonical.begin(), entry.canonical.end());
+        txs.push_back(std::move(tx));
+        continue;
+      }
+      auto it = txs_.find(entry.sig);
+      if (it == txs_.end()) {
+        missing.push_back(entry.sig);
+        continue;
+      }
+      std::vector<byte> tx_canon(it->second.tx->getCanonical());
+      canonical.insert(canonical.end(), tx_canon.begin(), tx_canon.end());
+      txs.push_back(it->second.tx->clone());
+    }
+    if (!missing.empty()) {
+      LOG_INFO << "ReconstructThinBlock(): missing " << missing.size()
+               << " of " << thin.txs.size() << " transactions";
+      canonical.clear();
+      txs.clear();
+      return missing;
+    }
+    canonical.insert(canonical.end(), thin.tail.begin(), thin.tail.end());
+    return missing;
+  }
+
+  /**
+   *  Record that a thin FinalBlock is waiting on missing Transactions.
+   *  FinalBlocks that arrive meanwhile are deferred until it completes.
+   *  @param merkle - the merkle root of the incomplete block
+   *  @param origin - the index of the node the request was sent to
+   *  @param request - the binary request for the missing Transactions, kept to retry
+   *  @param full_request - the binary request for every Transaction of the block
+   */
+  void AwaitRemoteBlock(const Hash& merkle,
+                        uint32_t origin,
+                        const std::vector<byte>& request,
+                        const std::vector<byte>& full_request) {
+    std::lock_guard<std::mutex> guard(awaited_mutex_);
+    awaited_block_ = merkle;
+    awaited_origin_ = origin;
+    awaited_request_ = request;
+    awaited_full_request_ = full_request;
+    awaited_attempts_ = 0;
+    is_awaiting_block_ = true;
+    awaited_timer_.reset();
+  }
+
+  /**
+   *  @return true, iff a thin FinalBlock is waiting on missing Transactions
+   */
+  bool IsAwaitingRemoteBlock() const {
+    std::lock_guard<std::mutex> guard(awaited_mutex_);
+    return is_awaiting_block_;
+  }
+
+  /**
+   *  @param merkle - the merkle root of a FinalBlock
+   *  @return true, iff this is the FinalBlock waiting on missing Transactions
+   */
+  bool IsAwaitedRemoteBlock(const Hash& merkle) const {
+    std::lock_guard<std::mutex> guard(awaited_mutex_);
+    return is_awaiting_block_ && (awaited_block_ == merkle);
+  }
+
+  /**
+   *  Hold a FinalBlock until the awaited FinalBlock completes.
+   *  @param data - the FinalBlock message data
+   *  @return false, if kMAX_DEFERRED_BLOCKS are already held and the block was dropped
+   */
+  bool DeferRemoteBlock(const std::vector<byte>& data) {
+    std::lock_guard<std::mutex> guard(awaited_mutex_);
+    if (deferred_blocks_.size() >= kMAX_DEFERRED_BLOCKS) {
+      deferred_dropped_.add(1);
+      return false;
+    }
+    deferred_blocks_.push_back(data);
+    deferred_gauge_.set(deferred_blocks_.size());
+    return true;
+  }
+
+  /**
+   *  Get the next request for the awaited FinalBlock once the last one went
+   *  unanswered for timeout_millis. The missing Transactions are asked from
+   *  the origin of the block max_retries times, after that every Transaction
+   *  of the block is asked from the other nodes in turn.
+   *  @param timeout_millis - how long to wait for an answer
+   *  @param max_retries - requests for the missing Transactions before asking for the whole block
+   *  @param[out] origin - the index of the node that sent the block
+   *  @param[out] attempt - the number of unanswered requests, from 1
+   *  @param[out] request - the binary request
+   *  @return true, iff a request should be sent
+   */
+  bool NextRemoteBlockRequest(double timeout_millis,
+                              size_t max_retries,
+                              uint32_t& origin,
+                              size_t& attempt,
+                              std::vector<byte>& request) {
+    std::lock_guard<std::mutex> guard(awaited_mutex_);
+    if (!is_awaiting_block_ || awaited_timer_.elapsed() < timeout_millis) {
+      return false;
+    }
+    awaited_timer_.reset();
+    attempt = ++awaited_attempts_;
+    origin = awaited_origin_;
+    request = attempt <= max_retries ? awaited_request_ : awaited_full_request_;
+    return true;
+  }
+
+  /**
+   *  Stop waiting for a FinalBlock
+   *  @return the FinalBlocks deferred while waiting, in arrival order
+   */
+  std::deque<std::vector<byte>> ReleaseRemoteBlocks() {
+    std::lock_guard<std::mutex> guard(awaited_mutex_);
+    is_awaiting_block_ = false;
+    awaited_request_.clear();
+    awaited_full_request_.clear();
+    deferred_gauge_.set(0);
+    std::deque<std::vector<byte>> released;
+    released.swap(deferred_blocks_);
+    return released;
+  }
+
+  /** Remove expired Transactions and Transactions over the limits from the pool.
+   *  @note only the oldest admissions are visited, so this is cheap to call often
    *  @return the number of Transactions removed.
    */
   int GarbageCollect() {
     LOG_DEBUG << "GarbageCollect()";
-    //TODO: delete old unrecorded Transactions periodically
-    return 0;
+    std::lock_guard<std::mutex> guard(txs_mutex_);
+    return GarbageCollect_Internal();
+  }
+
+  /**
+   *  @return the occupancy of this pool, the caller fills in the rest of the report
+   */
+  LoadReport getLoadReport() const {
+    std::lock_guard<std::mutex> guard(txs_mutex_);
+    LoadReport report;
+    report.pending_txs = txs_.size();
+    report.pending_bytes = pool_bytes_;
+    report.max_txs = max_txs_;
+    report.max_bytes = max_bytes_;
+    return report;
+  }
+
+  /**
+   *  @return the number of serialized Transaction bytes in this pool
+   */
+  size_t getPoolBytes() const {
+    std::lock_guard<std::mutex> guard(txs_mutex_);
+    return pool_bytes_;
   }
 
   /**
@@ -362,7 +701,6 @@ class UnrecordedTransactionPool {
   // Total number of transactions that have been
   // added to the transaction map
   size_t num_cum_txs_ = 0;
-  size_t max_tx_per_block_ = 10000;
 
   // Time since starting
   Timer timer_;
@@ -372,6 +710,79 @@ class UnrecordedTransactionPool {
   TransactionCreationManager tcm_;
   eAppMode mode_;
 
+  /// Number of Transactions in this pool
+  Gauge& pending_gauge_;
+  /// Sound Transactions added to this pool
+  Counter& added_counter_;
+  /// Resubmitted Transactions that were already pending
+  Counter& pending_duplicates_;
+  /// Resubmitted Transactions that were recently finalized
+  Counter& finalized_duplicates_;
+  /// Milliseconds from creating a ProposedBlock to finalizing it
+  Histogram& finalize_latency_;
+  Timer proposal_timer_;
+  /// Sizes proposals from the finalize latency
+  BlockSizeController block_sizer_;
+
+  /// Number of serialized Transaction bytes in this pool
+  Gauge& bytes_gauge_;
+  /// Transactions removed after waiting longer than tx_ttl_ms_
+  Counter& expired_counter_;
+  /// Transactions removed to keep this pool within its limits
+  Counter& evicted_counter_;
+
+  /**
+   * A Transaction admitted to this pool, in admission order
+   */
+  struct Admission {
+    Signature sig;
+    uint64_t sequence;
+    uint64_t time_ms;
+  };
+
+  /// Pool limits, see setLimits()
+  size_t max_txs_ = kDEFAULT_POOL_MAX_TXS;
+  size_t max_bytes_ = kDEFAULT_POOL_MAX_BYTES;
+  uint64_t tx_ttl_ms_ = kDEFAULT_POOL_TX_TTL_MS;
+  /// Serialized bytes of the Transactions in txs_
+  size_t pool_bytes_ = 0;
+  /// Admission number of the next Transaction
+  uint64_t next_sequence_ = 0;
+  /// Admissions oldest first, entries whose Transaction already left txs_ are skipped
+  std::deque<Admission> admissions_;
+
+  /// Signatures of recently finalized Transactions, guarded by txs_mutex_
+  std::set<Signature> recent_finalized_;
+  /// The same signatures in the order they were finalized, oldest first
+  std::deque<Signature> recent_finalized_order_;
+
+  // Thin FinalBlock waiting on missing Transactions
+  bool is_awaiting_block_ = false;
+  Hash awaited_block_ = {};
+  uint32_t awaited_origin_ = 0;
+  std::vector<byte> awaited_request_;
+  std::vector<byte> awaited_full_request_;
+  size_t awaited_attempts_ = 0;
+  Timer awaited_timer_;
+  std::deque<std::vector<byte>> deferred_blocks_;
+  /// FinalBlocks held while waiting
+  Gauge& deferred_gauge_ = MetricsRegistry::Get().gauge("utx_pool.thin.deferred_blocks");
+  /// FinalBlocks dropped because kMAX_DEFERRED_BLOCKS were already held
+  Counter& deferred_dropped_ = MetricsRegistry::Get().counter("utx_pool.thin.deferred_dropped");
+  mutable std::mutex awaited_mutex_;
+
+  /** Remove expired Transactions and Transactions over the limits.
+   *  @note txs_mutex_ must be held
+   *  @return the number of Transactions removed.
+   */
+  int GarbageCollect_Internal() {
+    size_t removed = expireTransactions(NowMillis());
+    removed += evictTransactions();
+    pending_gauge_.set(txs_.size());
+    bytes_gauge_.set(pool_bytes_);
+    return static_cast<int>(removed);
+  }
+
   /**
    *  Create a new ProposedBlock based on pending Transaction in this pool
    *  @param prev_hash - the hash of the previous block
@@ -391,10 +802,11 @@ class UnrecordedTransactionPool {
     Summary summary = Summary::Create();
     Validation validation = Validation::Create();
 
-    auto validated = CollectValidTransactions(prior_state, keys, summary, context);
+    auto validated = CollectValidTransactions(prior_state, keys, summary);
     if (!validated.empty()) {
       LOG_DEBUG << "Creating new proposal with " << validated.size() << " transactions";
       ProposedBlock new_proposal(prev_hash, validated, summary, validation, new_state, keys);
+      proposal_timer_.reset();
       size_t node_num = context.get_current_node() % context.get_peer_count();
       new_proposal.signBlock(keys, node_num);
       std::lock_guard<std::mutex> proposal_guard(pending_proposal_mutex_);
@@ -408,52 +820,216 @@ class UnrecordedTransactionPool {
     }
   }
 
-  /** Verifies Transactions for this pool.
-   *  @note this implementation is greedy in selecting Transactions
+  /**
+   *  @param max_tx_per_block - the number of Transactions in a block
+   *  @return bounds that keep the block size fixed and never wait
+   */
+  static BlockSizeBounds StaticBlockSize(size_t max_tx_per_block) {
+    BlockSizeBounds bounds;
+    bounds.min_txs = max_tx_per_block;
+    bounds.max_txs = max_tx_per_block;
+    return bounds;
+  }
+
+  /** Waits until this pool holds enough Transactions for the next proposal
+   *  or the wait allowed by the block sizer runs out.
+   *  @note txs_mutex_ is released while waiting, so Transactions keep arriving
+   */
+  void waitForTransactions() {
+    size_t pending = numPendingTransactions();
+    uint64_t wait_ms = block_sizer_.getWaitMillis(pending);
+    if (wait_ms == 0) {
+      return;
+    }
+    LOG_DEBUG << "low incoming transaction volume: waiting up to " << wait_ms << " ms";
+    size_t target = block_sizer_.getTargetTxs();
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(wait_ms);
+    while (pending < target && std::chrono::steady_clock::now() < deadline) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(kBLOCK_FILL_POLL_MS));
+      pending = numPendingTransactions();
+    }
+  }
+
+  /** Selects the Transactions of the next proposal.
+   *  @note Transactions are grouped by sender. A sender funded by another
+   *    pending sender is packed after it, and ties and funding cycles are
+   *    broken in signature order, so the same pool always yields the same block.
+   *  @note a Transaction that does not fit is skipped instead of ending the block.
+   *    It is deferred to a later block if its sender already spent in this block
+   *    or a pending Transaction funds it, otherwise it is removed from the pool.
+   *  @pre not thread-safe, call from within a mutex guard
    *  @params state the chain state to validate against
    *  @params keys a KeyRing that provides keys for signature verification
    *  @params summary the Summary to update
    *  @return a vector of unrecorded valid transactions
    */
   std::vector<TransactionPtr> CollectValidTransactions(const ChainState& state
-      , const KeyRing& keys, const Summary& pre_sum, const DevvContext& context) {
+      , const KeyRing& keys, const Summary& pre_sum) {
     LOG_DEBUG << "CollectValidTransactions(): state.size(): " << state.size();
     std::vector<TransactionPtr> valid;
     MTR_SCOPE_FUNC();
-    if (txs_.size() < max_tx_per_block_) {
-      LOG_DEBUG << "low incoming transaction volume: sleeping";
-      sleep(context.get_max_wait());
-    }
-    unsigned int num_txs = 0;
+    size_t max_txs = block_sizer_.getTargetTxs();
+    std::set<Address> funded;
+    std::vector<TxMap::iterator> order(PackingOrder(funded));
+
     Summary post_sum(Summary::Copy(pre_sum));
     std::map<Address, SmartCoin> aggregate;
     ChainState post_state(ChainState::Copy(state));
-    for (auto iter = txs_.begin(); iter != txs_.end(); ++iter) {
-      if (iter->second.second->isValidInAggregate(post_state, keys,
-                                         post_sum, aggregate, state)) {
-        valid.push_back(std::move(iter->second.second->clone()));
-        iter->second.first++;
-        num_txs++;
-        if (num_txs >= max_tx_per_block_) { break; }
-      } else {
-        LOG_INFO << "CollectValidTransactions: Invalid transaction in pool.";
-        RemoveTransaction(iter->second.second->getSignature());
-        //if valid transactions, propose them
-        if (num_txs > 0) break;
-        //if no valid transactions, clean pool, collect again
-        //clean
-        Summary sum_clone(Summary::Copy(pre_sum));
-        ChainState pre_state(ChainState::Copy(state));
-        while (!RemoveInvalidTransactions(pre_state, keys, sum_clone)) {
-          //do nothing
+    std::set<Address> spent;
+    std::vector<Signature> invalid;
+    size_t deferred = 0;
+    for (auto iter : order) {
+      if (valid.size() >= max_txs) { break; }
+      const Transaction& tx = *iter->second.tx;
+      if (ApplyInAggregate(tx, post_state, keys, post_sum, aggregate, state)) {
+        valid.push_back(tx.clone());
+        iter->second.refs++;
+        for (const auto& xfer : tx.getTransfers()) {
+          if (xfer->getAmount() < 0) { spent.insert(xfer->getAddress()); }
         }
-        //collect again
-        return CollectValidTransactions(state, keys, pre_sum, context);
+        continue;
+      }
+      bool may_fit_later = false;
+      for (const auto& xfer : tx.getTransfers()) {
+        if (xfer->getAmount() < 0
+            && (spent.count(xfer->getAddress()) > 0 || funded.count(xfer->getAddress()) > 0)) {
+          may_fit_later = true;
+        }
+      }
+      if (may_fit_later) {
+        deferred++;
+      } else {
+        invalid.push_back(iter->first);
       }
     }
+    for (const auto& sig : invalid) {
+      LOG_INFO << "CollectValidTransactions: Invalid transaction in pool.";
+      RemoveTransaction(sig);
+    }
+    LOG_INFO << "CollectValidTransactions: packed " << valid.size() << " of " << order.size()
+             << " transactions (" << deferred << " deferred, " << invalid.size() << " invalid)";
     return valid;
   }
 
+  /** Orders the pending Transactions for CollectValidTransactions().
+   *  @pre not thread-safe, call from within a mutex guard
+   *  @param[out] funded - the addresses credited by pending Transactions of another sender
+   *  @return iterators into txs_ in packing order
+   */
+  std::vector<TxMap::iterator> PackingOrder(std::set<Address>& funded) {
+    // Transactions of one sender form a group, groups are numbered in signature order
+    std::map<Address, size_t> sender_group;
+    std::vector<std::vector<TxMap::iterator>> groups;
+    std::vector<std::set<Address>> credits;
+    for (auto iter = txs_.begin(); iter != txs_.end(); ++iter) {
+      std::vector<TransferPtr> xfers(iter->second.tx->getTransfers());
+      auto debit = std::find_if(xfers.begin(), xfers.end(),
+                                [](const TransferPtr& xfer) { return xfer->getAmount() < 0; });
+      size_t group = groups.size();
+      if (debit != xfers.end()) {
+        auto known = sender_group.insert(std::make_pair((*debit)->getAddress(), group));
+        group = known.first->second;
+      }
+      if (group == groups.size()) {
+        groups.emplace_back();
+        credits.emplace_back();
+      }
+      groups[group].push_back(iter);
+      for (const auto& xfer : xfers) {
+        if (xfer->getAmount() > 0
+            && (debit == xfers.end() || xfer->getAddress() != (*debit)->getAddress())) {
+          credits[group].insert(xfer->getAddress());
+          funded.insert(xfer->getAddress());
+        }
+      }
+    }
+
+    // A group that credits a sender goes before the group of that sender
+    std::vector<std::vector<size_t>> funds(groups.size());
+    std::vector<size_t> waiting(groups.size(), 0);
+    for (size_t group = 0; group < groups.size(); ++group) {
+      for (const auto& addr : credits[group]) {
+        auto sender = sender_group.find(addr);
+        if (sender != sender_group.end() && sender->second != group) {
+          funds[group].push_back(sender->second);
+          waiting[sender->second]++;
+        }
+      }
+    }
+    std::set<size_t> ready;
+    for (size_t group = 0; group < groups.size(); ++group) {
+      if (waiting[group] == 0) { ready.insert(group); }
+    }
+    std::vector<bool> packed(groups.size(), false);
+    std::vector<TxMap::iterator> order;
+    order.reserve(txs_.size());
+    size_t first_unpacked = 0;
+    for (size_t count = 0; count < groups.size(); ++count) {
+      size_t group;
+      if (!ready.empty()) {
+        group = *ready.begin();
+        ready.erase(ready.begin());
+      } else {
+        // every remaining group waits on another, break the cycle in signature order
+        while (packed[first_unpacked]) { first_unpacked++; }
+        group = first_unpacked;
+      }
+      packed[group] = true;
+      order.insert(order.end(), groups[group].begin(), groups[group].end());
+      for (size_t next : funds[group]) {
+        if (!packed[next] && --waiting[next] == 0) { ready.insert(next); }
+      }
+    }
+    return order;
+  }
+
+  /** Applies a Transaction to the state of a block being packed, if it is valid there.
+   *  The Transaction is checked against copies of the entries of its own addresses,
+   *  so a Transaction that fails part way leaves the block state untouched.
+   *  @params tx the Transaction
+   *  @params state the state of the block, updated if the Transaction is valid
+   *  @params keys a KeyRing that provides keys for signature verification
+   *  @params summary the Summary of the block, updated if the Transaction is valid
+   *  @params aggregate the debits of the block, updated if the Transaction is valid
+   *  @params prior the chain state before the block
+   *  @return true iff the Transaction is valid after the Transactions already applied
+   */
+  static bool ApplyInAggregate(const Transaction& tx, ChainState& state, const KeyRing& keys
+      , Summary& summary, std::map<Address, SmartCoin>& aggregate, const ChainState& prior) {
+    ChainState trial_state;
+    std::map<Address, SmartCoin> trial_aggregate;
+    for (const auto& xfer : tx.getTransfers()) {
+      Address addr = xfer->getAddress();
+      auto balances = state.getStateMap().find(addr);
+      if (balances != state.getStateMap().end()) {
+        trial_state.getStateMap()[addr] = balances->second;
+      }
+      auto debits = aggregate.find(addr);
+      if (debits != aggregate.end()) {
+        trial_aggregate.insert(*debits);
+      }
+    }
+    Summary trial_summary(Summary::Create());
+    if (!tx.isValidInAggregate(trial_state, keys, trial_summary, trial_aggregate, prior)) {
+      return false;
+    }
+    for (const auto& balances : trial_state.getStateMap()) {
+      state.getStateMap()[balances.first] = balances.second;
+    }
+    for (const auto& debits : trial_aggregate) {
+      auto it = aggregate.find(debits.first);
+      if (it != aggregate.end()) {
+        it->second = debits.second;
+      } else {
+        aggregate.insert(debits);
+      }
+    }
+    for (const auto& xfer : tx.getTransfers()) {
+      summary.addItem(xfer->getAddress(), xfer->getCoin(), xfer->getAmount(), xfer->getDelay());
+    }
+    return true;
+  }
+
   /** Reverifies Transactions for this pool.
    *  @note this function modifies pending_proposal_
    *  @note if this returns false, a new proposal must be created
@@ -484,7 +1060,7 @@ class UnrecordedTransactionPool {
    */
   bool RemoveTransaction(const Signature& sig) {
     size_t txs_size = txs_.size();
-    if (txs_.erase(sig) == 0) {
+    if (!eraseTransaction(sig)) {
       LOG_WARNING << "RemoveTransaction(): ret = 0, transaction not found: "
                   << sig.getJSON();
     } else {
@@ -493,26 +1069,8 @@ class UnrecordedTransactionPool {
     LOG_DEBUG << "RemoveTransactions: (size pre/size post) ("
               << txs_size << "/"
               << txs_.size() << ")";
-    return true;
-  }
-
-  /** Removes invalid transactions from this pool
-   *  @pre not thread-safe, call from within a mutex guard
-   *  @return true if all invalid transactions in the block were removed
-   *  @return false if possible that not all invalid transactions removed
-   */
-  bool RemoveInvalidTransactions(const ChainState& state
-      , const KeyRing& keys, const Summary& summary) {
-    std::map<Address, SmartCoin> aggregate;
-    ChainState state_clone(ChainState::Copy(state));
-    Summary sum_clone(Summary::Copy(summary));
-    for (auto iter = txs_.begin(); iter != txs_.end(); ++iter) {
-	  if (!iter->second.second->isValidInAggregate(state_clone, keys, sum_clone
-                                                 , aggregate, state)) {
-        RemoveTransaction(iter->second.second->getSignature());
-        return false;
-      }
-    }
+    pending_gauge_.set(txs_.size());
+    bytes_gauge_.set(pool_bytes_);
     return true;
   }
 
@@ -525,7 +1083,8 @@ class UnrecordedTransactionPool {
     std::lock_guard<std::mutex> guard(txs_mutex_);
     size_t txs_size = txs_.size();
     for (auto const& item : proposed.getTransactions()) {
-      if (txs_.erase(item->getSignature()) == 0) {
+      rememberFinalized(item->getSignature());
+      if (!eraseTransaction(item->getSignature())) {
         LOG_WARNING << "RemoveTransactions(): ret = 0, transaction not found: "
                     << item->getSignature().getJSON();
       } else {
@@ -536,6 +1095,8 @@ class UnrecordedTransactionPool {
               << proposed.getNumTransactions() << "/"
               << txs_size << "/"
               << txs_.size() << ")";
+    pending_gauge_.set(txs_.size());
+    bytes_gauge_.set(pool_bytes_);
     return true;
   }
 
@@ -546,11 +1107,164 @@ class UnrecordedTransactionPool {
     std::lock_guard<std::mutex> guard(txs_mutex_);
     size_t txs_size = txs_.size();
     for (auto const& item : final_block.getTransactions()) {
-      txs_.erase(item->getSignature());
+      rememberFinalized(item->getSignature());
+      eraseTransaction(item->getSignature());
     }
     LOG_DEBUG << "RemoveTransactions: (size pre/size post) ("
               << txs_size << "/"
               << txs_.size() << ")";
+    pending_gauge_.set(txs_.size());
+    bytes_gauge_.set(pool_bytes_);
+  }
+
+  /** Drops a resubmitted Transaction before it is parsed or verified
+   *  @note if the Transaction is pending, its reference count is incremented
+   *  @param sig - the signature of the Transaction
+   *  @return true iff the Transaction is pending or was recently finalized
+   */
+  bool dropDuplicate(const Signature& sig) {
+    std::lock_guard<std::mutex> guard(txs_mutex_);
+    auto it = txs_.find(sig);
+    if (it != txs_.end()) {
+      it->second.refs++;
+      pending_duplicates_.add(1);
+      return true;
+    }
+    if (isRecentlyFinalized(sig)) {
+      finalized_duplicates_.add(1);
+      return true;
+    }
+    return false;
+  }
+
+  /**
+   *  @return milliseconds on a monotonic clock
+   */
+  static uint64_t NowMillis() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  /** Adds a Transaction to txs_ and the admission queue
+   *  @note txs_mutex_ must be held and the Transaction must not be in txs_
+   *  @param sig - the signature of the Transaction
+   *  @param tx - the Transaction
+   *  @param refs - the initial reference count
+   */
+  void admitTransaction(const Signature& sig, TransactionPtr tx, uint8_t refs) {
+    uint64_t sequence = next_sequence_++;
+    pool_bytes_ += tx->getCanonical().size();
+    txs_.emplace(sig, SharedTransaction(refs, std::move(tx), sequence));
+    admissions_.push_back(Admission{sig, sequence, NowMillis()});
+  }
+
+  /** Removes a Transaction from txs_
+   *  @note txs_mutex_ must be held, its admission is skipped when it is reached
+   *  @param sig - the signature of the Transaction
+   *  @return true iff the Transaction was in txs_
+   */
+  bool eraseTransaction(const Signature& sig) {
+    auto it = txs_.find(sig);
+    if (it == txs_.end()) {
+      return false;
+    }
+    pool_bytes_ -= it->second.tx->getCanonical().size();
+    txs_.erase(it);
+    return true;
+  }
+
+  /** Removes the oldest admission and its Transaction, if it is still pending
+   *  @note txs_mutex_ must be held and admissions_ must not be empty
+   *  @return true iff a Transaction was removed
+   */
+  bool popAdmission() {
+    const Admission& oldest = admissions_.front();
+    auto it = txs_.find(oldest.sig);
+    bool removed = false;
+    if (it != txs_.end() && it->second.sequence == oldest.sequence) {
+      pool_bytes_ -= it->second.tx->getCanonical().size();
+      txs_.erase(it);
+      removed = true;
+    }
+    admissions_.pop_front();
+    return removed;
+  }
+
+  /** Removes the Transactions that waited longer than tx_ttl_ms_
+   *  @note txs_mutex_ must be held
+   *  @param now_ms - the current time from NowMillis()
+   *  @return the number of Transactions removed
+   */
+  size_t expireTransactions(uint64_t now_ms) {
+    size_t expired = 0;
+    if (tx_ttl_ms_ == 0) {
+      return expired;
+    }
+    while (!admissions_.empty() && admissions_.front().time_ms + tx_ttl_ms_ <= now_ms) {
+      if (popAdmission()) {
+        expired++;
+      }
+    }
+    if (expired > 0) {
+      LOG_INFO << "UnrecordedTransactionPool: expired " << expired << " transactions";
+      expired_counter_.add(expired);
+    }
+    return expired;
+  }
+
+  /** Removes the oldest Transactions until this pool is within its limits.
+   *  Also drops the admissions of Transactions that already left the pool
+   *  once they outnumber the pending Transactions.
+   *  @note txs_mutex_ must be held
+   *  @return the number of Transactions removed
+   */
+  size_t evictTransactions() {
+    size_t evicted = 0;
+    while (!admissions_.empty() && (txs_.size() > max_txs_ || pool_bytes_ > max_bytes_)) {
+      if (popAdmission()) {
+        evicted++;
+      }
+    }
+    if (evicted > 0) {
+      LOG_WARNING << "UnrecordedTransactionPool: full, evicted " << evicted << " transactions";
+      evicted_counter_.add(evicted);
+    }
+    if (admissions_.size() > 2 * txs_.size() + kMIN_STALE_ADMISSIONS) {
+      std::deque<Admission> live;
+      for (auto& admission : admissions_) {
+        auto it = txs_.find(admission.sig);
+        if (it != txs_.end() && it->second.sequence == admission.sequence) {
+          live.push_back(std::move(admission));
+        }
+      }
+      admissions_.swap(live);
+    }
+    return evicted;
+  }
+
+  /** Checks whether a Transaction was recently finalized
+   *  @note txs_mutex_ must be held
+   *  @param sig - the signature of the Transaction
+   *  @return true iff the signature is among the recently finalized ones
+   */
+  bool isRecentlyFinalized(const Signature& sig) const {
+    return recent_finalized_.find(sig) != recent_finalized_.end();
+  }
+
+  /** Remembers the signature of a finalized Transaction,
+   *  forgetting the oldest one once kRECENT_FINALIZED_SIGNATURES are held
+   *  @note txs_mutex_ must be held
+   *  @param sig - the signature of the Transaction
+   */
+  void rememberFinalized(const Signature& sig) {
+    if (!recent_finalized_.insert(sig).second) {
+      return;
+    }
+    recent_finalized_order_.push_back(sig);
+    if (recent_finalized_order_.size() > kRECENT_FINALIZED_SIGNATURES) {
+      recent_finalized_.erase(recent_finalized_order_.front());
+      recent_finalized_order_.pop_front();
+    }
   }
 
   /** Finalize a ProposedBlock
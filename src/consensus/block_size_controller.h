@@ -0,0 +1,158 @@
+/*
+ * consensus/block_size_controller.h sizes proposals from measured
+ * consensus latency.
+ *
+ * After each local block is finalized the controller compares its
+ * validation round trip with a target latency. Over the target, the block
+ * size shrinks by a quarter. Under the target after a full block, it grows
+ * by an eighth. While the pool holds fewer transactions than the target
+ * size, the proposer waits for more, but only for the part of the latency
+ * budget the round trip leaves unused.
+ *
+ * With a target latency of 0 the controller keeps the configured maximum
+ * block size and wait, as static sizing did.
+ *
+ * @copywrite  2018 Devvio Inc
+ */
+#pragma once
+
+#include <algorithm>
+#include <mutex>
+
+#include "common/metrics.h"
+
+namespace Devv {
+
+/// Weight of the newest round trip in the smoothed round trip
+static const double kBLOCK_RTT_SMOOTHING = 0.25;
+/// Fraction of the block size removed when a round trip is over the target
+static const double kBLOCK_SIZE_DECREASE = 0.25;
+/// Fraction of the block size added after a full block under the target
+static const double kBLOCK_SIZE_INCREASE = 0.125;
+
+/**
+ * The bounds of adaptive block sizing
+ */
+struct BlockSizeBounds {
+  /// Smallest target block size
+  size_t min_txs = 1;
+  /// Largest target block size, the whole block when sizing is static
+  size_t max_txs = 10000;
+  /// Longest wait for a fuller block in milliseconds
+  uint64_t max_wait_ms = 0;
+  /// Validation round trip to aim for in milliseconds, 0 for static sizing
+  uint64_t target_latency_ms = 0;
+};
+
+class BlockSizeController {
+ public:
+  /**
+   * Constructor
+   * @param bounds - the bounds of the block size and wait
+   */
+  explicit BlockSizeController(const BlockSizeBounds& bounds)
+      : target_txs_gauge_(MetricsRegistry::Get().gauge("consensus.block.target_txs"))
+      , wait_gauge_(MetricsRegistry::Get().gauge("consensus.block.wait_ms")) {
+    setBounds(bounds);
+  }
+
+  BlockSizeController(const BlockSizeController&) = delete;
+  BlockSizeController& operator=(const BlockSizeController&) = delete;
+
+  /**
+   * Sets the bounds and starts over from the largest block size
+   * @param bounds - the bounds of the block size and wait
+   */
+  void setBounds(const BlockSizeBounds& bounds) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    bounds_ = bounds;
+    bounds_.max_txs = std::max<size_t>(bounds_.max_txs, 1);
+    bounds_.min_txs = std::min(std::max<size_t>(bounds_.min_txs, 1), bounds_.max_txs);
+    target_txs_ = bounds_.max_txs;
+    smoothed_rtt_ms_ = 0;
+    target_txs_gauge_.set(target_txs_);
+  }
+
+  /**
+   * @return true iff the block size follows the measured latency
+   */
+  bool isAdaptive() const {
+    std::lock_guard<std::mutex> guard(mutex_);
+    return bounds_.target_latency_ms > 0;
+  }
+
+  /**
+   * @return the number of Transactions the next proposal should hold
+   */
+  size_t getTargetTxs() const {
+    std::lock_guard<std::mutex> guard(mutex_);
+    return target_txs_;
+  }
+
+  /**
+   * @return the smoothed validation round trip in milliseconds
+   */
+  double getSmoothedRttMillis() const {
+    std::lock_guard<std::mutex> guard(mutex_);
+    return smoothed_rtt_ms_;
+  }
+
+  /**
+   * How long the proposer should wait for a fuller block
+   * @param pending_txs - the number of Transactions in the pool
+   * @return milliseconds to wait, 0 to propose now
+   */
+  uint64_t getWaitMillis(size_t pending_txs) const {
+    std::lock_guard<std::mutex> guard(mutex_);
+    uint64_t wait = 0;
+    if (pending_txs < target_txs_) {
+      wait = bounds_.max_wait_ms;
+      if (bounds_.target_latency_ms > 0) {
+        double budget = bounds_.target_latency_ms - smoothed_rtt_ms_;
+        wait = std::min(wait, static_cast<uint64_t>(std::max(budget, 0.0)));
+      }
+    }
+    wait_gauge_.set(wait);
+    return wait;
+  }
+
+  /**
+   * Adjusts the block size after a block of this node is finalized
+   * @param block_txs - the number of Transactions in the block
+   * @param rtt_ms - milliseconds from proposing the block to finalizing it
+   */
+  void recordValidation(size_t block_txs, double rtt_ms) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    if (smoothed_rtt_ms_ == 0) {
+      smoothed_rtt_ms_ = rtt_ms;
+    } else {
+      smoothed_rtt_ms_ += kBLOCK_RTT_SMOOTHING * (rtt_ms - smoothed_rtt_ms_);
+    }
+    if (bounds_.target_latency_ms == 0) {
+      return;
+    }
+    if (rtt_ms > bounds_.target_latency_ms) {
+      size_t decrease = std::max<size_t>(target_txs_ * kBLOCK_SIZE_DECREASE, 1);
+      target_txs_ = std::max(target_txs_ - std::min(decrease, target_txs_), bounds_.min_txs);
+    } else if (block_txs >= target_txs_) {
+      size_t increase = std::max<size_t>(target_txs_ * kBLOCK_SIZE_INCREASE, 1);
+      target_txs_ = std::min(target_txs_ + increase, bounds_.max_txs);
+    }
+    target_txs_gauge_.set(target_txs_);
+  }
+
+ private:
+  mutable std::mutex mutex_;
+  BlockSizeBounds bounds_;
+  /// Number of Transactions the next proposal should hold
+  size_t target_txs_ = 0;
+  /// Smoothed validation round trip, 0 until the first block is finalized
+  double smoothed_rtt_ms_ = 0;
+
+  /// Current target block size
+  Gauge& target_txs_gauge_;
+  /// Last wait for a fuller block
+  Gauge& wait_gauge_;
+};
+
+} // namespace Devv
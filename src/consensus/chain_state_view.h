@@ -0,0 +1,263 @@
+/*
+ * consensus/chain_state_view.h shares the ChainState of the highest
+ * FinalBlock with readers such as oracles.
+ *
+ * A snapshot is a shared pointer to an immutable state, so readers
+ * pay one reference count instead of a copy of every address. Readers
+ * keep their snapshot while new blocks replace it, and each block
+ * copies the state at most once.
+ *
+ * Blocks that arrive before the block they follow are kept until the
+ * missing block is applied, so a dropped or reordered message leaves
+ * the view behind instead of stuck.
+ *
+ * @copywrite  2018 Devvio Inc
+ */
+#pragma once
+
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include "consensus/blockchain.h"
+
+namespace Devv {
+
+/// Blocks kept while a block before them is missing
+static const size_t kMAX_PENDING_VIEW_BLOCKS = 64;
+/// Applied blocks remembered to recognize copies from other validators
+static const size_t kVIEW_RECENT_BLOCKS = 16;
+
+class ChainStateView {
+ public:
+  typedef std::shared_ptr<const ChainState> StatePtr;
+
+  /**
+   * @return the previous hash of the first block of a chain
+   */
+  static Hash GetGenesisHash() {
+    return DevvHash({'G', 'e', 'n', 'e', 's', 'i', 's'});
+  }
+
+  /**
+   * Constructor, an empty state before the first block
+   */
+  ChainStateView()
+      : state_(std::make_shared<ChainState>()), head_(GetGenesisHash()) {}
+
+  /**
+   * Constructor, a known state before the first block
+   * @param state - the state to start from
+   */
+  explicit ChainStateView(StatePtr state)
+      : state_(std::move(state)), head_(GetGenesisHash()) {}
+
+  /**
+   * Constructor, the state of the highest block of a chain
+   * @param chain - the chain to start from
+   */
+  explicit ChainStateView(const Blockchain& chain) : ChainStateView() {
+    if (chain.size() > 0) {
+      Blockchain::BlockSharedPtr block = chain.back();
+      state_ = StatePtr(block, &block->getChainState());
+      head_ = DevvHash(block->getCanonical());
+      height_ = chain.size();
+      recent_.push_back(block->getPreviousHash());
+    }
+  }
+
+  ChainStateView(const ChainStateView&) = delete;
+  ChainStateView& operator=(const ChainStateView&) = delete;
+
+  /**
+   * @return the state of the highest block, unchanged by later blocks
+   */
+  StatePtr getSnapshot() const {
+    std::lock_guard<std::mutex> guard(mutex_);
+    return state_;
+  }
+
+  /**
+   * @param coin - the coin type to check
+   * @param addr - the address to check
+   * @return the number of coins of this type at this address
+   */
+  int64_t getAmount(uint64_t coin, const Address& addr) const {
+    return getSnapshot()->getAmount(coin, addr);
+  }
+
+  /**
+   * @return the number of blocks applied to this view
+   */
+  size_t getHeight() const {
+    std::lock_guard<std::mutex> guard(mutex_);
+    return height_;
+  }
+
+  /**
+   * @return the hash of the highest block, the genesis hash before the first
+   */
+  Hash getHead() const {
+    std::lock_guard<std::mutex> guard(mutex_);
+    return head_;
+  }
+
+  /**
+   * @return the number of blocks waiting for a missing block before them,
+   *   more than 0 while this view is behind the chain
+   */
+  size_t getPendingCount() const {
+    std::lock_guard<std::mutex> guard(mutex_);
+    return pending_.size();
+  }
+
+  /**
+   * Makes a block the highest block if it follows the current one,
+   * otherwise keeps it until the blocks before it are applied
+   * @note the same block received from several validators is applied once
+   * @param block - a FinalBlock whose state follows the state of the block before it
+   * @return true iff the block was applied
+   */
+  bool push_back(Blockchain::BlockSharedPtr block) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    if (block->getPreviousHash() != head_) {
+      if (!isRecentInternal(block->getPreviousHash())) {
+        deferInternal(block, true);
+      }
+      return false;
+    }
+    applyInternal(StatePtr(block, &block->getChainState()), *block);
+    applyPendingInternal();
+    return true;
+  }
+
+  /**
+   * Makes a block the highest block if it follows the current one,
+   * otherwise keeps a copy until the blocks before it are applied.
+   * For blocks read with FinalBlock::Create(), which carry no state,
+   * the Summary of the block is added to a copy of the current state.
+   * @note the same block received from several validators is applied once
+   * @param block - a finalized block
+   * @return true iff the block was applied
+   */
+  bool push_back(const FinalBlock& block) {
+    Hash head;
+    StatePtr prior;
+    {
+      std::lock_guard<std::mutex> guard(mutex_);
+      if (block.getPreviousHash() != head_) {
+        if (!isRecentInternal(block.getPreviousHash())) {
+          deferInternal(std::make_shared<FinalBlock>(block), false);
+        }
+        return false;
+      }
+      head = head_;
+      prior = state_;
+    }
+    StatePtr next = ApplySummary(*prior, block);
+    std::lock_guard<std::mutex> guard(mutex_);
+    if (head_ != head) {
+      return false;
+    }
+    applyInternal(std::move(next), block);
+    applyPendingInternal();
+    return true;
+  }
+
+ private:
+  /**
+   * A block that arrived before the block it follows
+   */
+  struct PendingBlock {
+    Blockchain::BlockSharedPtr block;
+    /// whether the block carries its own state or only a Summary
+    bool has_state;
+  };
+
+  /**
+   * @param prior - the state before the block
+   * @param block - the block whose Summary to add
+   * @return a copy of prior with the transfers of the block
+   */
+  static StatePtr ApplySummary(const ChainState& prior, const FinalBlock& block) {
+    auto next = std::make_shared<ChainState>(prior);
+    for (const auto& change : block.getSummary().getSummaryMap()) {
+      for (const auto& delayed : change.second.first) {
+        next->addCoin(SmartCoin(change.first, delayed.first,
+                                static_cast<int64_t>(delayed.second.delta)));
+      }
+      for (const auto& coin : change.second.second) {
+        next->addCoin(SmartCoin(change.first, coin.first, coin.second));
+      }
+    }
+    return next;
+  }
+
+  /**
+   * @note expects mutex_ to be held
+   * @param prev_hash - the previous hash of a block
+   * @return true iff a block with this previous hash was applied recently
+   */
+  bool isRecentInternal(const Hash& prev_hash) const {
+    return std::find(recent_.begin(), recent_.end(), prev_hash) != recent_.end();
+  }
+
+  /**
+   * Keeps a block until the block before it is applied, blocks beyond
+   * kMAX_PENDING_VIEW_BLOCKS are dropped and must be pushed again
+   * @note expects mutex_ to be held
+   */
+  void deferInternal(Blockchain::BlockSharedPtr block, bool has_state) {
+    if (pending_.size() < kMAX_PENDING_VIEW_BLOCKS) {
+      Hash prev_hash(block->getPreviousHash());
+      pending_.emplace(prev_hash, PendingBlock{std::move(block), has_state});
+    }
+  }
+
+  /**
+   * Makes a block the highest block
+   * @note expects mutex_ to be held
+   */
+  void applyInternal(StatePtr state, const FinalBlock& block) {
+    recent_.push_back(block.getPreviousHash());
+    if (recent_.size() > kVIEW_RECENT_BLOCKS) {
+      recent_.pop_front();
+    }
+    pending_.erase(block.getPreviousHash());
+    state_ = std::move(state);
+    head_ = DevvHash(block.getCanonical());
+    height_++;
+  }
+
+  /**
+   * Applies the kept blocks that follow the highest block
+   * @note expects mutex_ to be held
+   */
+  void applyPendingInternal() {
+    for (auto it = pending_.find(head_); it != pending_.end(); it = pending_.find(head_)) {
+      PendingBlock next(std::move(it->second));
+      pending_.erase(it);
+      if (next.has_state) {
+        applyInternal(StatePtr(next.block, &next.block->getChainState()), *next.block);
+      } else {
+        applyInternal(ApplySummary(*state_, *next.block), *next.block);
+      }
+    }
+  }
+
+  mutable std::mutex mutex_;
+  /// State of the highest block
+  StatePtr state_;
+  /// Hash of the highest block, the previous hash of the next one
+  Hash head_;
+  /// Number of blocks applied
+  size_t height_ = 0;
+  /// Blocks waiting for the block before them, by previous hash
+  std::map<Hash, PendingBlock> pending_;
+  /// Previous hashes of the latest applied blocks
+  std::deque<Hash> recent_;
+};
+
+} // namespace Devv
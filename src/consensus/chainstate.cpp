@@ -37,8 +37,10 @@ bool ChainState::addCoin(const SmartCoin& coin) {
 int64_t ChainState::getAmount(uint64_t type, const Address& addr) const {
   auto it = state_map_.find(addr);
   if (it != state_map_.end()) {
-    int64_t amount = it->second.at(type);
-    return amount;
+    auto coin = it->second.find(type);
+    if (coin != it->second.end()) {
+      return coin->second;
+    }
   }
   return(0);
 }
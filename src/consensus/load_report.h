@@ -0,0 +1,152 @@
+/*
+ * consensus/load_report.h defines the load signal validators publish
+ * so transaction sources can back off before validators fall behind.
+ *
+ * A validator reports how full its UnrecordedTransactionPool is and
+ * how many messages wait in its outgoing queue. Reports are published
+ * on a topic of their own, so only subscribers that ask for them,
+ * like devv-announcer, receive them.
+ *
+ * @copywrite  2018 Devvio Inc
+ */
+#pragma once
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "common/binary_converters.h"
+#include "common/devv_exceptions.h"
+
+namespace Devv {
+
+/// Version of the load report format
+static const byte kLOAD_REPORT_FORMAT = 1;
+/// Milliseconds between load reports from a validator
+static const uint64_t kLOAD_REPORT_INTERVAL_MS = 200;
+/// Milliseconds after which a load report is ignored
+static const uint64_t kLOAD_REPORT_STALE_MS = 2000;
+/// Pool occupancy at which a validator is busy
+static const double kLOAD_BUSY_OCCUPANCY = 0.9;
+/// Queued outgoing messages at which a node is busy
+static const uint64_t kLOAD_BUSY_QUEUE_DEPTH = 10000;
+/// Retry delays suggested to clients of a busy node
+static const uint32_t kLOAD_MIN_RETRY_MS = 100;
+static const uint32_t kLOAD_MAX_RETRY_MS = 5000;
+
+/**
+ * The load of one validator
+ */
+struct LoadReport {
+  /// Index of the reporting node
+  uint32_t node_index = 0;
+  /// Transactions and serialized bytes in the pool
+  uint64_t pending_txs = 0;
+  uint64_t pending_bytes = 0;
+  /// Limits of the pool
+  uint64_t max_txs = 0;
+  uint64_t max_bytes = 0;
+  /// Messages waiting to be sent
+  uint64_t queue_depth = 0;
+
+  /**
+   * @return the fullest of the pool limits, from 0 to 1
+   */
+  double getOccupancy() const {
+    double occupancy = 0;
+    if (max_txs > 0) {
+      occupancy = std::max(occupancy, static_cast<double>(pending_txs) / max_txs);
+    }
+    if (max_bytes > 0) {
+      occupancy = std::max(occupancy, static_cast<double>(pending_bytes) / max_bytes);
+    }
+    return std::min(occupancy, 1.0);
+  }
+};
+
+/**
+ * @param shard_uri - the URI of the shard
+ * @return the topic load reports of the shard are published on
+ */
+static inline std::string GetLoadReportUri(const std::string& shard_uri) {
+  return "load-" + shard_uri;
+}
+
+/**
+ * Serialize a load report
+ * @param report
+ * @return the binary report
+ */
+static inline std::vector<byte> EncodeLoadReport(const LoadReport& report) {
+  std::vector<byte> out;
+  out.push_back(kLOAD_REPORT_FORMAT);
+  Uint32ToBin(report.node_index, out);
+  Uint64ToBin(report.pending_txs, out);
+  Uint64ToBin(report.pending_bytes, out);
+  Uint64ToBin(report.max_txs, out);
+  Uint64ToBin(report.max_bytes, out);
+  Uint64ToBin(report.queue_depth, out);
+  return out;
+}
+
+/**
+ * Deserialize a load report
+ * @param data - the binary report
+ * @return the report
+ * @throw DeserializationError if data is not a load report
+ */
+static inline LoadReport DecodeLoadReport(const std::vector<byte>& data) {
+  const size_t size = 1 + kBYTES_PER_INT + 5 * sizeof(uint64_t);
+  if (data.size() != size || data[0] != kLOAD_REPORT_FORMAT) {
+    throw DeserializationError("DecodeLoadReport(): invalid load report");
+  }
+  LoadReport report;
+  size_t offset = 1;
+  report.node_index = BinToUint32(data, offset);
+  offset += kBYTES_PER_INT;
+  report.pending_txs = BinToUint64(data, offset);
+  offset += sizeof(uint64_t);
+  report.pending_bytes = BinToUint64(data, offset);
+  offset += sizeof(uint64_t);
+  report.max_txs = BinToUint64(data, offset);
+  offset += sizeof(uint64_t);
+  report.max_bytes = BinToUint64(data, offset);
+  offset += sizeof(uint64_t);
+  report.queue_depth = BinToUint64(data, offset);
+  return report;
+}
+
+/**
+ * How long a client should wait before sending more Transactions
+ * to a node with the given load. The delay grows linearly from
+ * kLOAD_MIN_RETRY_MS at the busy thresholds to kLOAD_MAX_RETRY_MS
+ * at a full pool or twice the busy queue depth.
+ * @param occupancy - the pool occupancy, from 0 to 1
+ * @param queue_depth - the number of queued outgoing messages
+ * @return milliseconds to wait, 0 if the node is not busy
+ */
+static inline uint32_t RetryAfterMillis(double occupancy, uint64_t queue_depth) {
+  double overload = 0;
+  if (occupancy >= kLOAD_BUSY_OCCUPANCY) {
+    overload = (occupancy - kLOAD_BUSY_OCCUPANCY) / (1 - kLOAD_BUSY_OCCUPANCY);
+  } else if (queue_depth < kLOAD_BUSY_QUEUE_DEPTH) {
+    return 0;
+  }
+  if (queue_depth >= kLOAD_BUSY_QUEUE_DEPTH) {
+    double excess = static_cast<double>(queue_depth - kLOAD_BUSY_QUEUE_DEPTH) / kLOAD_BUSY_QUEUE_DEPTH;
+    overload = std::max(overload, excess);
+  }
+  overload = std::min(overload, 1.0);
+  return kLOAD_MIN_RETRY_MS
+      + static_cast<uint32_t>(overload * (kLOAD_MAX_RETRY_MS - kLOAD_MIN_RETRY_MS));
+}
+
+/**
+ * @param report - the load of a validator
+ * @return milliseconds to wait, 0 if the validator is not busy
+ */
+static inline uint32_t RetryAfterMillis(const LoadReport& report) {
+  return RetryAfterMillis(report.getOccupancy(), report.queue_depth);
+}
+
+} // namespace Devv
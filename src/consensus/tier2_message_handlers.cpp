@@ -5,7 +5,10 @@
  */
 
 #include "consensus/tier2_message_handlers.h"
+#include "common/metrics.h"
+#include "primitives/block_codec.h"
 #include "primitives/buffers.h"
+#include "primitives/thin_block.h"
 
 #include <boost/filesystem.hpp>
 
@@ -13,11 +16,74 @@ namespace fs = boost::filesystem;
 
 namespace Devv {
 
+/// Milliseconds to wait for missing transactions before asking again
+static const double kTHIN_BLOCK_RETRY_MILLIS = 2000;
+/// Requests for the missing transactions sent to the origin before asking other nodes for the whole block
+static const size_t kTHIN_BLOCK_MAX_RETRIES = 2;
+/// Offset of the merkle root in a canonical FinalBlock
+static const size_t kFINAL_BLOCK_MERKLE_OFFSET = 49;
+
+/**
+ * Encode a request for transactions of a thin block
+ * @param thin the incomplete block
+ * @param sigs Signatures of the requested transactions
+ * @param context
+ * @return the binary request
+ */
+static std::vector<byte> EncodeTransactionRequest(const ThinBlock& thin,
+                                                  const std::vector<Signature>& sigs,
+                                                  const DevvContext& context) {
+  ThinBlockRequest request;
+  request.kind = thin.kind;
+  request.block_id = thin.getBlockId();
+  request.requester = context.get_current_node();
+  request.sigs = sigs;
+  return EncodeThinBlockRequest(request);
+}
+
+/**
+ * Ask the origin of a thin block for the transactions missing from this node's pool
+ * @param thin the incomplete block
+ * @param missing Signatures of the missing transactions
+ * @param context
+ * @param index index of the block message
+ * @param callback
+ * @return the request message, already sent
+ */
+static std::vector<byte> RequestMissingTransactions(const ThinBlock& thin,
+                                                    const std::vector<Signature>& missing,
+                                                    const DevvContext& context,
+                                                    uint32_t index,
+                                                    std::function<void(DevvMessageUniquePtr)> callback) {
+  std::vector<byte> data(EncodeTransactionRequest(thin, missing, context));
+
+  auto request_msg = std::make_unique<DevvMessage>(context.get_uri_from_index(thin.origin),
+                                                   REQUEST_TRANSACTIONS,
+                                                   data,
+                                                   index);
+  LOG_INFO << "Requesting " << missing.size() << " missing transactions from node " << thin.origin;
+  callback(std::move(request_msg));
+  return data;
+}
+
+/**
+ * Count a FinalBlock appended to the chain
+ * @param block
+ */
+static void RecordFinalBlock(const FinalBlock& block) {
+  static Counter& blocks = MetricsRegistry::Get().counter("consensus.final.blocks");
+  static Counter& txs = MetricsRegistry::Get().counter("consensus.final.transactions");
+  blocks.add();
+  txs.add(block.getNumTransactions());
+}
+
 std::vector<byte> CreateNextProposal(const KeyRing& keys,
                         Blockchain& final_chain,
                         UnrecordedTransactionPool& utx_pool,
                         const DevvContext& context) {
   MTR_SCOPE_FUNC();
+  static Histogram& build_time = MetricsRegistry::Get().histogram("consensus.proposal.build_us");
+  ScopedTimer timer(build_time);
   size_t block_height = final_chain.size();
 
   if (!(block_height % 100) || !((block_height + 1) % 100)) {
@@ -48,34 +114,49 @@ std::vector<byte> CreateNextProposal(const KeyRing& keys,
 
   LOG_INFO << "Proposal #"+std::to_string(block_height+1)+".";
 
+  if (context.get_thin_blocks()) {
+    return utx_pool.getThinProposal(context.get_current_node());
+  }
   return utx_pool.getProposal();
 }
 
-bool HandleFinalBlock(DevvMessageUniquePtr ptr,
-                      const DevvContext& context,
-                      const KeyRing& keys,
-                      Blockchain& final_chain,
-                      UnrecordedTransactionPool& utx_pool,
-                      std::function<void(DevvMessageUniquePtr)> callback) {
-
-  if (ptr->message_type != eMessageType::FINAL_BLOCK) {
-    throw std::runtime_error("HandleFinalBlock: message != eMessageType::FINAL_BLOCK");
-  }
-
-  MTR_SCOPE_FUNC();
-  //Make the incoming block final
-  //if pending proposal, makes sure it is still valid
-  //if no pending proposal, check if should make one
-
+/**
+ * Append a remote FinalBlock to the chain and propose the next block if it is this node's turn
+ * @param ptr canonical FinalBlock message
+ * @param verified the block's transactions if it was reassembled from the pool, empty otherwise
+ * @param context
+ * @param keys
+ * @param final_chain
+ * @param utx_pool
+ * @param callback
+ * @return true iff a proposal was sent
+ */
+static bool AppendFinalBlock(DevvMessageUniquePtr ptr,
+                             std::vector<TransactionPtr>& verified,
+                             const DevvContext& context,
+                             const KeyRing& keys,
+                             Blockchain& final_chain,
+                             UnrecordedTransactionPool& utx_pool,
+                             std::function<void(DevvMessageUniquePtr)> callback) {
+  static Histogram& apply_time = MetricsRegistry::Get().histogram("consensus.final.remote_us");
+  static Histogram& propagation = MetricsRegistry::Get().histogram("consensus.final.propagation_ms");
+  ScopedTimer timer(apply_time);
   InputBuffer buffer(ptr->data);
-  LogDevvMessageSummary(*ptr, "HandleFinalBlock()");
-
   ChainState prior = final_chain.getHighestChainState();
   LOG_DEBUG << "prior.size(): " << prior.size();
   utx_pool.LockProposals();
-  FinalPtr top_block = std::make_shared<FinalBlock>(utx_pool.FinalizeRemoteBlock(
-                                               buffer, prior, keys));
+  FinalPtr top_block;
+  if (verified.empty()) {
+    top_block = std::make_shared<FinalBlock>(utx_pool.FinalizeRemoteBlock(buffer, prior, keys));
+  } else {
+    top_block = std::make_shared<FinalBlock>(utx_pool.FinalizeRemoteBlock(buffer, prior, keys, verified));
+  }
   final_chain.push_back(top_block);
+  uint64_t now = GetMillisecondsSinceEpoch();
+  if (now > top_block->getBlockTime()) {
+    propagation.record(now - top_block->getBlockTime());
+  }
+  RecordFinalBlock(*top_block);
   LOG_NOTICE << "final_chain.push_back(): Estimated rate: (ntxs/duration): rate -> "
              << "(" << final_chain.getNumTransactions() << "/"
              << utx_pool.getElapsedTime() << "): "
@@ -137,26 +218,141 @@ bool HandleFinalBlock(DevvMessageUniquePtr ptr,
   return sent_message;
 }
 
-bool HandleProposalBlock(DevvMessageUniquePtr ptr,
-                         const DevvContext& context,
-                         const KeyRing& keys,
-                         const Blockchain& final_chain,
-                         TransactionCreationManager& tcm,
-                         std::function<void(DevvMessageUniquePtr)> callback) {
+/**
+ * Hold a FinalBlock that arrived while a thin FinalBlock waits on missing transactions
+ * @param data the FinalBlock message data
+ * @param utx_pool
+ */
+static void DeferFinalBlock(const std::vector<byte>& data, UnrecordedTransactionPool& utx_pool) {
+  if (utx_pool.DeferRemoteBlock(data)) {
+    LOG_INFO << "HandleFinalBlock: waiting on missing transactions, deferring block";
+  } else {
+    LOG_ERROR << "HandleFinalBlock: too many blocks deferred (" << kMAX_DEFERRED_BLOCKS
+              << "), dropping block";
+  }
+}
 
-  if (ptr->message_type != eMessageType::PROPOSAL_BLOCK) {
-    throw std::runtime_error("HandleProposalBlock: message != eMessageType::PROPOSAL_BLOCK");
+bool RetryMissingTransactions(const DevvContext& context,
+                              UnrecordedTransactionPool& utx_pool,
+                              std::function<void(DevvMessageUniquePtr)> callback) {
+  uint32_t origin = 0;
+  size_t attempt = 0;
+  std::vector<byte> request;
+  if (!utx_pool.NextRemoteBlockRequest(kTHIN_BLOCK_RETRY_MILLIS, kTHIN_BLOCK_MAX_RETRIES,
+                                       origin, attempt, request)) {
+    return false;
+  }
+  uint32_t node = origin;
+  if (attempt > kTHIN_BLOCK_MAX_RETRIES) {
+    // Ask the other nodes in turn for the whole block, skipping this node
+    unsigned int peers = context.get_peer_count();
+    unsigned int self = context.get_current_node() % peers;
+    unsigned int peer = (origin + attempt - kTHIN_BLOCK_MAX_RETRIES) % peers;
+    if (peer == self) {
+      peer = (peer + 1) % peers;
+    }
+    node = context.get_current_node() - self + peer;
+    LOG_WARNING << "RetryMissingTransactions: missing transactions not received from node "
+                << origin << ", asking node " << node << " for the whole block";
+  } else {
+    LOG_WARNING << "RetryMissingTransactions: missing transactions not received, asking node "
+                << origin << " again";
+  }
+  callback(std::make_unique<DevvMessage>(context.get_uri_from_index(node),
+                                         REQUEST_TRANSACTIONS,
+                                         request,
+                                         static_cast<uint32_t>(attempt)));
+  return true;
+}
+
+bool HandleFinalBlock(DevvMessageUniquePtr ptr,
+                      const DevvContext& context,
+                      const KeyRing& keys,
+                      Blockchain& final_chain,
+                      UnrecordedTransactionPool& utx_pool,
+                      std::function<void(DevvMessageUniquePtr)> callback) {
+
+  if (ptr->message_type != eMessageType::FINAL_BLOCK) {
+    throw std::runtime_error("HandleFinalBlock: message != eMessageType::FINAL_BLOCK");
   }
 
   MTR_SCOPE_FUNC();
+  //Make the incoming block final
+  //if pending proposal, makes sure it is still valid
+  //if no pending proposal, check if should make one
 
-  LogDevvMessageSummary(*ptr, "HandleProposalBlock() -> Incoming");
+  if (IsCompactBlockData(ptr->data)) {
+    ptr->data = DecodeCompactBlocks(ptr->data);
+  }
+  LogDevvMessageSummary(*ptr, "HandleFinalBlock()");
 
-  ChainState prior = final_chain.getHighestChainState();
-  InputBuffer buffer(ptr->data);
-  ProposedBlock to_validate(ProposedBlock::Create(buffer, prior, keys, tcm));
+  std::vector<TransactionPtr> verified;
+  if (IsThinBlockData(ptr->data)) {
+    ThinBlock thin(DecodeThinBlock(ptr->data));
+    if (thin.kind != ThinFinalBlock) {
+      throw DeserializationError("HandleFinalBlock: thin block is not a FinalBlock");
+    }
+    Hash merkle = thin.getBlockId();
+    if (utx_pool.IsAwaitingRemoteBlock() && !utx_pool.IsAwaitedRemoteBlock(merkle)) {
+      DeferFinalBlock(ptr->data, utx_pool);
+      RetryMissingTransactions(context, utx_pool, callback);
+      return false;
+    }
+    std::vector<byte> canonical;
+    std::vector<Signature> missing(utx_pool.ReconstructThinBlock(thin, keys, canonical, verified));
+    if (!missing.empty()) {
+      std::vector<byte> request(RequestMissingTransactions(thin, missing, context, ptr->index, callback));
+      std::vector<Signature> all_sigs;
+      all_sigs.reserve(thin.txs.size());
+      for (const auto& tx : thin.txs) {
+        all_sigs.push_back(tx.sig);
+      }
+      utx_pool.AwaitRemoteBlock(merkle, thin.origin, request,
+                                EncodeTransactionRequest(thin, all_sigs, context));
+      return false;
+    }
+    ptr->data.swap(canonical);
+  } else if (utx_pool.IsAwaitingRemoteBlock()) {
+    Hash merkle = {};
+    if (ptr->data.size() >= FinalBlock::MinSize()) {
+      std::copy_n(ptr->data.begin() + kFINAL_BLOCK_MERKLE_OFFSET, merkle.size(), merkle.begin());
+    }
+    if (!utx_pool.IsAwaitedRemoteBlock(merkle)) {
+      DeferFinalBlock(ptr->data, utx_pool);
+      return false;
+    }
+  }
+
+  uint32_t index = ptr->index;
+  bool sent_message = AppendFinalBlock(std::move(ptr), verified, context, keys,
+                                       final_chain, utx_pool, callback);
+
+  // Blocks that arrived while this one was incomplete follow it
+  for (auto& data : utx_pool.ReleaseRemoteBlocks()) {
+    auto deferred = std::make_unique<DevvMessage>(context.get_shard_uri(), FINAL_BLOCK, data, index);
+    sent_message = HandleFinalBlock(std::move(deferred), context, keys,
+                                    final_chain, utx_pool, callback) || sent_message;
+  }
+  return sent_message;
+}
 
-  if (!to_validate.validate(keys)) {
+/**
+ * Validate a ProposedBlock and send this node's validation
+ * @param to_validate the proposal
+ * @param index index of the proposal message
+ * @param context
+ * @param keys
+ * @param tcm checks the node signatures on its worker threads
+ * @param callback
+ * @return true iff a validation was sent
+ */
+static bool SignProposal(ProposedBlock& to_validate,
+                         uint32_t index,
+                         const DevvContext& context,
+                         const KeyRing& keys,
+                         TransactionCreationManager& tcm,
+                         std::function<void(DevvMessageUniquePtr)> callback) {
+  if (!to_validate.validate(keys, tcm)) {
     LOG_WARNING << "ProposedBlock is invalid!";
     return false;
   }
@@ -173,12 +369,57 @@ bool HandleProposalBlock(DevvMessageUniquePtr ptr,
   auto valid = std::make_unique<DevvMessage>(context.get_shard_uri(),
                                                 VALID,
                                                 validation,
-                                                ptr->index);
+                                                index);
   LogDevvMessageSummary(*valid, "HandleProposalBlock() -> Validation");
   callback(std::move(valid));
   return true;
 }
 
+bool HandleProposalBlock(DevvMessageUniquePtr ptr,
+                         const DevvContext& context,
+                         const KeyRing& keys,
+                         const Blockchain& final_chain,
+                         UnrecordedTransactionPool& utx_pool,
+                         std::function<void(DevvMessageUniquePtr)> callback) {
+
+  if (ptr->message_type != eMessageType::PROPOSAL_BLOCK) {
+    throw std::runtime_error("HandleProposalBlock: message != eMessageType::PROPOSAL_BLOCK");
+  }
+
+  MTR_SCOPE_FUNC();
+  static Histogram& validate_time = MetricsRegistry::Get().histogram("consensus.proposal.validate_us");
+  ScopedTimer timer(validate_time);
+
+  LogDevvMessageSummary(*ptr, "HandleProposalBlock() -> Incoming");
+
+  ChainState prior = final_chain.getHighestChainState();
+  if (IsThinBlockData(ptr->data)) {
+    ThinBlock thin(DecodeThinBlock(ptr->data));
+    if (thin.kind != ThinProposedBlock) {
+      throw DeserializationError("HandleProposalBlock: thin block is not a ProposedBlock");
+    }
+    std::vector<byte> canonical;
+    std::vector<TransactionPtr> verified;
+    std::vector<Signature> missing(utx_pool.ReconstructThinBlock(thin, keys, canonical, verified));
+    if (!missing.empty()) {
+      // The proposer answers with the complete proposal, which is validated then
+      RequestMissingTransactions(thin, missing, context, ptr->index, callback);
+      return false;
+    }
+    ptr->data.swap(canonical);
+    InputBuffer buffer(ptr->data);
+    ProposedBlock to_validate(ProposedBlock::Create(buffer, prior, verified));
+    return SignProposal(to_validate, ptr->index, context, keys,
+                        utx_pool.get_transaction_creation_manager(), callback);
+  }
+
+  InputBuffer buffer(ptr->data);
+  ProposedBlock to_validate(ProposedBlock::Create(buffer, prior, keys,
+                                                  utx_pool.get_transaction_creation_manager()));
+  return SignProposal(to_validate, ptr->index, context, keys,
+                      utx_pool.get_transaction_creation_manager(), callback);
+}
+
 bool HandleValidationBlock(DevvMessageUniquePtr ptr,
                            const DevvContext& context,
                            Blockchain& final_chain,
@@ -199,12 +440,22 @@ bool HandleValidationBlock(DevvMessageUniquePtr ptr,
     LOG_DEBUG << "Ready to finalize block.";
     FinalPtr top_block = std::make_shared<FinalBlock>(utx_pool.FinalizeLocalBlock());
     final_chain.push_back(top_block);
+    RecordFinalBlock(*top_block);
     LOG_NOTICE << "final_chain.push_back(): Estimated rate: (ntxs/duration): rate -> "
                << "(" << final_chain.getNumTransactions() << "/"
                << utx_pool.getElapsedTime() << "): "
                << final_chain.getNumTransactions() / (utx_pool.getElapsedTime()/1000) << " txs/sec";
 
-    std::vector<byte> final_msg = top_block->getCanonical();
+    std::vector<byte> final_msg(EncodeBlocks(top_block->getCanonical(), context.get_block_encoding()));
+    if (context.get_thin_blocks()) {
+      // Peers reassemble the thin block, the archive subscribers need all of it
+      auto archive_block = std::make_unique<DevvMessage>(GetArchiveUri(context.get_shard_uri()),
+                                                         FINAL_BLOCK,
+                                                         final_msg,
+                                                         ptr->index);
+      callback(std::move(archive_block));
+      final_msg = EncodeThinBlock(*top_block, context.get_current_node());
+    }
 
     auto final_block = std::make_unique<DevvMessage>(context.get_shard_uri(), FINAL_BLOCK, final_msg, ptr->index);
     LogDevvMessageSummary(*final_block, "HandleValidationBlock() -> Final block");
@@ -215,6 +466,53 @@ bool HandleValidationBlock(DevvMessageUniquePtr ptr,
   return sent_message;
 }
 
+bool HandleTransactionRequest(DevvMessageUniquePtr ptr,
+                              const DevvContext& context,
+                              Blockchain& final_chain,
+                              UnrecordedTransactionPool& utx_pool,
+                              std::function<void(DevvMessageUniquePtr)> callback) {
+
+  if (ptr->message_type != eMessageType::REQUEST_TRANSACTIONS) {
+    throw std::runtime_error("HandleTransactionRequest: message != eMessageType::REQUEST_TRANSACTIONS");
+  }
+
+  MTR_SCOPE_FUNC();
+  LogDevvMessageSummary(*ptr, "HandleTransactionRequest() -> Incoming");
+
+  ThinBlockRequest request(DecodeThinBlockRequest(ptr->data));
+  std::set<Signature> inline_txs(request.sigs.begin(), request.sigs.end());
+  std::vector<byte> response;
+  eMessageType response_type = FINAL_BLOCK;
+
+  if (request.kind == ThinFinalBlock) {
+    const auto& blocks = final_chain.getBlockVector();
+    for (auto it = blocks.rbegin(); it != blocks.rend(); ++it) {
+      if ((*it)->getMerkleRoot() == request.block_id) {
+        response = EncodeThinBlock(**it, context.get_current_node(), inline_txs);
+        break;
+      }
+    }
+  } else {
+    response_type = PROPOSAL_BLOCK;
+    response = utx_pool.getThinProposal(request.block_id, context.get_current_node(), inline_txs);
+  }
+
+  if (response.empty()) {
+    LOG_WARNING << "HandleTransactionRequest(): requested block not found, node("
+                << request.requester << ")";
+    return false;
+  }
+
+  LOG_INFO << "HandleTransactionRequest(): sending " << request.sigs.size()
+           << " transactions to node(" << request.requester << ")";
+  auto response_msg = std::make_unique<DevvMessage>(context.get_uri_from_index(request.requester),
+                                                    response_type,
+                                                    response,
+                                                    ptr->index);
+  callback(std::move(response_msg));
+  return true;
+}
+
 bool HandleBlocksSinceRequest(DevvMessageUniquePtr ptr,
                               Blockchain& final_chain,
                               const DevvContext& context,
@@ -269,6 +567,8 @@ bool HandleBlocksSinceRequest(DevvMessageUniquePtr ptr,
     std::vector<byte> bin_height;
     Uint64ToBin(covered_height, bin_height);
     //put height at beginning of message
+    std::vector<byte> encoded = EncodeBlocks(raw, context.get_block_encoding());
+    raw.swap(encoded);
     raw.insert(raw.begin(), bin_height.begin(), bin_height.end());
     auto response = std::make_unique<DevvMessage>(context.get_uri_from_index(node),
                                                      BLOCKS_SINCE,
@@ -290,6 +590,11 @@ bool HandleBlocksSince(DevvMessageUniquePtr ptr,
                               uint64_t& remote_blocks) {
   LogDevvMessageSummary(*ptr, "HandleBlocksSince() -> Incoming");
 
+  if (IsCompactBlockData(ptr->data, kUINT64_SIZE)) {
+    std::vector<byte> blocks(DecodeCompactBlocks(ptr->data, kUINT64_SIZE));
+    ptr->data.resize(kUINT64_SIZE);
+    ptr->data.insert(ptr->data.end(), blocks.begin(), blocks.end());
+  }
   InputBuffer buffer(ptr->data);
   if (buffer.size() < 8) {
     LOG_WARNING << "BlockSince is too small!";
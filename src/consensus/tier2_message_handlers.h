@@ -42,6 +42,20 @@ bool HandleFinalBlock(DevvMessageUniquePtr ptr,
                       UnrecordedTransactionPool& utx_pool,
                       std::function<void(DevvMessageUniquePtr)> callback);
 
+/**
+ * Send the request for a thin FinalBlock waiting on missing transactions again
+ * if the last one went unanswered. The origin of the block is asked for the
+ * missing transactions first, then the other nodes for the whole block.
+ * Called periodically and when FinalBlocks arrive.
+ * @param[in] context
+ * @param[in, out] utx_pool
+ * @param[in] callback sends the request
+ * @return true iff a request was sent
+ */
+bool RetryMissingTransactions(const DevvContext& context,
+                              UnrecordedTransactionPool& utx_pool,
+                              std::function<void(DevvMessageUniquePtr)> callback);
+
 /**
  * Registered with DevvController and called when a eMessageType::PROPOSAL_BLOCK message
  * arrives.
@@ -49,7 +63,7 @@ bool HandleFinalBlock(DevvMessageUniquePtr ptr,
  * @param[in] context
  * @param[in] keys
  * @param[in, out] final_chain
- * @param[in, out] tcm
+ * @param[in, out] utx_pool resolves the transactions of thin proposals
  * @param[in] callback
  * @return
  */
@@ -57,7 +71,7 @@ bool HandleProposalBlock(DevvMessageUniquePtr ptr,
                          const DevvContext& context,
                          const KeyRing& keys,
                          const Blockchain& final_chain,
-                         TransactionCreationManager& tcm,
+                         UnrecordedTransactionPool& utx_pool,
                          std::function<void(DevvMessageUniquePtr)> callback);
 
 /**
@@ -75,6 +89,23 @@ bool HandleValidationBlock(DevvMessageUniquePtr ptr,
                            UnrecordedTransactionPool& utx_pool,
                            std::function<void(DevvMessageUniquePtr)> callback);
 
+/**
+ * Registered with DevvController and called when a eMessageType::REQUEST_TRANSACTIONS
+ * message arrives. Answers with the requested thin block carrying the missing
+ * transactions inline.
+ * @param[in] ptr
+ * @param[in] context
+ * @param[in] final_chain
+ * @param[in] utx_pool
+ * @param[in] callback
+ * @return true iff a response was sent
+ */
+bool HandleTransactionRequest(DevvMessageUniquePtr ptr,
+                              const DevvContext& context,
+                              Blockchain& final_chain,
+                              UnrecordedTransactionPool& utx_pool,
+                              std::function<void(DevvMessageUniquePtr)> callback);
+
 /**
  *
  * @param ptr
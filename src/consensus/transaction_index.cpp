@@ -0,0 +1,218 @@
+/*
+ * transaction_index.cpp maps Transaction signatures and addresses
+ * to their place in the chain.
+ *
+ * @copywrite  2018 Devvio Inc
+ */
+
+#include "consensus/transaction_index.h"
+
+#include <algorithm>
+#include <iterator>
+#include <set>
+
+#include <boost/filesystem.hpp>
+
+#include "common/logger.h"
+
+namespace Devv {
+
+namespace {
+
+/**
+ * A block record parsed from the index file
+ */
+struct IndexRecord {
+  uint32_t height = 0;
+  std::vector<std::string> signatures;
+  std::vector<std::vector<std::string>> addresses;
+};
+
+std::vector<byte> ReadBytes(const std::vector<byte>& data, size_t& offset) {
+  uint64_t length = BinToVarint(data, offset);
+  if (length > data.size() - offset) {
+    throw std::out_of_range("TransactionIndex record is truncated");
+  }
+  std::vector<byte> out(data.begin() + offset, data.begin() + offset + length);
+  offset += length;
+  return out;
+}
+
+void WriteBytes(const std::vector<byte>& bytes, std::vector<byte>& out) {
+  VarintToBin(bytes.size(), out);
+  out.insert(out.end(), bytes.begin(), bytes.end());
+}
+
+std::string ToKey(const std::vector<byte>& canonical) {
+  return std::string(canonical.begin(), canonical.end());
+}
+
+IndexRecord ParseRecord(const std::vector<byte>& record) {
+  IndexRecord parsed;
+  size_t offset = 0;
+  parsed.height = BinToUint32(record, offset);
+  offset += kBYTES_PER_INT;
+  uint64_t tx_count = BinToVarint(record, offset);
+  for (uint64_t i = 0; i < tx_count; ++i) {
+    parsed.signatures.push_back(ToKey(ReadBytes(record, offset)));
+    uint64_t addr_count = BinToVarint(record, offset);
+    std::vector<std::string> addrs;
+    for (uint64_t j = 0; j < addr_count; ++j) {
+      addrs.push_back(ToKey(ReadBytes(record, offset)));
+    }
+    parsed.addresses.push_back(std::move(addrs));
+  }
+  if (offset != record.size()) {
+    throw std::runtime_error("TransactionIndex record has trailing bytes");
+  }
+  return parsed;
+}
+
+} // namespace
+
+TransactionIndex::TransactionIndex(const std::string& path) : path_(path) {
+  size_t valid_size = 0;
+  if (boost::filesystem::exists(path_)) {
+    std::ifstream in(path_, std::ios::in | std::ios::binary);
+    std::vector<byte> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    valid_size = load(data);
+    if (valid_size < data.size()) {
+      LOG_WARNING << "TransactionIndex: dropping " << (data.size() - valid_size)
+                  << " bytes of incomplete records from " << path_;
+      boost::filesystem::resize_file(path_, valid_size);
+    }
+  }
+  file_.open(path_, std::ios::out | std::ios::binary | std::ios::app);
+  if (!file_.is_open()) {
+    throw std::runtime_error("TransactionIndex: failed to open " + path_);
+  }
+  if (valid_size == 0) {
+    file_.write(kTX_INDEX_MAGIC.data(), kTX_INDEX_MAGIC.size());
+    file_.put(static_cast<char>(kTX_INDEX_FORMAT));
+    file_.flush();
+  }
+  LOG_INFO << "TransactionIndex: " << by_signature_.size() << " transactions in "
+           << next_height_ << " blocks from " << path_;
+}
+
+size_t TransactionIndex::load(const std::vector<byte>& data) {
+  size_t header_size = kTX_INDEX_MAGIC.size() + 1;
+  if (data.size() < header_size) {
+    return 0;
+  }
+  if (!std::equal(kTX_INDEX_MAGIC.begin(), kTX_INDEX_MAGIC.end(), data.begin())
+      || data[kTX_INDEX_MAGIC.size()] != kTX_INDEX_FORMAT) {
+    throw std::runtime_error("TransactionIndex: " + path_ + " is not a transaction index");
+  }
+  size_t offset = header_size;
+  while (data.size() - offset >= kBYTES_PER_INT) {
+    uint32_t length = BinToUint32(data, offset);
+    if (length > data.size() - offset - kBYTES_PER_INT) {
+      break;
+    }
+    std::vector<byte> record(data.begin() + offset + kBYTES_PER_INT,
+                             data.begin() + offset + kBYTES_PER_INT + length);
+    try {
+      indexRecord(record);
+    } catch (const std::exception& e) {
+      LOG_WARNING << "TransactionIndex: invalid record at " << offset << ": " << e.what();
+      break;
+    }
+    offset += kBYTES_PER_INT + length;
+  }
+  return offset;
+}
+
+void TransactionIndex::indexRecord(const std::vector<byte>& record) {
+  IndexRecord parsed(ParseRecord(record));
+  for (size_t i = 0; i < parsed.signatures.size(); ++i) {
+    TxLocation location;
+    location.height = parsed.height;
+    location.position = static_cast<uint32_t>(i);
+    by_signature_[parsed.signatures[i]] = location;
+    for (const auto& addr : parsed.addresses[i]) {
+      by_address_[addr].push_back(location);
+    }
+  }
+  next_height_ = std::max(next_height_, parsed.height + 1);
+}
+
+bool TransactionIndex::addBlock(uint32_t height, const FinalBlock& block) {
+  std::vector<byte> record;
+  Uint32ToBin(height, record);
+  const std::vector<TransactionPtr>& txs = block.getTransactions();
+  VarintToBin(txs.size(), record);
+  for (const auto& tx : txs) {
+    WriteBytes(tx->getSignature().getCanonical(), record);
+    std::set<std::vector<byte>> addrs;
+    for (const auto& xfer : tx->getTransfers()) {
+      addrs.insert(xfer->getAddress().getCanonical());
+    }
+    VarintToBin(addrs.size(), record);
+    for (const auto& addr : addrs) {
+      WriteBytes(addr, record);
+    }
+  }
+
+  std::lock_guard<std::mutex> guard(mutex_);
+  if (height < next_height_) {
+    LOG_DEBUG << "TransactionIndex: block " << height << " is already indexed";
+    return false;
+  }
+  if (height > next_height_) {
+    LOG_WARNING << "TransactionIndex: block " << height << " skips blocks from "
+                << next_height_ << ", not indexed";
+    return false;
+  }
+  std::vector<byte> prefixed;
+  prefixed.reserve(kBYTES_PER_INT + record.size());
+  Uint32ToBin(static_cast<uint32_t>(record.size()), prefixed);
+  prefixed.insert(prefixed.end(), record.begin(), record.end());
+  file_.write(reinterpret_cast<const char*>(prefixed.data()), prefixed.size());
+  file_.flush();
+  if (!file_.good()) {
+    throw std::runtime_error("TransactionIndex: failed to write " + path_);
+  }
+  indexRecord(record);
+  return true;
+}
+
+bool TransactionIndex::findTransaction(const Signature& sig, TxLocation& location) const {
+  std::lock_guard<std::mutex> guard(mutex_);
+  auto it = by_signature_.find(ToKey(sig.getCanonical()));
+  if (it == by_signature_.end()) {
+    return false;
+  }
+  location = it->second;
+  return true;
+}
+
+std::vector<TxLocation> TransactionIndex::findAddress(const Address& addr,
+                                                      uint32_t start_height,
+                                                      uint32_t end_height) const {
+  std::vector<TxLocation> out;
+  std::lock_guard<std::mutex> guard(mutex_);
+  auto it = by_address_.find(ToKey(addr.getCanonical()));
+  if (it == by_address_.end()) {
+    return out;
+  }
+  const std::vector<TxLocation>& all = it->second;
+  auto first = std::lower_bound(all.begin(), all.end(), start_height,
+      [](const TxLocation& loc, uint32_t height) { return loc.height < height; });
+  for (auto loc = first; loc != all.end() && loc->height <= end_height; ++loc) {
+    out.push_back(*loc);
+  }
+  return out;
+}
+
+uint32_t TransactionIndex::getNextHeight() const {
+  std::lock_guard<std::mutex> guard(mutex_);
+  return next_height_;
+}
+
+size_t TransactionIndex::size() const {
+  std::lock_guard<std::mutex> guard(mutex_);
+  return by_signature_.size();
+}
+
+} // namespace Devv
@@ -0,0 +1,118 @@
+/*
+ * transaction_index.h maps Transaction signatures and addresses
+ * to their place in the chain.
+ *
+ * The index lives in memory and is persisted to an append-only file.
+ * Each FinalBlock becomes one length-prefixed record, so a record cut
+ * short by a crash is dropped when the file is loaded again.
+ *
+ * @copywrite  2018 Devvio Inc
+ */
+
+#ifndef CONSENSUS_TRANSACTION_INDEX_H_
+#define CONSENSUS_TRANSACTION_INDEX_H_
+
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "primitives/FinalBlock.h"
+
+namespace Devv {
+
+/// First bytes of an index file
+static const std::string kTX_INDEX_MAGIC = "DVIX";
+/// Version of the index file format
+static const byte kTX_INDEX_FORMAT = 1;
+
+/**
+ * The place of a Transaction in the chain
+ */
+struct TxLocation {
+  /// Height of the block holding the Transaction
+  uint32_t height = 0;
+  /// Position of the Transaction in that block
+  uint32_t position = 0;
+};
+
+class TransactionIndex {
+ public:
+  /**
+   * Open an index file, creating it if it does not exist.
+   * @param path - the index file
+   * @throw std::runtime_error if the file cannot be opened or is not an index
+   */
+  explicit TransactionIndex(const std::string& path);
+
+  /**
+   * Index the Transactions of a block and append them to the index file.
+   * Blocks below getNextHeight() are already indexed and are skipped,
+   * blocks above it would leave a gap and are refused.
+   * @param height - the height of the block
+   * @param block - the block
+   * @return true iff the block was indexed, only if height == getNextHeight()
+   */
+  bool addBlock(uint32_t height, const FinalBlock& block);
+
+  /**
+   * Find a Transaction by its signature.
+   * @param sig - the signature of the Transaction
+   * @param location - set to the place of the Transaction if it is found
+   * @return true iff the Transaction is indexed
+   */
+  bool findTransaction(const Signature& sig, TxLocation& location) const;
+
+  /**
+   * Find the Transactions with a transfer to or from an address.
+   * @param addr - the address
+   * @param start_height - the lowest block height to include
+   * @param end_height - the highest block height to include
+   * @return the places of those Transactions, in chain order
+   */
+  std::vector<TxLocation> findAddress(const Address& addr,
+                                      uint32_t start_height,
+                                      uint32_t end_height) const;
+
+  /**
+   * @return the height of the next block to index
+   */
+  uint32_t getNextHeight() const;
+
+  /**
+   * @return the number of indexed Transactions
+   */
+  size_t size() const;
+
+ private:
+  /**
+   * Read the records of the index file into memory.
+   * @param data - the contents of the index file
+   * @return the size of the complete records, anything after them is dropped
+   */
+  size_t load(const std::vector<byte>& data);
+
+  /**
+   * Add one block record to the in-memory maps.
+   * @param record - the record, without its length prefix
+   */
+  void indexRecord(const std::vector<byte>& record);
+
+  /// Path of the index file
+  std::string path_;
+  /// Index file, opened for appending
+  std::ofstream file_;
+  /// Signature canonical -> place of the Transaction
+  std::unordered_map<std::string, TxLocation> by_signature_;
+  /// Address canonical -> places of its Transactions, in chain order
+  std::unordered_map<std::string, std::vector<TxLocation>> by_address_;
+  /// Height of the next block to index
+  uint32_t next_height_ = 0;
+  /// Guards the maps and the file
+  mutable std::mutex mutex_;
+};
+
+} // namespace Devv
+
+#endif /* CONSENSUS_TRANSACTION_INDEX_H_ */
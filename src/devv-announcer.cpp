@@ -3,14 +3,17 @@
  * These envelopes include transaction files that devv-announcer
  * annouonces to nodes provided by the host-list arguments.
  * The envelopes also contain oracle proposals that are used
- * to invoke oracle logic.
+ * to invoke oracle logic. Oracles validate proposals against the
+ * chain state of the final blocks the validators publish.
  *
  * @copywrite  2018 Devvio Inc
  */
 
+#include <atomic>
 #include <fstream>
 #include <functional>
 #include <iostream>
+#include <map>
 #include <string>
 #include <thread>
 
@@ -19,9 +22,16 @@
 
 #include "common/logger.h"
 #include "common/devv_context.h"
+#include "common/metrics.h"
+#include "consensus/chain_state_view.h"
+#include "consensus/load_report.h"
+#include "io/file_ops.h"
 #include "io/message_service.h"
+#include "io/request_router.h"
 #include "modules/BlockchainModule.h"
+#include "primitives/block_codec.h"
 #include "primitives/block_tools.h"
+#include "primitives/thin_block.h"
 #include "pbuf/devv_pbuf.h"
 
 using namespace Devv;
@@ -43,6 +53,7 @@ void ParallelPush(std::mutex& m, std::vector<std::vector<byte>>& array
 struct announcer_options {
   std::string bind_endpoint;
   std::string protobuf_endpoint;
+  std::vector<std::string> host_vector{};
   eAppMode mode;
   unsigned int node_index;
   unsigned int shard_index;
@@ -54,6 +65,10 @@ struct announcer_options {
   unsigned int batch_size;
   unsigned int start_delay;
   bool distinct_ops;
+  std::string metrics_file;
+  unsigned int metrics_interval = 0;
+  unsigned int num_request_threads = io::kDEFAULT_REQUEST_WORKERS;
+  std::string block_dir;
 };
 
 /**
@@ -75,6 +90,13 @@ int main(int argc, char* argv[]) {
       exit(-1);
     }
 
+    MetricsReporter metrics_reporter(options->metrics_file, options->metrics_interval);
+    Counter& envelopes_received = MetricsRegistry::Get().counter("announcer.envelopes.received");
+    Counter& envelopes_rejected = MetricsRegistry::Get().counter("announcer.envelopes.rejected");
+    Counter& envelopes_busy = MetricsRegistry::Get().counter("announcer.envelopes.busy");
+    Counter& txs_announced = MetricsRegistry::Get().counter("announcer.transactions.announced");
+    Histogram& envelope_time = MetricsRegistry::Get().histogram("announcer.envelope.handle_us");
+
     zmq::context_t context(1);
 
     DevvContext this_context(options->node_index,
@@ -92,74 +114,170 @@ int main(int argc, char* argv[]) {
     auto server = io::CreateTransactionServer(options->bind_endpoint, context);
     server->startServer();
 
-    zmq::socket_t socket (context, ZMQ_REP);
-    socket.bind (options->protobuf_endpoint);
-
     if (options->start_delay > 0) sleep(options->start_delay);
 
-    bool keep_running = true;
-    unsigned int processed_total = 0;
-    while (keep_running) {
-      zmq::message_t transaction_message;
-      //  Wait for next request from client
+    // the latest load report of each validator, clients back off while one is busy
+    std::mutex load_mutex;
+    std::map<uint32_t, std::pair<LoadReport, Timer>> validator_loads;
+    // the state oracles validate proposals against, follows the finalized blocks
+    ChainStateView chain_view;
+    Gauge& chain_height = MetricsRegistry::Get().gauge("announcer.chain.height");
+    Counter& chain_gaps = MetricsRegistry::Get().counter("announcer.chain.gaps");
+    // applies the saved blocks from the height of the view on, such as the
+    // <height>.blk files devv-query writes for this shard
+    auto catch_up = [&]() {
+      if (options->block_dir.empty()) {
+        return;
+      }
+      for (;;) {
+        fs::path block_path(options->block_dir + "/" + std::to_string(chain_view.getHeight()) + ".blk");
+        if (!fs::exists(block_path)) {
+          break;
+        }
+        try {
+          std::vector<byte> saved(ReadBinaryFile(block_path));
+          InputBuffer buffer(saved);
+          if (!chain_view.push_back(FinalBlock::Create(buffer, ChainState()))) {
+            LOG_WARNING << "Saved block " << block_path.string() << " does not follow the chain view";
+            break;
+          }
+        } catch (const std::exception& e) {
+          LOG_WARNING << "Failed to load block " << block_path.string() << ": " << e.what();
+          break;
+        }
+      }
+      chain_height.set(chain_view.getHeight());
+    };
+    catch_up();
+    LOG_INFO << "Chain view starts at height " << chain_view.getHeight();
+    std::unique_ptr<io::TransactionClient> validator_client;
+    if (!options->host_vector.empty()) {
+      validator_client = io::CreateTransactionClient(options->host_vector, context);
+      validator_client->attachCallback([&](DevvMessageUniquePtr p) {
+        if (p->message_type == eMessageType::FINAL_BLOCK) {
+          try {
+            if (IsCompactBlockData(p->data)) {
+              p->data = DecodeCompactBlocks(p->data);
+            }
+            if (IsThinBlockData(p->data)) {
+              // the complete block arrives on the archive topic
+              return;
+            }
+            InputBuffer buffer(p->data);
+            FinalBlock block(FinalBlock::Create(buffer, ChainState()));
+            if (chain_view.push_back(block)) {
+              chain_height.set(chain_view.getHeight());
+            } else if (chain_view.getPendingCount() > 0) {
+              chain_gaps.add();
+              LOG_WARNING << "Chain view is missing blocks after height " << chain_view.getHeight()
+                          << ", " << chain_view.getPendingCount() << " later blocks are waiting";
+              catch_up();
+            } else {
+              LOG_DEBUG << "Final block was already applied to the chain view";
+            }
+          } catch (const std::exception& e) {
+            LOG_WARNING << "Ignoring final block: " << e.what();
+          }
+          return;
+        }
+        if (p->message_type != eMessageType::LOAD_REPORT) {
+          return;
+        }
+        try {
+          LoadReport report(DecodeLoadReport(p->data));
+          std::lock_guard<std::mutex> guard(load_mutex);
+          validator_loads[report.node_index] = std::make_pair(report, Timer());
+        } catch (const std::exception& e) {
+          LOG_WARNING << "Ignoring load report: " << e.what();
+        }
+      });
+      validator_client->listenTo(GetLoadReportUri(this_context.get_shard_uri()));
+      validator_client->listenTo(this_context.get_shard_uri());
+      validator_client->listenTo(GetArchiveUri(this_context.get_shard_uri()));
+      validator_client->startClient();
+    }
 
-      LOG_INFO << "Waiting for envelope";
-      auto res = socket.recv(&transaction_message);
-      if (!res) {
-        LOG_ERROR << "socket.recv != true - exiting";
-        keep_running = false;
+    // the busiest of this announcer's queue and the validators decides the delay
+    auto retry_after = [&]() {
+      uint32_t retry = RetryAfterMillis(0, server->getQueueDepth());
+      std::lock_guard<std::mutex> guard(load_mutex);
+      for (auto& load : validator_loads) {
+        if (load.second.second.elapsed() < kLOAD_REPORT_STALE_MS) {
+          retry = std::max(retry, RetryAfterMillis(load.second.first));
+        }
       }
-      LOG_INFO << "Received envelope";
+      return retry;
+    };
 
-      std::string tx_string = std::string(static_cast<char*>(transaction_message.data()),
-          transaction_message.size());
+    bool keep_running = true;
+    std::atomic<unsigned int> processed_total(0);
+    // envelopes are parsed and verified concurrently, announcing is serialized
+    std::mutex server_mutex;
+    auto router = io::CreateRequestRouter(options->protobuf_endpoint, options->num_request_threads
+        , [&](const std::string& tx_string) {
+      LOG_INFO << "Received envelope";
+      envelopes_received.add();
+      ScopedTimer envelope_timer(envelope_time);
 
       std::string response;
+      uint32_t retry = retry_after();
+      if (retry > 0) {
+        response = "Busy, retry after " + std::to_string(retry) + " ms";
+        LOG_WARNING << response;
+        envelopes_busy.add();
+        return response;
+      }
+
       std::vector<TransactionPtr> ptrs;
       try {
-        ptrs = DeserializeEnvelopeProtobufString(tx_string, keys);
+        ptrs = DeserializeEnvelopeProtobufString(tx_string, keys, chain_view);
       } catch (std::runtime_error& e) {
         response = "Deserialization error: " + std::string(e.what());
         LOG_ERROR << response;
-        zmq::message_t reply(response.size());
-        memcpy(reply.data(), response.data(), response.size());
-        socket.send(reply);
-        continue;
+        envelopes_rejected.add();
+        return response;
       }
 
       unsigned int processed = 0;
-      std::vector<DevvMessageUniquePtr> messages;
-      for (auto const& t2tx : ptrs) {
-        auto announce_msg = std::make_unique<DevvMessage>(
-            this_context.get_shard_uri(),
-            TRANSACTION_ANNOUNCEMENT,
-            t2tx->getCanonical(),
-            DEBUG_TRANSACTION_INDEX);
-
-        LOG_DEBUG << "Going to queue";
-        server->queueMessage(std::move(announce_msg));
-        LOG_DEBUG << "Sent transaction batch #" << processed;
-        ++processed;
-
-        if (fs::exists(options->stop_file)) {
-          LOG_INFO << "Shutdown file exists. Stopping pb_announcer...";
-          keep_running = false;
+      {
+        std::lock_guard<std::mutex> guard(server_mutex);
+        for (auto const& t2tx : ptrs) {
+          auto announce_msg = std::make_unique<DevvMessage>(
+              this_context.get_shard_uri(),
+              TRANSACTION_ANNOUNCEMENT,
+              t2tx->getCanonical(),
+              DEBUG_TRANSACTION_INDEX);
+
+          LOG_DEBUG << "Going to queue";
+          server->queueMessage(std::move(announce_msg));
+          LOG_DEBUG << "Sent transaction batch #" << processed;
+          ++processed;
         }
       }
-      processed_total += processed;
+      unsigned int total = (processed_total += processed);
+      txs_announced.add(processed);
       LOG_DEBUG << "Finished publishing transactions (processed/total) (" +
             std::to_string(processed) + "/" +
-            std::to_string(processed_total) + ")";
+            std::to_string(total) + ")";
 
-      response = "Successfully published " + std::to_string(processed) + " transactions.";
+      return "Successfully published " + std::to_string(processed) + " transactions.";
+    }, context);
+    router->startRouter();
 
-      zmq::message_t reply(response.size());
-      memcpy(reply.data(), response.data(), response.size());
-      socket.send(reply);
+    while (keep_running) {
+      if (fs::exists(options->stop_file)) {
+        LOG_INFO << "Shutdown file exists. Stopping pb_announcer...";
+        keep_running = false;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(kMAIN_WAIT_INTERVAL));
     }
+    router->stopRouter();
 
     LOG_INFO << "Finished running";
     sleep(1);
+    if (validator_client) {
+      validator_client->stopClient();
+    }
     server->stopServer();
     LOG_WARNING << "All done.";
     return (true);
@@ -201,12 +319,22 @@ annouonces them to nodes provided by the host-list arguments.\n\
         ("shard-index", po::value<unsigned int>(), "Index of this shard")
         ("bind-endpoint", po::value<std::string>(), "Endpoint for validator server (i.e. tcp://*:5556)")
         ("protobuf-endpoint", po::value<std::string>(), "Endpoint for protobuf server (i.e. tcp://*:5557)")
+        ("host-list,H", po::value<std::vector<std::string>>()->composing(),
+         "Validator URI whose load reports and final blocks are followed (i.e. tcp://192.168.10.1:5005). "
+         "Option can be repeated. Clients are told to retry later while a validator is busy, "
+         "and oracles validate proposals against the state of the final blocks.")
         ("inn-keys", po::value<std::string>(), "Path to INN key file")
         ("node-keys", po::value<std::string>(), "Path to Node key file")
         ("key-pass", po::value<std::string>(), "Password for private keys")
         ("stop-file", po::value<std::string>(), "When this file exists it indicates that this announcer should stop.")
         ("start-delay", po::value<unsigned int>(), "Sleep time before starting (millis)")
         ("separate-ops", po::value<bool>(), "Separate transactions with different operations into distinct batches?")
+        ("metrics-file", po::value<std::string>(), "File the metrics are written to (Prometheus text format)")
+        ("metrics-interval", po::value<unsigned int>(), "Seconds between metrics reports (0 disables reporting)")
+        ("num-request-threads", po::value<unsigned int>(), "Number of threads handling envelopes")
+        ("block-dir", po::value<std::string>(), "Directory of saved final blocks of this shard named <height>.blk "
+         "(i.e. the shard directory of devv-query), the chain view starts from them and catches up "
+         "from them when a final block is missed")
         ;
 
     po::options_description all_options;
@@ -304,6 +432,16 @@ annouonces them to nodes provided by the host-list arguments.\n\
       LOG_INFO << "Protobuf Endpoint was not set";
     }
 
+    if (vm.count("host-list")) {
+      options->host_vector = vm["host-list"].as<std::vector<std::string>>();
+      LOG_INFO << "Validator URIs:";
+      for (auto i : options->host_vector) {
+        LOG_INFO << "  " << i;
+      }
+    } else {
+      LOG_INFO << "Validator URIs were not set (load reports are not followed).";
+    }
+
     if (vm.count("inn-keys")) {
       options->inn_keys = vm["inn-keys"].as<std::string>();
       LOG_INFO << "INN keys file: " << options->inn_keys;
@@ -348,6 +486,35 @@ annouonces them to nodes provided by the host-list arguments.\n\
       options->distinct_ops = false;
     }
 
+    if (vm.count("metrics-file")) {
+      options->metrics_file = vm["metrics-file"].as<std::string>();
+      LOG_INFO << "Metrics file: " << options->metrics_file;
+    } else {
+      LOG_INFO << "Metrics file was not set.";
+    }
+
+    if (vm.count("metrics-interval")) {
+      options->metrics_interval = vm["metrics-interval"].as<unsigned int>();
+      LOG_INFO << "Metrics interval: " << options->metrics_interval;
+    } else {
+      LOG_INFO << "Metrics interval was not set (default to no reports).";
+    }
+
+    if (vm.count("num-request-threads")) {
+      options->num_request_threads = vm["num-request-threads"].as<unsigned int>();
+      LOG_INFO << "Num request threads: " << options->num_request_threads;
+    } else {
+      LOG_INFO << "Num request threads was not set (default to "
+               << options->num_request_threads << ").";
+    }
+
+    if (vm.count("block-dir")) {
+      options->block_dir = vm["block-dir"].as<std::string>();
+      LOG_INFO << "Block dir: " << options->block_dir;
+    } else {
+      LOG_INFO << "Block dir was not set (the chain view starts at the first block).";
+    }
+
   }
   catch(std::exception& e) {
     LOG_ERROR << "error: " << e.what();
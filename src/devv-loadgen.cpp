@@ -0,0 +1,659 @@
+/*
+ * devv-loadgen.cpp drives a shard with signed Tier2 transactions
+ * at a target rate and measures how quickly they are confirmed.
+ *
+ * Transactions are generated while the test runs (as turbulent-gen does)
+ * and announced in TRANSACTION_ANNOUNCEMENT batches from bind-endpoint,
+ * which the validators must list in their host-list. The load is open-loop:
+ * batches are sent on schedule whether or not earlier ones were confirmed.
+ * FINAL_BLOCK messages from the validators in host-list are matched
+ * to the announced transactions to measure confirmation latency.
+ * Validators must not send thin blocks, they cannot be read without a pool.
+ *
+ * @copywrite  2018 Devvio Inc
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <boost/program_options.hpp>
+
+#include "common/logger.h"
+#include "common/devv_context.h"
+#include "common/metrics.h"
+#include "concurrency/TransactionGenerator.h"
+#include "io/message_service.h"
+#include "modules/BlockchainModule.h"
+#include "primitives/block_codec.h"
+
+using namespace Devv;
+
+typedef std::chrono::steady_clock load_clock;
+
+/**
+ * Holds command-line options
+ */
+struct loadgen_options {
+  std::string bind_endpoint;
+  std::vector<std::string> host_vector{};
+  eAppMode mode = T2;
+  unsigned int node_index = 0;
+  unsigned int shard_index = 0;
+  std::string inn_keys;
+  std::string node_keys;
+  std::string wallet_keys;
+  std::string key_pass;
+  unsigned int key_load_threads = 0;
+  std::string key_cache_dir;
+  double rate = 1000;
+  double ramp_to = 0;
+  unsigned int ramp_secs = 0;
+  unsigned int duration = 60;
+  unsigned int drain_secs = 30;
+  unsigned int start_delay = 2;
+  unsigned int batch_size = 100;
+  unsigned int num_threads = 0;
+  uint64_t tx_amount = 10;
+  uint64_t seed = 0;
+  std::string metrics_file;
+  unsigned int metrics_interval = 0;
+};
+
+std::unique_ptr<struct loadgen_options> ParseLoadgenOptions(int argc, char** argv);
+
+/**
+ * A batch of announced transactions
+ */
+struct LoadBatch {
+  std::vector<byte> data;
+  std::vector<Signature> signatures;
+};
+
+/**
+ * A bounded queue of batches between the generating thread and the sender
+ */
+class LoadBatchQueue {
+ public:
+  explicit LoadBatchQueue(size_t capacity) : capacity_(capacity) {}
+
+  void push(LoadBatch&& batch) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    not_full_.wait(lock, [this]() { return batches_.size() < capacity_ || closed_; });
+    batches_.push_back(std::move(batch));
+    not_empty_.notify_one();
+  }
+
+  bool pop(LoadBatch& batch) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    not_empty_.wait(lock, [this]() { return !batches_.empty() || closed_; });
+    if (batches_.empty()) {
+      return false;
+    }
+    batch = std::move(batches_.front());
+    batches_.pop_front();
+    not_full_.notify_one();
+    return true;
+  }
+
+  void close() {
+    std::lock_guard<std::mutex> guard(mutex_);
+    closed_ = true;
+    not_empty_.notify_all();
+    not_full_.notify_all();
+  }
+
+  bool isClosed() const {
+    std::lock_guard<std::mutex> guard(mutex_);
+    return closed_;
+  }
+
+ private:
+  const size_t capacity_;
+  std::deque<LoadBatch> batches_;
+  bool closed_ = false;
+  mutable std::mutex mutex_;
+  std::condition_variable not_empty_;
+  std::condition_variable not_full_;
+};
+
+/**
+ * The number of transactions that should have been sent after secs seconds.
+ * The rate moves linearly from rate to ramp_to over ramp_secs, then stays.
+ */
+double ScheduledCount(const loadgen_options& options, double secs) {
+  if (options.ramp_secs == 0 || options.ramp_to <= 0) {
+    return options.rate * secs;
+  }
+  double ramp = options.ramp_secs;
+  double slope = (options.ramp_to - options.rate) / ramp;
+  if (secs <= ramp) {
+    return options.rate * secs + slope * secs * secs / 2;
+  }
+  return options.rate * ramp + slope * ramp * ramp / 2 + options.ramp_to * (secs - ramp);
+}
+
+int main(int argc, char* argv[]) {
+  init_log();
+
+  try {
+    auto options = ParseLoadgenOptions(argc, argv);
+
+    if (!options) {
+      LOG_ERROR << "ParseLoadgenOptions error";
+      exit(-1);
+    }
+
+    MetricsReporter metrics_reporter(options->metrics_file, options->metrics_interval);
+    Counter& txs_sent = MetricsRegistry::Get().counter("loadgen.transactions.sent");
+    Counter& txs_confirmed = MetricsRegistry::Get().counter("loadgen.transactions.confirmed");
+    Counter& blocks_received = MetricsRegistry::Get().counter("loadgen.blocks.received");
+    Counter& blocks_unreadable = MetricsRegistry::Get().counter("loadgen.blocks.unreadable");
+    Counter& batches_late = MetricsRegistry::Get().counter("loadgen.batches.late");
+    Histogram& latency = MetricsRegistry::Get().histogram("loadgen.confirm.latency_ms");
+
+    DevvContext this_context(options->node_index, options->shard_index, options->mode, options->inn_keys,
+                                options->node_keys, options->key_pass);
+    this_context.set_key_load_threads(options->key_load_threads);
+    this_context.set_key_cache_dir(options->key_cache_dir);
+
+    KeyRing keys(this_context);
+    keys.LoadWallets(options->wallet_keys, options->key_pass);
+
+    size_t addr_count = keys.CountWallets();
+    if (addr_count < 2) {
+      LOG_FATAL << "At least 2 wallets are needed to generate load.";
+      return (false);
+    }
+
+    Address inn_addr = keys.getInnAddr();
+    std::vector<Address> addrs;
+    std::vector<EC_KEY*> wallet_keys;
+    for (size_t i = 0; i < addr_count; ++i) {
+      addrs.push_back(keys.getWalletAddr(i));
+      wallet_keys.push_back(keys.getWalletKey(i));
+    }
+    EC_KEY* inn_key = keys.getKey(inn_addr);
+
+    // The first transaction funds every wallet, later ones move small random amounts
+    uint64_t tx_amount = std::max<uint64_t>(1, options->tx_amount);
+    uint64_t seed = options->seed;
+    uint64_t node_factor = 1000000 * (options->node_index + 1);
+    auto make = [&](size_t index, std::vector<byte>& out) {
+      std::vector<byte> nonce_bin;
+      if (index == 0) {
+        std::vector<Transfer> xfers;
+        int64_t funding = 1000 * tx_amount * addr_count;
+        Transfer inn_transfer(inn_addr, 0, -1l * funding * addr_count, 0);
+        xfers.push_back(inn_transfer);
+        for (size_t i = 0; i < addr_count; ++i) {
+          Transfer transfer(addrs[i], 0, funding, 0);
+          xfers.push_back(transfer);
+        }
+        Uint64ToBin(seed + node_factor * (tx_amount + 1), nonce_bin);
+        Tier2Transaction inn_tx(eOpType::Create, xfers, nonce_bin, inn_key);
+        const std::vector<byte>& inn_canon = inn_tx.getCanonical();
+        out.insert(out.end(), inn_canon.begin(), inn_canon.end());
+        return;
+      }
+      size_t i = (index - 1) % addr_count;
+      uint64_t random = TransactionGenerator::Random(seed, index);
+      size_t j = (i + 1 + random % (addr_count - 1)) % addr_count;
+      uint64_t amount = 1 + TransactionGenerator::Random(seed, random) % tx_amount;
+      std::vector<Transfer> peer_xfers;
+      Transfer sender(addrs[i], 0, -1l * amount, 0);
+      peer_xfers.push_back(sender);
+      Transfer receiver(addrs[j], 0, amount, 0);
+      peer_xfers.push_back(receiver);
+      Uint64ToBin(seed + node_factor * (i + 1) * (j + 1) + index, nonce_bin);
+      Tier2Transaction peer_tx(eOpType::Exchange, peer_xfers, nonce_bin, wallet_keys[i]);
+      const std::vector<byte>& peer_canon = peer_tx.getCanonical();
+      out.insert(out.end(), peer_canon.begin(), peer_canon.end());
+    };
+
+    // Generate batches ahead of the schedule on a pool of threads
+    const size_t batch_size = std::max(1u, options->batch_size);
+    LoadBatchQueue queue(64);
+    std::thread producer([&]() {
+      TransactionGenerator generator(options->num_threads);
+      size_t next_index = 0;
+      try {
+        while (!queue.isClosed()) {
+          // the funding transaction travels alone so it is recorded before any transfer
+          size_t count = (next_index == 0) ? 1 : batch_size;
+          size_t base = next_index;
+          std::stringstream stream;
+          generator.generate(count, [&](size_t index, std::vector<byte>& out) {
+            make(base + index, out);
+          }, &stream);
+          next_index += count;
+
+          LoadBatch batch;
+          std::string bytes(stream.str());
+          batch.data.assign(bytes.begin(), bytes.end());
+          InputBuffer buffer(batch.data);
+          while (buffer.getOffset() < batch.data.size()) {
+            batch.signatures.push_back(Tier2Transaction::QuickCreate(buffer).getSignature());
+          }
+          queue.push(std::move(batch));
+        }
+      } catch (const std::exception& e) {
+        LOG_ERROR << FormatException(&e, "loadgen producer");
+        queue.close();
+      }
+    });
+
+    // Announced transactions that are not confirmed yet
+    std::mutex pending_mutex;
+    std::map<Signature, load_clock::time_point> pending;
+    load_clock::time_point last_confirmed;
+
+    zmq::context_t zmq_context(1);
+    auto server = io::CreateTransactionServer(options->bind_endpoint, zmq_context);
+    server->startServer();
+
+    ChainState state;
+    auto block_listener = io::CreateTransactionClient(options->host_vector, zmq_context);
+    block_listener->attachCallback([&](DevvMessageUniquePtr p) {
+      if (p->message_type != eMessageType::FINAL_BLOCK) {
+        return;
+      }
+      blocks_received.add();
+      auto now = load_clock::now();
+      try {
+        if (IsCompactBlockData(p->data)) {
+          p->data = DecodeCompactBlocks(p->data);
+        }
+        InputBuffer buffer(p->data);
+        FinalBlock block(FinalBlock::Create(buffer, state));
+        std::lock_guard<std::mutex> guard(pending_mutex);
+        for (auto const& tx : block.getTransactions()) {
+          auto it = pending.find(tx->getSignature());
+          if (it == pending.end()) {
+            // already confirmed by another validator, or announced by someone else
+            continue;
+          }
+          latency.record(std::chrono::duration_cast<std::chrono::milliseconds>(now - it->second).count());
+          txs_confirmed.add();
+          pending.erase(it);
+          last_confirmed = now;
+        }
+      } catch (const std::exception& e) {
+        blocks_unreadable.add();
+        LOG_WARNING << FormatException(&e, "FINAL_BLOCK");
+      }
+    });
+    block_listener->listenTo(this_context.get_shard_uri());
+    block_listener->startClient();
+
+    // Give the validators time to connect before publishing (ZMQ drops messages until they do)
+    std::this_thread::sleep_for(std::chrono::seconds(options->start_delay));
+
+    LOG_INFO << "Sending to " << this_context.get_shard_uri() << " at " << options->rate << " tx/s"
+             << (options->ramp_secs > 0 ? " ramping to " + std::to_string(options->ramp_to)
+                 + " tx/s over " + std::to_string(options->ramp_secs) + "s" : "")
+             << " for " << options->duration << "s.";
+
+    auto start = load_clock::now();
+    auto next_report = start + std::chrono::seconds(1);
+    uint64_t sent = 0;
+    uint64_t reported_sent = 0;
+    uint64_t reported_confirmed = 0;
+    uint64_t message_index = 0;
+    while (true) {
+      auto now = load_clock::now();
+      double elapsed = std::chrono::duration<double>(now - start).count();
+      if (elapsed >= options->duration) {
+        break;
+      }
+      double target = ScheduledCount(*options, elapsed);
+      if (target >= sent + 1) {
+        LoadBatch batch;
+        if (!queue.pop(batch)) {
+          LOG_ERROR << "Transaction generation stopped.";
+          break;
+        }
+        // open-loop: falling a second behind schedule means the generator is too slow
+        double one_second = ScheduledCount(*options, elapsed + 1) - target;
+        if (target - sent > std::max<double>(batch_size, one_second)) {
+          batches_late.add();
+        }
+        auto send_time = load_clock::now();
+        {
+          std::lock_guard<std::mutex> guard(pending_mutex);
+          for (auto const& sig : batch.signatures) {
+            pending[sig] = send_time;
+          }
+        }
+        auto announce_msg = std::make_unique<DevvMessage>(this_context.get_shard_uri(),
+                                                          TRANSACTION_ANNOUNCEMENT,
+                                                          batch.data,
+                                                          message_index++);
+        server->queueMessage(std::move(announce_msg));
+        sent += batch.signatures.size();
+        txs_sent.add(batch.signatures.size());
+      } else {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+
+      if (now >= next_report) {
+        uint64_t confirmed = txs_confirmed.value();
+        LOG_INFO << "Sent " << (sent - reported_sent) << " tx/s, confirmed " << (confirmed - reported_confirmed)
+                 << " tx/s, latency p50 " << latency.quantile(0.5) << " ms p99 " << latency.quantile(0.99)
+                 << " ms, late batches " << batches_late.value();
+        reported_sent = sent;
+        reported_confirmed = confirmed;
+        next_report += std::chrono::seconds(1);
+      }
+    }
+    auto send_end = load_clock::now();
+    queue.close();
+    producer.join();
+    EC_KEY_free(inn_key);
+
+    // Wait for the outstanding transactions to be confirmed
+    auto drain_end = send_end + std::chrono::seconds(options->drain_secs);
+    while (load_clock::now() < drain_end) {
+      {
+        std::lock_guard<std::mutex> guard(pending_mutex);
+        if (pending.empty()) {
+          break;
+        }
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+
+    block_listener->stopClient();
+    server->stopServer();
+
+    size_t unconfirmed = 0;
+    double confirm_secs = 0;
+    {
+      std::lock_guard<std::mutex> guard(pending_mutex);
+      unconfirmed = pending.size();
+      if (last_confirmed > start) {
+        confirm_secs = std::chrono::duration<double>(last_confirmed - start).count();
+      }
+    }
+    double send_secs = std::chrono::duration<double>(send_end - start).count();
+    uint64_t confirmed = txs_confirmed.value();
+
+    std::stringstream summary;
+    summary << "Load test finished:\n"
+            << "  sent:        " << sent << " transactions in " << send_secs << "s ("
+            << (send_secs > 0 ? sent / send_secs : 0) << " tx/s)\n"
+            << "  confirmed:   " << confirmed << " transactions in " << confirm_secs << "s ("
+            << (confirm_secs > 0 ? confirmed / confirm_secs : 0) << " tx/s)\n"
+            << "  unconfirmed: " << unconfirmed << "\n"
+            << "  late batches: " << batches_late.value() << "\n"
+            << "  blocks:      " << blocks_received.value() << " (" << blocks_unreadable.value() << " unreadable)\n"
+            << "  latency ms:  p50 " << latency.quantile(0.5) << " p90 " << latency.quantile(0.9)
+            << " p99 " << latency.quantile(0.99) << " max " << latency.max() << "\n";
+    LOG_INFO << summary.str();
+    std::cout << summary.str();
+    if (options->metrics_interval > 0) {
+      metrics_reporter.report();
+    }
+
+    return (true);
+  } catch (const std::exception& e) {
+    std::exception_ptr p = std::current_exception();
+    std::string err("");
+    err += (p ? p.__cxa_exception_type()->name() : "null");
+    LOG_FATAL << "Error: " + err << std::endl;
+    std::cerr << err << std::endl;
+    return (false);
+  }
+}
+
+std::unique_ptr<struct loadgen_options> ParseLoadgenOptions(int argc, char** argv) {
+
+  namespace po = boost::program_options;
+
+  std::unique_ptr<loadgen_options> options(new loadgen_options());
+  std::vector<std::string> config_filenames;
+
+  try {
+    po::options_description general("General Options\n\
+" + std::string(argv[0]) + " [OPTIONS] \n\
+\n\
+Announces signed transactions to a shard at a target rate and \n\
+reports the confirmation latency and sustained throughput.\n\
+\nAllowed options");
+    general.add_options()
+        ("help,h", "produce help message")
+        ("version,v", "print version string")
+        ("config", po::value(&config_filenames), "Config file where options may be specified (can be specified more than once)")
+        ;
+
+    po::options_description behavior("Identity and Behavior Options");
+    behavior.add_options()
+        ("mode", po::value<std::string>(), "Devv mode (T1|T2)")
+        ("node-index", po::value<unsigned int>(), "Index of this node")
+        ("shard-index", po::value<unsigned int>(), "Index of the shard to load")
+        ("bind-endpoint", po::value<std::string>(), "Endpoint transactions are announced from (i.e. tcp://*:5556)")
+        ("host-list,H", po::value<std::vector<std::string>>()->composing(),
+         "Validator URI to receive final blocks from (i.e. tcp://localhost:5005). Can be repeated.")
+        ("inn-keys", po::value<std::string>(), "Path to INN key file")
+        ("node-keys", po::value<std::string>(), "Path to Node key file")
+        ("wallet-keys", po::value<std::string>(), "Path to Wallet key file")
+        ("key-pass", po::value<std::string>(), "Password for private keys")
+        ("key-load-threads", po::value<unsigned int>(), "Number of threads decoding key files (0 for one per core)")
+        ("key-cache-dir", po::value<std::string>(), "Directory where decoded keys are cached, encrypted with key-pass")
+        ;
+
+    po::options_description load("Load Options");
+    load.add_options()
+        ("rate", po::value<double>(), "Transactions per second (default 1000)")
+        ("ramp-to", po::value<double>(), "Rate reached at the end of the ramp")
+        ("ramp-secs", po::value<unsigned int>(), "Seconds to move from rate to ramp-to (default no ramp)")
+        ("duration", po::value<unsigned int>(), "Seconds to send transactions (default 60)")
+        ("drain-secs", po::value<unsigned int>(), "Seconds to wait for confirmations after sending (default 30)")
+        ("start-delay", po::value<unsigned int>(), "Seconds to wait for validators to connect (default 2)")
+        ("batch-size", po::value<unsigned int>(), "Transactions per announcement (default 100)")
+        ("num-threads", po::value<unsigned int>(), "Number of threads generating transactions (0 for one per core)")
+        ("tx-amount", po::value<uint64_t>(), "Maximum number of coins in a transfer (default 10)")
+        ("seed", po::value<uint64_t>(), "Seed of the nonces and random choices")
+        ("metrics-file", po::value<std::string>(), "File the metrics are written to (Prometheus text format)")
+        ("metrics-interval", po::value<unsigned int>(), "Seconds between metrics reports (0 disables reporting)")
+        ;
+
+    po::options_description all_options;
+    all_options.add(general);
+    all_options.add(behavior);
+    all_options.add(load);
+
+    po::variables_map vm;
+    po::store(po::command_line_parser(argc, argv).
+                  options(all_options).
+                  run(),
+              vm);
+
+    if (vm.count("help")) {
+      std::cout << all_options;
+      return nullptr;
+    }
+
+    if(vm.count("config") > 0)
+    {
+      config_filenames = vm["config"].as<std::vector<std::string> >();
+
+      for(size_t i = 0; i < config_filenames.size(); ++i)
+      {
+        std::ifstream ifs(config_filenames[i].c_str());
+        if(ifs.fail())
+        {
+          LOG_ERROR << "Error opening config file: " << config_filenames[i];
+          return nullptr;
+        }
+        po::store(po::parse_config_file(ifs, all_options), vm);
+      }
+    }
+
+    po::store(po::parse_command_line(argc, argv, all_options), vm);
+    po::notify(vm);
+
+    if (vm.count("mode")) {
+      std::string mode = vm["mode"].as<std::string>();
+      if (mode == "T1") {
+        options->mode = T1;
+      } else if (mode == "T2") {
+        options->mode = T2;
+      } else {
+        LOG_WARNING << "unknown mode: " << mode;
+      }
+      LOG_INFO << "mode: " << options->mode;
+    } else {
+      LOG_INFO << "mode was not set (default to T2).";
+    }
+
+    if (vm.count("node-index")) {
+      options->node_index = vm["node-index"].as<unsigned int>();
+      LOG_INFO << "Node index: " << options->node_index;
+    } else {
+      LOG_INFO << "Node index was not set.";
+    }
+
+    if (vm.count("shard-index")) {
+      options->shard_index = vm["shard-index"].as<unsigned int>();
+      LOG_INFO << "Shard index: " << options->shard_index;
+    } else {
+      LOG_INFO << "Shard index was not set.";
+    }
+
+    if (vm.count("bind-endpoint")) {
+      options->bind_endpoint = vm["bind-endpoint"].as<std::string>();
+      LOG_INFO << "Bind URI: " << options->bind_endpoint;
+    } else {
+      LOG_ERROR << "Bind URI was not set";
+      return nullptr;
+    }
+
+    if (vm.count("host-list")) {
+      options->host_vector = vm["host-list"].as<std::vector<std::string>>();
+      LOG_INFO << "Node URIs:";
+      for (auto i : options->host_vector) {
+        LOG_INFO << "  " << i;
+      }
+    } else {
+      LOG_WARNING << "host-list was not set, confirmations will not be measured.";
+    }
+
+    if (vm.count("inn-keys")) {
+      options->inn_keys = vm["inn-keys"].as<std::string>();
+      LOG_INFO << "INN keys file: " << options->inn_keys;
+    } else {
+      LOG_INFO << "INN keys file was not set.";
+    }
+
+    if (vm.count("node-keys")) {
+      options->node_keys = vm["node-keys"].as<std::string>();
+      LOG_INFO << "Node keys file: " << options->node_keys;
+    } else {
+      LOG_INFO << "Node keys file was not set.";
+    }
+
+    if (vm.count("wallet-keys")) {
+      options->wallet_keys = vm["wallet-keys"].as<std::string>();
+      LOG_INFO << "Wallet keys file: " << options->wallet_keys;
+    } else {
+      LOG_INFO << "Wallet keys file was not set.";
+    }
+
+    if (vm.count("key-pass")) {
+      options->key_pass = vm["key-pass"].as<std::string>();
+      LOG_INFO << "Key pass: " << options->key_pass;
+    } else {
+      LOG_INFO << "Key pass was not set.";
+    }
+
+    if (vm.count("key-load-threads")) {
+      options->key_load_threads = vm["key-load-threads"].as<unsigned int>();
+      LOG_INFO << "Key load threads: " << options->key_load_threads;
+    }
+
+    if (vm.count("key-cache-dir")) {
+      options->key_cache_dir = vm["key-cache-dir"].as<std::string>();
+      LOG_INFO << "Key cache dir: " << options->key_cache_dir;
+    }
+
+    if (vm.count("rate")) {
+      options->rate = vm["rate"].as<double>();
+    }
+    LOG_INFO << "Rate: " << options->rate << " tx/s";
+
+    if (vm.count("ramp-to")) {
+      options->ramp_to = vm["ramp-to"].as<double>();
+      LOG_INFO << "Ramp to: " << options->ramp_to << " tx/s";
+    }
+
+    if (vm.count("ramp-secs")) {
+      options->ramp_secs = vm["ramp-secs"].as<unsigned int>();
+      LOG_INFO << "Ramp seconds: " << options->ramp_secs;
+    }
+
+    if (vm.count("duration")) {
+      options->duration = vm["duration"].as<unsigned int>();
+    }
+    LOG_INFO << "Duration: " << options->duration << "s";
+
+    if (vm.count("drain-secs")) {
+      options->drain_secs = vm["drain-secs"].as<unsigned int>();
+    }
+    LOG_INFO << "Drain seconds: " << options->drain_secs;
+
+    if (vm.count("start-delay")) {
+      options->start_delay = vm["start-delay"].as<unsigned int>();
+    }
+    LOG_INFO << "Start delay: " << options->start_delay << "s";
+
+    if (vm.count("batch-size")) {
+      options->batch_size = vm["batch-size"].as<unsigned int>();
+    }
+    LOG_INFO << "Batch size: " << options->batch_size;
+
+    if (vm.count("num-threads")) {
+      options->num_threads = vm["num-threads"].as<unsigned int>();
+      LOG_INFO << "Generator threads: " << options->num_threads;
+    } else {
+      LOG_INFO << "Generator threads were not set (default to one per core).";
+    }
+
+    if (vm.count("tx-amount")) {
+      options->tx_amount = vm["tx-amount"].as<uint64_t>();
+    }
+    LOG_INFO << "Transaction amount: " << options->tx_amount;
+
+    if (vm.count("seed")) {
+      options->seed = vm["seed"].as<uint64_t>();
+      LOG_INFO << "Seed: " << options->seed;
+    } else {
+      options->seed = GetMillisecondsSinceEpoch();
+      LOG_INFO << "Seed was not set, defaulting to the current time " << options->seed;
+    }
+
+    if (vm.count("metrics-file")) {
+      options->metrics_file = vm["metrics-file"].as<std::string>();
+      LOG_INFO << "Metrics file: " << options->metrics_file;
+    }
+
+    if (vm.count("metrics-interval")) {
+      options->metrics_interval = vm["metrics-interval"].as<unsigned int>();
+      LOG_INFO << "Metrics interval: " << options->metrics_interval;
+    }
+
+  }
+  catch(std::exception& e) {
+    LOG_ERROR << "error: " << e.what();
+    return nullptr;
+  }
+
+  return options;
+}
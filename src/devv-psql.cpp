@@ -6,12 +6,16 @@
  * @copywrite  2018 Devvio Inc
  */
 
+#include <algorithm>
+#include <atomic>
 #include <fstream>
 #include <functional>
 #include <iostream>
+#include <set>
 #include <string>
 #include <thread>
 #include <memory>
+#include <unordered_map>
 
 #include <boost/filesystem.hpp>
 #include <boost/program_options.hpp>
@@ -22,6 +26,8 @@
 #include "common/devv_context.h"
 #include "io/message_service.h"
 #include "modules/BlockchainModule.h"
+#include "primitives/block_codec.h"
+#include "primitives/thin_block.h"
 
 using namespace Devv;
 
@@ -46,6 +52,7 @@ struct psql_options {
   std::string db_ip;
   std::string db_name;
   unsigned int db_port = 5432;
+  bool block_ingest = true;
 };
 
 static const std::string kREQUEST_COMMENT = "Test Devv from the INN";
@@ -109,6 +116,15 @@ static const std::string kDELETE_PENDING_RX_STATEMENT = "delete from pending_rx
 static const std::string kDELETE_PENDING_RX_BY_TX = "delete_pending_rx_by_tx";
 static const std::string kDELETE_PENDING_RX_BY_TX_STATEMENT = "delete from pending_rx where pending_tx_id = cast($1 as uuid);";
 
+/// Most rows written by one multi-row statement
+static const size_t kSQL_BATCH_ROWS = 1000;
+/// Most wallet ids cached before the cache is cleared
+static const size_t kWALLET_CACHE_MAX = 1000000;
+/// Times a block is recorded before devv-psql stops
+static const unsigned int kINGEST_ATTEMPTS = 3;
+/// Millis between attempts to record a block
+static const unsigned int kINGEST_RETRY_MS = 1000;
+
 template <typename Prepared>
 pqxx::result exec_and_log(Prepared& prep) {
   auto res = prep.exec();
@@ -128,7 +144,7 @@ std::unique_ptr<struct psql_options> ParsePsqlOptions(int argc, char** argv);
 
 /**
  * Update wallet balance
- * @param stmt a nontransaction statement to use to communicate with the db
+ * @param stmt a transaction or nontransaction to use to communicate with the db
  * @param hex_addr - the wallet address in hex
  * @param coin - the index of the currency to update
  * @param delta - the positive or negative amount to change the balance
@@ -136,7 +152,7 @@ std::unique_ptr<struct psql_options> ParsePsqlOptions(int argc, char** argv);
  * @note this method is not atomic and may be part of larger sql transactions
  * @return the new balance as int64_t
  */
-int64_t update_balance(pqxx::nontransaction& stmt, std::string hex_addr
+int64_t update_balance(pqxx::transaction_base& stmt, std::string hex_addr
         , unsigned int chain_height, uint64_t coin, int64_t delta, int shard
         , const ChainState& state) {
   LOG_INFO << "update_balance("+hex_addr+", "+std::to_string(coin)+", "+std::to_string(delta)+")";
@@ -202,8 +218,14 @@ int64_t update_balance(pqxx::nontransaction& stmt, std::string hex_addr
   return new_balance;
 }
 
-void handle_inn_tx(pqxx::nontransaction& stmt, int shard
-    , unsigned int chain_height, uint64_t blocktime, const ChainState& state) {
+/**
+ * Record the coin requests of the INN that are pending
+ * @param stmt a transaction or nontransaction to use to communicate with the db
+ * @param rethrow iff true, a failed statement is thrown so a transaction rolls back,
+ *   otherwise the request is skipped
+ */
+void handle_inn_tx(pqxx::transaction_base& stmt, int shard
+    , unsigned int chain_height, uint64_t blocktime, const ChainState& state, bool rethrow = false) {
   pqxx::result inn_result = stmt.prepared(kSELECT_PENDING_INN).exec();
   LOG_DEBUG << "SELECT_PENDING_INN returned (" << inn_result.size() << ") transactions";
   if (!inn_result.empty()) {
@@ -233,20 +255,28 @@ void handle_inn_tx(pqxx::nontransaction& stmt, int shard
         LOG_INFO << "Updated rx table";
         stmt.prepared(kDELETE_PENDING_RX)(pending_uuid).exec();
         stmt.prepared(kDELETE_PENDING_TX)(uuid).exec();
-        stmt.exec("commit;");
       } catch (const pqxx::pqxx_exception& e) {
         LOG_ERROR << e.base().what() << std::endl;
         const pqxx::sql_error* s = dynamic_cast<const pqxx::sql_error*>(&e.base());
         if (s) LOG_ERROR << "Query was: " << s->query() << std::endl;
+        if (rethrow) throw;
       } catch (const std::exception& e) {
         LOG_WARNING << FormatException(&e, "Exception selecting wallet");
+        if (rethrow) throw;
       }
     } //end for pending request loop
   } //endif result not empty
   //if result is empty, it was probably handled already, do nothing
 }
 
-void handle_old_tx(pqxx::nontransaction& stmt, int shard, unsigned int chain_height, uint64_t blocktime) {
+/**
+ * Reject the pending transactions marked old and mark the recent ones
+ * @param stmt a transaction or nontransaction to use to communicate with the db
+ * @param rethrow iff true, a failed statement is thrown so a transaction rolls back,
+ *   otherwise the transaction is skipped
+ */
+void handle_old_tx(pqxx::transaction_base& stmt, int shard, unsigned int chain_height, uint64_t blocktime
+    , bool rethrow = false) {
   pqxx::result old_result = stmt.prepared(kSELECT_OLD_PENDING).exec();
   LOG_DEBUG << "SELECT_OLD_PENDING returned (" << old_result.size() << ") transactions";
   pqxx::result recent_result = stmt.prepared(kSELECT_RECENT_PENDING).exec();
@@ -262,8 +292,10 @@ void handle_old_tx(pqxx::nontransaction& stmt, int shard, unsigned int chain_hei
         LOG_ERROR << e.base().what() << std::endl;
         const pqxx::sql_error* s = dynamic_cast<const pqxx::sql_error*>(&e.base());
         if (s) LOG_ERROR << "Query was: " << s->query() << std::endl;
+        if (rethrow) throw;
       } catch (const std::exception& e) {
         LOG_WARNING << FormatException(&e, "Exception selecting wallet");
+        if (rethrow) throw;
       }
     } //end for old request loop
   } //endif result not empty
@@ -276,13 +308,254 @@ void handle_old_tx(pqxx::nontransaction& stmt, int shard, unsigned int chain_hei
         LOG_ERROR << e.base().what() << std::endl;
         const pqxx::sql_error* s = dynamic_cast<const pqxx::sql_error*>(&e.base());
         if (s) LOG_ERROR << "Query was: " << s->query() << std::endl;
+        if (rethrow) throw;
       } catch (const std::exception& e) {
         LOG_WARNING << FormatException(&e, "Exception selecting wallet");
+        if (rethrow) throw;
       }
     } //end for old request loop
   } //endif recent result not empty
 }
 
+/**
+ * Run a multi-row statement in chunks of at most kSQL_BATCH_ROWS rows.
+ * @param stmt the transaction to run in
+ * @param prefix the statement up to and including VALUES
+ * @param rows the rows, each a parenthesized list of quoted values
+ * @param suffix the rest of the statement, may be empty
+ */
+void exec_batched(pqxx::transaction_base& stmt, const std::string& prefix
+    , const std::vector<std::string>& rows, const std::string& suffix) {
+  for (size_t start = 0; start < rows.size(); start += kSQL_BATCH_ROWS) {
+    size_t end = std::min(rows.size(), start + kSQL_BATCH_ROWS);
+    std::string query(prefix);
+    for (size_t i = start; i < end; ++i) {
+      if (i > start) query += ",";
+      query += rows[i];
+    }
+    query += suffix;
+    pqxx::result res = stmt.exec(query);
+    LOG_DEBUG << "Wrote " << (end - start) << " rows: " << prefix;
+  }
+}
+
+/**
+ * @return the values quoted into a SQL list, i.e. ('A','B')
+ */
+std::string sql_list(pqxx::transaction_base& stmt, const std::set<std::string>& values) {
+  std::string list("(");
+  for (const auto& value : values) {
+    if (list.size() > 1) list += ",";
+    list += stmt.quote(value);
+  }
+  return list + ")";
+}
+
+/**
+ * Look up the wallet ids of addresses that are not in the cache yet.
+ * Addresses without a wallet row are left out of the cache.
+ * @param stmt the transaction to run in
+ * @param addrs the wallet addresses in upper case hex
+ * @param wallet_ids the cache of wallet_addr -> wallet_id
+ */
+void cache_wallet_ids(pqxx::transaction_base& stmt, const std::set<std::string>& addrs
+    , std::unordered_map<std::string, std::string>& wallet_ids) {
+  std::set<std::string> missing;
+  for (const auto& addr : addrs) {
+    if (wallet_ids.find(addr) == wallet_ids.end()) missing.insert(addr);
+  }
+  if (missing.empty()) return;
+  if (wallet_ids.size() + missing.size() > kWALLET_CACHE_MAX) {
+    LOG_INFO << "Clearing the wallet id cache (" << wallet_ids.size() << " wallets)";
+    wallet_ids.clear();
+  }
+  pqxx::result res = stmt.exec("select wallet_addr, wallet_id from wallet where wallet_addr in "
+                               + sql_list(stmt, missing) + ";");
+  for (size_t i = 0; i < res.size(); ++i) {
+    wallet_ids[res[i][0].as<std::string>()] = res[i][1].as<std::string>();
+  }
+  LOG_DEBUG << "Cached " << res.size() << " of " << missing.size() << " new wallet ids";
+}
+
+/**
+ * A Transaction of a block, reduced to what the database records
+ */
+struct IngestTx {
+  std::string sig_hex;
+  std::string sender_hex;
+  uint64_t coin_id = 0;
+  int64_t send_amount = 0;
+  std::vector<TransferPtr> receivers;
+};
+
+/**
+ * Record a block in the database in one transaction.
+ * Balances are written once per (wallet, coin) touched by the block,
+ * and the rows of each table are written with multi-row statements.
+ * Any failed statement throws and rolls back the whole block.
+ * @param db the database connection
+ * @param block the block to record
+ * @param state the chain state after this block
+ * @param chain_height the height of this block
+ * @param shard the index of the shard
+ * @param wallet_ids the cache of wallet_addr -> wallet_id
+ */
+void ingest_block(pqxx::connection& db, const FinalBlock& block, const ChainState& state
+    , unsigned int chain_height, int shard, std::unordered_map<std::string, std::string>& wallet_ids) {
+  uint64_t blocktime = block.getBlockTime();
+  std::string height(std::to_string(chain_height));
+  std::string shard_str(std::to_string(shard));
+  std::string time_str(std::to_string(blocktime));
+
+  bool has_inn_tx = false;
+  std::vector<IngestTx> txs;
+  std::set<std::string> addrs;
+  std::set<std::string> sigs;
+  // (wallet, coin) pairs whose balance this block changes
+  std::set<std::pair<std::string, uint64_t>> balances;
+  for (const auto& one_tx : block.getTransactions()) {
+    if (one_tx->getSignature().isNodeSignature()) {
+      has_inn_tx = true;
+      continue;
+    }
+    IngestTx tx;
+    tx.sig_hex = one_tx->getSignature().getJSON();
+    for (TransferPtr& one_xfer : one_tx->getTransfers()) {
+      if (one_xfer->getAmount() < 0) {
+        if (!tx.sender_hex.empty()) {
+          LOG_WARNING << "Multiple senders in transaction '"+tx.sig_hex+"'?!";
+          continue;
+        }
+        tx.sender_hex = one_xfer->getAddress().getHexString();
+        tx.coin_id = one_xfer->getCoin();
+        tx.send_amount = one_xfer->getAmount();
+      } else {
+        tx.receivers.push_back(std::move(one_xfer));
+      }
+    }
+    if (tx.sender_hex.empty()) {
+      LOG_WARNING << "Transaction '"+tx.sig_hex+"' has no sender, skipping";
+      continue;
+    }
+    addrs.insert(tx.sender_hex);
+    balances.insert(std::make_pair(tx.sender_hex, tx.coin_id));
+    for (const auto& rcv : tx.receivers) {
+      std::string rcv_addr = rcv->getAddress().getHexString();
+      addrs.insert(rcv_addr);
+      balances.insert(std::make_pair(rcv_addr, rcv->getCoin()));
+    }
+    sigs.insert(tx.sig_hex);
+    txs.push_back(std::move(tx));
+  }
+
+  pqxx::work stmt(db, "ingest_block");
+  if (has_inn_tx) {
+    LOG_DEBUG << "Block has INN transactions: calling handle_inn_tx()";
+    handle_inn_tx(stmt, shard, chain_height, blocktime, state, true);
+  }
+
+  if (!txs.empty()) {
+    cache_wallet_ids(stmt, addrs, wallet_ids);
+
+    // balances come from the chain state, so each is written once
+    std::vector<std::string> balance_rows;
+    for (const auto& balance : balances) {
+      auto wallet = wallet_ids.find(balance.first);
+      if (wallet == wallet_ids.end()) {
+        LOG_WARNING << "No wallet for address '"+balance.first+"', balance not recorded";
+        continue;
+      }
+      Address chain_addr(Hex2Bin(balance.first));
+      int64_t new_balance = state.getAmount(balance.second, chain_addr);
+      balance_rows.push_back("(" + stmt.quote(wallet->second) + "::uuid," + std::to_string(balance.second)
+                             + "::bigint," + std::to_string(new_balance) + "::bigint," + height + ")");
+    }
+    if (!balance_rows.empty()) {
+      exec_batched(stmt, "UPDATE wallet_coin w set balance = v.balance, block_height = v.block_height"
+          " from (values ", balance_rows, ") as v(wallet_id, coin_id, balance, block_height)"
+          " where w.wallet_id = v.wallet_id and w.coin_id = v.coin_id;");
+      exec_batched(stmt, "INSERT INTO wallet_coin (wallet_coin_id, wallet_id, block_height, coin_id, balance)"
+          " (select devv_uuid(), v.wallet_id, v.block_height, v.coin_id, v.balance from (values "
+          , balance_rows, ") as v(wallet_id, coin_id, balance, block_height)"
+          " where not exists (select 1 from wallet_coin w"
+          " where w.wallet_id = v.wallet_id and w.coin_id = v.coin_id));");
+    }
+
+    // transactions requested through the database are pending, confirm them
+    std::unordered_map<std::string, std::string> pending;
+    pqxx::result pending_result = stmt.exec("select sig, pending_tx_id from pending_tx where sig in "
+                                            + sql_list(stmt, sigs) + ";");
+    std::set<std::string> pending_ids;
+    for (size_t i = 0; i < pending_result.size(); ++i) {
+      pending[pending_result[i][0].as<std::string>()] = pending_result[i][1].as<std::string>();
+      pending_ids.insert(pending_result[i][1].as<std::string>());
+    }
+    if (!pending_ids.empty()) {
+      std::string id_list("(");
+      for (const auto& id : pending_ids) {
+        if (id_list.size() > 1) id_list += ",";
+        id_list += stmt.quote(id) + "::uuid";
+      }
+      id_list += ")";
+      stmt.exec("INSERT INTO tx (tx_id, shard_id, block_height, block_time, tx_wallet, coin_id, amount, comment)"
+          " (select p.pending_tx_id, " + shard_str + ", " + height + ", " + time_str
+          + ", p.tx_wallet, p.coin_id, p.amount, p.comment from pending_tx p where p.pending_tx_id in "
+          + id_list + ");");
+      stmt.exec("INSERT INTO rx (rx_id, shard_id, block_height, block_time, tx_wallet, rx_wallet, coin_id, amount, delay, comment, tx_id)"
+          " (select devv_uuid(), " + shard_str + ", " + height + ", " + time_str
+          + ", p.tx_wallet, p.rx_wallet, p.coin_id, p.amount, p.delay, p.comment, p.pending_tx_id"
+          " from pending_rx p where p.pending_tx_id in " + id_list + ");");
+      stmt.exec("delete from pending_rx where pending_tx_id in " + id_list + ";");
+      stmt.exec("delete from pending_tx where pending_tx_id in " + id_list + ";");
+    }
+
+    // the rest are new, record them with fresh ids
+    std::vector<const IngestTx*> new_txs;
+    for (const auto& tx : txs) {
+      if (pending.find(tx.sig_hex) != pending.end()) continue;
+      if (wallet_ids.find(tx.sender_hex) == wallet_ids.end()) continue;
+      new_txs.push_back(&tx);
+    }
+    if (!new_txs.empty()) {
+      pqxx::result uuid_result = stmt.exec("select devv_uuid() from generate_series(1, "
+                                           + std::to_string(new_txs.size()) + ");");
+      if (uuid_result.size() != new_txs.size()) {
+        throw std::runtime_error("Failed to generate UUIDs for new transactions!");
+      }
+      std::vector<std::string> tx_rows;
+      std::vector<std::string> rx_rows;
+      for (size_t i = 0; i < new_txs.size(); ++i) {
+        const IngestTx& tx = *new_txs[i];
+        std::string tx_uuid = stmt.quote(uuid_result[i][0].as<std::string>()) + "::uuid";
+        std::string tx_wallet = stmt.quote(wallet_ids[tx.sender_hex]) + "::uuid";
+        tx_rows.push_back("(" + tx_uuid + "," + shard_str + "," + height + "," + time_str + ","
+                          + tx_wallet + "," + std::to_string(tx.coin_id) + ","
+                          + std::to_string(tx.send_amount) + ")");
+        for (const auto& rcv : tx.receivers) {
+          auto rx_wallet = wallet_ids.find(rcv->getAddress().getHexString());
+          if (rx_wallet == wallet_ids.end()) continue;
+          rx_rows.push_back("(devv_uuid()," + shard_str + "," + height + "," + time_str + ","
+                            + tx_wallet + "," + stmt.quote(rx_wallet->second) + "::uuid,"
+                            + std::to_string(rcv->getCoin()) + "," + std::to_string(rcv->getAmount())
+                            + "," + std::to_string(rcv->getDelay()) + "," + tx_uuid + ")");
+        }
+      }
+      exec_batched(stmt, "INSERT INTO tx (tx_id, shard_id, block_height, block_time, tx_wallet, coin_id, amount) values "
+          , tx_rows, ";");
+      if (!rx_rows.empty()) {
+        exec_batched(stmt, "INSERT INTO rx (rx_id, shard_id, block_height, block_time, tx_wallet, rx_wallet, coin_id, amount, delay, tx_id) values "
+            , rx_rows, ";");
+      }
+    }
+  }
+
+  LOG_DEBUG << "Clean old pending transactions.";
+  handle_old_tx(stmt, shard, chain_height, blocktime, true);
+  stmt.commit();
+  LOG_INFO << "Recorded block " << chain_height << " (" << txs.size() << " transactions, "
+           << balances.size() << " balances)";
+}
+
 int main(int argc, char* argv[]) {
   init_log();
 
@@ -357,12 +630,26 @@ int main(int argc, char* argv[]) {
     //@todo(nick@cloudsolar.co): read pre-existing chain
     unsigned int chain_height = 0;
     ChainState state;
+    // wallet_addr -> wallet_id, wallets are never renamed
+    std::unordered_map<std::string, std::string> wallet_ids;
+    // set when a block could not be recorded, later blocks would get wrong heights
+    std::atomic<bool> ingest_failed(false);
 
     auto peer_listener = io::CreateTransactionClient(options->host_vector, zmq_context);
     peer_listener->attachCallback([&](DevvMessageUniquePtr p) {
       if (p->message_type == eMessageType::FINAL_BLOCK) {
+        if (ingest_failed) {
+          return;
+        }
         //update database
         if (db_connected) {
+          if (IsCompactBlockData(p->data)) {
+            p->data = DecodeCompactBlocks(p->data);
+          }
+          if (IsThinBlockData(p->data)) {
+            // the complete block arrives on the archive topic
+            return;
+          }
           InputBuffer buffer(p->data);
           KeyRing keys;
           FinalBlock one_block(buffer, state, keys, options->mode);
@@ -370,6 +657,34 @@ int main(int argc, char* argv[]) {
           std::vector<TransactionPtr> txs = one_block.CopyTransactions();
           state = one_block.getChainState();
 
+          if (options->block_ingest) {
+            // a failed block is rolled back as a whole, so it can be recorded again
+            for (unsigned int attempt = 1; ; ++attempt) {
+              try {
+                ingest_block(*db_link, one_block, state, chain_height, options->shard_index, wallet_ids);
+                break;
+              } catch (const pqxx::pqxx_exception& e) {
+                LOG_ERROR << e.base().what() << std::endl;
+                const pqxx::sql_error* s = dynamic_cast<const pqxx::sql_error*>(&e.base());
+                if (s) LOG_ERROR << "Query was: " << s->query() << std::endl;
+              } catch (const std::exception& e) {
+                LOG_WARNING << FormatException(&e, "Exception recording block: "
+                  + std::to_string(chain_height));
+              }
+              if (attempt >= kINGEST_ATTEMPTS) {
+                LOG_FATAL << "Block " << chain_height << " was rolled back " << attempt
+                          << " times, stopping devv-psql";
+                ingest_failed = true;
+                return;
+              }
+              LOG_ERROR << "Block " << chain_height << " was rolled back, recording it again";
+              std::this_thread::sleep_for(millisecs(kINGEST_RETRY_MS));
+            }
+            chain_height++;
+            LOG_INFO << "Ready for block: "+std::to_string(chain_height);
+            return;
+          }
+
           for (TransactionPtr& one_tx : txs) {
             pqxx::nontransaction stmt(*db_link);
             LOG_INFO << "Begin processing transaction.";
@@ -522,6 +837,7 @@ int main(int argc, char* argv[]) {
       }
     });
     peer_listener->listenTo(get_shard_uri(options->shard_index));
+    peer_listener->listenTo(GetArchiveUri(get_shard_uri(options->shard_index)));
     peer_listener->run();
     //peer_listener->startClient();
     LOG_INFO << "devv-psql is listening to shard: "+get_shard_uri(options->shard_index);
@@ -535,9 +851,15 @@ int main(int argc, char* argv[]) {
         LOG_INFO << "Shutdown file exists. Stopping devv-psql...";
         break;
       }
+      if (ingest_failed) {
+        break;
+      }
     }
     if (db_connected) db_link->disconnect();
     peer_listener->stopClient();
+    if (ingest_failed) {
+      exit(-1);
+    }
     return (true);
   }
   catch (const std::exception& e) {
@@ -587,6 +909,7 @@ Listens for FinalBlock messages and updates a database\n\
         ("update-user", po::value<std::string>(), "Database username to use for updates.")
         ("update-pass", po::value<std::string>(), "Database password to use for updates.")
         ("update-port", po::value<unsigned int>(), "Database port to use for updates.")
+        ("ingest-mode", po::value<std::string>(), "Record each block in one transaction (block) or each transaction on its own (tx). Default block.")
         ;
 
     po::options_description all_options;
@@ -718,6 +1041,20 @@ Listens for FinalBlock messages and updates a database\n\
       options->db_port = 5432;
     }
 
+    if (vm.count("ingest-mode")) {
+      std::string ingest_mode = vm["ingest-mode"].as<std::string>();
+      if (ingest_mode == "block") {
+        options->block_ingest = true;
+      } else if (ingest_mode == "tx") {
+        options->block_ingest = false;
+      } else {
+        LOG_WARNING << "unknown ingest mode: " << ingest_mode;
+      }
+      LOG_INFO << "Ingest mode: " << (options->block_ingest ? "block" : "tx");
+    } else {
+      LOG_INFO << "Ingest mode was not set, default to block.";
+    }
+
   }
   catch(std::exception& e) {
     LOG_ERROR << "error: " << e.what();
@@ -15,14 +15,20 @@
 #include <memory>
 
 #include <boost/filesystem.hpp>
+#include <boost/thread/shared_mutex.hpp>
 #include <boost/program_options.hpp>
 
 #include "common/logger.h"
 #include "common/devv_context.h"
 #include "common/devv_uri.h"
+#include "common/metrics.h"
 #include "consensus/blockchain.h"
+#include "consensus/transaction_index.h"
 #include "io/message_service.h"
+#include "io/request_router.h"
 #include "modules/BlockchainModule.h"
+#include "primitives/block_codec.h"
+#include "primitives/thin_block.h"
 #include "pbuf/devv_pbuf.h"
 
 using namespace Devv;
@@ -49,6 +55,9 @@ struct repeater_options {
   std::string stop_file;
   bool testnet = false;
   eDebugMode debug_mode = eDebugMode::off;
+  std::string metrics_file;
+  unsigned int metrics_interval = 0;
+  unsigned int num_request_threads = io::kDEFAULT_REQUEST_WORKERS;
 };
 
 /**
@@ -67,10 +76,21 @@ std::unique_ptr<struct repeater_options> ParseRepeaterOptions(int argc, char** a
  * @param shard_name - the name of the shard this process tracks
  * @param shard_index - the index of the shard this process tracks
  * @param chain - the blockchain this shard tracks
+ * @param index - the transaction index of this shard
  * @return ServiceResponsePtr - a smart pointer to the response
  */
 ServiceResponsePtr HandleServiceRequest(const ServiceRequestPtr& request, const std::string& working_dir
-    , const std::string& shard_name, unsigned int shard_index, const Blockchain& chain);
+    , const std::string& shard_name, unsigned int shard_index, const Blockchain& chain
+    , const TransactionIndex& index);
+
+/**
+ * Read a stored block.
+ * @param shard - the shard directory of the block
+ * @param block - the height of the block
+ * @param working_dir - the directory where blocks are stored
+ * @return the canonical block
+ */
+std::vector<byte> ReadBlock(const std::string& shard, uint32_t block, const std::string& working_dir);
 
 /**
  * Generate a bad syntax error response.
@@ -94,6 +114,13 @@ int main(int argc, char* argv[]) {
       exit(-1);
     }
 
+    MetricsReporter metrics_reporter(options->metrics_file, options->metrics_interval);
+    Counter& blocks_received = MetricsRegistry::Get().counter("query.blocks.received");
+    Counter& requests_handled = MetricsRegistry::Get().counter("query.requests.handled");
+    Counter& requests_rejected = MetricsRegistry::Get().counter("query.requests.rejected");
+    Histogram& request_time = MetricsRegistry::Get().histogram("query.request.handle_us");
+    Gauge& indexed_txs = MetricsRegistry::Get().gauge("query.index.transactions");
+
     zmq::context_t zmq_context(1);
 
     DevvContext this_context(options->node_index, options->shard_index, options->mode, options->inn_keys,
@@ -112,13 +139,42 @@ int main(int argc, char* argv[]) {
 
     std::string shard_name = "Shard-"+std::to_string(options->shard_index);
 
-    //@todo(nick@cloudsolar.co): read pre-existing chain
     Blockchain chain(options->shard_name);
     ChainState state;
+    // requests read the chain concurrently, new blocks are added exclusively
+    boost::shared_mutex chain_mutex;
+
+    // Reload the blocks saved by earlier runs so new blocks keep their heights
+    // and the index can catch up with any blocks it missed.
+    std::string shard_uri(this_context.get_shard_uri());
+    TransactionIndex tx_index(options->working_dir + "/" + shard_uri + ".idx");
+    for (uint32_t height = 0; boost::filesystem::exists(options->working_dir + "/" + shard_uri
+             + "/" + std::to_string(height) + ".blk"); ++height) {
+      try {
+        std::vector<byte> block = ReadBlock(shard_uri, height, options->working_dir);
+        InputBuffer buffer(block);
+        FinalPtr saved_block = std::make_shared<FinalBlock>(FinalBlock::Create(buffer, state));
+        chain.push_back(saved_block);
+        tx_index.addBlock(height, *saved_block);
+      } catch (const std::exception& e) {
+        LOG_WARNING << "Failed to load block " << height << ": " << e.what();
+        break;
+      }
+    }
+    indexed_txs.set(tx_index.size());
+    LOG_INFO << "Loaded " << chain.size() << " blocks, " << tx_index.size() << " transactions indexed";
 
     auto peer_listener = io::CreateTransactionClient(options->host_vector, zmq_context);
     peer_listener->attachCallback([&](DevvMessageUniquePtr p) {
       if (p->message_type == eMessageType::FINAL_BLOCK) {
+        blocks_received.add();
+        if (IsCompactBlockData(p->data)) {
+          p->data = DecodeCompactBlocks(p->data);
+        }
+        if (IsThinBlockData(p->data)) {
+          // the complete block arrives on the archive topic
+          return;
+        }
         //write final chain to file
         std::string shard_dir(options->working_dir+"/"+this_context.get_shard_uri());
         fs::path dir_path(shard_dir);
@@ -140,7 +196,11 @@ int main(int argc, char* argv[]) {
         try {
           InputBuffer buffer(p->data);
           FinalPtr top_block = std::make_shared<FinalBlock>(FinalBlock::Create(buffer, state));
+          boost::unique_lock<boost::shared_mutex> chain_lock(chain_mutex);
+          uint32_t height = chain.size();
           chain.push_back(top_block);
+          tx_index.addBlock(height, *top_block);
+          indexed_txs.set(tx_index.size());
 	    } catch (const std::exception& e) {
           std::exception_ptr p = std::current_exception();
           std::string err("");
@@ -150,33 +210,15 @@ int main(int argc, char* argv[]) {
       }
     });
     peer_listener->listenTo(this_context.get_shard_uri());
+    peer_listener->listenTo(GetArchiveUri(this_context.get_shard_uri()));
     peer_listener->startClient();
     LOG_INFO << "Repeater is listening to shard: "+this_context.get_shard_uri();
 
-    zmq::context_t context(1);
-    zmq::socket_t socket (context, ZMQ_REP);
-    socket.bind (options->protobuf_endpoint);
-
-    unsigned int queries_processed = 0;
-    while (true) {
-      /* Should we shutdown? */
-      if (fs::exists(options->stop_file)) {
-        LOG_INFO << "Shutdown file exists. Stopping repeater...";
-        break;
-      }
-
-      zmq::message_t request_message;
-      //  Wait for next request from client
-
-      LOG_INFO << "Waiting for ServiceRequest";
-      auto res = socket.recv(&request_message);
-      if (!res) {
-        LOG_ERROR << "socket.recv != true - exiting";
-        break;
-      }
+    std::atomic<unsigned int> queries_processed(0);
+    auto router = io::CreateRequestRouter(options->protobuf_endpoint, options->num_request_threads
+        , [&](const std::string& msg_string) {
       LOG_INFO << "Received Message";
-      std::string msg_string = std::string(static_cast<char*>(request_message.data()),
-	            request_message.size());
+      ScopedTimer request_timer(request_time);
 
       std::string response;
       ServiceRequestPtr request_ptr;
@@ -186,19 +228,20 @@ int main(int argc, char* argv[]) {
         ServiceResponsePtr response_ptr =
           GenerateBadSyntaxResponse("ServiceRequest Deserialization error: "
           + std::string(e.what()));
+        requests_rejected.add();
         std::stringstream response_ss;
         Devv::proto::ServiceResponse pbuf_response = SerializeServiceResponse(std::move(response_ptr));
         pbuf_response.SerializeToOstream(&response_ss);
-        response = response_ss.str();
-        zmq::message_t reply(response.size());
-        memcpy(reply.data(), response.data(), response.size());
-        socket.send(reply);
-        continue;
+        return response_ss.str();
       }
 
-      ServiceResponsePtr response_ptr = HandleServiceRequest(std::move(request_ptr)
-        , options->working_dir, options->shard_name
-        , options->shard_index, chain);
+      ServiceResponsePtr response_ptr;
+      {
+        boost::shared_lock<boost::shared_mutex> chain_lock(chain_mutex);
+        response_ptr = HandleServiceRequest(std::move(request_ptr)
+          , options->working_dir, options->shard_name
+          , options->shard_index, chain, tx_index);
+      }
       if (options->testnet) {
         response_ptr->args.insert(std::make_pair("testnet", "true"));
       }
@@ -207,13 +250,24 @@ int main(int argc, char* argv[]) {
       std::stringstream response_ss;
       pbuf_response.SerializeToOstream(&response_ss);
       response = response_ss.str();
-      zmq::message_t reply(response.size());
-      memcpy(reply.data(), response.data(), response.size());
-      socket.send(reply);
-      queries_processed++;
+      requests_handled.add();
       LOG_INFO << "ServiceResponse sent, process has handled: "
-                +std::to_string(queries_processed)+" queries";
+                +std::to_string(++queries_processed)+" queries";
+      return response;
+    }, zmq_context);
+    router->startRouter();
+    LOG_INFO << "Serving requests on " << options->protobuf_endpoint << " with "
+             << options->num_request_threads << " threads";
+
+    while (true) {
+      /* Should we shutdown? */
+      if (fs::exists(options->stop_file)) {
+        LOG_INFO << "Shutdown file exists. Stopping repeater...";
+        break;
+      }
+      std::this_thread::sleep_for(millisecs(kMAIN_WAIT_INTERVAL));
     }
+    router->stopRouter();
     peer_listener->stopClient();
     return (true);
   }
@@ -263,6 +317,9 @@ Listens for FinalBlock messages and saves them to a file\n\
         ("key-pass", po::value<std::string>(), "Password for private keys")
         ("stop-file", po::value<std::string>(), "A file in working-dir indicating that this node should stop.")
         ("testnet", po::bool_switch()->default_value(false), "Set to true for the testnet.")
+        ("metrics-file", po::value<std::string>(), "File the metrics are written to (Prometheus text format)")
+        ("metrics-interval", po::value<unsigned int>(), "Seconds between metrics reports (0 disables reporting)")
+        ("num-request-threads", po::value<unsigned int>(), "Number of threads handling service requests")
         ;
 
     po::options_description all_options;
@@ -404,6 +461,28 @@ Listens for FinalBlock messages and saves them to a file\n\
       options->testnet = vm["testnet"].as<bool>();
       if (options->testnet) LOG_INFO << "TESTNET";
     }
+
+    if (vm.count("metrics-file")) {
+      options->metrics_file = vm["metrics-file"].as<std::string>();
+      LOG_INFO << "Metrics file: " << options->metrics_file;
+    } else {
+      LOG_INFO << "Metrics file was not set.";
+    }
+
+    if (vm.count("metrics-interval")) {
+      options->metrics_interval = vm["metrics-interval"].as<unsigned int>();
+      LOG_INFO << "Metrics interval: " << options->metrics_interval;
+    } else {
+      LOG_INFO << "Metrics interval was not set (default to no reports).";
+    }
+
+    if (vm.count("num-request-threads")) {
+      options->num_request_threads = vm["num-request-threads"].as<unsigned int>();
+      LOG_INFO << "Num request threads: " << options->num_request_threads;
+    } else {
+      LOG_INFO << "Num request threads was not set (default to "
+               << options->num_request_threads << ").";
+    }
   }
   catch(std::exception& e) {
     LOG_ERROR << "error: " << e.what();
@@ -455,10 +534,72 @@ std::vector<byte> ReadBlock(const std::string& shard, uint32_t block, const std:
   return out;
 }
 
+/**
+ * Get a block from memory if the chain holds it, otherwise from its file.
+ * @param shard - the shard directory of the block
+ * @param height - the height of the block
+ * @param working_dir - the directory holding the shard directories
+ * @param chain - the blockchain of this shard, only pass it for the shard this process tracks
+ */
+std::vector<byte> LoadBlock(const std::string& shard, uint32_t height
+    , const std::string& working_dir, const Blockchain& chain) {
+  if (height < chain.size()) {
+    return chain.raw_at(height);
+  }
+  return ReadBlock(shard, height, working_dir);
+}
+
+/**
+ * Collect indexed Transactions, reading each block they are in once.
+ * @param shard - the shard this process tracks, the only one indexed
+ * @param locations - the places of the Transactions, in chain order
+ * @return a map of signature hex -> Transaction hex
+ */
 std::map<std::string, std::string> TraceTransactions(const std::string& shard
+    , const std::vector<TxLocation>& locations
+    , const std::string& working_dir, const Blockchain& chain) {
+  std::map<std::string, std::string> txs;
+  size_t i = 0;
+  while (i < locations.size()) {
+    uint32_t height = locations[i].height;
+    if (height >= chain.size() && !hasBlock(shard, height, working_dir)) {
+      ++i;
+      continue;
+    }
+    std::vector<byte> block = LoadBlock(shard, height, working_dir, chain);
+    InputBuffer buffer(block);
+    ChainState state;
+    FinalBlock one_block(FinalBlock::Create(buffer, state));
+    const std::vector<std::vector<byte>>& raw_txs = one_block.getRawTransactions();
+    for (; i < locations.size() && locations[i].height == height; ++i) {
+      if (locations[i].position >= raw_txs.size()) {
+        LOG_WARNING << "Index points past the end of block " << height;
+        continue;
+      }
+      const std::vector<byte>& raw_tx = raw_txs[locations[i].position];
+      InputBuffer t2_buffer(raw_tx);
+      Tier2Transaction t2tx = Tier2Transaction::QuickCreate(t2_buffer);
+      txs.insert(std::make_pair(ToHex(t2tx.getSignature().getCanonical()), ToHex(raw_tx)));
+    }
+  }
+  return txs;
+}
+
+/**
+ * Collect the Transactions containing a target by reading every block file
+ * in a range, for shards that are not indexed.
+ * @param shard - the shard directory of the blocks
+ * @param start_block - the first height to read
+ * @param end_block - the last height to read
+ * @param target - the signature or address to look for
+ * @param working_dir - the directory holding the shard directories
+ * @return a map of signature hex -> Transaction hex
+ */
+std::map<std::string, std::string> ScanTransactions(const std::string& shard
     , uint32_t start_block, uint32_t end_block
     , const std::vector<byte>& target, const std::string& working_dir) {
   std::map<std::string, std::string> txs;
+  if (!hasShard(shard, working_dir)) return txs;
   uint32_t highest = std::min(end_block, getHighestBlock(shard, working_dir));
   if (highest < start_block) return txs;
 
@@ -479,6 +620,40 @@ std::map<std::string, std::string> TraceTransactions(const std::string& shard
   return txs;
 }
 
+/**
+ * Add a Transaction and, for blocks with a MerkleTree, its inclusion proof
+ * to a response.
+ * @param block - the block to search
+ * @param tx_id - the signature of the Transaction
+ * @param response - the response to add to
+ * @param hint - the position of the Transaction if it is indexed
+ * @return true iff the Transaction is in this block
+ */
+bool AddTransactionInfo(const FinalBlock& block, const Signature& tx_id, ServiceResponse& response
+    , size_t hint = SIZE_MAX) {
+  const std::vector<TransactionPtr>& txs = block.getTransactions();
+  size_t found = txs.size();
+  if (hint < txs.size() && txs[hint]->getSignature() == tx_id) {
+    found = hint;
+  } else {
+    for (size_t i = 0; i < txs.size(); ++i) {
+      if (txs[i]->getSignature() == tx_id) {
+        found = i;
+        break;
+      }
+    }
+  }
+  if (found == txs.size()) {
+    return false;
+  }
+  response.args.insert(std::make_pair("tx-data", ToHex(txs[found]->getCanonical())));
+  if (block.getVersion() >= 1) {
+    response.args.insert(std::make_pair("Merkle", ToHex(block.getMerkleRoot())));
+    response.args.insert(std::make_pair("merkle-proof", block.getTransactionProof(found).getJSON()));
+  }
+  return true;
+}
+
 std::string getServiceArgument(std::map<std::string, std::string>& args, std::string key) {
   auto it = args.find(key);
   if (it != args.end()) {
@@ -488,7 +663,8 @@ std::string getServiceArgument(std::map<std::string, std::string>& args, std::st
 }
 
 ServiceResponsePtr HandleServiceRequest(const ServiceRequestPtr& request, const std::string& working_dir
-    , const std::string& shard_name, unsigned int shard_index, const Blockchain& chain) {
+    , const std::string& shard_name, unsigned int shard_index, const Blockchain& chain
+    , const TransactionIndex& index) {
   ServiceResponse response;
   try {
     response.request_timestamp = request->timestamp;
@@ -562,6 +738,9 @@ ServiceResponsePtr HandleServiceRequest(const ServiceRequestPtr& request, const
           , std::to_string(chain.getAvgBlocktime())));
 	  }
     } else if (SearchString(request->endpoint, "/trace", true)) {
+      // the transaction index only covers the shard this process tracks,
+      // the block files of other shards are scanned
+      bool indexed = shard_id == std::to_string(shard_index);
       std::string start_str = getServiceArgument(request->args, "start-block");
       size_t start_block = 0;
       if (!start_str.empty()) {
@@ -582,37 +761,55 @@ ServiceResponsePtr HandleServiceRequest(const ServiceRequestPtr& request, const
       }
       if (!sig.empty()) {
         response.args.insert(std::make_pair("signature", sig));
-        std::vector<byte> target = Hex2Bin(sig);
-        std::map<std::string, std::string> txs = TraceTransactions(shard_id
-          , start_block, end_block, target, working_dir);
+        std::map<std::string, std::string> txs;
+        if (indexed) {
+          std::vector<TxLocation> locations;
+          TxLocation location;
+          if (index.findTransaction(Signature(Hex2Bin(sig)), location)
+              && location.height >= start_block && location.height <= end_block) {
+            locations.push_back(location);
+          }
+          txs = TraceTransactions(shard_id, locations, working_dir, chain);
+        } else {
+          txs = ScanTransactions(shard_id, start_block, end_block, Hex2Bin(sig), working_dir);
+        }
         response.args.insert(txs.begin(), txs.end());
       }
       if (!addr.empty()) {
         response.args.insert(std::make_pair("address", addr));
-        std::vector<byte> target = Hex2Bin(addr);
-        std::map<std::string, std::string> txs = TraceTransactions(shard_id
-          , start_block, end_block, target, working_dir);
+        std::map<std::string, std::string> txs;
+        if (indexed) {
+          std::vector<TxLocation> locations = index.findAddress(Address(Hex2Bin(addr))
+            , start_block, std::min<size_t>(end_block, UINT32_MAX));
+          txs = TraceTransactions(shard_id, locations, working_dir, chain);
+        } else {
+          txs = ScanTransactions(shard_id, start_block, end_block, Hex2Bin(addr), working_dir);
+        }
         response.args.insert(txs.begin(), txs.end());
 	  }
     } else if (SearchString(request->endpoint, "/tx-info", true)) {
-      size_t height = std::stoi(getServiceArgument(request->args, "block-height"));
-      response.args.insert(std::make_pair("block-height", std::to_string(height)));
       std::string sig = getServiceArgument(request->args, "signature");
       response.args.insert(std::make_pair("signature", sig));
       Signature tx_id(Hex2Bin(sig));
+      // the block height is optional for indexed transactions
+      TxLocation location;
+      bool indexed = shard_id == std::to_string(shard_index) && index.findTransaction(tx_id, location);
+      std::string height_str = getServiceArgument(request->args, "block-height");
+      if (height_str.empty() && !indexed) {
+        response.return_code = 1050;
+        response.message = "Transaction not found.";
+        return std::make_unique<ServiceResponse>(response);
+      }
+      size_t height = height_str.empty() ? location.height : std::stoi(height_str);
+      size_t hint = (indexed && location.height == height) ? location.position : SIZE_MAX;
+      response.args.insert(std::make_pair("block-height", std::to_string(height)));
       if (height < chain.size() && shard_id == std::to_string(shard_index)) {
         std::vector<byte> block = chain.raw_at(height);
         InputBuffer buffer(block);
         ChainState state;
         bool found_tx = false;
         FinalBlock one_block(FinalBlock::Create(buffer, state));
-        for (const auto& tx : one_block.getTransactions()) {
-          if (tx->getSignature() == tx_id) {
-            response.args.insert(std::make_pair("tx-data", ToHex(tx->getCanonical())));
-            found_tx = true;
-            break;
-          }
-        }
+        found_tx = AddTransactionInfo(one_block, tx_id, response, hint);
         if (!found_tx) {
           response.return_code = 1050;
           response.message = "Transaction not found in block "+std::to_string(height)+".";
@@ -623,13 +820,7 @@ ServiceResponsePtr HandleServiceRequest(const ServiceRequestPtr& request, const
         ChainState state;
         bool found_tx = false;
         FinalBlock one_block(FinalBlock::Create(buffer, state));
-        for (const auto& tx : one_block.getTransactions()) {
-          if (tx->getSignature() == tx_id) {
-            response.args.insert(std::make_pair("tx-data", ToHex(tx->getCanonical())));
-            found_tx = true;
-            break;
-          }
-        }
+        found_tx = AddTransactionInfo(one_block, tx_id, response, hint);
         if (!found_tx) {
           response.return_code = 1050;
           response.message = "Transaction not found in block "+std::to_string(height)+".";
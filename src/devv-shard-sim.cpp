@@ -0,0 +1,591 @@
+/*
+ * devv-shard-sim.cpp runs a whole shard in one process to measure consensus.
+ *
+ * num-nodes BlockchainModules are wired together over inproc:// ZMQ
+ * endpoints of one context, exactly as run_shard.py wires devv-validator
+ * processes over tcp (inproc connect-before-bind needs libzmq 4 or newer).
+ * A fixed set of Tier2 transactions is generated from the seed and
+ * announced to the shard, then FINAL_BLOCK messages from every node are
+ * matched to the announced transactions to measure blocks/s, tx/s and
+ * time-to-finality for the given batch-size, max-wait, target-latency and num-nodes.
+ *
+ * Without key files the test keys of devv_constants.h are used, which
+ * limits the shard to their node keys. Wallets start with kSIM_BALANCE coins.
+ *
+ * @copywrite  2018 Devvio Inc
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include <boost/program_options.hpp>
+
+#include "common/logger.h"
+#include "common/devv_context.h"
+#include "common/metrics.h"
+#include "concurrency/TransactionGenerator.h"
+#include "io/message_service.h"
+#include "modules/BlockchainModule.h"
+#include "primitives/block_codec.h"
+
+using namespace Devv;
+
+typedef std::chrono::steady_clock sim_clock;
+
+/// Coins held by every wallet when the simulation starts
+static const int64_t kSIM_BALANCE = 1000000000;
+
+/**
+ * Holds command-line options
+ */
+struct sim_options {
+  unsigned int num_nodes = kDEFAULT_PEER_COUNT;
+  unsigned int shard_index = 1;
+  eAppMode mode = T2;
+  std::string inn_keys;
+  std::string node_keys;
+  std::string wallet_keys;
+  std::string key_pass = "password";
+  unsigned int block_size = 10000;
+  unsigned int max_wait = 0;
+  unsigned int target_latency = 0;
+  size_t tx_count = 10000;
+  unsigned int announce_size = 100;
+  double rate = 0;
+  unsigned int timeout = 120;
+  unsigned int start_delay = 1;
+  unsigned int num_threads = 0;
+  uint64_t tx_amount = 10;
+  uint64_t seed = 0;
+  std::string metrics_file;
+  unsigned int metrics_interval = 0;
+};
+
+std::unique_ptr<struct sim_options> ParseSimOptions(int argc, char** argv);
+
+/**
+ * A batch of announced transactions
+ */
+struct SimBatch {
+  std::vector<byte> data;
+  std::vector<Signature> signatures;
+};
+
+/**
+ * The inproc endpoint of a simulated node
+ */
+std::string NodeEndpoint(unsigned int node_index) {
+  return "inproc://devv-sim-node-" + std::to_string(node_index);
+}
+
+static const std::string kSIM_ANNOUNCER_ENDPOINT = "inproc://devv-sim-announcer";
+
+int main(int argc, char* argv[]) {
+  init_log();
+
+  try {
+    auto options = ParseSimOptions(argc, argv);
+
+    if (!options) {
+      LOG_ERROR << "ParseSimOptions error";
+      exit(-1);
+    }
+
+    MetricsReporter metrics_reporter(options->metrics_file, options->metrics_interval);
+    Counter& txs_final = MetricsRegistry::Get().counter("shardsim.transactions.final");
+    Counter& blocks_final = MetricsRegistry::Get().counter("shardsim.blocks.final");
+    Counter& blocks_unreadable = MetricsRegistry::Get().counter("shardsim.blocks.unreadable");
+    Histogram& finality = MetricsRegistry::Get().histogram("shardsim.finality_ms");
+
+    // One context per node, they must outlive the modules
+    std::vector<std::unique_ptr<DevvContext>> contexts;
+    for (unsigned int i = 0; i < options->num_nodes; ++i) {
+      contexts.emplace_back(new DevvContext(i, options->shard_index, options->mode, options->inn_keys,
+                                            options->node_keys, options->key_pass, options->block_size,
+                                            options->max_wait, options->num_nodes));
+      // the observer cannot read thin blocks without a pool
+      contexts.back()->set_thin_blocks(false);
+      contexts.back()->set_target_latency_ms(options->target_latency);
+    }
+    const DevvContext& shard_context = *contexts.front();
+
+    std::unique_ptr<KeyRing> keys;
+    if (!options->inn_keys.empty() && !options->node_keys.empty()) {
+      keys.reset(new KeyRing(shard_context));
+    } else {
+      keys.reset(new KeyRing());
+      keys->setInnKeyPair(kINN_ADDR, kINN_KEY, "password");
+      for (size_t i = 0; i < kNODE_ADDRs.size(); ++i) {
+        keys->addNodeKeyPair(kNODE_ADDRs.at(i), kNODE_KEYs.at(i), "password");
+      }
+    }
+    if (!options->wallet_keys.empty()) {
+      keys->LoadWallets(options->wallet_keys, options->key_pass);
+    } else {
+      for (size_t i = 0; i < kADDRs.size(); ++i) {
+        keys->addWalletKeyPair(kADDRs.at(i), kADDR_KEYs.at(i), "password");
+      }
+    }
+
+    if (keys->CountNodes() < options->num_nodes) {
+      LOG_FATAL << options->num_nodes << " nodes need as many node keys, "
+                << keys->CountNodes() << " are loaded (see --node-keys).";
+      return (false);
+    }
+    size_t addr_count = keys->CountWallets();
+    if (addr_count < 2) {
+      LOG_FATAL << "At least 2 wallets are needed to generate transactions.";
+      return (false);
+    }
+
+    std::vector<Address> addrs;
+    std::vector<EC_KEY*> wallet_keys;
+    ChainState prior;
+    for (size_t i = 0; i < addr_count; ++i) {
+      addrs.push_back(keys->getWalletAddr(i));
+      wallet_keys.push_back(keys->getWalletKey(i));
+      prior.addCoin(SmartCoin(addrs.back(), 0, kSIM_BALANCE));
+    }
+
+    // Generate every transaction up front so runs with the same seed announce the same data
+    uint64_t tx_amount = std::max<uint64_t>(1, options->tx_amount);
+    uint64_t seed = options->seed;
+    auto make = [&](size_t index, std::vector<byte>& out) {
+      size_t i = index % addr_count;
+      uint64_t random = TransactionGenerator::Random(seed, index);
+      size_t j = (i + 1 + random % (addr_count - 1)) % addr_count;
+      uint64_t amount = 1 + TransactionGenerator::Random(seed, random) % tx_amount;
+      std::vector<Transfer> xfers;
+      Transfer sender(addrs[i], 0, -1l * amount, 0);
+      xfers.push_back(sender);
+      Transfer receiver(addrs[j], 0, amount, 0);
+      xfers.push_back(receiver);
+      std::vector<byte> nonce_bin;
+      Uint64ToBin(seed + 1000000 * (i + 1) * (j + 1) + index, nonce_bin);
+      Tier2Transaction tx(eOpType::Exchange, xfers, nonce_bin, wallet_keys[i]);
+      const std::vector<byte>& canon = tx.getCanonical();
+      out.insert(out.end(), canon.begin(), canon.end());
+    };
+
+    TransactionGenerator generator(options->num_threads);
+    std::stringstream stream;
+    generator.generate(options->tx_count, make, &stream);
+    LOG_INFO << "Generated " << options->tx_count << " transactions in "
+             << generator.getElapsedMillis() << "ms";
+
+    const size_t announce_size = std::max(1u, options->announce_size);
+    std::vector<SimBatch> batches;
+    {
+      std::string bytes(stream.str());
+      std::vector<byte> all(bytes.begin(), bytes.end());
+      InputBuffer buffer(all);
+      while (buffer.getOffset() < all.size()) {
+        if (batches.empty() || batches.back().signatures.size() == announce_size) {
+          batches.emplace_back();
+        }
+        size_t begin = buffer.getOffset();
+        Tier2Transaction tx(Tier2Transaction::QuickCreate(buffer));
+        batches.back().signatures.push_back(tx.getSignature());
+        batches.back().data.insert(batches.back().data.end(), all.begin() + begin,
+                                   all.begin() + buffer.getOffset());
+      }
+    }
+
+    zmq::context_t zmq_context(1);
+
+    // The announcer binds first so the nodes connect to an existing endpoint
+    auto announcer = io::CreateTransactionServer(kSIM_ANNOUNCER_ENDPOINT, zmq_context);
+    announcer->startServer();
+
+    std::vector<std::unique_ptr<io::TransactionServer>> servers;
+    std::vector<std::unique_ptr<io::TransactionClient>> peer_clients;
+    std::vector<std::unique_ptr<io::TransactionClient>> loopback_clients;
+    std::vector<std::unique_ptr<BlockchainModule>> modules;
+    for (unsigned int i = 0; i < options->num_nodes; ++i) {
+      std::vector<std::string> hosts{kSIM_ANNOUNCER_ENDPOINT};
+      for (unsigned int peer = 0; peer < options->num_nodes; ++peer) {
+        if (peer != i) {
+          hosts.push_back(NodeEndpoint(peer));
+        }
+      }
+      servers.push_back(io::CreateTransactionServer(NodeEndpoint(i), zmq_context));
+      peer_clients.push_back(io::CreateTransactionClient(hosts, zmq_context));
+      loopback_clients.emplace_back(new io::TransactionClient(zmq_context));
+      loopback_clients.back()->addConnection(NodeEndpoint(i));
+      modules.push_back(BlockchainModule::Create(*servers.back(), *peer_clients.back(),
+                                                 *loopback_clients.back(), *keys, prior,
+                                                 options->mode, *contexts[i], options->block_size));
+    }
+
+    std::vector<std::thread> node_threads;
+    for (auto& module : modules) {
+      BlockchainModule* bcm = module.get();
+      node_threads.emplace_back([bcm]() {
+        try {
+          bcm->start();
+        } catch (const std::exception& e) {
+          LOG_FATAL << FormatException(&e, "devv-shard-sim node");
+        }
+      });
+    }
+
+    // Announced transactions that are not final yet
+    std::mutex pending_mutex;
+    std::map<Signature, sim_clock::time_point> pending;
+    std::set<Hash> seen_blocks;
+    sim_clock::time_point last_final;
+
+    ChainState observer_state;
+    std::vector<std::string> node_endpoints;
+    for (unsigned int i = 0; i < options->num_nodes; ++i) {
+      node_endpoints.push_back(NodeEndpoint(i));
+    }
+    auto observer = io::CreateTransactionClient(node_endpoints, zmq_context);
+    observer->attachCallback([&](DevvMessageUniquePtr p) {
+      if (p->message_type != eMessageType::FINAL_BLOCK) {
+        return;
+      }
+      auto now = sim_clock::now();
+      try {
+        if (IsCompactBlockData(p->data)) {
+          p->data = DecodeCompactBlocks(p->data);
+        }
+        InputBuffer buffer(p->data);
+        FinalBlock block(FinalBlock::Create(buffer, observer_state));
+        std::lock_guard<std::mutex> guard(pending_mutex);
+        // every node may publish the block, count it once
+        if (!seen_blocks.insert(DevvHash(p->data)).second) {
+          return;
+        }
+        blocks_final.add();
+        for (auto const& tx : block.getTransactions()) {
+          auto it = pending.find(tx->getSignature());
+          if (it == pending.end()) {
+            continue;
+          }
+          finality.record(std::chrono::duration_cast<std::chrono::milliseconds>(now - it->second).count());
+          txs_final.add();
+          pending.erase(it);
+          last_final = now;
+        }
+      } catch (const std::exception& e) {
+        blocks_unreadable.add();
+        LOG_WARNING << FormatException(&e, "FINAL_BLOCK");
+      }
+    });
+    observer->listenTo(shard_context.get_shard_uri());
+    observer->startClient();
+
+    // Give the subscriptions time to propagate (ZMQ drops messages until they do)
+    std::this_thread::sleep_for(std::chrono::seconds(options->start_delay));
+
+    LOG_INFO << "Simulating " << options->num_nodes << " nodes, block size " << options->block_size
+             << ", max wait " << options->max_wait << "ms, " << options->tx_count << " transactions"
+             << (options->rate > 0 ? " at " + std::to_string(options->rate) + " tx/s" : "");
+
+    auto start = sim_clock::now();
+    size_t announced = 0;
+    uint64_t message_index = 0;
+    for (auto& batch : batches) {
+      if (options->rate > 0) {
+        std::this_thread::sleep_until(start + std::chrono::microseconds(
+            static_cast<int64_t>(announced * 1000000 / options->rate)));
+      }
+      auto send_time = sim_clock::now();
+      {
+        std::lock_guard<std::mutex> guard(pending_mutex);
+        for (auto const& sig : batch.signatures) {
+          pending[sig] = send_time;
+        }
+      }
+      auto announce_msg = std::make_unique<DevvMessage>(shard_context.get_shard_uri(),
+                                                        TRANSACTION_ANNOUNCEMENT,
+                                                        batch.data,
+                                                        message_index++);
+      announcer->queueMessage(std::move(announce_msg));
+      announced += batch.signatures.size();
+    }
+    auto announce_end = sim_clock::now();
+
+    // Wait for every transaction to be final
+    auto deadline = start + std::chrono::seconds(options->timeout);
+    while (sim_clock::now() < deadline) {
+      {
+        std::lock_guard<std::mutex> guard(pending_mutex);
+        if (pending.empty()) {
+          break;
+        }
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    observer->stopClient();
+    announcer->stopServer();
+    for (auto& module : modules) {
+      module->shutdown();
+    }
+    for (auto& thread : node_threads) {
+      thread.join();
+    }
+
+    size_t not_final = 0;
+    double final_secs = 0;
+    {
+      std::lock_guard<std::mutex> guard(pending_mutex);
+      not_final = pending.size();
+      if (last_final > start) {
+        final_secs = std::chrono::duration<double>(last_final - start).count();
+      }
+    }
+    double announce_secs = std::chrono::duration<double>(announce_end - start).count();
+    uint64_t final_txs = txs_final.value();
+    uint64_t final_blocks = blocks_final.value();
+
+    std::stringstream summary;
+    summary << "Shard simulation finished:\n"
+            << "  nodes:        " << options->num_nodes << "\n"
+            << "  block size:   " << options->block_size << "\n"
+            << "  max wait:     " << options->max_wait << "ms\n"
+            << "  target lat.:  " << options->target_latency << "ms\n"
+            << "  announced:    " << announced << " transactions in " << announce_secs << "s\n"
+            << "  final:        " << final_txs << " transactions in " << final_blocks << " blocks in "
+            << final_secs << "s (" << (not_final) << " not final, "
+            << blocks_unreadable.value() << " unreadable blocks)\n"
+            << "  throughput:   " << (final_secs > 0 ? final_txs / final_secs : 0) << " tx/s, "
+            << (final_secs > 0 ? final_blocks / final_secs : 0) << " blocks/s\n"
+            << "  finality ms:  p50 " << finality.quantile(0.5) << " p90 " << finality.quantile(0.9)
+            << " p99 " << finality.quantile(0.99) << " max " << finality.max() << "\n";
+    LOG_INFO << summary.str();
+    std::cout << summary.str();
+    if (options->metrics_interval > 0) {
+      metrics_reporter.report();
+    }
+
+    return (true);
+  } catch (const std::exception& e) {
+    std::exception_ptr p = std::current_exception();
+    std::string err("");
+    err += (p ? p.__cxa_exception_type()->name() : "null");
+    LOG_FATAL << "Error: " + err << std::endl;
+    std::cerr << err << std::endl;
+    return (false);
+  }
+}
+
+std::unique_ptr<struct sim_options> ParseSimOptions(int argc, char** argv) {
+
+  namespace po = boost::program_options;
+
+  std::unique_ptr<sim_options> options(new sim_options());
+  std::vector<std::string> config_filenames;
+
+  try {
+    po::options_description general("General Options\n\
+" + std::string(argv[0]) + " [OPTIONS] \n\
+\n\
+Runs a shard of validators in this process, announces a fixed set \n\
+of transactions to it and reports throughput and time-to-finality.\n\
+\nAllowed options");
+    general.add_options()
+        ("help,h", "produce help message")
+        ("version,v", "print version string")
+        ("config", po::value(&config_filenames), "Config file where options may be specified (can be specified more than once)")
+        ;
+
+    po::options_description behavior("Shard Options");
+    behavior.add_options()
+        ("mode", po::value<std::string>(), "Devv mode (T1|T2)")
+        ("num-nodes", po::value<unsigned int>(), "Number of validators in the shard (default 3)")
+        ("shard-index", po::value<unsigned int>(), "Index of the simulated shard (default 1)")
+        ("batch-size", po::value<unsigned int>(), "Maximum transactions per block (default 10000)")
+        ("max-wait", po::value<unsigned int>(), "Milliseconds to wait for a full block (default 0)")
+        ("target-latency", po::value<unsigned int>(), "Milliseconds to finality that block sizes adapt to (default 0, fixed size)")
+        ("inn-keys", po::value<std::string>(), "Path to INN key file (default test keys)")
+        ("node-keys", po::value<std::string>(), "Path to Node key file (default test keys)")
+        ("wallet-keys", po::value<std::string>(), "Path to Wallet key file (default test keys)")
+        ("key-pass", po::value<std::string>(), "Password for private keys")
+        ;
+
+    po::options_description load("Load Options");
+    load.add_options()
+        ("tx-count", po::value<size_t>(), "Number of transactions to announce (default 10000)")
+        ("announce-size", po::value<unsigned int>(), "Transactions per announcement (default 100)")
+        ("rate", po::value<double>(), "Transactions per second (default 0, as fast as possible)")
+        ("timeout", po::value<unsigned int>(), "Seconds to wait for every transaction to be final (default 120)")
+        ("start-delay", po::value<unsigned int>(), "Seconds to wait for the nodes to connect (default 1)")
+        ("num-threads", po::value<unsigned int>(), "Number of threads generating transactions (0 for one per core)")
+        ("tx-amount", po::value<uint64_t>(), "Maximum number of coins in a transfer (default 10)")
+        ("seed", po::value<uint64_t>(), "Seed of the nonces and random choices (default 0)")
+        ("metrics-file", po::value<std::string>(), "File the metrics are written to (Prometheus text format)")
+        ("metrics-interval", po::value<unsigned int>(), "Seconds between metrics reports (0 disables reporting)")
+        ;
+
+    po::options_description all_options;
+    all_options.add(general);
+    all_options.add(behavior);
+    all_options.add(load);
+
+    po::variables_map vm;
+    po::store(po::command_line_parser(argc, argv).
+                  options(all_options).
+                  run(),
+              vm);
+
+    if (vm.count("help")) {
+      std::cout << all_options;
+      return nullptr;
+    }
+
+    if(vm.count("config") > 0)
+    {
+      config_filenames = vm["config"].as<std::vector<std::string> >();
+
+      for(size_t i = 0; i < config_filenames.size(); ++i)
+      {
+        std::ifstream ifs(config_filenames[i].c_str());
+        if(ifs.fail())
+        {
+          LOG_ERROR << "Error opening config file: " << config_filenames[i];
+          return nullptr;
+        }
+        po::store(po::parse_config_file(ifs, all_options), vm);
+      }
+    }
+
+    po::store(po::parse_command_line(argc, argv, all_options), vm);
+    po::notify(vm);
+
+    if (vm.count("mode")) {
+      std::string mode = vm["mode"].as<std::string>();
+      if (mode == "T1") {
+        options->mode = T1;
+      } else if (mode == "T2") {
+        options->mode = T2;
+      } else {
+        LOG_WARNING << "unknown mode: " << mode;
+      }
+      LOG_INFO << "mode: " << options->mode;
+    } else {
+      LOG_INFO << "mode was not set (default to T2).";
+    }
+
+    if (vm.count("num-nodes")) {
+      options->num_nodes = vm["num-nodes"].as<unsigned int>();
+    }
+    if (options->num_nodes < 1) {
+      LOG_ERROR << "num-nodes must be at least 1";
+      return nullptr;
+    }
+    LOG_INFO << "Nodes: " << options->num_nodes;
+
+    if (vm.count("shard-index")) {
+      options->shard_index = vm["shard-index"].as<unsigned int>();
+    }
+    LOG_INFO << "Shard index: " << options->shard_index;
+
+    if (vm.count("batch-size")) {
+      options->block_size = vm["batch-size"].as<unsigned int>();
+    }
+    LOG_INFO << "Batch size: " << options->block_size;
+
+    if (vm.count("max-wait")) {
+      options->max_wait = vm["max-wait"].as<unsigned int>();
+    }
+    LOG_INFO << "Max wait: " << options->max_wait << "ms";
+
+    if (vm.count("target-latency")) {
+      options->target_latency = vm["target-latency"].as<unsigned int>();
+    }
+    LOG_INFO << "Target latency: " << options->target_latency << "ms";
+
+    if (vm.count("inn-keys")) {
+      options->inn_keys = vm["inn-keys"].as<std::string>();
+      LOG_INFO << "INN keys file: " << options->inn_keys;
+    } else {
+      LOG_INFO << "INN keys file was not set (default to test keys).";
+    }
+
+    if (vm.count("node-keys")) {
+      options->node_keys = vm["node-keys"].as<std::string>();
+      LOG_INFO << "Node keys file: " << options->node_keys;
+    } else {
+      LOG_INFO << "Node keys file was not set (default to test keys).";
+    }
+
+    if (vm.count("wallet-keys")) {
+      options->wallet_keys = vm["wallet-keys"].as<std::string>();
+      LOG_INFO << "Wallet keys file: " << options->wallet_keys;
+    } else {
+      LOG_INFO << "Wallet keys file was not set (default to test keys).";
+    }
+
+    if (vm.count("key-pass")) {
+      options->key_pass = vm["key-pass"].as<std::string>();
+    }
+
+    if (vm.count("tx-count")) {
+      options->tx_count = vm["tx-count"].as<size_t>();
+    }
+    LOG_INFO << "Transactions: " << options->tx_count;
+
+    if (vm.count("announce-size")) {
+      options->announce_size = vm["announce-size"].as<unsigned int>();
+    }
+    LOG_INFO << "Announce size: " << options->announce_size;
+
+    if (vm.count("rate")) {
+      options->rate = vm["rate"].as<double>();
+      LOG_INFO << "Rate: " << options->rate << " tx/s";
+    }
+
+    if (vm.count("timeout")) {
+      options->timeout = vm["timeout"].as<unsigned int>();
+    }
+    LOG_INFO << "Timeout: " << options->timeout << "s";
+
+    if (vm.count("start-delay")) {
+      options->start_delay = vm["start-delay"].as<unsigned int>();
+    }
+    LOG_INFO << "Start delay: " << options->start_delay << "s";
+
+    if (vm.count("num-threads")) {
+      options->num_threads = vm["num-threads"].as<unsigned int>();
+      LOG_INFO << "Generator threads: " << options->num_threads;
+    }
+
+    if (vm.count("tx-amount")) {
+      options->tx_amount = vm["tx-amount"].as<uint64_t>();
+    }
+    LOG_INFO << "Transaction amount: " << options->tx_amount;
+
+    if (vm.count("seed")) {
+      options->seed = vm["seed"].as<uint64_t>();
+    }
+    LOG_INFO << "Seed: " << options->seed;
+
+    if (vm.count("metrics-file")) {
+      options->metrics_file = vm["metrics-file"].as<std::string>();
+      LOG_INFO << "Metrics file: " << options->metrics_file;
+    }
+
+    if (vm.count("metrics-interval")) {
+      options->metrics_interval = vm["metrics-interval"].as<unsigned int>();
+      LOG_INFO << "Metrics interval: " << options->metrics_interval;
+    }
+
+  }
+  catch(std::exception& e) {
+    LOG_ERROR << "error: " << e.what();
+    return nullptr;
+  }
+
+  return options;
+}
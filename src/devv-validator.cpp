@@ -12,6 +12,7 @@
 
 #include "common/argument_parser.h"
 #include "common/devv_context.h"
+#include "common/metrics.h"
 #include "concurrency/ValidatorController.h"
 #include "modules/BlockchainModule.h"
 #include "io/message_service.h"
@@ -33,6 +34,8 @@ int main(int argc, char* argv[])
 
     init_log(lg_context);
 
+    MetricsReporter metrics_reporter(options->metrics_file, options->metrics_interval);
+
     zmq::context_t zmq_context(1);
 
     DevvContext devv_context(options->node_index
@@ -43,6 +46,16 @@ int main(int argc, char* argv[])
                                 , options->key_pass
                                 , options->batch_size
                                 , options->max_wait);
+    devv_context.set_block_encoding(options->block_encoding);
+    devv_context.set_thin_blocks(options->thin_blocks);
+    devv_context.set_key_load_threads(options->key_load_threads);
+    devv_context.set_verify_keys(options->verify_keys);
+    devv_context.set_key_cache_dir(options->key_cache_dir);
+    devv_context.set_pool_max_txs(options->pool_max_txs);
+    devv_context.set_pool_max_bytes(options->pool_max_bytes);
+    devv_context.set_pool_tx_ttl_ms(options->pool_tx_ttl_ms);
+    devv_context.set_min_block_txs(options->min_block_txs);
+    devv_context.set_target_latency_ms(options->target_latency_ms);
     KeyRing keys(devv_context);
     ChainState prior;
 
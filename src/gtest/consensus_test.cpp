@@ -4,6 +4,11 @@
  * @copywrite  2018 Devvio Inc
  */
 
+#include <chrono>
+#include <thread>
+
+#include <boost/filesystem.hpp>
+
 #include "gtest/gtest.h"
 
 #include "primitives/Summary.h"
@@ -12,9 +17,14 @@
 #include "primitives/Transfer.h"
 #include "primitives/json_interface.h"
 
+#include "consensus/block_size_controller.h"
+#include "consensus/chain_state_view.h"
 #include "consensus/chainstate.h"
+#include "consensus/transaction_index.h"
 #include "consensus/UnrecordedTransactionPool.h"
 #include "consensus/tier2_message_handlers.h"
+#include "concurrency/TransactionGenerator.h"
+#include "gtest/test_tools.h"
 
 namespace Devv {
 namespace {
@@ -75,6 +85,10 @@ TEST_F(ChainStateTest, addCoin_0) {
   chain_state.addCoin(coin);
 
   EXPECT_EQ(chain_state.getStateMap().size(), 1);
+  EXPECT_EQ(chain_state.getAmount(10, keys_.getWalletAddr(0)), 10);
+  // a known address without this coin type holds none of it
+  EXPECT_EQ(chain_state.getAmount(2, keys_.getWalletAddr(0)), 0);
+  EXPECT_EQ(chain_state.getAmount(10, keys_.getWalletAddr(1)), 0);
 }
 
 /*
@@ -314,7 +328,7 @@ class TestProposalHandler : public TestHandler {
                         context_,
                         *keys_,
                         final_chain_,
-                        utx_pool_ptr_->get_transaction_creation_manager(),
+                        *utx_pool_ptr_,
                         completion_cb0_);
   }
 
@@ -358,7 +372,7 @@ typedef std::unique_ptr<TestProposalHandler> TestProposalHandlerPtr;
                         context_,
                         *keys_,
                         final_chain_,
-                        utx_pool_ptr_->get_transaction_creation_manager(), halt_cb);
+                        *utx_pool_ptr_, halt_cb);
   }
 
   void handleValidationBlock(DevvMessageUniquePtr message) {
@@ -653,6 +667,40 @@ TEST_F(UnrecordedTransactionPoolTest, validate_0) {
   EXPECT_TRUE(valid);
 }
 
+TEST_F(UnrecordedTransactionPoolTest, validate_parallel) {
+  std::vector<TransactionPtr> tx_vector;
+  tx_vector.push_back(CreateInnTransaction(keys_, 100));
+  utx_pool_ptr_->addTransactions(tx_vector, keys_);
+  auto proposal = createTestProposal();
+  TransactionCreationManager& tcm = utx_pool_ptr_->get_transaction_creation_manager();
+
+  InputBuffer buffer(proposal);
+  ProposedBlock to_validate(ProposedBlock::Create(buffer, chain_state_, keys_, tcm));
+  AddValidators(to_validate, keys_, 16, t2_context_);
+  EXPECT_EQ(to_validate.getNumValidations(), 17);
+  // four workers, so the checks run in parallel on any machine
+  TransactionCreationManager workers(eAppMode::T2, 4);
+  EXPECT_TRUE(to_validate.validate(keys_));
+  EXPECT_TRUE(to_validate.validate(keys_, workers));
+
+  // a validator that signed other data invalidates the block either way
+  InputBuffer tampered_buffer(proposal);
+  ProposedBlock tampered(ProposedBlock::Create(tampered_buffer, chain_state_, keys_, tcm));
+  AddValidators(tampered, keys_, 8, t2_context_);
+  std::vector<byte> other = {'o', 't', 'h', 'e', 'r'};
+  Validation forged(Validation::Create());
+  forged.addValidation(keys_.getNodeAddr(2), SignBinary(keys_.getNodeKey(2), DevvHash(other)));
+  std::vector<byte> data(tampered.getPrevHash().begin(), tampered.getPrevHash().end());
+  std::vector<byte> pairs(forged.getCanonical());
+  data.insert(data.end(), pairs.begin(), pairs.end());
+  // validation messages carry at least two pairs
+  data.insert(data.end(), pairs.begin(), pairs.end());
+  InputBuffer forged_buffer(data);
+  tampered.checkValidationData(forged_buffer, t2_context_);
+  EXPECT_EQ(tampered.getNumValidations(), 10);
+  EXPECT_FALSE(tampered.validate(keys_));
+  EXPECT_FALSE(tampered.validate(keys_, workers));
+}
 
 TEST_F(UnrecordedTransactionPoolTest, validate_1) {
   auto t2x = CreateInnTransaction(keys_, 100);
@@ -763,7 +811,7 @@ TEST_F(UnrecordedTransactionPoolTest, finalize_inn_tx) {
                       sign_context,
                       keys_,
                       proposal_chain_,
-                      utx_pool_ptr_->get_transaction_creation_manager(), cb);
+                      *utx_pool_ptr_, cb);
 }
 
 TEST_F(UnrecordedTransactionPoolTest, finalize_tx_1) {
@@ -804,7 +852,7 @@ auto propose_msg =
 
 DevvMessageCallback cb = [this](DevvMessageUniquePtr p) { this->handleValidationBlock(std::move(p)); };
 DevvContext sign_context(2, 1, Devv::eAppMode::T2, "", "", "");
-HandleProposalBlock(std::move(propose_msg), sign_context, keys_, proposal_chain_, utx_pool_ptr_->get_transaction_creation_manager(), cb);
+HandleProposalBlock(std::move(propose_msg), sign_context, keys_, proposal_chain_, *utx_pool_ptr_, cb);
 }
 
 TEST_F(UnrecordedTransactionPoolTest, DISABLED_proposal_stream_0) {
@@ -825,5 +873,759 @@ TEST_F(UnrecordedTransactionPoolTest, DISABLED_proposal_stream_0) {
   EXPECT_EQ(proposal, proposal2.getCanonical());
 }
 
+TEST_F(UnrecordedTransactionPoolTest, thinProposal_0) {
+  auto t2x = CreateInnTransaction(keys_, 100);
+
+  std::vector<TransactionPtr> inn_tx_vector;
+  inn_tx_vector.push_back(std::move(t2x));
+
+  utx_pool_ptr_->addTransactions(inn_tx_vector, keys_);
+
+  auto proposal = createTestProposal();
+  auto thin = utx_pool_ptr_->getThinProposal(t2_context_.get_current_node());
+
+  EXPECT_TRUE(IsThinBlockData(thin));
+  EXPECT_FALSE(IsThinBlockData(proposal));
+  EXPECT_LT(thin.size(), proposal.size());
+
+  ThinBlock thin_block(DecodeThinBlock(thin));
+  EXPECT_EQ(thin_block.kind, ThinProposedBlock);
+  EXPECT_EQ(thin_block.origin, t2_context_.get_current_node());
+  EXPECT_EQ(thin_block.txs.size(), 1);
+
+  std::vector<byte> canonical;
+  std::vector<TransactionPtr> verified;
+  auto missing = utx_pool_ptr_->ReconstructThinBlock(thin_block, keys_, canonical, verified);
+  EXPECT_TRUE(missing.empty());
+  EXPECT_EQ(canonical, proposal);
+
+  InputBuffer buffer(canonical);
+  ProposedBlock to_validate(ProposedBlock::Create(buffer, chain_state_, verified));
+  EXPECT_EQ(to_validate.getCanonical(), proposal);
+  EXPECT_TRUE(to_validate.validate(keys_));
+}
+
+TEST_F(UnrecordedTransactionPoolTest, thinProposal_missing) {
+  auto t2x = CreateInnTransaction(keys_, 100);
+  Signature sig = t2x->getSignature();
+
+  std::vector<TransactionPtr> inn_tx_vector;
+  inn_tx_vector.push_back(std::move(t2x));
+
+  utx_pool_ptr_->addTransactions(inn_tx_vector, keys_);
+
+  auto proposal = createTestProposal();
+  ThinBlock thin_block(DecodeThinBlock(utx_pool_ptr_->getThinProposal(0)));
+
+  // A peer that has not seen the transaction yet
+  UnrecordedTransactionPool peer_pool(chain_state_, eAppMode::T2, 100);
+  std::vector<byte> canonical;
+  std::vector<TransactionPtr> verified;
+  auto missing = peer_pool.ReconstructThinBlock(thin_block, keys_, canonical, verified);
+  ASSERT_EQ(missing.size(), 1);
+  EXPECT_EQ(missing.at(0), sig);
+
+  ThinBlockRequest request;
+  request.kind = thin_block.kind;
+  request.block_id = thin_block.getBlockId();
+  request.requester = 2;
+  request.sigs = missing;
+  ThinBlockRequest decoded(DecodeThinBlockRequest(EncodeThinBlockRequest(request)));
+  EXPECT_EQ(decoded.block_id, request.block_id);
+  EXPECT_EQ(decoded.requester, 2);
+  EXPECT_EQ(decoded.sigs, missing);
+
+  // The proposer answers with the missing transaction inline
+  std::set<Signature> inline_txs(decoded.sigs.begin(), decoded.sigs.end());
+  Hash other_hash = {};
+  EXPECT_TRUE(utx_pool_ptr_->getThinProposal(other_hash, 0, inline_txs).empty());
+  auto response = utx_pool_ptr_->getThinProposal(decoded.block_id, 0, inline_txs);
+  ThinBlock complete(DecodeThinBlock(response));
+  missing = peer_pool.ReconstructThinBlock(complete, keys_, canonical, verified);
+  EXPECT_TRUE(missing.empty());
+  EXPECT_EQ(canonical, proposal);
+}
+
+TEST_F(UnrecordedTransactionPoolTest, thinFinalBlock_0) {
+  auto t2x = CreateInnTransaction(keys_, 100);
+
+  std::vector<TransactionPtr> inn_tx_vector;
+  inn_tx_vector.push_back(std::move(t2x));
+
+  utx_pool_ptr_->addTransactions(inn_tx_vector, keys_);
+
+  auto proposal = createTestProposal();
+  InputBuffer proposal_buffer(proposal);
+  ProposedBlock proposed(ProposedBlock::Create(proposal_buffer,
+                                               chain_state_,
+                                               keys_,
+                                               utx_pool_ptr_->get_transaction_creation_manager()));
+  FinalBlock final_block(proposed);
+  std::vector<byte> final_canonical(final_block.getCanonical());
+
+  ThinBlock thin_block(DecodeThinBlock(EncodeThinBlock(final_block, 1)));
+  EXPECT_EQ(thin_block.kind, ThinFinalBlock);
+  EXPECT_EQ(thin_block.getBlockId(), final_block.getMerkleRoot());
+
+  std::vector<byte> canonical;
+  std::vector<TransactionPtr> verified;
+  auto missing = utx_pool_ptr_->ReconstructThinBlock(thin_block, keys_, canonical, verified);
+  EXPECT_TRUE(missing.empty());
+  EXPECT_EQ(canonical, final_canonical);
+
+  InputBuffer buffer(canonical);
+  FinalBlock remote(utx_pool_ptr_->FinalizeRemoteBlock(buffer, chain_state_, keys_, verified));
+  EXPECT_EQ(remote.getCanonical(), final_canonical);
+  EXPECT_EQ(remote.getNumTransactions(), 1);
+  EXPECT_EQ(utx_pool_ptr_->numPendingTransactions(), 0);
+}
+
+TEST_F(UnrecordedTransactionPoolTest, thinFinalBlock_tampered) {
+  auto t2x = CreateInnTransaction(keys_, 100);
+
+  std::vector<TransactionPtr> inn_tx_vector;
+  inn_tx_vector.push_back(std::move(t2x));
+
+  utx_pool_ptr_->addTransactions(inn_tx_vector, keys_);
+
+  auto proposal = createTestProposal();
+  InputBuffer proposal_buffer(proposal);
+  ProposedBlock proposed(ProposedBlock::Create(proposal_buffer,
+                                               chain_state_,
+                                               keys_,
+                                               utx_pool_ptr_->get_transaction_creation_manager()));
+  FinalBlock final_block(proposed);
+
+  ThinBlock thin_block(DecodeThinBlock(EncodeThinBlock(final_block, 1)));
+  // corrupt the block time, which the merkle root covers
+  thin_block.header.at(9) ^= 0xFF;
+
+  std::vector<byte> canonical;
+  std::vector<TransactionPtr> verified;
+  auto missing = utx_pool_ptr_->ReconstructThinBlock(thin_block, keys_, canonical, verified);
+  EXPECT_TRUE(missing.empty());
+
+  InputBuffer buffer(canonical);
+  EXPECT_THROW({ FinalBlock tampered(buffer, chain_state_, keys_, verified); }, DeserializationError);
+
+  std::vector<byte> truncated(EncodeThinBlock(final_block, 1));
+  truncated.resize(FinalBlock::MinSize());
+  EXPECT_THROW(DecodeThinBlock(truncated), DeserializationError);
+}
+
+TEST_F(UnrecordedTransactionPoolTest, awaitRemoteBlock_0) {
+  Hash merkle = DevvHash({'m', 'e', 'r', 'k', 'l', 'e'});
+  std::vector<byte> missing_request = {1};
+  std::vector<byte> full_request = {2};
+  utx_pool_ptr_->AwaitRemoteBlock(merkle, 1, missing_request, full_request);
+  EXPECT_TRUE(utx_pool_ptr_->IsAwaitingRemoteBlock());
+  EXPECT_TRUE(utx_pool_ptr_->IsAwaitedRemoteBlock(merkle));
+
+  // the deferred blocks are bounded
+  for (size_t i = 0; i < kMAX_DEFERRED_BLOCKS; ++i) {
+    EXPECT_TRUE(utx_pool_ptr_->DeferRemoteBlock({static_cast<byte>(i)}));
+  }
+  EXPECT_FALSE(utx_pool_ptr_->DeferRemoteBlock({0}));
+
+  // not retried before the timeout
+  uint32_t origin = 0;
+  size_t attempt = 0;
+  std::vector<byte> request;
+  EXPECT_FALSE(utx_pool_ptr_->NextRemoteBlockRequest(60000, 2, origin, attempt, request));
+  EXPECT_FALSE(RetryMissingTransactions(t2_context_, *utx_pool_ptr_, [](DevvMessageUniquePtr) {}));
+
+  // the missing transactions are asked from the origin, then the whole block
+  EXPECT_TRUE(utx_pool_ptr_->NextRemoteBlockRequest(0, 2, origin, attempt, request));
+  EXPECT_EQ(origin, 1);
+  EXPECT_EQ(attempt, 1);
+  EXPECT_EQ(request, missing_request);
+  EXPECT_TRUE(utx_pool_ptr_->NextRemoteBlockRequest(0, 2, origin, attempt, request));
+  EXPECT_EQ(request, missing_request);
+  EXPECT_TRUE(utx_pool_ptr_->NextRemoteBlockRequest(0, 2, origin, attempt, request));
+  EXPECT_EQ(attempt, 3);
+  EXPECT_EQ(request, full_request);
+
+  auto deferred = utx_pool_ptr_->ReleaseRemoteBlocks();
+  EXPECT_EQ(deferred.size(), kMAX_DEFERRED_BLOCKS);
+  EXPECT_EQ(deferred.front(), std::vector<byte>({0}));
+  EXPECT_FALSE(utx_pool_ptr_->IsAwaitingRemoteBlock());
+  EXPECT_FALSE(utx_pool_ptr_->NextRemoteBlockRequest(0, 2, origin, attempt, request));
+}
+
+TEST_F(UnrecordedTransactionPoolTest, transactionIndex_0) {
+  auto t2x = CreateInnTransaction(keys_, 100);
+  Signature sig = t2x->getSignature();
+
+  std::vector<TransactionPtr> inn_tx_vector;
+  inn_tx_vector.push_back(std::move(t2x));
+
+  utx_pool_ptr_->addTransactions(inn_tx_vector, keys_);
+
+  auto proposal = createTestProposal();
+  InputBuffer proposal_buffer(proposal);
+  ProposedBlock proposed(ProposedBlock::Create(proposal_buffer,
+                                               chain_state_,
+                                               keys_,
+                                               utx_pool_ptr_->get_transaction_creation_manager()));
+  FinalBlock final_block(proposed);
+
+  boost::filesystem::path path = boost::filesystem::temp_directory_path()
+      / boost::filesystem::unique_path("devv-index-%%%%-%%%%.idx");
+  {
+    TransactionIndex index(path.string());
+    EXPECT_EQ(index.getNextHeight(), 0);
+    EXPECT_TRUE(index.addBlock(0, final_block));
+    EXPECT_FALSE(index.addBlock(0, final_block));
+  }
+
+  // a record cut short by a crash is dropped on load
+  {
+    std::ofstream file(path.string(), std::ios::out | std::ios::binary | std::ios::app);
+    file.write("\x40\x00\x00\x00\x01", 5);
+  }
+
+  TransactionIndex index(path.string());
+  EXPECT_EQ(index.getNextHeight(), 1);
+  EXPECT_EQ(index.size(), 1);
+  TxLocation location;
+  EXPECT_TRUE(index.findTransaction(sig, location));
+  EXPECT_EQ(location.height, 0);
+  EXPECT_EQ(location.position, 0);
+  EXPECT_FALSE(index.findTransaction(Signature(), location));
+  EXPECT_EQ(index.findAddress(keys_.getInnAddr(), 0, UINT32_MAX).size(), 1);
+  EXPECT_TRUE(index.findAddress(keys_.getInnAddr(), 1, UINT32_MAX).empty());
+
+  EXPECT_FALSE(index.addBlock(3, final_block));
+  EXPECT_EQ(index.getNextHeight(), 1);
+  EXPECT_TRUE(index.addBlock(1, final_block));
+  EXPECT_EQ(index.findAddress(keys_.getInnAddr(), 0, UINT32_MAX).size(), 2);
+  EXPECT_EQ(TransactionIndex(path.string()).getNextHeight(), 2);
+  boost::filesystem::remove(path);
+}
+
+TEST_F(UnrecordedTransactionPoolTest, verifiedCache_0) {
+  auto t2x = CreateInnTransaction(keys_, 100);
+
+  std::vector<TransactionPtr> inn_tx_vector;
+  inn_tx_vector.push_back(std::move(t2x));
+
+  auto& verified = utx_pool_ptr_->get_transaction_creation_manager().get_verified_cache();
+  EXPECT_EQ(verified.size(), 0);
+  utx_pool_ptr_->addTransactions(inn_tx_vector, keys_);
+  EXPECT_EQ(verified.size(), 1);
+
+  // Transactions parsed from a proposal are found in the cache
+  auto proposal = createTestProposal();
+  InputBuffer buffer(proposal);
+  ProposedBlock proposed(ProposedBlock::Create(buffer,
+                                               chain_state_,
+                                               keys_,
+                                               utx_pool_ptr_->get_transaction_creation_manager()));
+  ASSERT_EQ(proposed.getTransactions().size(), 1);
+  EXPECT_TRUE(verified.contains(*proposed.getTransactions().at(0)));
+  EXPECT_EQ(verified.size(), 1);
+  EXPECT_TRUE(proposed.validate(keys_));
+}
+
+TEST_F(UnrecordedTransactionPoolTest, verifiedCache_evict) {
+  auto first = CreateInnTransaction(keys_, 100);
+  auto second = CreateInnTransaction(keys_, 200);
+
+  VerifiedTransactionCache verified(1);
+  EXPECT_TRUE(verified.setIsSound(*first, keys_));
+  EXPECT_TRUE(verified.contains(*first));
+  EXPECT_TRUE(verified.setIsSound(*second, keys_));
+  EXPECT_TRUE(verified.contains(*second));
+  EXPECT_FALSE(verified.contains(*first));
+  EXPECT_EQ(verified.size(), 1);
+}
+
+TEST_F(UnrecordedTransactionPoolTest, duplicates_0) {
+  auto t2x = CreateInnTransaction(keys_, 100);
+  std::vector<byte> serial(t2x->getCanonical());
+
+  size_t tx_size = 0;
+  InputBuffer peek(serial);
+  EXPECT_EQ(Tier2Transaction::PeekSignature(peek, tx_size), t2x->getSignature());
+  EXPECT_EQ(tx_size, serial.size());
+  EXPECT_EQ(peek.getOffset(), 0);
+
+  Counter& pending = MetricsRegistry::Get().counter("utx_pool.duplicates.pending");
+  Counter& finalized = MetricsRegistry::Get().counter("utx_pool.duplicates.finalized");
+  uint64_t pending_before = pending.value();
+  uint64_t finalized_before = finalized.value();
+
+  EXPECT_TRUE(utx_pool_ptr_->addTransactions(serial, keys_));
+  EXPECT_TRUE(utx_pool_ptr_->addTransactions(serial, keys_));
+  EXPECT_EQ(utx_pool_ptr_->numPendingTransactions(), 1);
+  EXPECT_EQ(pending.value(), pending_before + 1);
+
+  auto proposal = createTestProposal();
+  InputBuffer proposal_buffer(proposal);
+  ProposedBlock proposed(ProposedBlock::Create(proposal_buffer,
+                                               chain_state_,
+                                               keys_,
+                                               utx_pool_ptr_->get_transaction_creation_manager()));
+  FinalBlock final_block(proposed);
+  std::vector<byte> final_canonical(final_block.getCanonical());
+  InputBuffer final_buffer(final_canonical);
+  utx_pool_ptr_->FinalizeRemoteBlock(final_buffer, chain_state_, keys_);
+  EXPECT_EQ(utx_pool_ptr_->numPendingTransactions(), 0);
+
+  // a finalized Transaction is not added again
+  EXPECT_TRUE(utx_pool_ptr_->addTransactions(serial, keys_));
+  EXPECT_EQ(utx_pool_ptr_->numPendingTransactions(), 0);
+  EXPECT_EQ(finalized.value(), finalized_before + 1);
+}
+
+TEST_F(UnrecordedTransactionPoolTest, chainStateView_0) {
+  std::vector<TransactionPtr> inn_tx_vector;
+  inn_tx_vector.push_back(CreateInnTransaction(keys_, 100));
+  utx_pool_ptr_->addTransactions(inn_tx_vector, keys_);
+
+  auto proposal = createTestProposal();
+  InputBuffer proposal_buffer(proposal);
+  ProposedBlock proposed(ProposedBlock::Create(proposal_buffer,
+                                               chain_state_,
+                                               keys_,
+                                               utx_pool_ptr_->get_transaction_creation_manager()));
+  std::vector<byte> final_canonical(FinalBlock(proposed).getCanonical());
+
+  ChainStateView view;
+  EXPECT_EQ(view.getHead(), ChainStateView::GetGenesisHash());
+  ChainStateView::StatePtr genesis_state = view.getSnapshot();
+  EXPECT_EQ(genesis_state->size(), 0);
+
+  InputBuffer final_buffer(final_canonical);
+  auto block = std::make_shared<FinalBlock>(final_buffer, *genesis_state, keys_,
+                                            utx_pool_ptr_->get_transaction_creation_manager());
+  EXPECT_TRUE(view.push_back(block));
+  EXPECT_EQ(view.getHeight(), 1);
+  EXPECT_EQ(view.getHead(), DevvHash(final_canonical));
+
+  // snapshots share the state of the block, older snapshots are unchanged
+  ChainStateView::StatePtr state = view.getSnapshot();
+  EXPECT_EQ(state.get(), &block->getChainState());
+  EXPECT_GT(state->size(), 0);
+  EXPECT_EQ(genesis_state->size(), 0);
+  EXPECT_EQ(view.getAmount(0, keys_.getWalletAddr(0)),
+            block->getChainState().getAmount(0, keys_.getWalletAddr(0)));
+
+  // the same block from another validator is not applied again
+  EXPECT_FALSE(view.push_back(block));
+  EXPECT_EQ(view.getHeight(), 1);
+
+  // a block read without its state gets the transfers applied
+  ChainStateView stateless_view;
+  InputBuffer stateless_buffer(final_canonical);
+  FinalBlock stateless(FinalBlock::Create(stateless_buffer, ChainState()));
+  EXPECT_TRUE(stateless_view.push_back(stateless));
+  EXPECT_FALSE(stateless_view.push_back(stateless));
+  EXPECT_EQ(stateless_view.getHead(), view.getHead());
+  EXPECT_EQ(stateless_view.getSnapshot()->getStateMap(), block->getChainState().getStateMap());
+
+  Blockchain chain("view-chain");
+  chain.push_back(block);
+  ChainStateView from_chain(chain);
+  EXPECT_EQ(from_chain.getHead(), view.getHead());
+  EXPECT_EQ(from_chain.getSnapshot().get(), state.get());
+}
+
+TEST_F(UnrecordedTransactionPoolTest, chainStateView_1) {
+  std::vector<TransactionPtr> inn_tx_vector;
+  inn_tx_vector.push_back(CreateInnTransaction(keys_, 100));
+  utx_pool_ptr_->addTransactions(inn_tx_vector, keys_);
+
+  auto proposal = createTestProposal();
+  InputBuffer proposal_buffer(proposal);
+  ProposedBlock proposed(ProposedBlock::Create(proposal_buffer,
+                                               chain_state_,
+                                               keys_,
+                                               utx_pool_ptr_->get_transaction_creation_manager()));
+  // three blocks with the same transfers, each following the one before
+  std::vector<std::vector<byte>> canonicals(1, FinalBlock(proposed).getCanonical());
+  const size_t prev_hash_offset = 1 + 8 + 8;
+  for (size_t i = 1; i < 3; ++i) {
+    std::vector<byte> next(canonicals.back());
+    Hash prev_hash(DevvHash(canonicals.back()));
+    std::copy(prev_hash.begin(), prev_hash.end(), next.begin() + prev_hash_offset);
+    canonicals.push_back(next);
+  }
+  std::vector<FinalBlock> blocks;
+  for (const auto& canonical : canonicals) {
+    InputBuffer buffer(canonical);
+    blocks.push_back(FinalBlock::Create(buffer, ChainState()));
+  }
+
+  ChainStateView in_order;
+  for (const auto& block : blocks) {
+    EXPECT_TRUE(in_order.push_back(block));
+  }
+
+  // later blocks wait for the missing one and are applied with it
+  ChainStateView view;
+  EXPECT_FALSE(view.push_back(blocks[2]));
+  EXPECT_FALSE(view.push_back(blocks[1]));
+  EXPECT_FALSE(view.push_back(blocks[2]));
+  EXPECT_EQ(view.getHeight(), 0);
+  EXPECT_EQ(view.getPendingCount(), 2);
+  EXPECT_EQ(view.getHead(), ChainStateView::GetGenesisHash());
+
+  EXPECT_TRUE(view.push_back(blocks[0]));
+  EXPECT_EQ(view.getHeight(), 3);
+  EXPECT_EQ(view.getPendingCount(), 0);
+  EXPECT_EQ(view.getHead(), in_order.getHead());
+  EXPECT_EQ(view.getSnapshot()->getStateMap(), in_order.getSnapshot()->getStateMap());
+
+  // copies of applied blocks are not kept
+  EXPECT_FALSE(view.push_back(blocks[0]));
+  EXPECT_FALSE(view.push_back(blocks[1]));
+  EXPECT_EQ(view.getPendingCount(), 0);
+  EXPECT_EQ(view.getHeight(), 3);
+}
+
+TEST_F(UnrecordedTransactionPoolTest, packing_0) {
+  ChainState prior;
+  prior.addCoin(SmartCoin(keys_.getWalletAddr(1), 0, 100));
+  prior.addCoin(SmartCoin(keys_.getWalletAddr(2), 0, 100));
+
+  uint64_t nonce = 0;
+  auto exchange = [this, &nonce](size_t from, size_t to, int64_t amount) {
+    std::vector<Transfer> xfers;
+    xfers.push_back(Transfer(keys_.getWalletAddr(from), 0, -amount, 0));
+    xfers.push_back(Transfer(keys_.getWalletAddr(to), 0, amount, 0));
+    std::vector<byte> nonce_bin;
+    Uint64ToBin(++nonce, nonce_bin);
+    return std::make_unique<Tier2Transaction>(eOpType::Exchange, xfers, nonce_bin,
+                                              keys_.getWalletKey(from), keys_);
+  };
+
+  // wallet 1 can only afford one of its two 60 coin transfers,
+  // wallet 0 spends coins that wallet 1 sends it and wallet 3 has no coins
+  std::vector<TransactionPtr> txs;
+  txs.push_back(exchange(1, 0, 60));
+  txs.push_back(exchange(1, 0, 60));
+  txs.push_back(exchange(1, 0, 10));
+  txs.push_back(exchange(0, 2, 50));
+  txs.push_back(exchange(3, 0, 5));
+  Signature funded_spend = txs[3]->getSignature();
+  std::vector<TransactionPtr> copies;
+  for (const auto& tx : txs) {
+    copies.push_back(tx->clone());
+  }
+
+  auto packed = [this, &prior](UnrecordedTransactionPool& pool) {
+    Hash prev_hash = DevvHash({'G', 'e', 'n', 'e', 's', 'i', 's'});
+    EXPECT_TRUE(pool.proposeBlock(prev_hash, prior, keys_, t2_context_));
+    std::vector<byte> proposal(pool.getProposal());
+    InputBuffer buffer(proposal);
+    ProposedBlock proposed(ProposedBlock::Create(buffer, prior, keys_,
+                                                 pool.get_transaction_creation_manager()));
+    std::vector<Signature> sigs;
+    for (const auto& tx : proposed.getTransactions()) {
+      sigs.push_back(tx->getSignature());
+    }
+    return sigs;
+  };
+
+  utx_pool_ptr_->addTransactions(txs, keys_);
+  std::vector<Signature> sigs(packed(*utx_pool_ptr_));
+  ASSERT_EQ(sigs.size(), 3);
+  EXPECT_EQ(sigs.back(), funded_spend);
+  // the invalid Transaction is dropped, the conflicting one waits for a later block
+  EXPECT_EQ(utx_pool_ptr_->numPendingTransactions(), 4);
+
+  // the same Transactions are packed in the same order
+  UnrecordedTransactionPool other_pool(chain_state_, eAppMode::T2, 100);
+  other_pool.addTransactions(copies, keys_);
+  EXPECT_EQ(packed(other_pool), sigs);
+}
+
+TEST_F(UnrecordedTransactionPoolTest, limits_0) {
+  std::vector<byte> first_serial;
+  std::vector<byte> last_serial;
+  size_t tx_size = 0;
+  Counter& evicted = MetricsRegistry::Get().counter("utx_pool.evicted");
+  uint64_t evicted_before = evicted.value();
+
+  // sustained overload, the pool never holds more than its limit
+  utx_pool_ptr_->setLimits(10, kDEFAULT_POOL_MAX_BYTES, 0);
+  for (int batch = 0; batch < 10; ++batch) {
+    std::vector<TransactionPtr> txs;
+    for (int i = 0; i < 5; ++i) {
+      auto t2x = CreateInnTransaction(keys_, 100);
+      tx_size = t2x->getCanonical().size();
+      if (first_serial.empty()) {
+        first_serial = t2x->getCanonical();
+      }
+      last_serial = t2x->getCanonical();
+      txs.push_back(std::move(t2x));
+    }
+    utx_pool_ptr_->addTransactions(txs, keys_);
+    EXPECT_LE(utx_pool_ptr_->numPendingTransactions(), 10);
+    EXPECT_EQ(utx_pool_ptr_->getPoolBytes(), utx_pool_ptr_->numPendingTransactions() * tx_size);
+  }
+  EXPECT_EQ(utx_pool_ptr_->numPendingTransactions(), 10);
+  EXPECT_EQ(evicted.value(), evicted_before + 40);
+
+  // the oldest Transactions were evicted, the newest are still pending
+  Counter& pending = MetricsRegistry::Get().counter("utx_pool.duplicates.pending");
+  uint64_t pending_before = pending.value();
+  EXPECT_TRUE(utx_pool_ptr_->addTransactions(last_serial, keys_));
+  EXPECT_EQ(pending.value(), pending_before + 1);
+  EXPECT_TRUE(utx_pool_ptr_->addTransactions(first_serial, keys_));
+  EXPECT_EQ(pending.value(), pending_before + 1);
+  EXPECT_EQ(utx_pool_ptr_->numPendingTransactions(), 10);
+
+  // a byte limit evicts the same way
+  utx_pool_ptr_->setLimits(10, 3 * tx_size, 0);
+  EXPECT_EQ(utx_pool_ptr_->numPendingTransactions(), 3);
+  EXPECT_EQ(utx_pool_ptr_->getPoolBytes(), 3 * tx_size);
+}
+
+TEST_F(UnrecordedTransactionPoolTest, expiry_0) {
+  utx_pool_ptr_->setLimits(kDEFAULT_POOL_MAX_TXS, kDEFAULT_POOL_MAX_BYTES, 1);
+  std::vector<TransactionPtr> txs;
+  txs.push_back(CreateInnTransaction(keys_, 100));
+  txs.push_back(CreateInnTransaction(keys_, 200));
+  utx_pool_ptr_->addTransactions(txs, keys_);
+  EXPECT_EQ(utx_pool_ptr_->numPendingTransactions(), 2);
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  EXPECT_EQ(utx_pool_ptr_->GarbageCollect(), 2);
+  EXPECT_EQ(utx_pool_ptr_->numPendingTransactions(), 0);
+  EXPECT_EQ(utx_pool_ptr_->getPoolBytes(), 0);
+  EXPECT_EQ(utx_pool_ptr_->GarbageCollect(), 0);
+
+  // expired Transactions are not proposed
+  txs.clear();
+  txs.push_back(CreateInnTransaction(keys_, 300));
+  utx_pool_ptr_->addTransactions(txs, keys_);
+  std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  EXPECT_THROW(createTestProposal(), std::runtime_error);
+  EXPECT_EQ(utx_pool_ptr_->numPendingTransactions(), 0);
+}
+
+TEST_F(UnrecordedTransactionPoolTest, loadReport_0) {
+  utx_pool_ptr_->setLimits(4, kDEFAULT_POOL_MAX_BYTES, 0);
+  std::vector<TransactionPtr> txs;
+  for (int i = 0; i < 4; ++i) {
+    txs.push_back(CreateInnTransaction(keys_, 100));
+  }
+  utx_pool_ptr_->addTransactions(txs, keys_);
+
+  LoadReport report(utx_pool_ptr_->getLoadReport());
+  report.node_index = 2;
+  report.queue_depth = 7;
+  EXPECT_EQ(report.pending_txs, 4);
+  EXPECT_EQ(report.max_txs, 4);
+  EXPECT_EQ(report.pending_bytes, utx_pool_ptr_->getPoolBytes());
+  EXPECT_DOUBLE_EQ(report.getOccupancy(), 1.0);
+
+  LoadReport decoded(DecodeLoadReport(EncodeLoadReport(report)));
+  EXPECT_EQ(decoded.node_index, 2);
+  EXPECT_EQ(decoded.pending_txs, report.pending_txs);
+  EXPECT_EQ(decoded.pending_bytes, report.pending_bytes);
+  EXPECT_EQ(decoded.max_txs, report.max_txs);
+  EXPECT_EQ(decoded.max_bytes, report.max_bytes);
+  EXPECT_EQ(decoded.queue_depth, 7);
+  EXPECT_THROW(DecodeLoadReport(std::vector<byte>(3, 0)), DeserializationError);
+
+  // a full pool asks for the longest delay, an idle node for none
+  EXPECT_EQ(RetryAfterMillis(decoded), kLOAD_MAX_RETRY_MS);
+  EXPECT_EQ(RetryAfterMillis(0.5, 0), 0);
+  EXPECT_EQ(RetryAfterMillis(kLOAD_BUSY_OCCUPANCY, 0), kLOAD_MIN_RETRY_MS);
+  EXPECT_GT(RetryAfterMillis(0, kLOAD_BUSY_QUEUE_DEPTH * 3 / 2), kLOAD_MIN_RETRY_MS);
+  EXPECT_LT(RetryAfterMillis(0, kLOAD_BUSY_QUEUE_DEPTH * 3 / 2), kLOAD_MAX_RETRY_MS);
+}
+
+TEST_F(UnrecordedTransactionPoolTest, metrics_0) {
+  auto t2x = CreateInnTransaction(keys_, 100);
+
+  std::vector<TransactionPtr> inn_tx_vector;
+  inn_tx_vector.push_back(std::move(t2x));
+
+  Counter& added = MetricsRegistry::Get().counter("utx_pool.added");
+  uint64_t added_before = added.value();
+  utx_pool_ptr_->addTransactions(inn_tx_vector, keys_);
+  EXPECT_EQ(added.value(), added_before + 1);
+  EXPECT_EQ(MetricsRegistry::Get().gauge("utx_pool.pending").value(), 1);
+
+  Histogram histogram;
+  EXPECT_EQ(histogram.quantile(0.5), 0);
+  for (uint64_t i = 1; i <= 100; ++i) {
+    histogram.record(i);
+  }
+  EXPECT_EQ(histogram.count(), 100);
+  EXPECT_EQ(histogram.sum(), 5050);
+  EXPECT_EQ(histogram.max(), 100);
+  EXPECT_GE(histogram.quantile(0.5), 50);
+  EXPECT_LE(histogram.quantile(0.5), 63);
+  EXPECT_EQ(histogram.quantile(1), 100);
+
+  std::string text(MetricsRegistry::Get().getText());
+  EXPECT_NE(text.find("devv_utx_pool_pending 1"), std::string::npos);
+}
+
+/**
+ * Simulates a shard whose validation round trip grows with the block size
+ * @param sizer - the controller under test
+ * @param rate - Transactions arriving per millisecond
+ * @param rounds - the number of blocks to simulate
+ * @param[in, out] pending - the number of Transactions in the pool
+ * @return the latency, wait plus round trip, of each block
+ */
+std::vector<double> SimulateBlocks(BlockSizeController& sizer, double rate, size_t rounds, double& pending) {
+  std::vector<double> latencies;
+  for (size_t round = 0; round < rounds; ++round) {
+    double wait = sizer.getWaitMillis(static_cast<size_t>(pending));
+    pending += rate * wait;
+    size_t block_txs = std::min(sizer.getTargetTxs(), static_cast<size_t>(pending));
+    double rtt = 20 + 0.01 * block_txs;
+    pending += rate * rtt - block_txs;
+    sizer.recordValidation(block_txs, rtt);
+    latencies.push_back(wait + rtt);
+  }
+  return latencies;
+}
+
+TEST(BlockSizeControllerTest, converge_0) {
+  BlockSizeBounds bounds;
+  bounds.min_txs = 100;
+  bounds.max_txs = 20000;
+  bounds.max_wait_ms = 50;
+  bounds.target_latency_ms = 100;
+  BlockSizeController sizer(bounds);
+  EXPECT_TRUE(sizer.isAdaptive());
+  EXPECT_EQ(sizer.getTargetTxs(), 20000);
+
+  // overload, the round trip settles around the target with 8000 transaction blocks
+  double pending = 50000;
+  std::vector<double> busy(SimulateBlocks(sizer, 200, 300, pending));
+  for (size_t round = 200; round < busy.size(); ++round) {
+    EXPECT_GT(busy[round], 70);
+    EXPECT_LT(busy[round], 120);
+  }
+  EXPECT_GE(sizer.getTargetTxs(), 4000);
+  EXPECT_LE(sizer.getTargetTxs(), 10000);
+  EXPECT_EQ(sizer.getWaitMillis(20000), 0);
+
+  // light load, blocks wait for transactions but stay within the latency budget
+  pending = 0;
+  std::vector<double> light(SimulateBlocks(sizer, 20, 100, pending));
+  for (size_t round = 10; round < light.size(); ++round) {
+    EXPECT_LE(light[round], 110);
+  }
+  EXPECT_LE(sizer.getWaitMillis(0), bounds.max_wait_ms);
+  EXPECT_GT(sizer.getWaitMillis(0), 0);
+
+  // fast validation of full blocks grows them up to the upper bound
+  for (int round = 0; round < 100; ++round) {
+    sizer.recordValidation(sizer.getTargetTxs(), 10);
+  }
+  EXPECT_EQ(sizer.getTargetTxs(), bounds.max_txs);
+
+  // slow validation never shrinks blocks below the lower bound
+  for (int round = 0; round < 100; ++round) {
+    sizer.recordValidation(sizer.getTargetTxs(), 1000);
+  }
+  EXPECT_EQ(sizer.getTargetTxs(), bounds.min_txs);
+}
+
+TEST(BlockSizeControllerTest, static_0) {
+  BlockSizeBounds bounds;
+  bounds.max_txs = 500;
+  bounds.max_wait_ms = 30;
+  BlockSizeController sizer(bounds);
+  EXPECT_FALSE(sizer.isAdaptive());
+  sizer.recordValidation(500, 1000);
+  sizer.recordValidation(10, 1);
+  EXPECT_EQ(sizer.getTargetTxs(), 500);
+  EXPECT_EQ(sizer.getWaitMillis(499), 30);
+  EXPECT_EQ(sizer.getWaitMillis(500), 0);
+}
+
+TEST(TransactionGenerator, threads_0) {
+  auto make = [](size_t index, std::vector<byte>& out) {
+    Uint64ToBin(TransactionGenerator::Random(42, index), out);
+  };
+
+  std::stringstream single;
+  TransactionGenerator one_thread(1, 7);
+  EXPECT_EQ(one_thread.generate(100, make, &single), 800);
+
+  std::stringstream several;
+  TransactionGenerator four_threads(4, 7);
+  EXPECT_EQ(four_threads.generate(100, make, &several), 800);
+  EXPECT_EQ(single.str(), several.str());
+
+  std::vector<byte> bin(Str2Bin(several.str()));
+  EXPECT_EQ(BinToUint64(bin, 99 * 8), TransactionGenerator::Random(42, 99));
+
+  auto fail = [](size_t index, std::vector<byte>&) {
+    if (index == 50) {
+      throw std::runtime_error("generate failed");
+    }
+  };
+  EXPECT_THROW(four_threads.generate(100, fail, nullptr), std::runtime_error);
+}
+
+TEST(WorkStealingExecutor, parallelFor_0) {
+  WorkStealingExecutor executor(4);
+  std::vector<std::atomic<int>> calls(10000);
+  executor.ParallelFor(size_t(0), calls.size(), [&](size_t i) { calls[i]++; });
+  executor.ParallelFor(size_t(100), size_t(200), [&](size_t i) { calls[i]++; }, 7);
+  for (size_t i = 0; i < calls.size(); ++i) {
+    EXPECT_EQ(calls[i], (i >= 100 && i < 200) ? 2 : 1);
+  }
+
+  // ranges submitted from a worker run on the same workers
+  std::atomic<size_t> nested(0);
+  executor.ParallelFor(0, 16, [&](int) {
+    executor.ParallelFor(0, 64, [&](int) { nested++; }, 4);
+  }, 1);
+  EXPECT_EQ(nested, 16 * 64);
+
+  std::atomic<size_t> done(0);
+  auto fail = [&](size_t i) {
+    if (i == 500) {
+      throw std::runtime_error("range failed");
+    }
+    done++;
+  };
+  EXPECT_THROW(executor.ParallelFor(size_t(0), size_t(1000), fail, 10), std::runtime_error);
+  EXPECT_EQ(done, 990);
+
+  WorkStealingExecutor serial(0);
+  size_t sum = 0;
+  serial.ParallelFor(1, 101, [&](int i) { sum += i; });
+  EXPECT_EQ(sum, 5050);
+}
+
+TEST(ThreadPool, parallelFor_0) {
+  std::vector<std::atomic<int>> calls(1000);
+  ThreadPool::ParallelFor(size_t(0), calls.size(), [&](size_t i) { calls[i]++; });
+
+  // no more than max_threads calls at once
+  std::atomic<int> active(0);
+  std::atomic<int> most_active(0);
+  ThreadPool::ParallelFor(size_t(0), calls.size(), [&](size_t i) {
+    int now = ++active;
+    int most = most_active;
+    while (now > most && !most_active.compare_exchange_weak(most, now)) {}
+    std::this_thread::sleep_for(std::chrono::microseconds(10));
+    calls[i]++;
+    active--;
+  }, 2);
+  EXPECT_LE(most_active, 2);
+  for (const auto& count : calls) {
+    EXPECT_EQ(count, 2);
+  }
+
+  size_t sum = 0;
+  ThreadPool::ParallelFor(1, 101, [&](int i) { sum += i; }, 1);
+  EXPECT_EQ(sum, 5050);
+}
+
 } // namespace
 } // namespace Devv
@@ -5,6 +5,7 @@
  */
 
 #include "gtest/gtest.h"
+#include "common/hash_batch.h"
 #include "common/ossladapter.h"
 #include "primitives/Address.h"
 
@@ -90,6 +91,35 @@ TEST(ossladapter, GenerateAndVerify_1) {
 }
 
 
+TEST(ossladapter, DevvHashBatch_0) {
+  // lengths around the SHA-256 padding boundaries, with runs long enough for the multi-buffer path
+  std::vector<std::vector<byte>> msgs;
+  for (size_t len : {0, 1, 55, 56, 63, 64, 119, 120, 200}) {
+    for (size_t n = 0; n < 11; ++n) {
+      std::vector<byte> msg(len);
+      for (size_t i = 0; i < len; ++i) {
+        msg[i] = static_cast<byte>(i * 31 + n * 7 + len);
+      }
+      msgs.push_back(msg);
+    }
+  }
+  std::vector<const std::vector<byte>*> pointers;
+  for (auto const& msg : msgs) {
+    pointers.push_back(&msg);
+  }
+
+  std::vector<Hash> batch(DevvHashBatch(msgs));
+  std::vector<Hash> multi(DevvHashBatchMultiBuffer(pointers));
+  ASSERT_EQ(batch.size(), msgs.size());
+  ASSERT_EQ(multi.size(), msgs.size());
+  for (size_t i = 0; i < msgs.size(); ++i) {
+    EXPECT_EQ(batch[i], DevvHash(msgs[i]));
+    EXPECT_EQ(multi[i], DevvHash(msgs[i]));
+  }
+  EXPECT_EQ(ToHex(DevvHashBatch(std::vector<std::vector<byte>>(1)).at(0)),
+            "E3B0C44298FC1C149AFBF4C8996FB92427AE41E4649B934CA495991B7852B855");
+}
+
 } // namespace
 
 int main(int argc, char **argv) {
@@ -299,6 +299,79 @@ TEST_F(PbufTransactionTest, createTransaction_signature_validation) {
   }
 }
 
+TEST_F(PbufTransactionTest, oracleRegistry_0) {
+  OracleRegistry& registry = OracleRegistry::Get();
+  EXPECT_EQ(registry.size(), 10);
+
+  const OracleHandler* handler = registry.find(dcash::GetOracleName());
+  ASSERT_NE(handler, nullptr);
+  EXPECT_EQ(handler->name, dcash::GetOracleName());
+  EXPECT_EQ(registry.getId(dcash::GetOracleName()), handler->id);
+  EXPECT_EQ(registry.find(handler->id), handler);
+
+  OraclePtr oracle = handler->create("");
+  EXPECT_EQ(oracle->getOracleName(), dcash::GetOracleName());
+
+  EXPECT_EQ(registry.find("io.devv.unknown"), nullptr);
+  EXPECT_EQ(registry.getId("io.devv.unknown"), kUNKNOWN_ORACLE);
+  EXPECT_EQ(registry.find(kUNKNOWN_ORACLE), nullptr);
+}
+
+TEST_F(PbufTransactionTest, decomposeProposal_0) {
+  std::vector<byte> nonce_bin;
+  Uint64ToBin(7, nonce_bin);
+  Tier2Transaction tx(eOpType::Exchange, transfers_, nonce_bin, keys_.getWalletKey(0), keys_);
+  ChainStateView chain;
+
+  Devv::proto::Proposal proposal;
+  proposal.set_oraclename(dcash::GetOracleName());
+  proposal.set_data(Bin2Str(tx.getCanonical()));
+  std::vector<TransactionPtr> dcash_txs = DecomposeProposal(proposal, chain, keys_);
+  ASSERT_EQ(dcash_txs.size(), 1);
+  EXPECT_EQ(dcash_txs[0]->getCanonical(), tx.getCanonical());
+
+  proposal.set_oraclename(DoTransaction::GetOracleName());
+  proposal.set_data(ToHex(tx.getCanonical()));
+  std::vector<TransactionPtr> do_txs = DecomposeProposal(proposal, chain, keys_);
+  ASSERT_EQ(do_txs.size(), 1);
+  EXPECT_EQ(do_txs[0]->getCanonical(), tx.getCanonical());
+
+  proposal.set_oraclename("io.devv.unknown");
+  EXPECT_TRUE(DecomposeProposal(proposal, chain, keys_).empty());
+}
+
+TEST_F(PbufTransactionTest, deserializeEnvelope_parallel) {
+  const size_t count = kENVELOPE_PARALLEL_MIN_TXS + kENVELOPE_CHUNK_TXS / 2;
+  std::vector<Tier2Transaction> txs;
+  Devv::proto::Envelope envelope;
+  for (size_t i = 0; i < count; ++i) {
+    std::vector<byte> nonce_bin;
+    Uint64ToBin(i + 1000, nonce_bin);
+    txs.emplace_back(eOpType::Exchange, transfers_, nonce_bin, keys_.getWalletKey(0), keys_);
+    SerializeTransaction(txs.back(), *envelope.add_txs());
+  }
+  std::string serial;
+  envelope.SerializeToString(&serial);
+
+  std::vector<TransactionPtr> ptrs = DeserializeEnvelopeProtobufString(serial, keys_);
+  ASSERT_EQ(ptrs.size(), count);
+  for (size_t i = 0; i < count; ++i) {
+    EXPECT_EQ(ptrs[i]->getCanonical(), txs[i].getCanonical());
+  }
+
+  // the first invalid Transaction is reported, whichever chunk fails first
+  envelope.mutable_txs(count - 1)->set_nonce("1");
+  envelope.mutable_txs(kENVELOPE_CHUNK_TXS + 1)->mutable_xfers(1)->set_amount(8);
+  envelope.SerializeToString(&serial);
+  try {
+    DeserializeEnvelopeProtobufString(serial, keys_);
+    FAIL() << "Expected std::runtime_error";
+  }
+  catch (std::runtime_error const& err) {
+    EXPECT_EQ(err.what(), std::string("TransactionError: transaction amounts are asymmetric. (sum=-2)"));
+  }
+}
+
 } // unnamed namespace
 } // namespace Devv
 
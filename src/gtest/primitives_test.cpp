@@ -6,15 +6,20 @@
  */
 
 #include <cstdint>
+#include <fstream>
+
+#include <boost/filesystem.hpp>
 
 #include "gtest/gtest.h"
 
+#include "primitives/MerkleTree.h"
 #include "primitives/Summary.h"
 #include "primitives/Tier1Transaction.h"
 #include "primitives/Tier2Transaction.h"
 #include "primitives/Transfer.h"
 #include "primitives/json_interface.h"
 #include "primitives/block_tools.h"
+#include "primitives/block_codec.h"
 
 namespace Devv {
 namespace {
@@ -85,6 +90,38 @@ TEST(converters, UInt64ToBin_1) {
   EXPECT_EQ(i, i2);
 }
 
+TEST(converters, VarintToBin_0) {
+  std::vector<byte> buf;
+  std::vector<uint64_t> values = {0, 1, 127, 128, 16383, 16384, UINT32_MAX, UINT64_MAX};
+  for (auto i : values) {
+    VarintToBin(i, buf);
+  }
+  EXPECT_EQ(buf.at(0), 0);
+  size_t offset = 0;
+  for (auto i : values) {
+    EXPECT_EQ(i, BinToVarint(buf, offset));
+  }
+  EXPECT_EQ(offset, buf.size());
+}
+
+TEST(converters, VarintToBin_truncated) {
+  std::vector<byte> buf;
+  VarintToBin(UINT64_MAX, buf);
+  EXPECT_EQ(buf.size(), kMAX_VARINT_SIZE);
+  buf.pop_back();
+  size_t offset = 0;
+  EXPECT_THROW(BinToVarint(buf, offset), std::out_of_range);
+}
+
+TEST(converters, ZigZag_0) {
+  std::vector<int64_t> values = {0, -1, 1, -2, INT64_MAX, INT64_MIN};
+  for (auto i : values) {
+    EXPECT_EQ(i, ZigZagDecode(ZigZagEncode(i)));
+  }
+  EXPECT_EQ(ZigZagEncode(-1), 1);
+  EXPECT_EQ(ZigZagEncode(1), 2);
+}
+
 /**
  *
  * InputBufferTest
@@ -559,6 +596,83 @@ TEST(ossl, SignBinary_0) {
   EXPECT_EQ(s1.size(), 106);
 }
 
+TEST(KeyRing, LoadWallets_0) {
+  namespace fs = boost::filesystem;
+  fs::path dir = fs::temp_directory_path() / fs::unique_path();
+  fs::create_directories(dir);
+  std::string wallet_file = (dir / "wallets.pem").string();
+  {
+    std::ofstream out(wallet_file);
+    for (size_t i = 0; i < kADDRs.size(); ++i) {
+      out << kADDRs.at(i) << kADDR_KEYs.at(i) << "\n";
+    }
+  }
+
+  Devv::DevvContext context(0, 0, Devv::eAppMode::T1, "", "", "password");
+  context.set_key_load_threads(4);
+  context.set_key_cache_dir(dir.string());
+
+  // decode the PEM keys and write the cache
+  Devv::KeyRing keys(context);
+  EXPECT_TRUE(keys.LoadWallets(wallet_file, "password"));
+  ASSERT_EQ(keys.CountWallets(), kADDRs.size());
+
+  size_t cache_files = 0;
+  for (auto& entry : fs::directory_iterator(dir)) {
+    if (entry.path().extension() == kKEY_CACHE_EXTENSION) {
+      ++cache_files;
+      EXPECT_EQ(fs::status(entry.path()).permissions(), fs::owner_read | fs::owner_write);
+    }
+  }
+  EXPECT_EQ(cache_files, 1);
+
+  // load the same keys from the cache
+  Devv::KeyRing cached(context);
+  EXPECT_TRUE(cached.LoadWallets(wallet_file, "password"));
+  ASSERT_EQ(cached.CountWallets(), kADDRs.size());
+
+  std::vector<byte> msg = {'t', 'e', 's', 't'};
+  Hash hash = DevvHash(msg);
+  for (size_t i = 0; i < kADDRs.size(); ++i) {
+    EXPECT_EQ(keys.getWalletAddr(i), cached.getWalletAddr(i));
+    EXPECT_EQ(cached.getWalletAddr(i).getHexString(), kADDRs.at(i));
+    Signature sig = SignBinary(cached.getWalletKey(i), hash);
+    EXPECT_TRUE(VerifyByteSig(keys.getWalletKey(i), hash, sig));
+  }
+
+  // a modified cache is rejected and the keys are decoded from the key file,
+  // also when the loaded keys are not checked
+  for (auto& entry : fs::directory_iterator(dir)) {
+    if (entry.path().extension() == kKEY_CACHE_EXTENSION) {
+      std::fstream cache(entry.path().string(), std::ios::in | std::ios::out | std::ios::binary);
+      cache.seekg(0, std::ios::end);
+      std::streamoff middle = cache.tellg() / 2;
+      char c = 0;
+      cache.seekg(middle);
+      cache.get(c);
+      cache.seekp(middle);
+      cache.put(static_cast<char>(c ^ 0xFF));
+    }
+  }
+  Devv::DevvContext unchecked(context);
+  unchecked.set_verify_keys(false);
+  Devv::KeyRing corrupt(unchecked);
+  EXPECT_TRUE(corrupt.LoadWallets(wallet_file, "password"));
+  ASSERT_EQ(corrupt.CountWallets(), kADDRs.size());
+  for (size_t i = 0; i < kADDRs.size(); ++i) {
+    EXPECT_EQ(corrupt.getWalletAddr(i).getHexString(), kADDRs.at(i));
+    Signature sig = SignBinary(corrupt.getWalletKey(i), hash);
+    EXPECT_TRUE(VerifyByteSig(keys.getWalletKey(i), hash, sig));
+  }
+
+  // a wrong password ignores the cache
+  Devv::KeyRing wrong(context);
+  wrong.LoadWallets(wallet_file, "wrong");
+  EXPECT_EQ(wrong.CountWallets(), 0);
+
+  fs::remove_all(dir);
+}
+
 /**
  *
  * Tier1TransactionTest
@@ -1162,6 +1276,180 @@ TEST(Primitives, getCanonical0) {
   EXPECT_EQ(final_test.getCanonical(), final_id.getCanonical());
 }
 
+/**
+ * Create the canonical form of a FinalBlock holding an INN transaction
+ * and an exchange between the first two wallets
+ */
+std::vector<byte> CreateTestFinalBlock(const KeyRing& keys, uint64_t nonce) {
+  std::vector<byte> nonce_bin;
+  Uint64ToBin(nonce, nonce_bin);
+
+  std::vector<Transfer> inn_xfers;
+  inn_xfers.push_back(Transfer(keys.getInnAddr(), 0, -200, 0));
+  inn_xfers.push_back(Transfer(keys.getWalletAddr(0), 0, 100, 0));
+  inn_xfers.push_back(Transfer(keys.getWalletAddr(1), 0, 100, 0));
+
+  std::vector<Transfer> xfers;
+  xfers.push_back(Transfer(keys.getWalletAddr(0), 0, -10, 0));
+  xfers.push_back(Transfer(keys.getWalletAddr(1), 0, 10, 0));
+
+  std::vector<TransactionPtr> txs;
+  txs.push_back(std::make_unique<Tier2Transaction>(eOpType::Create, inn_xfers, nonce_bin,
+                                                   keys.getKey(keys.getInnAddr()), keys));
+  txs.push_back(std::make_unique<Tier2Transaction>(eOpType::Exchange, xfers, nonce_bin,
+                                                   keys.getWalletKey(0), keys));
+
+  Summary summary = Summary::Create();
+  Validation validation = Validation::Create();
+  ChainState state;
+  Hash prev_hash = DevvHash(nonce_bin);
+  ProposedBlock proposal(prev_hash, txs, summary, validation, state, keys);
+  proposal.signBlock(keys, 0);
+  proposal.signBlock(keys, 1);
+  FinalBlock final_block(proposal);
+  return final_block.getCanonical();
+}
+
+TEST_F(Tier2TransactionTest, compactBlock_0) {
+  std::vector<byte> canonical = CreateTestFinalBlock(keys_, 1001);
+  std::vector<byte> compact = EncodeCompactBlocks(canonical, false);
+
+  EXPECT_TRUE(IsCompactBlockData(compact));
+  EXPECT_FALSE(IsCompactBlockData(canonical));
+  EXPECT_LT(compact.size(), canonical.size());
+  EXPECT_EQ(canonical, DecodeCompactBlocks(compact));
+
+  InputBuffer buffer(DecodeCompactBlocks(compact));
+  ChainState state;
+  FinalBlock block(FinalBlock::Create(buffer, state));
+  EXPECT_EQ(block.getNumTransactions(), 2);
+  EXPECT_EQ(block.getCanonical(), canonical);
+}
+
+TEST_F(Tier2TransactionTest, compactBlock_deflate) {
+  std::vector<byte> canonical = CreateTestFinalBlock(keys_, 1001);
+  std::vector<byte> more = CreateTestFinalBlock(keys_, 1002);
+  canonical.insert(canonical.end(), more.begin(), more.end());
+
+  std::vector<byte> compact = EncodeCompactBlocks(canonical, false);
+  std::vector<byte> deflated = EncodeBlocks(canonical, DeflatedBlocks);
+  EXPECT_LE(deflated.size(), compact.size());
+  EXPECT_EQ(canonical, DecodeCompactBlocks(compact));
+  EXPECT_EQ(canonical, DecodeCompactBlocks(deflated));
+  EXPECT_EQ(canonical, EncodeBlocks(canonical, CanonicalBlocks));
+}
+
+TEST_F(Tier2TransactionTest, compactBlock_tail) {
+  std::vector<byte> canonical = CreateTestFinalBlock(keys_, 1001);
+  canonical.push_back(7);
+  canonical.push_back(0);
+  std::vector<byte> compact = EncodeCompactBlocks(canonical, true);
+  EXPECT_EQ(canonical, DecodeCompactBlocks(compact));
+
+  std::vector<byte> garbage(50, 0xFF);
+  EXPECT_EQ(garbage, DecodeCompactBlocks(EncodeCompactBlocks(garbage, false)));
+}
+
+TEST_F(Tier2TransactionTest, compactBlock_offset) {
+  std::vector<byte> canonical = CreateTestFinalBlock(keys_, 1001);
+  std::vector<byte> message;
+  Uint64ToBin(12, message);
+  std::vector<byte> compact = EncodeCompactBlocks(canonical, false);
+  message.insert(message.end(), compact.begin(), compact.end());
+  EXPECT_TRUE(IsCompactBlockData(message, kUINT64_SIZE));
+  EXPECT_EQ(canonical, DecodeCompactBlocks(message, kUINT64_SIZE));
+}
+
+TEST_F(Tier2TransactionTest, compactBlock_malformed) {
+  std::vector<byte> canonical = CreateTestFinalBlock(keys_, 1001);
+  std::vector<byte> compact = EncodeCompactBlocks(canonical, false);
+  std::vector<byte> truncated(compact.begin(), compact.begin() + compact.size() / 2);
+  EXPECT_THROW(DecodeCompactBlocks(truncated), DeserializationError);
+  EXPECT_THROW(DecodeCompactBlocks(canonical), DeserializationError);
+
+  std::vector<byte> deflated = EncodeCompactBlocks(canonical, true);
+  deflated.resize(deflated.size() - 4);
+  EXPECT_THROW(DecodeCompactBlocks(deflated), DeserializationError);
+}
+
+TEST_F(Tier2TransactionTest, compactBlock_oversized) {
+  // a few bytes claiming a 1 GiB body are rejected without allocating it
+  std::vector<byte> bomb = {kCOMPACT_BLOCK_MARKER, kCOMPACT_BLOCK_FORMAT, kCOMPACT_BLOCK_DEFLATE};
+  VarintToBin(kMAX_COMPACT_BLOCK_EXPANSION, bomb);
+  bomb.insert(bomb.end(), {0x78, 0x9C, 0x03, 0x00});
+  EXPECT_THROW(DecodeCompactBlocks(bomb), DeserializationError);
+
+  // a body size larger than the data inflates to is rejected too
+  std::vector<byte> zeros(4096, 0);
+  std::vector<byte> deflated = EncodeCompactBlocks(zeros, true);
+  ASSERT_EQ(deflated[2], kCOMPACT_BLOCK_DEFLATE);
+  EXPECT_EQ(zeros, DecodeCompactBlocks(deflated));
+  size_t offset = 3;
+  uint64_t body_size = BinToVarint(deflated, offset);
+  std::vector<byte> larger(deflated.begin(), deflated.begin() + 3);
+  VarintToBin(body_size + 1, larger);
+  larger.insert(larger.end(), deflated.begin() + offset, deflated.end());
+  EXPECT_THROW(DecodeCompactBlocks(larger), DeserializationError);
+}
+
+TEST(MerkleTree, append_0) {
+  std::vector<Hash> leaves;
+  MerkleTree incremental;
+  for (uint64_t i = 0; i < 13; ++i) {
+    std::vector<byte> data;
+    Uint64ToBin(i, data);
+    leaves.push_back(MerkleTree::LeafHash(data));
+    incremental.append(leaves.back());
+    MerkleTree batch(leaves);
+    EXPECT_EQ(incremental.size(), leaves.size());
+    EXPECT_EQ(incremental.getRoot(), batch.getRoot());
+  }
+  EXPECT_EQ(MerkleTree().getRoot(), DevvHash(std::vector<byte>()));
+}
+
+TEST(MerkleTree, getProof_0) {
+  for (uint64_t count = 1; count < 12; ++count) {
+    std::vector<Hash> leaves;
+    for (uint64_t i = 0; i < count; ++i) {
+      std::vector<byte> data;
+      Uint64ToBin(i, data);
+      leaves.push_back(MerkleTree::LeafHash(data));
+    }
+    MerkleTree tree(leaves);
+    for (uint64_t i = 0; i < count; ++i) {
+      MerkleProof proof = tree.getProof(i);
+      EXPECT_TRUE(MerkleTree::VerifyProof(leaves[i], proof, tree.getRoot()));
+      if (count > 1) {
+        EXPECT_FALSE(MerkleTree::VerifyProof(leaves[(i + 1) % count], proof, tree.getRoot()));
+      }
+      if (!proof.path.empty()) {
+        proof.path[0][0] ^= 0x01;
+        EXPECT_FALSE(MerkleTree::VerifyProof(leaves[i], proof, tree.getRoot()));
+      }
+    }
+    EXPECT_THROW(tree.getProof(count), std::out_of_range);
+  }
+}
+
+TEST_F(Tier2TransactionTest, finalBlockProof_0) {
+  std::vector<byte> canonical = CreateTestFinalBlock(keys_, 1001);
+  InputBuffer buffer(canonical);
+  ChainState state;
+  FinalBlock block(FinalBlock::Create(buffer, state));
+  EXPECT_EQ(block.getVersion(), kFINAL_BLOCK_VERSION);
+  EXPECT_EQ(block.computeMerkleRoot(), block.getMerkleRoot());
+
+  for (size_t i = 0; i < block.getNumTransactions(); ++i) {
+    MerkleProof proof = block.getTransactionProof(i);
+    EXPECT_TRUE(FinalBlock::VerifyTransactionProof(block.getRawTransactions()[i], proof,
+                                                   block.getMerkleRoot()));
+    std::vector<byte> tampered(block.getRawTransactions()[i]);
+    tampered.back() ^= 0x01;
+    EXPECT_FALSE(FinalBlock::VerifyTransactionProof(tampered, proof, block.getMerkleRoot()));
+  }
+  EXPECT_THROW(block.getTransactionProof(block.getNumTransactions()), std::out_of_range);
+}
+
 } // namespace
 } // namespace Devv
 
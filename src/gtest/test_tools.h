@@ -0,0 +1,41 @@
+/*
+ * gtest/test_tools.h defines tools shared by the tests and the
+ * benchmarks for building blocks
+ *
+ * @copywrite  2018 Devvio Inc
+ */
+#pragma once
+
+#include "common/ossladapter.h"
+#include "consensus/KeyRing.h"
+#include "primitives/ProposedBlock.h"
+
+namespace Devv {
+
+/**
+ * Add the validations of count new validators to a proposal
+ * @param block the proposal
+ * @param keys (out) receives the keys of the validators
+ * @param count the number of validators
+ * @param context
+ */
+inline void AddValidators(ProposedBlock& block, KeyRing& keys, size_t count, const DevvContext& context) {
+  Hash md_hash = DevvHash(block.getSummary().getCanonical());
+  Validation validation(Validation::Create());
+  for (size_t i = 0; i < count; ++i) {
+    EC_KEY* key = GetNodeKey();
+    EC_KEY_generate_key(key);
+    char* hex = EC_POINT_point2hex(EC_KEY_get0_group(key), EC_KEY_get0_public_key(key),
+                                   POINT_CONVERSION_COMPRESSED, nullptr);
+    Address addr = keys.InsertAddress(hex, key);
+    OPENSSL_free(hex);
+    validation.addValidation(addr, SignBinary(key, md_hash));
+  }
+  std::vector<byte> data(block.getPrevHash().begin(), block.getPrevHash().end());
+  std::vector<byte> pairs(validation.getCanonical());
+  data.insert(data.end(), pairs.begin(), pairs.end());
+  InputBuffer buffer(data);
+  block.checkValidationData(buffer, context);
+}
+
+} // namespace Devv
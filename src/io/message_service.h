@@ -50,6 +50,13 @@ class TransactionServer final {
    */
   void queueMessage(DevvMessageUniquePtr message) noexcept;
 
+  /**
+   * @return the approximate number of queued messages waiting to be sent
+   */
+  size_t getQueueDepth() const {
+    return message_queue_.size();
+  }
+
   /**
    * Starts a server in a background thread
    */
@@ -0,0 +1,230 @@
+/*
+ * request_router.cpp serves request/reply clients from a pool of workers.
+ *
+ * @copywrite  2018 Devvio Inc
+ */
+#include <io/request_router.h>
+
+#include <algorithm>
+#include <map>
+#include <sstream>
+
+#include "common/logger.h"
+
+namespace Devv {
+namespace io {
+
+namespace {
+
+/// Milliseconds between checks for a shutdown request
+const int kROUTER_POLL_MS = 100;
+
+/**
+ * Receive all parts of a message.
+ * @return the parts, empty if nothing arrived before the socket timed out
+ */
+std::vector<zmq::message_t> RecvFrames(zmq::socket_t& socket, int flags = 0) {
+  std::vector<zmq::message_t> frames;
+  zmq::message_t frame;
+  if (!socket.recv(&frame, flags)) {
+    return frames;
+  }
+  bool more = frame.more();
+  frames.push_back(std::move(frame));
+  while (more) {
+    zmq::message_t next;
+    socket.recv(&next);
+    more = next.more();
+    frames.push_back(std::move(next));
+  }
+  return frames;
+}
+
+/**
+ * Send all parts of a message.
+ */
+void SendFrames(zmq::socket_t& socket, std::vector<zmq::message_t>& frames) {
+  for (size_t i = 0; i < frames.size(); ++i) {
+    socket.send(frames[i], (i + 1 < frames.size()) ? ZMQ_SNDMORE : 0);
+  }
+}
+
+} // namespace
+
+RequestRouter::RequestRouter(zmq::context_t& context,
+                             const std::string& bind_url,
+                             size_t num_workers,
+                             RequestHandler handler)
+    : bind_url_(bind_url)
+    , context_(context)
+    , num_workers_(std::max<size_t>(num_workers, 1))
+    , handler_(handler) {}
+
+std::string RequestRouter::getWorkerUrl(size_t worker) const {
+  std::stringstream url;
+  url << "inproc://devv-request-router-" << static_cast<const void*>(this) << "-" << worker;
+  return url.str();
+}
+
+void RequestRouter::startRouter() {
+  LOG_DEBUG << "Starting RequestRouter";
+  if (keep_running_) {
+    LOG_WARNING << "Attempted to start a RequestRouter that was already running";
+    return;
+  }
+  keep_running_ = true;
+  std::promise<void> bound;
+  std::future<void> bind_result = bound.get_future();
+  broker_thread_ = std::make_unique<std::thread>([this, &bound]() { this->runBroker(bound); });
+  try {
+    bind_result.get();
+  } catch (...) {
+    keep_running_ = false;
+    broker_thread_->join();
+    broker_thread_ = nullptr;
+    throw;
+  }
+}
+
+void RequestRouter::stopRouter() {
+  if (keep_running_) {
+    LOG_DEBUG << "Stopping RequestRouter";
+    keep_running_ = false;
+    if (broker_thread_) {
+      broker_thread_->join();
+      broker_thread_ = nullptr;
+    }
+    LOG_INFO << "Stopped RequestRouter";
+  }
+}
+
+void RequestRouter::runBroker(std::promise<void>& bound) noexcept {
+  bool started = false;
+  try {
+    MTR_META_THREAD_NAME("RequestRouter::runBroker() Thread");
+    zmq::socket_t frontend(context_, ZMQ_ROUTER);
+    LOG_INFO << "RequestRouter: Binding bind_url_ '" << bind_url_ << "'";
+    frontend.bind(bind_url_);
+
+    // inproc endpoints must be bound before the workers connect
+    std::vector<std::unique_ptr<zmq::socket_t>> backends;
+    for (size_t i = 0; i < num_workers_; ++i) {
+      backends.push_back(std::make_unique<zmq::socket_t>(context_, ZMQ_PAIR));
+      backends.back()->bind(getWorkerUrl(i));
+    }
+    for (size_t i = 0; i < num_workers_; ++i) {
+      worker_threads_.emplace_back([this, i]() { this->runWorker(i); });
+    }
+    started = true;
+    bound.set_value();
+
+    // the backends come first, the frontend is only polled while a worker is idle
+    std::vector<zmq::pollitem_t> items;
+    for (auto& backend : backends) {
+      items.push_back({static_cast<void*>(*backend), 0, ZMQ_POLLIN, 0});
+    }
+    items.push_back({static_cast<void*>(frontend), 0, ZMQ_POLLIN, 0});
+    std::deque<size_t> idle;
+    for (size_t i = 0; i < num_workers_; ++i) {
+      idle.push_back(i);
+    }
+    // the client each busy worker is serving, empty for idle workers
+    std::vector<std::string> worker_clients(num_workers_);
+    // requests of clients that are being served, in the order they arrived
+    std::map<std::string, std::deque<std::vector<zmq::message_t>>> waiting;
+
+    while (keep_running_) {
+      zmq::poll(items.data(), idle.empty() ? num_workers_ : items.size(), kROUTER_POLL_MS);
+      for (size_t i = 0; i < num_workers_; ++i) {
+        if (items[i].revents & ZMQ_POLLIN) {
+          std::vector<zmq::message_t> reply = RecvFrames(*backends[i]);
+          SendFrames(frontend, reply);
+          // the next request of the same client only starts after this reply
+          auto next = waiting.find(worker_clients[i]);
+          if (next == waiting.end()) {
+            worker_clients[i].clear();
+            idle.push_back(i);
+            continue;
+          }
+          SendFrames(*backends[i], next->second.front());
+          next->second.pop_front();
+          if (next->second.empty()) {
+            waiting.erase(next);
+          }
+        }
+      }
+      if (!idle.empty() && (items[num_workers_].revents & ZMQ_POLLIN)) {
+        // the first frame is the identity of the client
+        std::vector<zmq::message_t> request = RecvFrames(frontend);
+        if (request.size() > 1) {
+          std::string client(static_cast<const char*>(request.front().data()), request.front().size());
+          if (std::find(worker_clients.begin(), worker_clients.end(), client) != worker_clients.end()) {
+            waiting[client].push_back(std::move(request));
+          } else {
+            size_t worker = idle.front();
+            idle.pop_front();
+            worker_clients[worker] = client;
+            SendFrames(*backends[worker], request);
+          }
+        }
+      }
+      items[num_workers_].revents = 0;
+    }
+  } catch (const std::exception& e) {
+    if (started) {
+      LOG_FATAL << "EXCEPTION[RequestRouter::runBroker()]:" + std::string(e.what());
+    } else {
+      // startRouter() rethrows it to the caller
+      LOG_ERROR << "RequestRouter: failed to bind '" << bind_url_ << "': " << e.what();
+      bound.set_exception(std::current_exception());
+    }
+    keep_running_ = false;
+  }
+  for (auto& worker : worker_threads_) {
+    worker.join();
+  }
+  worker_threads_.clear();
+}
+
+void RequestRouter::runWorker(size_t worker) noexcept {
+  try {
+    MTR_META_THREAD_NAME("RequestRouter::runWorker() Thread");
+    zmq::socket_t socket(context_, ZMQ_PAIR);
+    socket.setsockopt(ZMQ_RCVTIMEO, &kROUTER_POLL_MS, sizeof(kROUTER_POLL_MS));
+    socket.connect(getWorkerUrl(worker));
+
+    while (keep_running_) {
+      std::vector<zmq::message_t> frames = RecvFrames(socket);
+      if (frames.empty()) {
+        continue;
+      }
+      // the envelope frames route the reply, the last frame is the request
+      std::string request(static_cast<const char*>(frames.back().data()), frames.back().size());
+      std::string reply;
+      try {
+        reply = handler_(request);
+      } catch (const std::exception& e) {
+        LOG_ERROR << "RequestRouter: request failed: " << e.what();
+        reply = "Error: " + std::string(e.what());
+      }
+      frames.back().rebuild(reply.data(), reply.size());
+      SendFrames(socket, frames);
+    }
+  } catch (const std::exception& e) {
+    LOG_FATAL << "EXCEPTION[RequestRouter::runWorker()]:" + std::string(e.what());
+  }
+}
+
+std::unique_ptr<io::RequestRouter> CreateRequestRouter(const std::string& bind_endpoint,
+                                                       size_t num_workers,
+                                                       RequestHandler handler,
+                                                       zmq::context_t& context) {
+  std::unique_ptr<io::RequestRouter> router(new io::RequestRouter(context,
+                                                                  bind_endpoint,
+                                                                  num_workers,
+                                                                  handler));
+  return router;
+}
+
+}  // namespace io
+}  // namespace Devv
@@ -0,0 +1,129 @@
+/*
+ * request_router.h serves request/reply clients from a pool of workers.
+ *
+ * A ROUTER socket accepts requests from REQ or DEALER clients and a broker
+ * thread hands each one to an idle worker thread over an inproc socket.
+ * Requests wait in the ROUTER socket while every worker is busy, so a slow
+ * request only holds up its own worker. A client has one request in a
+ * worker at a time: a DEALER client that sends several requests at once
+ * has the later ones queued until the reply to the previous one is sent,
+ * so its replies arrive in the order of its requests while other clients
+ * are served by the other workers.
+ *
+ * @copywrite  2018 Devvio Inc
+ */
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "io/zhelpers.hpp"
+
+namespace Devv {
+
+namespace io {
+
+/// Default number of request worker threads
+static const size_t kDEFAULT_REQUEST_WORKERS = 4;
+
+/// Handles one request and returns the reply, called from the worker threads
+typedef std::function<std::string(const std::string&)> RequestHandler;
+
+class RequestRouter final {
+ public:
+  /**
+   * Constructor
+   * @param context
+   * @param bind_url - the endpoint clients connect to
+   * @param num_workers - the number of worker threads
+   * @param handler - handles each request, must be thread-safe
+   */
+  RequestRouter(zmq::context_t& context,
+                const std::string& bind_url,
+                size_t num_workers,
+                RequestHandler handler);
+
+  ~RequestRouter() {
+    /// Stop the threads if they are running
+    stopRouter();
+  }
+
+  // Disable copying
+  RequestRouter(const RequestRouter&) = delete;
+  RequestRouter& operator=(const RequestRouter&) = delete;
+
+  /**
+   * Starts the broker and worker threads
+   * @throw zmq::error_t if bind_url cannot be bound
+   */
+  void startRouter();
+
+  /**
+   * Stops the broker and worker threads, requests in progress are finished
+   */
+  void stopRouter();
+
+ private:
+  /**
+   * Forwards requests to idle workers and replies to the clients
+   * @param bound - set once the sockets are bound, or to the bind error
+   */
+  void runBroker(std::promise<void>& bound) noexcept;
+
+  /**
+   * Handles the requests forwarded to one worker
+   * @param worker - the index of the worker
+   */
+  void runWorker(size_t worker) noexcept;
+
+  /**
+   * @param worker - the index of the worker
+   * @return the inproc endpoint of a worker
+   */
+  std::string getWorkerUrl(size_t worker) const;
+
+  /// URL to bind to
+  const std::string bind_url_;
+
+  /// zmq context
+  zmq::context_t& context_;
+
+  /// Number of worker threads
+  const size_t num_workers_;
+
+  /// Called by the workers for each request
+  RequestHandler handler_;
+
+  /// Runs runBroker()
+  std::unique_ptr<std::thread> broker_thread_ = nullptr;
+
+  /// Run runWorker()
+  std::vector<std::thread> worker_threads_;
+
+  /// Set to true when the threads start and false when a shutdown is requested
+  std::atomic<bool> keep_running_{false};
+};
+
+/**
+ * Creates a router that binds to the bind_endpoint and
+ * answers requests with handler on num_workers threads
+ *
+ * @param bind_endpoint
+ * @param num_workers
+ * @param handler
+ * @param context
+ * @return
+ */
+std::unique_ptr<io::RequestRouter> CreateRequestRouter(const std::string& bind_endpoint,
+                                                       size_t num_workers,
+                                                       RequestHandler handler,
+                                                       zmq::context_t& context);
+
+}  // namespace io
+}  // namespace Devv
@@ -77,6 +77,15 @@ BlockchainModule::BlockchainModule(io::TransactionServer& server,
       validator_controller_(keys_, app_context_, prior_, final_chain_, utx_pool_, mode_)
 {
   LOG_INFO << "Hello from node: " << app_context_.get_uri() << "!!";
+  utx_pool_.setLimits(app_context_.get_pool_max_txs(),
+                      app_context_.get_pool_max_bytes(),
+                      app_context_.get_pool_tx_ttl_ms());
+  BlockSizeBounds bounds;
+  bounds.max_txs = max_tx_per_block;
+  bounds.max_wait_ms = app_context_.get_max_wait();
+  bounds.target_latency_ms = app_context_.get_target_latency_ms();
+  bounds.min_txs = bounds.target_latency_ms > 0 ? app_context_.get_min_block_txs() : max_tx_per_block;
+  utx_pool_.setBlockSizing(bounds);
 }
 
 std::unique_ptr<BlockchainModule> BlockchainModule::Create(io::TransactionServer &server,
@@ -108,10 +117,11 @@ std::unique_ptr<BlockchainModule> BlockchainModule::Create(io::TransactionServer
   auto& ic = blockchain_module_ptr->internetwork_controller_;
 
   vc.registerOutgoingCallback(outgoing_callback);
+  vc.registerQueueDepthCallback([&server]() { return server.getQueueDepth(); });
   /// The controllers contain the the algorithms, the ParallelExecutor parallelizes them
 
   blockchain_module_ptr->validator_executor_ =
-      std::make_unique<ParallelExecutor<ValidatorController>>(vc, 1);
+      std::make_unique<ParallelExecutor<ValidatorController>>(vc, 1, "validator");
   /// Attach a callback to be run in the threads
 
   blockchain_module_ptr->validator_executor_->attachCallback(
@@ -124,7 +134,7 @@ std::unique_ptr<BlockchainModule> BlockchainModule::Create(io::TransactionServer
 
   /// The controllers contain the the algorithms, the ParallelExecutor parallelizes them
   blockchain_module_ptr->consensus_executor_ =
-      std::make_unique<ParallelExecutor<ConsensusController>>(cc, 1);
+      std::make_unique<ParallelExecutor<ConsensusController>>(cc, 1, "consensus");
 
   /// Attach a callback to be run in the threads
   blockchain_module_ptr->consensus_executor_->attachCallback([&](DevvMessageUniquePtr p) {
@@ -137,7 +147,7 @@ std::unique_ptr<BlockchainModule> BlockchainModule::Create(io::TransactionServer
 
   /// The controllers contain the the algorithms, the ParallelExecutor parallelizes them
   blockchain_module_ptr->internetwork_executor_ =
-      std::make_unique<ParallelExecutor<InternetworkController>>(ic, 1);
+      std::make_unique<ParallelExecutor<InternetworkController>>(ic, 1, "internetwork");
 
   /// Attach a callback to be run in the threads
   blockchain_module_ptr->internetwork_executor_->attachCallback([&](DevvMessageUniquePtr p) {
@@ -178,6 +188,13 @@ void BlockchainModule::handleMessage(DevvMessageUniquePtr message) {
       LOG_DEBUG << "BlockchainModule::handleMessage(): push(VALID)";
       consensus_executor_->pushMessage(std::move(message));
       break;
+    case eMessageType::REQUEST_TRANSACTIONS:
+      LOG_DEBUG << "BlockchainModule::handleMessage(): push(REQUEST_TRANSACTIONS)";
+      consensus_executor_->pushMessage(std::move(message));
+      break;
+    case eMessageType::LOAD_REPORT:
+      LOG_DEBUG << "BlockchainModule::handleMessage(): ignoring LOAD_REPORT";
+      break;
     default:
       throw DevvMessageError("Unknown message type:"+std::to_string(message->message_type));
   }
@@ -252,14 +269,24 @@ void BlockchainModule::start()
       server_.queueMessage(std::move(request_msg));
       remote_blocks_ = final_chain_.size();
     }
+    // an idle validator never proposes, so expire its Transactions here
+    int removed = utx_pool_.GarbageCollect();
+    if (removed > 0) {
+      LOG_INFO << "main loop: removed " << removed << " expired or evicted transactions";
+    }
     LOG_DEBUG << "main loop: sleeping ";
-    sleep(5);
+    for (int i = 0; i < 50 && !shutdown_; ++i) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      RetryMissingTransactions(app_context_, utx_pool_,
+                               [this](DevvMessageUniquePtr p) { server_.queueMessage(std::move(p)); });
+    }
   }
 }
 
 void BlockchainModule::shutdown()
 {
   request_shutdown = true;
+  shutdown_ = true;
   /// Wait for the threads to see the shutdown request
   std::this_thread::sleep_for(std::chrono::milliseconds(100));
 
@@ -267,6 +294,11 @@ void BlockchainModule::shutdown()
   server_.stopServer();
   loopback_client_.stopClient();
 
+  /// Join the controller threads before the controllers are destroyed
+  if (consensus_executor_) { consensus_executor_->shutdown(); }
+  if (internetwork_executor_) { internetwork_executor_->shutdown(); }
+  if (validator_executor_) { validator_executor_->shutdown(); }
+
   LOG_INFO << "Shutting down Devv";
 
 }
@@ -6,6 +6,7 @@
 
 #pragma once
 
+#include <atomic>
 #include <string>
 #include <vector>
 
@@ -85,6 +86,7 @@ class BlockchainModule : public ModuleInterface {
 
   /**
    * Devv core main initialization.
+   * Blocks until shutdown() is called from another thread.
    * @note Call Shutdown() if this function fails.
    */
   void start();
@@ -121,7 +123,7 @@ class BlockchainModule : public ModuleInterface {
   ThreadedInternetworkPtr internetwork_executor_ = nullptr;
   ThreadedValidatorPtr validator_executor_ = nullptr;
 
-  bool shutdown_ = false;
+  std::atomic<bool> shutdown_ = ATOMIC_VAR_INIT(false);
   uint64_t remote_blocks_ = 0;
 };
 
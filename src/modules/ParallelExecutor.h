@@ -27,11 +27,13 @@ class ParallelExecutor {
    * @param controller
    * @param context
    * @param num_threads
+   * @param name prefix of this executor's metrics
    */
   ParallelExecutor(Controller& controller,
-                     size_t num_threads)
+                     size_t num_threads,
+                     const std::string& name = "executor")
       : controller_(controller)
-      , thread_group_(num_threads)
+      , thread_group_(num_threads, name)
   {
     LOG_DEBUG << "ParallelExecutor(" << num_threads << ")";
   }
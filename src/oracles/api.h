@@ -60,12 +60,12 @@ class api : public oracleInterface {
   }
 
 /** Checks if this proposal is valid according to this oracle
- *  given a specific blockchain.
- * @params context the blockchain to check against
+ *  given a specific chain state.
+ * @params context the chain state to check against
  * @return true iff the proposal is valid according to this oracle
  * @return false otherwise
  */
-  bool isValid(const Blockchain& context) override {
+  bool isValid(const ChainStateView& context) override {
     return isSound();
   }
 
@@ -77,18 +77,18 @@ class api : public oracleInterface {
   }
 
   std::map<uint64_t, std::vector<Tier2Transaction>>
-  getTrace(const Blockchain& context) override {
+  getTrace(const ChainStateView& context) override {
     std::map<uint64_t, std::vector<Tier2Transaction>> out;
     return out;
   }
 
-  uint64_t getCurrentDepth(const Blockchain& context) override {
+  uint64_t getCurrentDepth(const ChainStateView& context) override {
     //@TODO(nick) scan pre-existing chain for this oracle instance.
     return (0);
   }
 
   std::map<uint64_t, std::vector<Tier2Transaction>>
-  getNextTransactions(const Blockchain& context, const KeyRing& keys) override {
+  getNextTransactions(const ChainStateView& context, const KeyRing& keys) override {
     std::map<uint64_t, std::vector<Tier2Transaction>> out;
     return out;
   }
@@ -96,11 +96,11 @@ class api : public oracleInterface {
 /** Recursively generate the state of this oracle and all dependent oracles.
  *
  * @pre This transaction must be valid.
- * @params context the blockchain of the shard that provides context for this oracle
+ * @params context the chain state of the shard that provides context for this oracle
  * @return a map of oracles to data
  */
   std::map<std::string, std::vector<byte>>
-  getDecompositionMap(const Blockchain& context) override {
+  getDecompositionMap(const ChainStateView& context) override {
     std::map<std::string, std::vector<byte>> out;
     std::vector<byte> data(Str2Bin(raw_data_));
     std::pair<std::string, std::vector<byte>> p(getOracleName(), data);
@@ -111,11 +111,11 @@ class api : public oracleInterface {
 /** Recursively generate the state of this oracle and all dependent oracles.
  *
  * @pre This transaction must be valid.
- * @params context the blockchain of the shard that provides context for this oracle
+ * @params context the chain state of the shard that provides context for this oracle
  * @return a map of oracles to data encoded in JSON
  */
   virtual std::map<std::string, std::string>
-  getDecompositionMapJSON(const Blockchain& context) override {
+  getDecompositionMapJSON(const ChainStateView& context) override {
     std::map<std::string, std::string> out;
     std::pair<std::string, std::string> p(getOracleName(), getJSON());
     out.insert(p);
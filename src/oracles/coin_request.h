@@ -60,19 +60,23 @@ CoinRequest(std::string data) : oracleInterface(data) {};
  * @return false otherwise
  */
   bool isSound() override {
-    coin_ = BinToUint64(Str2Bin(raw_data_), 0);
-    amount_ = BinToInt64(Str2Bin(raw_data_), 8);
-    addr_ = Str2Bin(raw_data_.substr(16));
+    if (!parsed_) {
+      std::vector<byte> request(getCanonical());
+      coin_ = BinToUint64(request, 0);
+      amount_ = BinToInt64(request, 8);
+      addr_ = Str2Bin(raw_data_.substr(16));
+      parsed_ = true;
+    }
     return true;
   }
 
 /** Checks if this proposal is valid according to this oracle
- *  given a specific blockchain.
- * @params context the blockchain to check against
+ *  given a specific chain state.
+ * @params context the chain state to check against
  * @return true iff the proposal is valid according to this oracle
  * @return false otherwise
  */
-  bool isValid(const Blockchain& context) override {
+  bool isValid(const ChainStateView& context) override {
     if (!isSound()) return false;
     if (addr_.isNull()) {
       error_msg_ = "Recipient address is null";
@@ -98,18 +102,18 @@ CoinRequest(std::string data) : oracleInterface(data) {};
 
   //always empty for now
   std::map<uint64_t, std::vector<Tier2Transaction>>
-      getTrace(const Blockchain& context) override {
+      getTrace(const ChainStateView& context) override {
     std::map<uint64_t, std::vector<Tier2Transaction>> out;
     return out;
   }
 
-  uint64_t getCurrentDepth(const Blockchain& context) override {
+  uint64_t getCurrentDepth(const ChainStateView& context) override {
     //@TODO(nick) scan pre-existing chain for this oracle instance.
     return(0);
   }
 
   std::map<uint64_t, std::vector<Tier2Transaction>>
-      getNextTransactions(const Blockchain& context, const KeyRing& keys) override {
+      getNextTransactions(const ChainStateView& context, const KeyRing& keys) override {
     std::map<uint64_t, std::vector<Tier2Transaction>> out;
     if (!isValid(context)) return out;
     std::vector<Transfer> xfers;
@@ -130,11 +134,11 @@ CoinRequest(std::string data) : oracleInterface(data) {};
 /** Recursively generate the state of this oracle and all dependent oracles.
  *
  * @pre This proposal must be valid.
- * @params context the blockchain of the shard that provides context for this oracle
+ * @params context the chain state of the shard that provides context for this oracle
  * @return a map of oracles to data
  */
   std::map<std::string, std::vector<byte>>
-      getDecompositionMap(const Blockchain& context) override {
+      getDecompositionMap(const ChainStateView& context) override {
     std::map<std::string, std::vector<byte>> out;
     std::vector<byte> data(Str2Bin(raw_data_));
     std::pair<std::string, std::vector<byte>> p(getOracleName(), data);
@@ -145,11 +149,11 @@ CoinRequest(std::string data) : oracleInterface(data) {};
 /** Recursively generate the state of this oracle and all dependent oracles.
  *
  * @pre This proposal must be valid.
- * @params context the blockchain of the shard that provides context for this oracle
+ * @params context the chain state of the shard that provides context for this oracle
  * @return a map of oracles to data encoded in JSON
  */
   std::map<std::string, std::string>
-      getDecompositionMapJSON(const Blockchain& context) override {
+      getDecompositionMapJSON(const ChainStateView& context) override {
     std::map<std::string, std::string> out;
     std::pair<std::string, std::string> p(getOracleName(), getJSON());
     out.insert(p);
@@ -179,6 +183,8 @@ private:
  uint64_t coin_;
  Address addr_;
  int64_t amount_;
+ /// Whether coin_, addr_ and amount_ hold the parsed request
+ bool parsed_ = false;
 
 };
 
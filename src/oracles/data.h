@@ -84,20 +84,20 @@ class data : public oracleInterface {
   }
 
 /** Checks if this proposal is valid according to this oracle
- *  given a specific blockchain.
- * @params context the blockchain to check against
+ *  given a specific chain state.
+ * @params context the chain state to check against
  * @return true iff the proposal is valid according to this oracle
  * @return false otherwise
  */
-  bool isValid(const Blockchain& context) override {
+  bool isValid(const ChainStateView& context) override {
     if (!isSound()) return false;
     size_t addr_size = Address::getSizeByType(raw_data_.at(0));
     Address client(Str2Bin(raw_data_.substr(0, addr_size + 1)));
     size_t sig_size = Signature::getSizeByType(raw_data_.at(addr_size + 1));
     size_t data_size = raw_data_.size() - addr_size - sig_size - 2;
     int64_t coins_needed = ceil(data_size / kBYTES_PER_COIN);
-    ChainState last_state = context.getHighestChainState();
-    int64_t available = last_state.getAmount(getCoinIndex(), client);
+    ChainStateView::StatePtr last_state = context.getSnapshot();
+    int64_t available = last_state->getAmount(getCoinIndex(), client);
     if (available < coins_needed) {
       error_msg_ = "Data too large for coins provided";
       return false;
@@ -113,18 +113,18 @@ class data : public oracleInterface {
   }
 
   std::map<uint64_t, std::vector<Tier2Transaction>>
-  getTrace(const Blockchain& context) override {
+  getTrace(const ChainStateView& context) override {
     std::map<uint64_t, std::vector<Tier2Transaction>> out;
     return out;
   }
 
-  uint64_t getCurrentDepth(const Blockchain& context) override {
+  uint64_t getCurrentDepth(const ChainStateView& context) override {
     //@TODO(nick) scan pre-existing chain for this oracle instance.
     return (0);
   }
 
   std::map<uint64_t, std::vector<Tier2Transaction>>
-  getNextTransactions(const Blockchain& context, const KeyRing& keys) override {
+  getNextTransactions(const ChainStateView& context, const KeyRing& keys) override {
     std::map<uint64_t, std::vector<Tier2Transaction>> out;
     if (!isValid(context)) return out;
     size_t addr_size = Address::getSizeByType(raw_data_.at(0));
@@ -150,11 +150,11 @@ class data : public oracleInterface {
 /** Recursively generate the state of this oracle and all dependent oracles.
  *
  * @pre This proposal must be valid.
- * @params context the blockchain of the shard that provides context for this oracle
+ * @params context the chain state of the shard that provides context for this oracle
  * @return a map of oracles to data
  */
   std::map<std::string, std::vector<byte>>
-  getDecompositionMap(const Blockchain& context) override {
+  getDecompositionMap(const ChainStateView& context) override {
     std::map<std::string, std::vector<byte>> out;
     std::vector<byte> data(Str2Bin(raw_data_));
     std::pair<std::string, std::vector<byte>> p(getOracleName(), data);
@@ -165,11 +165,11 @@ class data : public oracleInterface {
 /** Recursively generate the state of this oracle and all dependent oracles.
  *
  * @pre This proposal must be valid.
- * @params context the blockchain of the shard that provides context for this oracle
+ * @params context the chain state of the shard that provides context for this oracle
  * @return a map of oracles to data encoded in JSON
  */
   std::map<std::string, std::string>
-  getDecompositionMapJSON(const Blockchain& context) override {
+  getDecompositionMapJSON(const ChainStateView& context) override {
     std::map<std::string, std::string> out;
     std::pair<std::string, std::string> p(getOracleName(), getJSON());
     out.insert(p);
@@ -11,7 +11,7 @@
 #include "oracles/dnerowallet.h"
 #include "oracles/oracleInterface.h"
 #include "common/logger.h"
-#include "consensus/blockchain.h"
+#include "consensus/chain_state_view.h"
 
 namespace Devv {
 
@@ -56,8 +56,7 @@ class dcash : public oracleInterface {
  * @return false otherwise
  */
   bool isSound() override {
-    InputBuffer buffer(Str2Bin(raw_data_));
-    Tier2Transaction tx = Tier2Transaction::QuickCreate(buffer);
+    const Tier2Transaction& tx = getProposedTransaction();
     for (const TransferPtr& xfer : tx.getTransfers()) {
       if (xfer->getDelay() != 0) {
         error_msg_ = "Dcash transactions may not have a delay.";
@@ -68,20 +67,19 @@ class dcash : public oracleInterface {
   }
 
 /** Checks if this proposal is valid according to this oracle
- *  given a specific blockchain.
- * @params context the blockchain to check against
+ *  given a specific chain state.
+ * @params context the chain state to check against
  * @return true iff the proposal is valid according to this oracle
  * @return false otherwise
  */
-  bool isValid(const Blockchain& context) override {
+  bool isValid(const ChainStateView& context) override {
     if (!isSound()) return false;
-    InputBuffer buffer(Str2Bin(raw_data_));
-    Tier2Transaction tx = Tier2Transaction::QuickCreate(buffer);
-    ChainState last_state = context.getHighestChainState();
+    const Tier2Transaction& tx = getProposedTransaction();
+    ChainStateView::StatePtr last_state = context.getSnapshot();
     for (const TransferPtr& xfer : tx.getTransfers()) {
       if (xfer->getAmount() < 0) {
         Address addr = xfer->getAddress();
-        if (last_state.getAmount(dnerowallet::getCoinIndex(), addr) > 0) {
+        if (last_state->getAmount(dnerowallet::getCoinIndex(), addr) > 0) {
           error_msg_ = "Error: Dnerowallets may not send dcash.";
           return false;
         } //endif has dnerowallet
@@ -99,24 +97,22 @@ class dcash : public oracleInterface {
   }
 
   std::map<uint64_t, std::vector<Tier2Transaction>>
-  getTrace(const Blockchain& context) override {
+  getTrace(const ChainStateView& context) override {
     std::map<uint64_t, std::vector<Tier2Transaction>> out;
     return out;
   }
 
-  uint64_t getCurrentDepth(const Blockchain& context) override {
+  uint64_t getCurrentDepth(const ChainStateView& context) override {
     //@TODO(nick) scan pre-existing chain for this oracle instance.
     return (0);
   }
 
   std::map<uint64_t, std::vector<Tier2Transaction>>
-  getNextTransactions(const Blockchain& context, const KeyRing& keys) override {
+  getNextTransactions(const ChainStateView& context, const KeyRing& keys) override {
     std::map<uint64_t, std::vector<Tier2Transaction>> out;
     if (!isValid(context)) return out;
-    InputBuffer buffer(Str2Bin(raw_data_));
-    Tier2Transaction tx = Tier2Transaction::QuickCreate(buffer);
     std::vector<Tier2Transaction> txs;
-    txs.push_back(std::move(tx));
+    txs.push_back(copyProposedTransaction());
     std::pair<uint64_t, std::vector<Tier2Transaction>> p(getShardIndex(), std::move(txs));
     out.insert(std::move(p));
     return out;
@@ -125,11 +121,11 @@ class dcash : public oracleInterface {
 /** Recursively generate the state of this oracle and all dependent oracles.
  *
  * @pre This transaction must be valid.
- * @params context the blockchain of the shard that provides context for this oracle
+ * @params context the chain state of the shard that provides context for this oracle
  * @return a map of oracles to data
  */
   std::map<std::string, std::vector<byte>>
-  getDecompositionMap(const Blockchain& context) override {
+  getDecompositionMap(const ChainStateView& context) override {
     std::map<std::string, std::vector<byte>> out;
     std::vector<byte> data(Str2Bin(raw_data_));
     std::pair<std::string, std::vector<byte>> p(getOracleName(), data);
@@ -140,11 +136,11 @@ class dcash : public oracleInterface {
 /** Recursively generate the state of this oracle and all dependent oracles.
  *
  * @pre This transaction must be valid.
- * @params context the blockchain of the shard that provides context for this oracle
+ * @params context the chain state of the shard that provides context for this oracle
  * @return a map of oracles to data encoded in JSON
  */
   virtual std::map<std::string, std::string>
-  getDecompositionMapJSON(const Blockchain& context) override {
+  getDecompositionMapJSON(const ChainStateView& context) override {
     std::map<std::string, std::string> out;
     std::pair<std::string, std::string> p(getOracleName(), getJSON());
     out.insert(p);
@@ -155,8 +151,7 @@ class dcash : public oracleInterface {
  * @return the internal state of this oracle in JSON.
  */
   std::string getJSON() override {
-    InputBuffer buffer(Str2Bin(raw_data_));
-    Tier2Transaction tx = Tier2Transaction::QuickCreate(buffer);
+    const Tier2Transaction& tx = getProposedTransaction();
     return tx.getJSON();
   }
 
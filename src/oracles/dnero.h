@@ -59,8 +59,7 @@ class dnero : public oracleInterface {
  * @return false otherwise
  */
   bool isSound() override {
-    InputBuffer buffer(Str2Bin(raw_data_));
-    Tier2Transaction tx = Tier2Transaction::QuickCreate(buffer);
+    const Tier2Transaction& tx = getProposedTransaction();
     for (const TransferPtr& xfer : tx.getTransfers()) {
       if (xfer->getDelay() < 1) {
         error_msg_ = "Dnero transactions must have a delay.";
@@ -71,21 +70,20 @@ class dnero : public oracleInterface {
   }
 
 /** Checks if this proposal is valid according to this oracle
- *  given a specific blockchain.
- * @params context the blockchain to check against
+ *  given a specific chain state.
+ * @params context the chain state to check against
  * @return true iff the proposal is valid according to this oracle
  * @return false otherwise
  */
-  bool isValid(const Blockchain& context) override {
+  bool isValid(const ChainStateView& context) override {
     if (!isSound()) return false;
-    InputBuffer buffer(Str2Bin(raw_data_));
-    Tier2Transaction tx = Tier2Transaction::QuickCreate(buffer);
-    ChainState last_state = context.getHighestChainState();
+    const Tier2Transaction& tx = getProposedTransaction();
+    ChainStateView::StatePtr last_state = context.getSnapshot();
     for (const TransferPtr& xfer : tx.getTransfers()) {
       if (xfer->getAmount() < 0) {
         Address addr = xfer->getAddress();
-        if (last_state.getAmount(dnerowallet::getCoinIndex(), addr) < 1
-            && last_state.getAmount(dneroavailable::getCoinIndex(), addr) < 1) {
+        if (last_state->getAmount(dnerowallet::getCoinIndex(), addr) < 1
+            && last_state->getAmount(dneroavailable::getCoinIndex(), addr) < 1) {
           error_msg_ = "Error: Dnerowallets or dneroavailable required.";
           return false;
         }
@@ -103,24 +101,22 @@ class dnero : public oracleInterface {
   }
 
   std::map<uint64_t, std::vector<Tier2Transaction>>
-  getTrace(const Blockchain& context) override {
+  getTrace(const ChainStateView& context) override {
     std::map<uint64_t, std::vector<Tier2Transaction>> out;
     return out;
   }
 
-  uint64_t getCurrentDepth(const Blockchain& context) override {
+  uint64_t getCurrentDepth(const ChainStateView& context) override {
     //@TODO(nick) scan pre-existing chain for this oracle instance.
     return (0);
   }
 
   std::map<uint64_t, std::vector<Tier2Transaction>>
-  getNextTransactions(const Blockchain& context, const KeyRing& keys) override {
+  getNextTransactions(const ChainStateView& context, const KeyRing& keys) override {
     std::map<uint64_t, std::vector<Tier2Transaction>> out;
     if (!isValid(context)) return out;
-    InputBuffer buffer(Str2Bin(raw_data_));
-    Tier2Transaction tx = Tier2Transaction::QuickCreate(buffer);
     std::vector<Tier2Transaction> txs;
-    txs.push_back(std::move(tx));
+    txs.push_back(copyProposedTransaction());
     std::pair<uint64_t, std::vector<Tier2Transaction>> p(getShardIndex(), std::move(txs));
     out.insert(std::move(p));
     return out;
@@ -129,11 +125,11 @@ class dnero : public oracleInterface {
 /** Recursively generate the state of this oracle and all dependent oracles.
  *
  * @pre This transaction must be valid.
- * @params context the blockchain of the shard that provides context for this oracle
+ * @params context the chain state of the shard that provides context for this oracle
  * @return a map of oracles to data
  */
   std::map<std::string, std::vector<byte>>
-  getDecompositionMap(const Blockchain& context) override {
+  getDecompositionMap(const ChainStateView& context) override {
     std::map<std::string, std::vector<byte>> out;
     std::vector<byte> data(Str2Bin(raw_data_));
     std::pair<std::string, std::vector<byte>> p(getOracleName(), data);
@@ -144,11 +140,11 @@ class dnero : public oracleInterface {
 /** Recursively generate the state of this oracle and all dependent oracles.
  *
  * @pre This transaction must be valid.
- * @params context the blockchain of the shard that provides context for this oracle
+ * @params context the chain state of the shard that provides context for this oracle
  * @return a map of oracles to data encoded in JSON
  */
   virtual std::map<std::string, std::string>
-  getDecompositionMapJSON(const Blockchain& context) override {
+  getDecompositionMapJSON(const ChainStateView& context) override {
     std::map<std::string, std::string> out;
     std::pair<std::string, std::string> p(getOracleName(), getJSON());
     out.insert(p);
@@ -159,8 +155,7 @@ class dnero : public oracleInterface {
  * @return the internal state of this oracle in JSON.
  */
   std::string getJSON() override {
-    InputBuffer buffer(Str2Bin(raw_data_));
-    Tier2Transaction tx = Tier2Transaction::QuickCreate(buffer);
+    const Tier2Transaction& tx = getProposedTransaction();
     return tx.getJSON();
   }
 
@@ -57,20 +57,17 @@ class DoTransaction : public oracleInterface {
  * @return false otherwise
  */
   bool isSound() override {
-    std::string hex = Bin2Str(getCanonical());
-    std::vector<byte> serial = Hex2Bin(hex);
-    InputBuffer buffer(serial);
-    Tier2Transaction tx = Tier2Transaction::QuickCreate(buffer);
+    getProposedTransaction();
     return true;
   }
 
 /** Checks if this proposal is valid according to this oracle
- *  given a specific blockchain.
- * @params context the blockchain to check against
+ *  given a specific chain state.
+ * @params context the chain state to check against
  * @return true iff the proposal is valid according to this oracle
  * @return false otherwise
  */
-  bool isValid(const Blockchain& context) override {
+  bool isValid(const ChainStateView& context) override {
     if (!isSound()) {
       error_msg_ = "Transaction is not sound: hex data: " + Bin2Str(getCanonical());
       return false;
@@ -87,23 +84,21 @@ class DoTransaction : public oracleInterface {
 
   //always empty for now
   std::map<uint64_t, std::vector<Tier2Transaction>>
-  getTrace(const Blockchain& context) override {
+  getTrace(const ChainStateView& context) override {
     std::map<uint64_t, std::vector<Tier2Transaction>> out;
     return out;
   }
 
-  uint64_t getCurrentDepth(const Blockchain& context) override {
+  uint64_t getCurrentDepth(const ChainStateView& context) override {
     //@TODO(nick) scan pre-existing chain for this oracle instance.
     return (0);
   }
 
   std::map<uint64_t, std::vector<Tier2Transaction>>
-  getNextTransactions(const Blockchain& context, const KeyRing& keys) override {
+  getNextTransactions(const ChainStateView& context, const KeyRing& keys) override {
     std::map<uint64_t, std::vector<Tier2Transaction>> out;
     if (!isValid(context)) return out;
-    std::string hex = Bin2Str(getCanonical());
-    std::vector<byte> serial = Hex2Bin(hex);
-    InputBuffer buffer(serial);
+    InputBuffer buffer(proposed_serial_);
     Tier2Transaction the_tx = Tier2Transaction::Create(buffer, keys, true);
     std::vector<Tier2Transaction> txs;
     txs.push_back(std::move(the_tx));
@@ -115,11 +110,11 @@ class DoTransaction : public oracleInterface {
 /** Recursively generate the state of this oracle and all dependent oracles.
  *
  * @pre This proposal must be valid.
- * @params context the blockchain of the shard that provides context for this oracle
+ * @params context the chain state of the shard that provides context for this oracle
  * @return a map of oracles to data
  */
   std::map<std::string, std::vector<byte>>
-  getDecompositionMap(const Blockchain& context) override {
+  getDecompositionMap(const ChainStateView& context) override {
     std::map<std::string, std::vector<byte>> out;
     std::vector<byte> data(Str2Bin(raw_data_));
     std::pair<std::string, std::vector<byte>> p(getOracleName(), data);
@@ -130,11 +125,11 @@ class DoTransaction : public oracleInterface {
 /** Recursively generate the state of this oracle and all dependent oracles.
  *
  * @pre This proposal must be valid.
- * @params context the blockchain of the shard that provides context for this oracle
+ * @params context the chain state of the shard that provides context for this oracle
  * @return a map of oracles to data encoded in JSON
  */
   std::map<std::string, std::string>
-  getDecompositionMapJSON(const Blockchain& context) override {
+  getDecompositionMapJSON(const ChainStateView& context) override {
     std::map<std::string, std::string> out;
     std::pair<std::string, std::string> p(getOracleName(), getJSON());
     out.insert(p);
@@ -157,6 +152,14 @@ class DoTransaction : public oracleInterface {
     return json;
   }
 
+ protected:
+  /**
+   * @return the serialized Tier2Transaction, decoded from the hex proposal
+   */
+  std::vector<byte> getProposedSerial() override {
+    return Hex2Bin(raw_data_);
+  }
+
  private:
   std::string error_msg_;
 
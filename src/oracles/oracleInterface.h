@@ -14,10 +14,11 @@
  */
 #pragma once
 
+#include <memory>
 #include <string>
 
 #include "common/binary_converters.h"
-#include "consensus/blockchain.h"
+#include "consensus/chain_state_view.h"
 #include "primitives/Tier2Transaction.h"
 #include "devv.pb.h"
 
@@ -57,12 +58,12 @@ class oracleInterface {
   virtual bool isSound() = 0;
 
 /** Checks if this proposal is valid according to this oracle
- *  given a specific blockchain.
- * @params context the blockchain to check against
+ *  given a specific chain state.
+ * @params context the chain state to check against
  * @return true iff the proposal is valid according to this oracle
  * @return false otherwise
  */
-  virtual bool isValid(const Blockchain& context) = 0;
+  virtual bool isValid(const ChainStateView& context) = 0;
 
 /**
  *  @return if not valid or not sound, return an error message
@@ -75,18 +76,18 @@ class oracleInterface {
  * length of this map equals getCurrentDepth().
  * For a new proposal with no transactions on chain, this map is empty.
  *
- * @params context the blockchain of the shard that provides context for this oracle
+ * @params context the chain state of the shard that provides context for this oracle
  * @return a map of previous transactions generated by this oracle.
  */
   virtual std::map<uint64_t, std::vector<Tier2Transaction>>
-    getTrace(const Blockchain& context) = 0;
+    getTrace(const ChainStateView& context) = 0;
 
 /** Determines the current depth of this oracle given its contextual blockchain.
  *
- * @params context the blockchain of the shard that provides context for this oracle
+ * @params context the chain state of the shard that provides context for this oracle
  * @return a number indicating the current iteration/depth of this oracle's DAG
  */
-  virtual uint64_t getCurrentDepth(const Blockchain& context) = 0;
+  virtual uint64_t getCurrentDepth(const ChainStateView& context) = 0;
 
 /** This method returns all of the fully decomposed transactions generated by
  * this oracle given its proposal and current context, including the relevant
@@ -96,30 +97,30 @@ class oracleInterface {
  * transaction should be encoded. All of these transactions will be encoded at
  * roughly the same time as they are announced to the shard peers simultaneously.
  *
- * @params context the blockchain of the shard that provides context for this oracle
+ * @params context the chain state of the shard that provides context for this oracle
  * @params keys provides INN keys to sign new transactions
  * @return a map of next transactions generated by this oracle.
  */
   virtual std::map<uint64_t, std::vector<Tier2Transaction>>
-    getNextTransactions(const Blockchain& context, const KeyRing& keys) = 0;
+    getNextTransactions(const ChainStateView& context, const KeyRing& keys) = 0;
 
 /** Recursively generate the state of this oracle and all dependent oracles.
  *
  * @pre This proposal must be valid.
- * @params context the blockchain of the shard that provides context for this oracle
+ * @params context the chain state of the shard that provides context for this oracle
  * @return a map of oracles to data
  */
   virtual std::map<std::string, std::vector<byte>>
-    getDecompositionMap(const Blockchain& context) = 0;
+    getDecompositionMap(const ChainStateView& context) = 0;
 
 /** Recursively generate the state of this oracle and all dependent oracles.
  *
  * @pre This proposal must be valid.
- * @params context the blockchain of the shard that provides context for this oracle
+ * @params context the chain state of the shard that provides context for this oracle
  * @return a map of oracles to data encoded in JSON
  */
   virtual std::map<std::string, std::string>
-    getDecompositionMapJSON(const Blockchain& context) = 0;
+    getDecompositionMapJSON(const ChainStateView& context) = 0;
 
 /** Generate the proposal message to sign for this oracle.
  *
@@ -143,8 +144,41 @@ class oracleInterface {
    */
   oracleInterface() = default;
 
+  /**
+   * @return the serialized Tier2Transaction this proposal carries
+   */
+  virtual std::vector<byte> getProposedSerial() { return getCanonical(); }
+
+  /**
+   * The Tier2Transaction this proposal carries, parsed on first use so
+   * every method of the oracle shares one copy
+   * @return the proposed Transaction
+   * @throw DeserializationError if the proposal does not hold a Transaction
+   */
+  const Tier2Transaction& getProposedTransaction() {
+    if (!proposed_tx_) {
+      proposed_serial_ = getProposedSerial();
+      InputBuffer buffer(proposed_serial_);
+      proposed_tx_.reset(new Tier2Transaction(Tier2Transaction::QuickCreate(buffer)));
+    }
+    return *proposed_tx_;
+  }
+
+  /**
+   * @return a copy of the proposed Tier2Transaction to decompose into
+   */
+  Tier2Transaction copyProposedTransaction() {
+    std::unique_ptr<Transaction> copy = getProposedTransaction().clone();
+    return std::move(static_cast<Tier2Transaction&>(*copy));
+  }
+
   //using string to align with protobuf type
   std::string raw_data_;
+  /// Serialized proposed Transaction, set by getProposedTransaction()
+  std::vector<byte> proposed_serial_;
+
+ private:
+  std::unique_ptr<Tier2Transaction> proposed_tx_;
 
 };
 
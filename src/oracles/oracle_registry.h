@@ -0,0 +1,157 @@
+/*
+ * oracle_registry.h maps oracle names to the handlers that build them.
+ *
+ * Oracle names are interned once, when an oracle type is registered,
+ * so dispatching a proposal costs one hash lookup instead of a string
+ * compare per known oracle.
+ *
+ * @copywrite  2018 Devvio Inc
+ *
+ */
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "oracles/api.h"
+#include "oracles/coin_request.h"
+#include "oracles/data.h"
+#include "oracles/dcash.h"
+#include "oracles/do_transaction.h"
+#include "oracles/dnero.h"
+#include "oracles/dneroavailable.h"
+#include "oracles/dnerowallet.h"
+#include "oracles/id.h"
+#include "oracles/oracleInterface.h"
+#include "oracles/vote.h"
+
+namespace Devv {
+
+/// Interned oracle name, the index of its handler in the registry
+typedef uint32_t OracleId;
+
+/// Id of names that are not registered
+static const OracleId kUNKNOWN_ORACLE = static_cast<OracleId>(-1);
+
+typedef std::unique_ptr<oracleInterface> OraclePtr;
+
+/**
+ * Builds the oracles of one type
+ */
+struct OracleHandler {
+  /// Interned name of the oracle
+  OracleId id;
+  /// Name that invokes the oracle
+  std::string name;
+  /// Builds an oracle from its proposal data
+  std::function<OraclePtr(const std::string&)> create;
+};
+
+class OracleRegistry {
+ public:
+  /**
+   * @return the registry of the oracles built into Devv
+   */
+  static OracleRegistry& Get() {
+    static OracleRegistry* registry = []() {
+      OracleRegistry* built_in = new OracleRegistry();
+      built_in->add<CoinRequest>();
+      built_in->add<DoTransaction>();
+      built_in->add<api>();
+      built_in->add<data>();
+      built_in->add<dcash>();
+      built_in->add<dnero>();
+      built_in->add<dneroavailable>();
+      built_in->add<dnerowallet>();
+      built_in->add<id>();
+      built_in->add<vote>();
+      return built_in;
+    }();
+    return *registry;
+  }
+
+  OracleRegistry() = default;
+  OracleRegistry(const OracleRegistry&) = delete;
+  OracleRegistry& operator=(const OracleRegistry&) = delete;
+
+  /**
+   * Registers an oracle type, T must have a static GetOracleName()
+   * and a constructor taking the proposal data
+   * @return the id of the oracle name
+   */
+  template <typename T>
+  OracleId add() {
+    return add(T::GetOracleName(), [](const std::string& proposal) {
+      return OraclePtr(new T(proposal));
+    });
+  }
+
+  /**
+   * Registers an oracle, a name that is already registered keeps its handler
+   * @param name - the name that invokes the oracle
+   * @param create - builds an oracle from its proposal data
+   * @return the id of the oracle name
+   */
+  OracleId add(const std::string& name, std::function<OraclePtr(const std::string&)> create) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    auto it = ids_.find(name);
+    if (it != ids_.end()) {
+      LOG_WARNING << "OracleRegistry: oracle " << name << " is already registered";
+      return it->second;
+    }
+    OracleId id = static_cast<OracleId>(handlers_.size());
+    handlers_.emplace_back(new OracleHandler{id, name, create});
+    ids_.emplace(name, id);
+    return id;
+  }
+
+  /**
+   * @param name - the name of an oracle
+   * @return the id of the oracle, kUNKNOWN_ORACLE if it is not registered
+   */
+  OracleId getId(const std::string& name) const {
+    std::lock_guard<std::mutex> guard(mutex_);
+    auto it = ids_.find(name);
+    return it == ids_.end() ? kUNKNOWN_ORACLE : it->second;
+  }
+
+  /**
+   * @param id - the id of an oracle
+   * @return the handler of the oracle, nullptr if it is not registered
+   */
+  const OracleHandler* find(OracleId id) const {
+    std::lock_guard<std::mutex> guard(mutex_);
+    return id < handlers_.size() ? handlers_[id].get() : nullptr;
+  }
+
+  /**
+   * @param name - the name of an oracle
+   * @return the handler of the oracle, nullptr if it is not registered
+   */
+  const OracleHandler* find(const std::string& name) const {
+    std::lock_guard<std::mutex> guard(mutex_);
+    auto it = ids_.find(name);
+    return it == ids_.end() ? nullptr : handlers_[it->second].get();
+  }
+
+  /**
+   * @return the number of registered oracles
+   */
+  size_t size() const {
+    std::lock_guard<std::mutex> guard(mutex_);
+    return handlers_.size();
+  }
+
+ private:
+  mutable std::mutex mutex_;
+  /// Interned names
+  std::unordered_map<std::string, OracleId> ids_;
+  /// Handlers by id, the handlers do not move when more are added
+  std::vector<std::unique_ptr<OracleHandler>> handlers_;
+};
+
+} // namespace Devv
@@ -10,23 +10,24 @@
 #include <exception>
 #include <typeinfo>
 
+#include <google/protobuf/arena.h>
+
 #include "consensus/blockchain.h"
+#include "consensus/chain_state_view.h"
 #include "primitives/Tier2Transaction.h"
-#include "oracles/api.h"
-#include "oracles/coin_request.h"
-#include "oracles/data.h"
-#include "oracles/dcash.h"
-#include "oracles/do_transaction.h"
-#include "oracles/dnero.h"
-#include "oracles/dneroavailable.h"
-#include "oracles/dnerowallet.h"
-#include "oracles/id.h"
-#include "oracles/vote.h"
+#include "oracles/oracle_registry.h"
 
 #include "devv.pb.h"
 
 namespace Devv {
 
+/// Envelopes with fewer Transactions are converted on the calling thread
+static const size_t kENVELOPE_PARALLEL_MIN_TXS = 256;
+/// Transactions converted by one task of a large envelope
+static const size_t kENVELOPE_CHUNK_TXS = 64;
+/// Smallest first arena block used to parse an envelope
+static const size_t kENVELOPE_MIN_ARENA_BLOCK = 4096;
+
 struct Proposal {
   std::string oracle_name;
   std::string data;
@@ -87,61 +88,45 @@ typedef std::unique_ptr<ServiceResponse> ServiceResponsePtr;
 
 TransactionPtr CreateTransaction(const Devv::proto::Transaction& transaction, const KeyRing& keys, bool do_sign = false) {
   auto operation = transaction.operation();
-  auto pb_xfers = transaction.xfers();
+  const auto& pb_xfers = transaction.xfers();
 
   std::vector<Transfer> transfers;
-  EC_KEY* key = nullptr;
+  transfers.reserve(pb_xfers.size());
+  const Transfer* sender = nullptr;
   for (auto const& xfer : pb_xfers) {
-    std::vector<byte> bytes(xfer.address().begin(), xfer.address().end());
-    auto address = Address(bytes);
-    LOG_INFO << "Transfer addr: "+ToHex(xfer.address());
-    LOG_INFO << "Coin: "+std::to_string(xfer.coin());
-    LOG_INFO << "Amount: "+std::to_string(xfer.amount());
-    LOG_INFO << "Delay: "+std::to_string(xfer.delay());
+    Address address(std::vector<byte>(xfer.address().begin(), xfer.address().end()));
+    LOG_DEBUG << "Transfer addr: "+ToHex(xfer.address());
+    LOG_DEBUG << "Coin: "+std::to_string(xfer.coin());
+    LOG_DEBUG << "Amount: "+std::to_string(xfer.amount());
+    LOG_DEBUG << "Delay: "+std::to_string(xfer.delay());
     transfers.emplace_back(address, xfer.coin(), xfer.amount(), xfer.delay());
     if (xfer.amount() < 0) {
-      if (key != nullptr) {
+      if (sender != nullptr) {
         throw std::runtime_error("More than one send transfer not supported.");
       }
-      key = keys.getKey(address);
+      sender = &transfers.back();
     }
   }
 
-  if (key == nullptr) {
+  if (sender == nullptr) {
     throw std::runtime_error("Exchange transactions must have one transfer with a negative amount.");
   }
 
   std::vector<byte> nonce(transaction.nonce().begin(), transaction.nonce().end());
 
   if (do_sign) {
-    Tier2Transaction t2tx(
-        operation,
-        transfers,
-        nonce,
-        key,
-        keys);
-    EC_KEY_free(key);
-    return t2tx.clone();
-  } else {
-    std::vector<byte> sig(transaction.sig().begin(), transaction.sig().end());
-    Signature signature(sig);
-
-    Tier2Transaction t2tx(
-        operation,
-        transfers,
-        nonce,
-        key,
-        keys,
-        signature);
-    EC_KEY_free(key);
-    return t2tx.clone();
+    std::unique_ptr<EC_KEY, void(*)(EC_KEY*)> key(keys.getKey(sender->getAddress()), EC_KEY_free);
+    return std::make_unique<Tier2Transaction>(operation, transfers, std::move(nonce), key.get(), keys);
   }
+  // a given signature is checked against the sender address, no key is loaded
+  Signature signature(std::vector<byte>(transaction.sig().begin(), transaction.sig().end()));
+  return std::make_unique<Tier2Transaction>(operation, transfers, std::move(nonce), nullptr, keys, signature);
 }
 
 Tier2TransactionPtr CreateTransaction(const Devv::proto::Transaction& transaction
     , std::string pk, std::string pk_pass) {
   auto operation = transaction.operation();
-  auto pb_xfers = transaction.xfers();
+  const auto& pb_xfers = transaction.xfers();
 
   std::vector<Transfer> transfers;
   EC_KEY* key = nullptr;
@@ -175,7 +160,7 @@ Tier2TransactionPtr CreateTransaction(const Devv::proto::Transaction& transactio
 }
 
 std::vector<TransactionPtr> validateOracle(oracleInterface& oracle
-                            , const Blockchain& chain, const KeyRing& keys) {
+                            , const ChainStateView& chain, const KeyRing& keys) {
   std::vector<TransactionPtr> out;
   if (oracle.isValid(chain)) {
     std::map<uint64_t, std::vector<Tier2Transaction>> oracle_actions =
@@ -184,79 +169,80 @@ std::vector<TransactionPtr> validateOracle(oracleInterface& oracle
       //TODO (nick) forward transactions for other shards to those shards
       for (auto& tx : it.second) {
         LOG_INFO << "Oracle: "+oracle.getOracleName()+" creates transaction: "+tx.getJSON();
-        TransactionPtr t2tx_ptr = tx.clone();
-        out.push_back(std::move(t2tx_ptr));
+        out.push_back(TransactionPtr(new Tier2Transaction(std::move(tx))));
       }
     }
   }
   return out;
 }
 
-std::vector<TransactionPtr> DecomposeProposal(const Devv::proto::Proposal& proposal, const Blockchain& chain
+std::vector<TransactionPtr> DecomposeProposal(const Devv::proto::Proposal& proposal, const ChainStateView& chain
                                              , const KeyRing& keys) {
   std::vector<TransactionPtr> ptrs;
-  std::string oracle_name = proposal.oraclename();
-  if (oracle_name == CoinRequest::GetOracleName()) {
-    CoinRequest oracle(proposal.data());
-    std::vector<TransactionPtr> actions = validateOracle(oracle, chain, keys);
-    ptrs.insert(ptrs.end(), std::make_move_iterator(actions.begin()), std::make_move_iterator(actions.end()));
-  }else if (oracle_name == DoTransaction::GetOracleName()) {
-    DoTransaction oracle(proposal.data());
-    std::vector<TransactionPtr> actions = validateOracle(oracle, chain, keys);
-    ptrs.insert(ptrs.end(), std::make_move_iterator(actions.begin()), std::make_move_iterator(actions.end()));
-  } else if (oracle_name == api::GetOracleName()) {
-    api oracle(proposal.data());
-    std::vector<TransactionPtr> actions = validateOracle(oracle, chain, keys);
-    ptrs.insert(ptrs.end(), std::make_move_iterator(actions.begin()), std::make_move_iterator(actions.end()));
-  } else if (oracle_name == data::GetOracleName()) {
-    data oracle(proposal.data());
-    std::vector<TransactionPtr> actions = validateOracle(oracle, chain, keys);
-    ptrs.insert(ptrs.end(), std::make_move_iterator(actions.begin()), std::make_move_iterator(actions.end()));
-  } else if (oracle_name == dcash::GetOracleName()) {
-    dcash oracle(proposal.data());
-    std::vector<TransactionPtr> actions = validateOracle(oracle, chain, keys);
-    ptrs.insert(ptrs.end(), std::make_move_iterator(actions.begin()), std::make_move_iterator(actions.end()));
-  } else if (oracle_name == dnero::GetOracleName()) {
-    dnero oracle(proposal.data());
-    std::vector<TransactionPtr> actions = validateOracle(oracle, chain, keys);
-    ptrs.insert(ptrs.end(), std::make_move_iterator(actions.begin()), std::make_move_iterator(actions.end()));
-  } else if (oracle_name == dneroavailable::GetOracleName()) {
-    dneroavailable oracle(proposal.data());
-    std::vector<TransactionPtr> actions = validateOracle(oracle, chain, keys);
-    ptrs.insert(ptrs.end(), std::make_move_iterator(actions.begin()), std::make_move_iterator(actions.end()));
-  } else if (oracle_name == dnerowallet::GetOracleName()) {
-    dnerowallet oracle(proposal.data());
-    std::vector<TransactionPtr> actions = validateOracle(oracle, chain, keys);
-    ptrs.insert(ptrs.end(), std::make_move_iterator(actions.begin()), std::make_move_iterator(actions.end()));
-  } else if (oracle_name == id::GetOracleName()) {
-    id oracle(proposal.data());
-    std::vector<TransactionPtr> actions = validateOracle(oracle, chain, keys);
-    ptrs.insert(ptrs.end(), std::make_move_iterator(actions.begin()), std::make_move_iterator(actions.end()));
-  } else if (oracle_name == vote::GetOracleName()) {
-    vote oracle(proposal.data());
-    std::vector<TransactionPtr> actions = validateOracle(oracle, chain, keys);
-    ptrs.insert(ptrs.end(), std::make_move_iterator(actions.begin()), std::make_move_iterator(actions.end()));
-  } else {
-    LOG_ERROR << "Unknown oracle: " + oracle_name;
+  const OracleHandler* handler = OracleRegistry::Get().find(proposal.oraclename());
+  if (handler == nullptr) {
+    LOG_ERROR << "Unknown oracle: " + proposal.oraclename();
+    return ptrs;
   }
+  OraclePtr oracle = handler->create(proposal.data());
+  ptrs = validateOracle(*oracle, chain, keys);
   return ptrs;
 }
 
-std::vector<TransactionPtr> DeserializeEnvelopeProtobufString(const std::string& pb_envelope, const KeyRing& keys) {
-  Devv::proto::Envelope envelope;
-  envelope.ParseFromString(pb_envelope);
-
-  std::vector<TransactionPtr> ptrs;
+/**
+ * Converts the Transactions of an envelope to Tier2Transactions.
+ * Large envelopes are converted in chunks on several threads, since
+ * checking each signature dominates the conversion.
+ * @param pb_transactions - the Transactions of an envelope
+ * @param keys - the KeyRing to check signatures with
+ * @return the Transactions in envelope order
+ * @throw the first error in envelope order if a Transaction is invalid
+ */
+std::vector<TransactionPtr> CreateTransactions(
+    const google::protobuf::RepeatedPtrField<Devv::proto::Transaction>& pb_transactions
+    , const KeyRing& keys) {
+  const size_t count = pb_transactions.size();
+  std::vector<TransactionPtr> ptrs(count);
+  if (count < kENVELOPE_PARALLEL_MIN_TXS) {
+    for (size_t i = 0; i < count; ++i) {
+      ptrs[i] = CreateTransaction(pb_transactions.Get(i), keys);
+    }
+    return ptrs;
+  }
 
-  auto pb_transactions = envelope.txs();
-  for (auto const& transaction : pb_transactions) {
-    ptrs.push_back(CreateTransaction(transaction, keys));
+  const size_t chunks = (count + kENVELOPE_CHUNK_TXS - 1) / kENVELOPE_CHUNK_TXS;
+  std::vector<std::exception_ptr> errors(chunks);
+  ThreadPool::ParallelFor(size_t(0), chunks, [&](size_t chunk) {
+    const size_t end = std::min(count, (chunk + 1) * kENVELOPE_CHUNK_TXS);
+    try {
+      for (size_t i = chunk * kENVELOPE_CHUNK_TXS; i < end; ++i) {
+        ptrs[i] = CreateTransaction(pb_transactions.Get(i), keys);
+      }
+    } catch (...) {
+      errors[chunk] = std::current_exception();
+    }
+  });
+  for (const auto& error : errors) {
+    if (error) {
+      std::rethrow_exception(error);
+    }
   }
+  return ptrs;
+}
+
+std::vector<TransactionPtr> DeserializeEnvelopeProtobufString(const std::string& pb_envelope, const KeyRing& keys
+                                                             , const ChainStateView& chain) {
+  // the parsed envelope lives in a few arena blocks instead of a heap allocation per field
+  google::protobuf::ArenaOptions options;
+  options.start_block_size = std::max<size_t>(2 * pb_envelope.size(), kENVELOPE_MIN_ARENA_BLOCK);
+  options.max_block_size = std::max(options.start_block_size, options.max_block_size);
+  google::protobuf::Arena arena(options);
+  auto envelope = google::protobuf::Arena::CreateMessage<Devv::proto::Envelope>(&arena);
+  envelope->ParseFromString(pb_envelope);
+
+  std::vector<TransactionPtr> ptrs(CreateTransactions(envelope->txs(), keys));
 
-  //TODO (nick): use the latest blockchain of this shard from the repeater
-  Blockchain chain("test-shard");
-  auto pb_proposals = envelope.proposals();
-  for (auto const& proposal : pb_proposals) {
+  for (auto const& proposal : envelope->proposals()) {
     std::vector<TransactionPtr> actions = DecomposeProposal(proposal, chain, keys);
     ptrs.insert(ptrs.end(), std::make_move_iterator(actions.begin())
                           , std::make_move_iterator(actions.end()));
@@ -265,6 +251,12 @@ std::vector<TransactionPtr> DeserializeEnvelopeProtobufString(const std::string&
   return ptrs;
 }
 
+std::vector<TransactionPtr> DeserializeEnvelopeProtobufString(const std::string& pb_envelope, const KeyRing& keys) {
+  // without a view of the shard, oracles validate proposals against an empty state
+  static const ChainStateView empty_chain;
+  return DeserializeEnvelopeProtobufString(pb_envelope, keys, empty_chain);
+}
+
 TransactionPtr DeserializeTxProtobufString(const std::string& pb_tx, const KeyRing& keys, bool do_sign = false) {
 
   Devv::proto::Transaction tx;
@@ -350,9 +342,9 @@ Devv::proto::Transaction SerializeTransaction(const Tier2Transaction& one_tx
   tx.set_nonce(nonce_str);
   for (auto const& xfer : one_tx.getTransfers()) {
     Devv::proto::Transfer* transfer = tx.add_xfers();
-    std::string addr(std::begin(xfer->getAddress().getCanonical())
-                    ,std::end(xfer->getAddress().getCanonical()));
-    transfer->set_address(addr);
+    Address address = xfer->getAddress();
+    transfer->set_address(std::string(std::begin(address.getCanonical())
+                                    , std::end(address.getCanonical())));
     transfer->set_coin(xfer->getCoin());
     transfer->set_amount(xfer->getAmount());
     transfer->set_delay(xfer->getDelay());
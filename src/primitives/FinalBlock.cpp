@@ -15,7 +15,7 @@ FinalBlock FinalBlock::Create(InputBuffer &buffer, const ChainState &prior) {
     throw DeserializationError("Invalid serialized FinalBlock, too small!");
   }
   block.version_ |= buffer.getNextByte();
-  if (block.version_ != 0) {
+  if (block.version_ > kFINAL_BLOCK_VERSION) {
     throw DeserializationError("Invalid FinalBlock.version: " + std::to_string(block.version_));
   }
   block.num_bytes_ = buffer.getNextUint64();
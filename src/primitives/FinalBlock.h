@@ -7,11 +7,19 @@
 #ifndef PRIMITIVES_FINALBLOCK_H_
 #define PRIMITIVES_FINALBLOCK_H_
 
+#include <memory>
+
 #include "common/devv_exceptions.h"
+#include "primitives/MerkleTree.h"
 #include "primitives/ProposedBlock.h"
 
 namespace Devv {
 
+/// Version of new FinalBlocks.
+/// In version 0 the merkle root is the hash of the whole block digest,
+/// from version 1 it is the root of the block's MerkleTree.
+static const uint8_t kFINAL_BLOCK_VERSION = 1;
+
 /**
  * Contains a finalized blockchain block
  */
@@ -22,7 +30,8 @@ class FinalBlock {
    * @param proposed
    */
   explicit FinalBlock(const ProposedBlock& proposed)
-      : num_bytes_(proposed.getNumBytes() + 40),
+      : version_(kFINAL_BLOCK_VERSION),
+        num_bytes_(proposed.getNumBytes() + 40),
         block_time_(GetMillisecondsSinceEpoch()),
         prev_hash_(proposed.getPrevHash()),
         merkle_root_(),
@@ -34,7 +43,7 @@ class FinalBlock {
         summary_(Summary::Copy(proposed.getSummary())),
         vals_(proposed.getValidation()),
         block_state_(proposed.getBlockState()) {
-    merkle_root_ = DevvHash(getBlockDigest());
+    merkle_root_ = computeMerkleRoot();
     std::vector<byte> merkle(std::begin(merkle_root_), std::end(merkle_root_));
     LOG_INFO << "Merkle: " + ToHex(merkle);
   }
@@ -55,7 +64,7 @@ class FinalBlock {
       return;
     }
     version_ |= buffer.getNextByte();
-    if (version_ != 0) {
+    if (version_ > kFINAL_BLOCK_VERSION) {
       LOG_WARNING << "Invalid FinalBlock.version: " + std::to_string(version_);
       return;
     }
@@ -83,6 +92,55 @@ class FinalBlock {
     vals_ = Validation::Create(buffer);
   }
 
+  /**
+   * Constructor for a block whose Transactions were already verified,
+   * such as one reassembled from a thin block. The transaction section
+   * of the buffer is skipped and the merkle root is checked instead.
+   * Throws DeserializationError if the block is malformed.
+   * @param buffer canonical block
+   * @param prior
+   * @param keys
+   * @param verified the sound Transactions of this block, in block order
+   */
+  FinalBlock(InputBuffer& buffer,
+             const ChainState& prior,
+             const KeyRing& keys,
+             std::vector<TransactionPtr>& verified) : block_state_(prior) {
+    MTR_SCOPE_FUNC();
+    if (buffer.size() < MinSize()) {
+      throw DeserializationError("Invalid serialized FinalBlock, too small!");
+    }
+    version_ |= buffer.getNextByte();
+    if (version_ > kFINAL_BLOCK_VERSION) {
+      throw DeserializationError("Invalid FinalBlock.version: " + std::to_string(version_));
+    }
+    num_bytes_ = buffer.getNextUint64();
+    if (buffer.size() != num_bytes_) {
+      throw DeserializationError("Invalid serialized FinalBlock, wrong size!");
+    }
+    block_time_ = buffer.getNextUint64();
+    buffer.copy(prev_hash_);
+    buffer.copy(merkle_root_);
+    tx_size_ = buffer.getNextUint64();
+    sum_size_ = buffer.getNextUint64();
+    val_count_ = buffer.getNextUint32();
+    buffer.increment(tx_size_);
+
+    transaction_vector_ = std::move(verified);
+    for (auto& tx : transaction_vector_) {
+      raw_transactions_.push_back(tx->getCanonical());
+      auto summary = Summary::Create();
+      tx->isValid(block_state_, keys, summary);
+    }
+
+    summary_ = Summary::Create(buffer);
+    vals_ = Validation::Create(buffer);
+
+    if (computeMerkleRoot() != merkle_root_) {
+      throw DeserializationError("FinalBlock does not match its merkle root!");
+    }
+  }
+
   /**
    * Constructor
    * @param serial
@@ -100,7 +158,7 @@ class FinalBlock {
       throw std::runtime_error("Invalid serialized FinalBlock, too small!");
     }
     version_ |= buffer.getNextByte();
-    if (version_ != 0) {
+    if (version_ > kFINAL_BLOCK_VERSION) {
       throw std::runtime_error("Invalid FinalBlock.version: " + std::to_string(version_));
     }
 
@@ -155,7 +213,8 @@ class FinalBlock {
       , raw_transactions_(other.raw_transactions_)
       , summary_(Summary::Copy(other.summary_))
       , vals_(other.vals_)
-      , block_state_(other.block_state_){}
+      , block_state_(other.block_state_)
+      , merkle_tree_(std::atomic_load(&other.merkle_tree_)) {}
 
   /**
    *
@@ -252,6 +311,86 @@ class FinalBlock {
     return serial;
   }
 
+  /**
+   * Returns the MerkleTree of this block, built on first use.
+   * Leaf 0 is the block header, leaves 1 to n the Transactions in block order
+   * and the last leaf the Summary and Validations.
+   * @return the MerkleTree of this block
+   */
+  std::shared_ptr<const MerkleTree> getMerkleTree() const {
+    auto tree = std::atomic_load(&merkle_tree_);
+    if (tree) {
+      return tree;
+    }
+    std::vector<byte> header;
+    header.push_back(version_ & 0xFF);
+    Uint64ToBin(num_bytes_, header);
+    Uint64ToBin(block_time_, header);
+    header.insert(header.end(), prev_hash_.begin(), prev_hash_.end());
+    Uint64ToBin(tx_size_, header);
+    Uint64ToBin(sum_size_, header);
+    Uint32ToBin(val_count_, header);
+    std::vector<byte> tail(summary_.getCanonical());
+    const std::vector<byte> val_canon(vals_.getCanonical());
+    tail.insert(tail.end(), val_canon.begin(), val_canon.end());
+
+    std::vector<const std::vector<byte>*> leaves;
+    leaves.reserve(raw_transactions_.size() + 2);
+    leaves.push_back(&header);
+    for (auto const& raw : raw_transactions_) {
+      leaves.push_back(&raw);
+    }
+    leaves.push_back(&tail);
+    tree = std::make_shared<const MerkleTree>(MerkleTree::LeafHashes(leaves));
+    std::atomic_store(&merkle_tree_, tree);
+    return tree;
+  }
+
+  /**
+   * Prove that a Transaction is recorded in this block.
+   * @param tx_index - the position of the Transaction in this block
+   * @return a proof to check with VerifyTransactionProof()
+   * @throw std::out_of_range if there is no such Transaction
+   * @throw std::runtime_error if this block predates MerkleTrees
+   */
+  MerkleProof getTransactionProof(size_t tx_index) const {
+    if (version_ < 1) {
+      throw std::runtime_error("FinalBlock version " + std::to_string(version_) + " has no MerkleTree");
+    }
+    if (tx_index >= raw_transactions_.size()) {
+      throw std::out_of_range("FinalBlock has no Transaction " + std::to_string(tx_index));
+    }
+    return getMerkleTree()->getProof(tx_index + 1);
+  }
+
+  /**
+   * Check that a Transaction is recorded in the block with this merkle root.
+   * @param tx_canonical - the canonical Transaction
+   * @param proof - a proof from getTransactionProof()
+   * @param merkle_root - the merkle root of the block
+   * @return true iff the Transaction is in that block
+   */
+  static bool VerifyTransactionProof(const std::vector<byte>& tx_canonical,
+                                     const MerkleProof& proof,
+                                     const Hash& merkle_root) {
+    // leaf 0 is the header and the last leaf the Summary
+    if (proof.index == 0 || proof.index + 1 >= proof.leaf_count) {
+      return false;
+    }
+    return MerkleTree::VerifyProof(MerkleTree::LeafHash(tx_canonical), proof, merkle_root);
+  }
+
+  /**
+   * Compute the merkle root this block should carry for its version.
+   * @return the merkle root
+   */
+  Hash computeMerkleRoot() const {
+    if (version_ < 1) {
+      return DevvHash(getBlockDigest());
+    }
+    return getMerkleTree()->getRoot();
+  }
+
   /**
    * Returns a CBOR representation of this block as a byte vector.
    * @return a CBOR representation of this block as a byte vector.
@@ -400,6 +539,8 @@ class FinalBlock {
   Validation vals_ = Validation::Create();
   /// ChainState
   ChainState block_state_;
+  /// MerkleTree, built on first use
+  mutable std::shared_ptr<const MerkleTree> merkle_tree_;
 };
 
 typedef std::shared_ptr<FinalBlock> FinalPtr;
@@ -0,0 +1,243 @@
+/*
+ * MerkleTree.h a binary hash tree over the parts of a block.
+ *
+ * Leaves and interior nodes are hashed with different prefixes
+ * (as in RFC 6962) so a node cannot be passed off as a leaf.
+ * A node without a sibling is carried up to the next level unchanged.
+ * Levels are hashed with DevvHashBatch(), and appending a leaf only
+ * rehashes the path from that leaf to the root.
+ *
+ * @copywrite  2018 Devvio Inc
+ */
+
+#ifndef PRIMITIVES_MERKLETREE_H_
+#define PRIMITIVES_MERKLETREE_H_
+
+#include <stdexcept>
+#include <vector>
+
+#include "common/binary_converters.h"
+#include "common/hash_batch.h"
+#include "common/ossladapter.h"
+
+namespace Devv {
+
+/// Prefix of the data hashed into a leaf
+static const byte kMERKLE_LEAF_PREFIX = 0x00;
+/// Prefix of the child hashes hashed into an interior node
+static const byte kMERKLE_NODE_PREFIX = 0x01;
+
+/**
+ * Proves that a leaf is part of a MerkleTree
+ */
+struct MerkleProof {
+  /// Position of the leaf in the tree
+  uint64_t index = 0;
+  /// Number of leaves in the tree
+  uint64_t leaf_count = 0;
+  /// Sibling hashes from the leaf level up, carried nodes have none
+  std::vector<Hash> path;
+
+  /**
+   * @return a JSON representation of this proof
+   */
+  std::string getJSON() const {
+    std::string json("{\"index\":" + std::to_string(index)
+                     + ",\"leaf_count\":" + std::to_string(leaf_count) + ",\"path\":[");
+    for (size_t i = 0; i < path.size(); ++i) {
+      if (i > 0) {
+        json += ",";
+      }
+      json += "\"" + ToHex(path[i]) + "\"";
+    }
+    json += "]}";
+    return json;
+  }
+};
+
+class MerkleTree {
+ public:
+  /**
+   * Create an empty tree
+   */
+  MerkleTree() = default;
+
+  /**
+   * Build a tree over leaf hashes
+   * @param leaves - the leaf hashes, see LeafHash()
+   */
+  explicit MerkleTree(const std::vector<Hash>& leaves) {
+    if (leaves.empty()) {
+      return;
+    }
+    levels_.push_back(leaves);
+    while (levels_.back().size() > 1) {
+      const std::vector<Hash>& below = levels_.back();
+      std::vector<std::vector<byte>> pairs;
+      pairs.reserve(below.size() / 2);
+      for (size_t i = 0; i + 1 < below.size(); i += 2) {
+        pairs.push_back(NodeData(below[i], below[i + 1]));
+      }
+      std::vector<Hash> above(DevvHashBatch(pairs));
+      if (below.size() % 2 == 1) {
+        above.push_back(below.back());
+      }
+      levels_.push_back(std::move(above));
+    }
+  }
+
+  /**
+   * @param data - the data of a leaf
+   * @return the hash of the leaf
+   */
+  static Hash LeafHash(const std::vector<byte>& data) {
+    std::vector<byte> prefixed;
+    prefixed.reserve(data.size() + 1);
+    prefixed.push_back(kMERKLE_LEAF_PREFIX);
+    prefixed.insert(prefixed.end(), data.begin(), data.end());
+    return DevvHash(prefixed);
+  }
+
+  /**
+   * Hash many leaves together
+   * @param data - the data of each leaf
+   * @return the hash of each leaf, in the order of data
+   */
+  static std::vector<Hash> LeafHashes(const std::vector<const std::vector<byte>*>& data) {
+    std::vector<std::vector<byte>> prefixed(data.size());
+    for (size_t i = 0; i < data.size(); ++i) {
+      prefixed[i].reserve(data[i]->size() + 1);
+      prefixed[i].push_back(kMERKLE_LEAF_PREFIX);
+      prefixed[i].insert(prefixed[i].end(), data[i]->begin(), data[i]->end());
+    }
+    return DevvHashBatch(prefixed);
+  }
+
+  /**
+   * @return the hash of an interior node
+   */
+  static Hash NodeHash(const Hash& left, const Hash& right) {
+    return DevvHash(NodeData(left, right));
+  }
+
+  /**
+   * Add a leaf to the right of the tree, rehashing its path to the root
+   * @param leaf - the leaf hash, see LeafHash()
+   */
+  void append(const Hash& leaf) {
+    if (levels_.empty()) {
+      levels_.emplace_back();
+    }
+    levels_[0].push_back(leaf);
+    size_t level = 0;
+    while (levels_[level].size() > 1) {
+      const std::vector<Hash>& below = levels_[level];
+      size_t parent = (below.size() - 1) / 2;
+      Hash node = (below.size() % 2 == 0)
+          ? NodeHash(below[below.size() - 2], below.back())
+          : below.back();
+      if (levels_.size() == level + 1) {
+        levels_.emplace_back();
+      }
+      std::vector<Hash>& above = levels_[level + 1];
+      if (above.size() == parent) {
+        above.push_back(node);
+      } else {
+        above[parent] = node;
+      }
+      ++level;
+    }
+  }
+
+  /**
+   * @return the number of leaves
+   */
+  size_t size() const {
+    return levels_.empty() ? 0 : levels_[0].size();
+  }
+
+  /**
+   * @return the root of this tree, the hash of no data if the tree is empty
+   */
+  Hash getRoot() const {
+    if (levels_.empty()) {
+      return DevvHash(std::vector<byte>());
+    }
+    return levels_.back()[0];
+  }
+
+  /**
+   * Prove that a leaf is part of this tree
+   * @param index - the position of the leaf
+   * @return the proof, O(log n) hashes
+   * @throw std::out_of_range if there is no such leaf
+   */
+  MerkleProof getProof(size_t index) const {
+    if (index >= size()) {
+      throw std::out_of_range("MerkleTree::getProof(): no leaf " + std::to_string(index));
+    }
+    MerkleProof proof;
+    proof.index = index;
+    proof.leaf_count = size();
+    size_t position = index;
+    for (size_t level = 0; level + 1 < levels_.size(); ++level) {
+      const std::vector<Hash>& nodes = levels_[level];
+      size_t sibling = position ^ 1;
+      if (sibling < nodes.size()) {
+        proof.path.push_back(nodes[sibling]);
+      }
+      position /= 2;
+    }
+    return proof;
+  }
+
+  /**
+   * Check that a leaf is part of the tree with the given root
+   * @param leaf - the leaf hash, see LeafHash()
+   * @param proof - the proof from getProof()
+   * @param root - the trusted root
+   * @return true iff the proof leads from leaf to root
+   */
+  static bool VerifyProof(const Hash& leaf, const MerkleProof& proof, const Hash& root) {
+    if (proof.index >= proof.leaf_count) {
+      return false;
+    }
+    Hash node = leaf;
+    uint64_t position = proof.index;
+    uint64_t width = proof.leaf_count;
+    size_t next = 0;
+    while (width > 1) {
+      if (position % 2 == 1) {
+        if (next >= proof.path.size()) {
+          return false;
+        }
+        node = NodeHash(proof.path[next++], node);
+      } else if (position + 1 < width) {
+        if (next >= proof.path.size()) {
+          return false;
+        }
+        node = NodeHash(node, proof.path[next++]);
+      }
+      position /= 2;
+      width = (width + 1) / 2;
+    }
+    return (next == proof.path.size()) && (node == root);
+  }
+
+ private:
+  static std::vector<byte> NodeData(const Hash& left, const Hash& right) {
+    std::vector<byte> data;
+    data.reserve(1 + left.size() + right.size());
+    data.push_back(kMERKLE_NODE_PREFIX);
+    data.insert(data.end(), left.begin(), left.end());
+    data.insert(data.end(), right.begin(), right.end());
+    return data;
+  }
+
+  /// Hashes of each level, leaves first, the root last
+  std::vector<std::vector<Hash>> levels_;
+};
+
+} // namespace Devv
+
+#endif /* PRIMITIVES_MERKLETREE_H_ */
@@ -5,11 +5,22 @@
  * @copywrite  2018 Devvio Inc
  */
 #include "ProposedBlock.h"
+
+#include <exception>
+
 #include "primitives/json_interface.h"
 
 namespace Devv {
 
 bool ProposedBlock::validate(const KeyRing& keys) const {
+  return validateBlock(keys, nullptr);
+}
+
+bool ProposedBlock::validate(const KeyRing& keys, TransactionCreationManager& tcm) const {
+  return validateBlock(keys, &tcm);
+}
+
+bool ProposedBlock::validateBlock(const KeyRing& keys, TransactionCreationManager* tcm) const {
   LOG_DEBUG << "validate()";
   MTR_SCOPE_FUNC();
   if (transaction_vector_.size() < 1) {
@@ -24,15 +35,42 @@ bool ProposedBlock::validate(const KeyRing& keys) const {
   }
 
   std::vector<byte> md = summary_.getCanonical();
+  Hash md_hash = DevvHash(md);
+  std::vector<const ValidationMap::value_type*> sigs;
   for (auto& sig : vals_.getValidationMap()) {
-    EC_KEY* eckey = keys.getKey(sig.first);
-    auto verified = VerifyByteSig(eckey, DevvHash(md), sig.second);
-    EC_KEY_free(eckey);
-    if (!verified) {
+    sigs.push_back(&sig);
+  }
+
+  // Every signature is checked, then the results are reported in order
+  // so the first invalid signature is the one a sequential check reports
+  std::vector<char> verified(sigs.size(), 0);
+  std::vector<std::exception_ptr> errors(sigs.size());
+  auto verify = [&](size_t i) {
+    try {
+      EC_KEY* eckey = keys.getKey(sigs[i]->first);
+      verified[i] = VerifyByteSig(eckey, md_hash, sigs[i]->second);
+      EC_KEY_free(eckey);
+    } catch (...) {
+      errors[i] = std::current_exception();
+    }
+  };
+  if (tcm != nullptr) {
+    tcm->ParallelFor(sigs.size(), verify);
+  } else {
+    for (size_t i = 0; i < sigs.size(); ++i) {
+      verify(i);
+    }
+  }
+
+  for (size_t i = 0; i < sigs.size(); ++i) {
+    if (errors[i]) {
+      std::rethrow_exception(errors[i]);
+    }
+    if (!verified[i]) {
       LOG_WARNING << "Invalid block signature";
       LOG_DEBUG << "Block state: " + GetJSON(*this);
-      LOG_DEBUG << "Block Node Addr: " + sig.first.getJSON();
-      LOG_DEBUG << "Block Node Sig: " + sig.second.getJSON();
+      LOG_DEBUG << "Block Node Addr: " + sigs[i]->first.getJSON();
+      LOG_DEBUG << "Block Node Sig: " + sigs[i]->second.getJSON();
       return false;
     }
   }
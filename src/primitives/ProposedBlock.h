@@ -7,6 +7,7 @@
 #ifndef PRIMITIVES_PROPOSEDBLOCK_H_
 #define PRIMITIVES_PROPOSEDBLOCK_H_
 
+#include "common/devv_exceptions.h"
 #include "common/logger.h"
 
 #include "primitives/block.h"
@@ -70,6 +71,21 @@ class ProposedBlock {
                 const ChainState& prior,
                 const KeyRing& keys,
                 TransactionCreationManager& tcm);
+
+  /**
+   * Create a new ProposedBlock from an InputBuffer whose Transactions
+   * were already verified, such as one reassembled from a thin block.
+   * The transaction section of the buffer is skipped.
+   *
+   * @param buffer
+   * @param prior
+   * @param verified the sound Transactions of this block, in block order
+   * @return
+   */
+  static ProposedBlock Create(InputBuffer& buffer,
+                const ChainState& prior,
+                std::vector<TransactionPtr>& verified);
+
   /**
    * Copy constructor
    * @param other
@@ -186,6 +202,15 @@ class ProposedBlock {
    */
   bool validate(const KeyRing& keys) const;
 
+  /**
+   * Validates this block, checking the node signatures on the worker threads.
+   * @note returns and logs the same as validate(keys)
+   * @param keys the directory of node keys
+   * @param tcm provides the worker threads
+   * @return true iff this block is valid
+   */
+  bool validate(const KeyRing& keys, TransactionCreationManager& tcm) const;
+
   /**
    * Signs this block.
    * @pre OpenSSL is initialized and ecKey contains a private key
@@ -393,6 +418,14 @@ class ProposedBlock {
    */
   explicit ProposedBlock(const ChainState& prior) : block_state_(prior) {};
 
+  /**
+   * Validates this block.
+   * @param keys the directory of node keys
+   * @param tcm provides the worker threads, nullptr to check signatures on this thread
+   * @return true iff this block is valid
+   */
+  bool validateBlock(const KeyRing& keys, TransactionCreationManager* tcm) const;
+
   /// Version of the block
   uint8_t version_ = 0;
   /// Number of bytes in the block
@@ -477,6 +510,40 @@ inline ProposedBlock ProposedBlock::Create(InputBuffer &buffer,
   return new_block;
 }
 
+inline ProposedBlock ProposedBlock::Create(InputBuffer &buffer,
+                            const ChainState &prior,
+                            std::vector<TransactionPtr>& verified) {
+  MTR_SCOPE_FUNC();
+  ProposedBlock new_block(prior);
+
+  if (buffer.size() < MinSize()) {
+    throw DeserializationError("Invalid serialized ProposedBlock, too small!");
+  }
+  new_block.version_ |= buffer.getNextByte();
+  if (new_block.version_ != 0) {
+    throw DeserializationError("Invalid ProposedBlock.version: " + std::to_string(new_block.version_));
+  }
+  new_block.num_bytes_ = buffer.getNextUint64();
+  if (buffer.size() != new_block.num_bytes_) {
+    throw DeserializationError("Invalid serialized ProposedBlock, wrong size! ("
+                               + std::to_string(buffer.size()) + " != "
+                               + std::to_string(new_block.num_bytes_) + ")");
+  }
+
+  buffer.copy(new_block.prev_hash_);
+  new_block.tx_size_ = buffer.getNextUint64();
+  new_block.sum_size_ = buffer.getNextUint64();
+  new_block.val_count_ = buffer.getNextUint32();
+  buffer.increment(new_block.tx_size_);
+  new_block.transaction_vector_ = std::move(verified);
+
+  new_block.summary_ = Summary::Create(buffer);
+  Validation val_temp(Validation::Create(buffer));
+  new_block.vals_ = val_temp;
+
+  return new_block;
+}
+
 typedef std::unique_ptr<ProposedBlock> ProposedBlockPtr;
 typedef std::shared_ptr<ProposedBlock> ProposedBlockSharedPtr;
 
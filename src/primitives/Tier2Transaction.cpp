@@ -141,4 +141,30 @@ Tier2TransactionPtr Tier2Transaction::CreateUniquePtr(InputBuffer& buffer,
   return tx;
 }
 
+Signature Tier2Transaction::PeekSignature(InputBuffer& buffer, size_t& tx_size) {
+  if (buffer.size() < buffer.getOffset() + MinSize()) {
+    throw DeserializationError("Invalid serialized T2 transaction, too small!");
+  }
+  uint64_t xfer_size = buffer.getNextUint64(false);
+  uint64_t nonce_size = buffer.getSecondUint64(false);
+  if (nonce_size < minNonceSize()) {
+    throw DeserializationError("Invalid serialized T2 transaction, bad nonce size ("
+                               + std::to_string(nonce_size) + ")!");
+  }
+  size_t sig_offset = kTRANSFER_OFFSET + xfer_size + nonce_size;
+  if (buffer.size() <= buffer.getOffset() + sig_offset) {
+    throw DeserializationError("Invalid serialized T2 transaction, too small!");
+  }
+  /// The first byte of a Signature is the size of the signature that follows
+  size_t sig_size = buffer.offsetAt(sig_offset) + 1;
+  tx_size = sig_offset + sig_size;
+  if (buffer.size() < buffer.getOffset() + tx_size) {
+    throw DeserializationError("Invalid serialized T2 transaction, wrong size ("
+                               + std::to_string(tx_size) + ")!");
+  }
+  auto sig_begin = buffer.getCurrentIterator() + sig_offset;
+  std::vector<byte> sig_bin(sig_begin, sig_begin + sig_size);
+  return Signature(sig_bin);
+}
+
 } // namespace Devv
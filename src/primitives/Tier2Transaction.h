@@ -55,25 +55,10 @@ class Tier2Transaction : public Transaction {
         + std::to_string(nonce_size_) + ")");
     }
 
-    Uint64ToBin(nonce_size_, canonical_);
-    canonical_.push_back(oper);
-
-    xfer_size_ = 0;
-    for (const auto& transfer : xfers) {
-      xfer_size_ += transfer.Size();
-      std::vector<byte> xfer_canon(transfer.getCanonical());
-      canonical_.insert(std::end(canonical_), std::begin(xfer_canon), std::end(xfer_canon));
-    }
-
-    std::vector<byte> xfer_size_bin;
-    Uint64ToBin(xfer_size_, xfer_size_bin);
-    //Note that xfer size goes on the beginning
-    canonical_.insert(std::begin(canonical_), std::begin(xfer_size_bin), std::end(xfer_size_bin));
-
-    canonical_.insert(std::end(canonical_), std::begin(nonce), std::end(nonce));
+    serializeBody(oper, xfers, nonce);
     std::vector<byte> msg(getMessageDigest());
     Signature sig = SignBinary(eckey, DevvHash(msg));
-    std::vector<byte> sig_canon(sig.getCanonical());
+    const std::vector<byte>& sig_canon(sig.getCanonical());
     canonical_.insert(std::end(canonical_), std::begin(sig_canon), std::end(sig_canon));
     is_sound_ = isSound(keys);
     if (!is_sound_) {
@@ -106,25 +91,9 @@ class Tier2Transaction : public Transaction {
         +std::to_string(nonce_size_)+").";
     }
 
-    Uint64ToBin(nonce_size_, canonical_);
-    canonical_.push_back(oper);
-
-    xfer_size_ = 0;
-    for (const auto& transfer : xfers) {
-      xfer_size_ += transfer.Size();
-      std::vector<byte> xfer_canon(transfer.getCanonical());
-      canonical_.insert(std::end(canonical_), std::begin(xfer_canon), std::end(xfer_canon));
-    }
-
-    std::vector<byte> xfer_size_bin;
-    Uint64ToBin(xfer_size_, xfer_size_bin);
-    //Note that xfer size goes on the beginning
-    canonical_.insert(std::begin(canonical_), std::begin(xfer_size_bin), std::end(xfer_size_bin));
-
-    canonical_.insert(std::end(canonical_), std::begin(nonce), std::end(nonce));
-    std::vector<byte> msg(getMessageDigest());
+    serializeBody(oper, xfers, nonce);
     LOG_DEBUG << signature.getJSON();
-    std::vector<byte> sig_canon(signature.getCanonical());
+    const std::vector<byte>& sig_canon(signature.getCanonical());
     canonical_.insert(std::end(canonical_), std::begin(sig_canon), std::end(sig_canon));
     is_sound_ = isSound(keys);
     if (!is_sound_) {
@@ -151,26 +120,11 @@ class Tier2Transaction : public Transaction {
         +std::to_string(nonce_size_)+").";
     }
 
-    Uint64ToBin(nonce_size_, canonical_);
-    canonical_.push_back(oper);
-
-    xfer_size_ = 0;
-    for (const auto& transfer : xfers) {
-      xfer_size_ += transfer.Size();
-      std::vector<byte> xfer_canon(transfer.getCanonical());
-      canonical_.insert(std::end(canonical_), std::begin(xfer_canon), std::end(xfer_canon));
-    }
-
-    std::vector<byte> xfer_size_bin;
-    Uint64ToBin(xfer_size_, xfer_size_bin);
-    //Note that xfer size goes on the beginning
-    canonical_.insert(std::begin(canonical_), std::begin(xfer_size_bin), std::end(xfer_size_bin));
-
-    canonical_.insert(std::end(canonical_), std::begin(nonce), std::end(nonce));
+    serializeBody(oper, xfers, nonce);
     std::vector<byte> msg(getMessageDigest());
     Signature signature = SignBinary(eckey, DevvHash(msg));
     LOG_DEBUG << signature.getJSON();
-    std::vector<byte> sig_canon(signature.getCanonical());
+    const std::vector<byte>& sig_canon(signature.getCanonical());
     canonical_.insert(std::end(canonical_), std::begin(sig_canon), std::end(sig_canon));
   }
 
@@ -193,25 +147,9 @@ class Tier2Transaction : public Transaction {
         +std::to_string(nonce_size_)+").";
     }
 
-    Uint64ToBin(nonce_size_, canonical_);
-    canonical_.push_back(oper);
-
-    xfer_size_ = 0;
-    for (const auto& transfer : xfers) {
-      xfer_size_ += transfer.Size();
-      std::vector<byte> xfer_canon(transfer.getCanonical());
-      canonical_.insert(std::end(canonical_), std::begin(xfer_canon), std::end(xfer_canon));
-    }
-
-    std::vector<byte> xfer_size_bin;
-    Uint64ToBin(xfer_size_, xfer_size_bin);
-    //Note that xfer size goes on the beginning
-    canonical_.insert(std::begin(canonical_), std::begin(xfer_size_bin), std::end(xfer_size_bin));
-
-    canonical_.insert(std::end(canonical_), std::begin(nonce), std::end(nonce));
-    std::vector<byte> msg(getMessageDigest());
+    serializeBody(oper, xfers, nonce);
     LOG_DEBUG << signature.getJSON();
-    std::vector<byte> sig_canon(signature.getCanonical());
+    const std::vector<byte>& sig_canon(signature.getCanonical());
     canonical_.insert(std::end(canonical_), std::begin(sig_canon), std::end(sig_canon));
   }
 
@@ -225,6 +163,17 @@ class Tier2Transaction : public Transaction {
                                                            const KeyRing& keys,
                                                            bool calculate_soundness = true);
 
+  /**
+   * Read the Signature of the next Tier2Transaction in a buffer
+   * without copying the Transaction or checking its soundness.
+   * The buffer offset is not changed.
+   * @param buffer - the buffer holding the serialized Transaction
+   * @param tx_size - set to the serialized size of the Transaction
+   * @return the Signature of the Transaction
+   * @throw DeserializationError if the buffer does not hold a whole Transaction
+   */
+  static Signature PeekSignature(InputBuffer& buffer, size_t& tx_size);
+
   /**
    * Returns the operation performed by this transfer
    * @return
@@ -263,6 +212,29 @@ class Tier2Transaction : public Transaction {
    */
   Tier2Transaction() = default;
 
+  /**
+   * Write everything but the signature to canonical_, in one allocation
+   * that leaves room for the signature
+   * @param oper Operation of this transaction
+   * @param xfers
+   * @param nonce
+   */
+  void serializeBody(byte oper, const std::vector<Transfer>& xfers, const std::vector<byte>& nonce) {
+    xfer_size_ = 0;
+    for (const auto& transfer : xfers) {
+      xfer_size_ += transfer.Size();
+    }
+    canonical_.reserve(kTRANSFER_OFFSET + xfer_size_ + nonce.size() + kNODE_SIG_BUF_SIZE);
+    Uint64ToBin(xfer_size_, canonical_);
+    Uint64ToBin(nonce_size_, canonical_);
+    canonical_.push_back(oper);
+    for (const auto& transfer : xfers) {
+      const std::vector<byte>& xfer_canon(transfer.getCanonical());
+      canonical_.insert(std::end(canonical_), std::begin(xfer_canon), std::end(xfer_canon));
+    }
+    canonical_.insert(std::end(canonical_), std::begin(nonce), std::end(nonce));
+  }
+
   /**
    * Default private copy constructor. We keep this private so the programmer has to
    * explicity call clone() to avoid accidental copies
@@ -371,7 +343,7 @@ class Tier2Transaction : public Transaction {
             if (sender != it->getAddress()) {
               throw std::runtime_error("TransactionError: Multiple senders in transaction");
             } else {
-              LOG_INFO << "Sending multiple distinct transfers at once.";
+              LOG_DEBUG << "Sending multiple distinct transfers at once.";
             }
           }
           sender = it->getAddress();
@@ -438,14 +410,14 @@ class Tier2Transaction : public Transaction {
                         << "), state.getAmount()(" << state.getAmount(coin, addr) << ")";
             return false;
           } else {
-            LOG_INFO << "eOpType(" << int(oper) << "): addr(" << addr.getHexString() << "): amount: " << amount
+            LOG_DEBUG << "eOpType(" << int(oper) << "): addr(" << addr.getHexString() << "): amount: " << amount
                      << " state.getAmount(): " << state.getAmount(coin, addr);
           }
         }
         SmartCoin next_flow(addr, coin, amount);
         state.addCoin(next_flow);
         summary.addItem(addr, coin, amount, it->getDelay());
-        LOG_INFO << "New balance: wallet address: " << addr.getHexString()
+        LOG_DEBUG << "New balance: wallet address: " << addr.getHexString()
                  << "; coin: " << coin << "; balance: " << state.getAmount(coin, addr);
       }
       return true;
@@ -511,7 +483,7 @@ class Tier2Transaction : public Transaction {
         SmartCoin next_flow(addr, coin, amount);
         state.addCoin(next_flow);
         summary.addItem(addr, coin, amount, it->getDelay());
-        LOG_INFO << "New balance: wallet address: " << addr.getHexString()
+        LOG_DEBUG << "New balance: wallet address: " << addr.getHexString()
                  << "; coin: " << coin << "; balance: " << state.getAmount(coin, addr);
       }
       return no_error;
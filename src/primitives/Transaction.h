@@ -159,6 +159,12 @@ class Transaction {
    */
   bool setIsSound(const KeyRing& keys) { return do_setIsSound(keys); }
 
+  /**
+   * Mark this Transaction sound without verifying it.
+   * Only for Transactions whose canonical form was already proven sound.
+   */
+  void setIsSoundVerified() { is_sound_ = true; }
+
   /**
    * Checks if this transaction is sound, meaning potentially valid.
    * If any portion of the transaction is invalid,
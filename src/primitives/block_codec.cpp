@@ -0,0 +1,555 @@
+/*
+ * primitives/block_codec.cpp implements the compact wire encoding
+ * for sequences of canonical FinalBlocks.
+ *
+ * Compact message layout:
+ *   marker(1) format(1) flags(1) [raw_size(varint) if deflated] body
+ *
+ * Body layout:
+ *   block_count(varint) addr_count(varint) addresses...
+ *   blocks... tail_size(varint) tail
+ *
+ * Each block keeps its hashes and signatures verbatim, writes
+ * integer fields as varints and replaces addresses with indexes
+ * into the address dictionary. Bytes that cannot be parsed as
+ * a block are carried in the tail unchanged.
+ *
+ * @copywrite  2018 Devvio Inc
+ */
+#include "primitives/block_codec.h"
+
+#include <map>
+#include <zlib.h>
+
+#include "common/binary_converters.h"
+#include "common/devv_constants.h"
+#include "common/devv_exceptions.h"
+#include "common/logger.h"
+#include "primitives/Signature.h"
+
+namespace Devv {
+
+namespace {
+
+/// Size of the canonical FinalBlock header
+static const size_t kFINAL_BLOCK_HEADER_SIZE = 101;
+
+/// Largest size ratio deflate can reach, bounds the size a message may claim
+static const uint64_t kMAX_DEFLATE_RATIO = 1032;
+/// Bytes inflated at a time, the output grows only as far as the data goes
+static const size_t kINFLATE_STEP = 64 * 1024;
+
+/// Record tags inside a compact block, parsed fields or verbatim bytes
+static const byte kPARSED_RECORD = 0;
+static const byte kRAW_RECORD = 1;
+
+/**
+ * Bounds checked reader over a region of a canonical buffer.
+ * The parse functions below return false rather than throwing
+ * so that the encoder can fall back to copying bytes verbatim.
+ */
+struct CanonicalReader {
+  CanonicalReader(const std::vector<byte>& bytes, size_t offset, size_t limit)
+      : bytes(bytes), offset(offset), limit(limit) {}
+
+  bool has(uint64_t n) const { return (offset <= limit) && (limit - offset >= n); }
+
+  uint64_t nextUint64() {
+    uint64_t ret = BinToUint64(bytes, offset);
+    offset += kUINT64_SIZE;
+    return ret;
+  }
+
+  uint32_t nextUint32() {
+    uint32_t ret = BinToUint32(bytes, offset);
+    offset += 4;
+    return ret;
+  }
+
+  const std::vector<byte>& bytes;
+  size_t offset;
+  size_t limit;
+};
+
+/**
+ * Address dictionary shared by all blocks in a message
+ */
+class AddressDictionary {
+ public:
+  uint64_t indexOf(std::vector<byte>&& addr) {
+    auto it = index_.find(addr);
+    if (it != index_.end()) {
+      return it->second;
+    }
+    uint64_t index = entries_.size();
+    index_.emplace(addr, index);
+    entries_.push_back(std::move(addr));
+    return index;
+  }
+
+  const std::vector<std::vector<byte>>& entries() const { return entries_; }
+
+ private:
+  std::map<std::vector<byte>, uint64_t> index_;
+  std::vector<std::vector<byte>> entries_;
+};
+
+bool EncodeAddress(CanonicalReader& reader, AddressDictionary& dict, std::vector<byte>& out) {
+  if (!reader.has(1)) { return false; }
+  byte addr_size = reader.bytes.at(reader.offset);
+  if (addr_size != kWALLET_ADDR_SIZE && addr_size != kNODE_ADDR_SIZE) { return false; }
+  if (!reader.has(addr_size + 1)) { return false; }
+  auto begin = reader.bytes.begin() + reader.offset;
+  VarintToBin(dict.indexOf(std::vector<byte>(begin, begin + addr_size + 1)), out);
+  reader.offset += addr_size + 1;
+  return true;
+}
+
+bool CopySignature(CanonicalReader& reader, std::vector<byte>& out) {
+  if (!reader.has(1)) { return false; }
+  byte sig_size = reader.bytes.at(reader.offset);
+  if (sig_size != kWALLET_SIG_SIZE && sig_size != kNODE_SIG_SIZE) { return false; }
+  if (!reader.has(sig_size + 1)) { return false; }
+  auto begin = reader.bytes.begin() + reader.offset;
+  out.insert(out.end(), begin, begin + sig_size + 1);
+  reader.offset += sig_size + 1;
+  return true;
+}
+
+/**
+ * Encode one Tier2Transaction starting at reader.offset
+ * @return false if the bytes are not a well formed Tier2Transaction
+ */
+bool EncodeTier2Transaction(CanonicalReader& reader, AddressDictionary& dict, std::vector<byte>& out) {
+  if (!reader.has(kTRANSFER_OFFSET)) { return false; }
+  uint64_t xfer_size = reader.nextUint64();
+  uint64_t nonce_size = reader.nextUint64();
+  byte oper = reader.bytes.at(reader.offset++);
+  if (oper >= eOpType::NumOperations || nonce_size < kMIN_NONCE_SIZE || !reader.has(xfer_size)) {
+    return false;
+  }
+
+  std::vector<byte> xfers;
+  uint64_t xfer_count = 0;
+  CanonicalReader xfer_reader(reader.bytes, reader.offset, reader.offset + xfer_size);
+  while (xfer_reader.offset < xfer_reader.limit) {
+    if (!EncodeAddress(xfer_reader, dict, xfers)) { return false; }
+    if (!xfer_reader.has(kTRANSFER_NONADDR_DATA_SIZE)) { return false; }
+    VarintToBin(xfer_reader.nextUint64(), xfers);
+    VarintToBin(ZigZagEncode(static_cast<int64_t>(xfer_reader.nextUint64())), xfers);
+    VarintToBin(xfer_reader.nextUint64(), xfers);
+    ++xfer_count;
+  }
+  reader.offset = xfer_reader.offset;
+
+  if (!reader.has(nonce_size)) { return false; }
+  out.push_back(kPARSED_RECORD);
+  out.push_back(oper);
+  VarintToBin(xfer_count, out);
+  out.insert(out.end(), xfers.begin(), xfers.end());
+  VarintToBin(nonce_size, out);
+  auto nonce_begin = reader.bytes.begin() + reader.offset;
+  out.insert(out.end(), nonce_begin, nonce_begin + nonce_size);
+  reader.offset += nonce_size;
+  return CopySignature(reader, out);
+}
+
+/**
+ * Encode a canonical Summary occupying exactly the reader's region
+ * @return false if the region is not a well formed Summary
+ */
+bool EncodeSummary(CanonicalReader& reader, AddressDictionary& dict, std::vector<byte>& out) {
+  if (!reader.has(sizeof(uint32_t))) { return false; }
+  uint32_t addr_count = reader.nextUint32();
+  VarintToBin(addr_count, out);
+  for (uint32_t i = 0; i < addr_count; ++i) {
+    if (!EncodeAddress(reader, dict, out)) { return false; }
+    if (!reader.has(2 * kUINT64_SIZE)) { return false; }
+    uint64_t delayed_count = reader.nextUint64();
+    uint64_t coin_count = reader.nextUint64();
+    if (delayed_count > (reader.limit - reader.offset) / (3 * kUINT64_SIZE)) { return false; }
+    if (coin_count > (reader.limit - reader.offset) / (2 * kUINT64_SIZE)) { return false; }
+    if (!reader.has((delayed_count * 3 + coin_count * 2) * kUINT64_SIZE)) { return false; }
+    VarintToBin(delayed_count, out);
+    VarintToBin(coin_count, out);
+    for (uint64_t j = 0; j < delayed_count; ++j) {
+      VarintToBin(reader.nextUint64(), out);
+      VarintToBin(reader.nextUint64(), out);
+      VarintToBin(ZigZagEncode(static_cast<int64_t>(reader.nextUint64())), out);
+    }
+    for (uint64_t j = 0; j < coin_count; ++j) {
+      VarintToBin(reader.nextUint64(), out);
+      VarintToBin(ZigZagEncode(static_cast<int64_t>(reader.nextUint64())), out);
+    }
+  }
+  return (reader.offset == reader.limit);
+}
+
+/**
+ * Encode one canonical FinalBlock starting at reader.offset
+ * @return false if the bytes are not a well formed FinalBlock
+ */
+bool EncodeBlock(CanonicalReader& reader, AddressDictionary& dict, std::vector<byte>& out) {
+  if (!reader.has(kFINAL_BLOCK_HEADER_SIZE)) { return false; }
+  out.push_back(reader.bytes.at(reader.offset++));
+  VarintToBin(reader.nextUint64(), out);
+  VarintToBin(reader.nextUint64(), out);
+  auto hashes = reader.bytes.begin() + reader.offset;
+  out.insert(out.end(), hashes, hashes + 2 * kHASH_LENGTH);
+  reader.offset += 2 * kHASH_LENGTH;
+  uint64_t tx_size = reader.nextUint64();
+  uint64_t sum_size = reader.nextUint64();
+  uint32_t val_count = reader.nextUint32();
+  VarintToBin(tx_size, out);
+  VarintToBin(sum_size, out);
+  VarintToBin(val_count, out);
+
+  if (!reader.has(tx_size)) { return false; }
+  size_t tx_end = reader.offset + tx_size;
+  std::vector<byte> records;
+  records.reserve(tx_size / 2);
+  uint64_t record_count = 0;
+  while (reader.offset < tx_end) {
+    CanonicalReader tx_reader(reader.bytes, reader.offset, tx_end);
+    size_t record_start = records.size();
+    if (EncodeTier2Transaction(tx_reader, dict, records)) {
+      reader.offset = tx_reader.offset;
+    } else {
+      // Tier1 transactions and anything unexpected are copied verbatim
+      records.resize(record_start);
+      records.push_back(kRAW_RECORD);
+      VarintToBin(tx_end - reader.offset, records);
+      records.insert(records.end(), reader.bytes.begin() + reader.offset, reader.bytes.begin() + tx_end);
+      reader.offset = tx_end;
+    }
+    ++record_count;
+  }
+  VarintToBin(record_count, out);
+  out.insert(out.end(), records.begin(), records.end());
+
+  if (!reader.has(sum_size)) { return false; }
+  CanonicalReader sum_reader(reader.bytes, reader.offset, reader.offset + sum_size);
+  size_t summary_start = out.size();
+  out.push_back(kPARSED_RECORD);
+  if (!EncodeSummary(sum_reader, dict, out)) {
+    out.resize(summary_start);
+    out.push_back(kRAW_RECORD);
+    out.insert(out.end(), reader.bytes.begin() + reader.offset,
+               reader.bytes.begin() + reader.offset + sum_size);
+  }
+  reader.offset += sum_size;
+
+  for (uint32_t i = 0; i < val_count; ++i) {
+    if (!EncodeAddress(reader, dict, out)) { return false; }
+    if (!CopySignature(reader, out)) { return false; }
+  }
+  return true;
+}
+
+/**
+ * Bounds checked reader over a compact body. Throws
+ * DeserializationError on any malformed input.
+ */
+class CompactReader {
+ public:
+  CompactReader(const std::vector<byte>& bytes, size_t offset)
+      : bytes_(bytes), offset_(offset) {}
+
+  bool done() const { return offset_ >= bytes_.size(); }
+
+  size_t getOffset() const { return offset_; }
+
+  byte nextByte() {
+    require(1);
+    return bytes_[offset_++];
+  }
+
+  uint64_t nextVarint() {
+    try {
+      return BinToVarint(bytes_, offset_);
+    } catch (const std::exception&) {
+      throw DeserializationError("Invalid compact block, bad varint");
+    }
+  }
+
+  void copy(std::vector<byte>& out, uint64_t length) {
+    require(length);
+    out.insert(out.end(), bytes_.begin() + offset_, bytes_.begin() + offset_ + length);
+    offset_ += length;
+  }
+
+  void copyPrefixed(std::vector<byte>& out) {
+    require(1);
+    copy(out, uint64_t(bytes_[offset_]) + 1);
+  }
+
+ private:
+  void require(uint64_t length) const {
+    if (offset_ > bytes_.size() || bytes_.size() - offset_ < length) {
+      throw DeserializationError("Invalid compact block, too small!");
+    }
+  }
+
+  const std::vector<byte>& bytes_;
+  size_t offset_;
+};
+
+void DecodeAddress(CompactReader& reader,
+                   const std::vector<std::vector<byte>>& dict,
+                   std::vector<byte>& out) {
+  uint64_t index = reader.nextVarint();
+  if (index >= dict.size()) {
+    throw DeserializationError("Invalid compact block, address index out of range");
+  }
+  out.insert(out.end(), dict[index].begin(), dict[index].end());
+}
+
+void DecodeTier2Transaction(CompactReader& reader,
+                            const std::vector<std::vector<byte>>& dict,
+                            std::vector<byte>& out) {
+  byte oper = reader.nextByte();
+  uint64_t xfer_count = reader.nextVarint();
+  std::vector<byte> xfers;
+  for (uint64_t i = 0; i < xfer_count; ++i) {
+    DecodeAddress(reader, dict, xfers);
+    Uint64ToBin(reader.nextVarint(), xfers);
+    Int64ToBin(ZigZagDecode(reader.nextVarint()), xfers);
+    Uint64ToBin(reader.nextVarint(), xfers);
+  }
+  uint64_t nonce_size = reader.nextVarint();
+  Uint64ToBin(xfers.size(), out);
+  Uint64ToBin(nonce_size, out);
+  out.push_back(oper);
+  out.insert(out.end(), xfers.begin(), xfers.end());
+  reader.copy(out, nonce_size);
+  reader.copyPrefixed(out);
+}
+
+void DecodeSummary(CompactReader& reader,
+                   const std::vector<std::vector<byte>>& dict,
+                   std::vector<byte>& out) {
+  uint64_t addr_count = reader.nextVarint();
+  Uint32ToBin(static_cast<uint32_t>(addr_count), out);
+  for (uint64_t i = 0; i < addr_count; ++i) {
+    DecodeAddress(reader, dict, out);
+    uint64_t delayed_count = reader.nextVarint();
+    uint64_t coin_count = reader.nextVarint();
+    Uint64ToBin(delayed_count, out);
+    Uint64ToBin(coin_count, out);
+    for (uint64_t j = 0; j < delayed_count; ++j) {
+      Uint64ToBin(reader.nextVarint(), out);
+      Uint64ToBin(reader.nextVarint(), out);
+      Int64ToBin(ZigZagDecode(reader.nextVarint()), out);
+    }
+    for (uint64_t j = 0; j < coin_count; ++j) {
+      Uint64ToBin(reader.nextVarint(), out);
+      Int64ToBin(ZigZagDecode(reader.nextVarint()), out);
+    }
+  }
+}
+
+void DecodeBlock(CompactReader& reader,
+                 const std::vector<std::vector<byte>>& dict,
+                 std::vector<byte>& out) {
+  out.push_back(reader.nextByte());
+  Uint64ToBin(reader.nextVarint(), out);
+  Uint64ToBin(reader.nextVarint(), out);
+  reader.copy(out, 2 * kHASH_LENGTH);
+  uint64_t tx_size = reader.nextVarint();
+  uint64_t sum_size = reader.nextVarint();
+  uint64_t val_count = reader.nextVarint();
+  Uint64ToBin(tx_size, out);
+  Uint64ToBin(sum_size, out);
+  Uint32ToBin(static_cast<uint32_t>(val_count), out);
+
+  uint64_t record_count = reader.nextVarint();
+  for (uint64_t i = 0; i < record_count; ++i) {
+    byte tag = reader.nextByte();
+    if (tag == kPARSED_RECORD) {
+      DecodeTier2Transaction(reader, dict, out);
+    } else if (tag == kRAW_RECORD) {
+      reader.copy(out, reader.nextVarint());
+    } else {
+      throw DeserializationError("Invalid compact block, unknown record tag");
+    }
+    if (out.size() > kMAX_COMPACT_BLOCK_EXPANSION) {
+      throw DeserializationError("Invalid compact block, too large!");
+    }
+  }
+
+  byte sum_tag = reader.nextByte();
+  if (sum_tag == kPARSED_RECORD) {
+    DecodeSummary(reader, dict, out);
+  } else if (sum_tag == kRAW_RECORD) {
+    reader.copy(out, sum_size);
+  } else {
+    throw DeserializationError("Invalid compact block, unknown summary tag");
+  }
+
+  for (uint64_t i = 0; i < val_count; ++i) {
+    DecodeAddress(reader, dict, out);
+    reader.copyPrefixed(out);
+  }
+}
+
+} // namespace
+
+bool IsCompactBlockData(const std::vector<byte>& raw, size_t offset) {
+  return (raw.size() > offset + 2)
+      && (raw[offset] == kCOMPACT_BLOCK_MARKER)
+      && (raw[offset + 1] == kCOMPACT_BLOCK_FORMAT);
+}
+
+std::vector<byte> EncodeCompactBlocks(const std::vector<byte>& canonical, bool deflate) {
+  MTR_SCOPE_FUNC();
+  AddressDictionary dict;
+  std::vector<byte> blocks;
+  blocks.reserve(canonical.size() / 2);
+  uint64_t block_count = 0;
+
+  CanonicalReader reader(canonical, 0, canonical.size());
+  while (reader.offset < reader.limit) {
+    CanonicalReader block_reader(canonical, reader.offset, reader.limit);
+    size_t block_start = blocks.size();
+    if (!EncodeBlock(block_reader, dict, blocks)) {
+      blocks.resize(block_start);
+      LOG_DEBUG << "EncodeCompactBlocks(): carrying " << (reader.limit - reader.offset)
+                << " unparsed bytes verbatim";
+      break;
+    }
+    reader.offset = block_reader.offset;
+    ++block_count;
+  }
+
+  std::vector<byte> body;
+  body.reserve(blocks.size() + dict.entries().size() * (kNODE_ADDR_BUF_SIZE) + 32);
+  VarintToBin(block_count, body);
+  VarintToBin(dict.entries().size(), body);
+  for (const auto& addr : dict.entries()) {
+    body.insert(body.end(), addr.begin(), addr.end());
+  }
+  body.insert(body.end(), blocks.begin(), blocks.end());
+  VarintToBin(reader.limit - reader.offset, body);
+  body.insert(body.end(), canonical.begin() + reader.offset, canonical.end());
+
+  std::vector<byte> out;
+  out.push_back(kCOMPACT_BLOCK_MARKER);
+  out.push_back(kCOMPACT_BLOCK_FORMAT);
+  if (deflate) {
+    uLongf deflated_size = compressBound(body.size());
+    std::vector<byte> deflated(deflated_size);
+    int result = compress2(deflated.data(), &deflated_size, body.data(), body.size(), Z_DEFAULT_COMPRESSION);
+    if (result == Z_OK && deflated_size < body.size()) {
+      out.push_back(kCOMPACT_BLOCK_DEFLATE);
+      VarintToBin(body.size(), out);
+      out.insert(out.end(), deflated.begin(), deflated.begin() + deflated_size);
+      return out;
+    }
+    LOG_DEBUG << "EncodeCompactBlocks(): deflate did not reduce size, sending uncompressed";
+  }
+  out.push_back(0);
+  out.insert(out.end(), body.begin(), body.end());
+  return out;
+}
+
+/**
+ * Inflates deflated data, growing the output only as data is produced,
+ * so a message that claims a large size cannot allocate it up front
+ * @param deflated - the deflated data
+ * @param deflated_size - the number of deflated bytes
+ * @param body_size - the expected inflated size
+ * @param out - (out) the inflated data
+ * @throw DeserializationError if the data does not inflate to body_size bytes
+ */
+static void InflateBounded(const byte* deflated, size_t deflated_size,
+                           uint64_t body_size, std::vector<byte>& out) {
+  z_stream stream = {};
+  if (inflateInit(&stream) != Z_OK) {
+    throw DeserializationError("Invalid compact block, inflate failed");
+  }
+  stream.next_in = const_cast<Bytef*>(deflated);
+  stream.avail_in = static_cast<uInt>(deflated_size);
+  int result = Z_OK;
+  while (result == Z_OK && out.size() < body_size) {
+    size_t produced = out.size();
+    out.resize(produced + std::min<uint64_t>(body_size - produced, kINFLATE_STEP));
+    stream.next_out = out.data() + produced;
+    stream.avail_out = static_cast<uInt>(out.size() - produced);
+    result = inflate(&stream, Z_NO_FLUSH);
+    out.resize(out.size() - stream.avail_out);
+  }
+  if (result == Z_OK) {
+    // all bytes are out, the end of the stream must follow
+    byte extra;
+    stream.next_out = &extra;
+    stream.avail_out = 1;
+    result = inflate(&stream, Z_NO_FLUSH);
+    if (stream.avail_out == 0) {
+      result = Z_DATA_ERROR;
+    }
+  }
+  bool complete = result == Z_STREAM_END && out.size() == body_size;
+  inflateEnd(&stream);
+  if (!complete) {
+    throw DeserializationError("Invalid compact block, inflate failed");
+  }
+}
+
+std::vector<byte> DecodeCompactBlocks(const std::vector<byte>& compact, size_t offset) {
+  MTR_SCOPE_FUNC();
+  if (!IsCompactBlockData(compact, offset)) {
+    throw DeserializationError("Invalid compact block header");
+  }
+  byte flags = compact[offset + 2];
+  size_t body_offset = offset + 3;
+
+  std::vector<byte> inflated;
+  if (flags & kCOMPACT_BLOCK_DEFLATE) {
+    CompactReader header(compact, body_offset);
+    uint64_t body_size = header.nextVarint();
+    if (body_size > kMAX_COMPACT_BLOCK_EXPANSION) {
+      throw DeserializationError("Invalid compact block, too large!");
+    }
+    size_t deflated_offset = header.getOffset();
+    size_t deflated_size = compact.size() - deflated_offset;
+    if (body_size > deflated_size * kMAX_DEFLATE_RATIO) {
+      throw DeserializationError("Invalid compact block, size does not match deflated data");
+    }
+    InflateBounded(compact.data() + deflated_offset, deflated_size, body_size, inflated);
+  } else if (flags != 0) {
+    throw DeserializationError("Invalid compact block, unknown flags");
+  }
+
+  const std::vector<byte>& body = (flags & kCOMPACT_BLOCK_DEFLATE) ? inflated : compact;
+  CompactReader reader(body, (flags & kCOMPACT_BLOCK_DEFLATE) ? 0 : body_offset);
+
+  uint64_t block_count = reader.nextVarint();
+  uint64_t addr_count = reader.nextVarint();
+  std::vector<std::vector<byte>> dict;
+  for (uint64_t i = 0; i < addr_count; ++i) {
+    std::vector<byte> addr;
+    reader.copyPrefixed(addr);
+    dict.push_back(std::move(addr));
+  }
+
+  std::vector<byte> out;
+  for (uint64_t i = 0; i < block_count; ++i) {
+    DecodeBlock(reader, dict, out);
+  }
+  reader.copy(out, reader.nextVarint());
+  if (!reader.done()) {
+    throw DeserializationError("Invalid compact block, trailing bytes");
+  }
+  return out;
+}
+
+std::vector<byte> EncodeBlocks(const std::vector<byte>& canonical, eBlockEncoding encoding) {
+  if (encoding == eBlockEncoding::CompactBlocks) {
+    return EncodeCompactBlocks(canonical, false);
+  } else if (encoding == eBlockEncoding::DeflatedBlocks) {
+    return EncodeCompactBlocks(canonical, true);
+  }
+  return canonical;
+}
+
+} // namespace Devv
@@ -0,0 +1,68 @@
+/*
+ * primitives/block_codec.h defines a compact wire encoding
+ * for sequences of canonical FinalBlocks.
+ *
+ * The compact form replaces repeated addresses with indexes
+ * into a per-message address dictionary, writes integers as
+ * varints (zigzag for signed amounts) and optionally deflates
+ * the result. Decoding always reproduces the exact canonical
+ * bytes, so hashes and signatures are computed as before.
+ *
+ * @copywrite  2018 Devvio Inc
+ */
+#pragma once
+
+#include <vector>
+
+#include "common/devv_types.h"
+
+namespace Devv {
+
+/// First byte of a compact block message. Canonical blocks start with version 0.
+static const byte kCOMPACT_BLOCK_MARKER = 0xDB;
+/// Version of the compact block format
+static const byte kCOMPACT_BLOCK_FORMAT = 1;
+/// Flag set when the compact body is deflated
+static const byte kCOMPACT_BLOCK_DEFLATE = 0x01;
+/// Upper bound on the canonical size a compact message may expand to
+static const uint64_t kMAX_COMPACT_BLOCK_EXPANSION = 1ULL << 30;
+
+/**
+ * Checks if the binary holds a compact block header at offset
+ * @param raw
+ * @param offset position of the header in raw
+ * @return true if raw is a compact block message
+ * @return false otherwise
+ */
+bool IsCompactBlockData(const std::vector<byte>& raw, size_t offset = 0);
+
+/**
+ * Encode a sequence of canonical FinalBlocks into the compact form.
+ * Any bytes that do not parse as a block are carried verbatim, so the
+ * result always decodes back to the input.
+ *
+ * @param canonical concatenated canonical FinalBlocks
+ * @param deflate compress the compact body with zlib
+ * @return the compact encoding
+ */
+std::vector<byte> EncodeCompactBlocks(const std::vector<byte>& canonical, bool deflate);
+
+/**
+ * Decode a compact block message back into canonical FinalBlocks.
+ * Throws DeserializationError if the message is malformed.
+ *
+ * @param compact a message created by EncodeCompactBlocks
+ * @param offset position of the compact header in the message
+ * @return concatenated canonical FinalBlocks
+ */
+std::vector<byte> DecodeCompactBlocks(const std::vector<byte>& compact, size_t offset = 0);
+
+/**
+ * Encode canonical blocks for the wire with the given encoding
+ * @param canonical concatenated canonical FinalBlocks
+ * @param encoding
+ * @return the encoded blocks (a copy of canonical for CanonicalBlocks)
+ */
+std::vector<byte> EncodeBlocks(const std::vector<byte>& canonical, eBlockEncoding encoding);
+
+} // namespace Devv
@@ -12,7 +12,7 @@ bool IsBlockData(const std::vector<byte>& raw) {
   //check if big enough
   if (raw.size() < FinalBlock::MinSize()) { return false; }
   //check version
-  if (raw[0] != 0x00) { return false; }
+  if (raw[0] > kFINAL_BLOCK_VERSION) { return false; }
   size_t offset = 9;
   uint64_t block_time = BinToUint64(raw, offset);
   // check blocktime is from 2018 or newer.
@@ -0,0 +1,225 @@
+/*
+ * primitives/thin_block.cpp implements the thin wire encoding
+ * for FinalBlocks and ProposedBlocks.
+ *
+ * Thin block layout:
+ *   marker(1) format(1) kind(1) origin(4) header tx_count(4)
+ *   transactions... tail
+ *
+ * Each Transaction is tag(1) signature, followed by
+ * size(8) canonical when the tag is kTHIN_TX_INLINE.
+ * The header and tail (Summary and Validation) are canonical.
+ *
+ * Request layout:
+ *   kind(1) block_id(32) requester(4) sig_count(4) signatures...
+ *
+ * @copywrite  2018 Devvio Inc
+ */
+#include "primitives/thin_block.h"
+
+#include "common/binary_converters.h"
+#include "common/devv_constants.h"
+#include "common/devv_exceptions.h"
+
+namespace Devv {
+
+namespace {
+
+/// Offset of the tx_size field in the canonical block headers
+static const size_t kFINAL_TX_SIZE_OFFSET = 81;
+static const size_t kPROPOSAL_TX_SIZE_OFFSET = 41;
+/// Offset of the block id in the canonical block headers
+static const size_t kFINAL_MERKLE_OFFSET = 49;
+static const size_t kPROPOSAL_PREV_HASH_OFFSET = 9;
+
+size_t HeaderSize(eThinBlockKind kind) {
+  return (kind == ThinFinalBlock) ? FinalBlock::MinSize() : ProposedBlock::MinSize();
+}
+
+/**
+ * Bounds checked reader, throws DeserializationError on overrun
+ */
+struct ThinReader {
+  ThinReader(const std::vector<byte>& bytes, size_t offset)
+      : bytes(bytes), offset(offset) {}
+
+  void require(uint64_t n) const {
+    if ((offset > bytes.size()) || (bytes.size() - offset < n)) {
+      throw DeserializationError("Invalid thin block, truncated at offset "
+                                     + std::to_string(offset));
+    }
+  }
+
+  byte nextByte() {
+    require(1);
+    return bytes.at(offset++);
+  }
+
+  uint32_t nextUint32() {
+    require(4);
+    uint32_t ret = BinToUint32(bytes, offset);
+    offset += 4;
+    return ret;
+  }
+
+  uint64_t nextUint64() {
+    require(kUINT64_SIZE);
+    uint64_t ret = BinToUint64(bytes, offset);
+    offset += kUINT64_SIZE;
+    return ret;
+  }
+
+  std::vector<byte> nextBytes(uint64_t n) {
+    require(n);
+    std::vector<byte> out(bytes.begin() + offset, bytes.begin() + offset + n);
+    offset += n;
+    return out;
+  }
+
+  Signature nextSignature() {
+    require(1);
+    byte sig_size = bytes.at(offset);
+    if (sig_size != kWALLET_SIG_SIZE && sig_size != kNODE_SIG_SIZE) {
+      throw DeserializationError("Invalid thin block, bad signature size: "
+                                     + std::to_string(sig_size));
+    }
+    return Signature(nextBytes(sig_size + 1));
+  }
+
+  const std::vector<byte>& bytes;
+  size_t offset;
+};
+
+std::vector<byte> EncodeThin(eThinBlockKind kind,
+                             const std::vector<byte>& canonical,
+                             const std::vector<TransactionPtr>& txs,
+                             uint32_t origin,
+                             const std::set<Signature>& inline_txs) {
+  size_t header_size = HeaderSize(kind);
+  size_t tx_size_offset = (kind == ThinFinalBlock) ? kFINAL_TX_SIZE_OFFSET : kPROPOSAL_TX_SIZE_OFFSET;
+  if (canonical.size() < header_size) {
+    throw std::runtime_error("EncodeThinBlock(): block is too small");
+  }
+  uint64_t tx_size = BinToUint64(canonical, tx_size_offset);
+  if (canonical.size() - header_size < tx_size) {
+    throw std::runtime_error("EncodeThinBlock(): block is shorter than its transactions");
+  }
+
+  std::vector<byte> out;
+  out.push_back(kTHIN_BLOCK_MARKER);
+  out.push_back(kTHIN_BLOCK_FORMAT);
+  out.push_back(kind);
+  Uint32ToBin(origin, out);
+  out.insert(out.end(), canonical.begin(), canonical.begin() + header_size);
+  Uint32ToBin(txs.size(), out);
+  for (auto const& tx : txs) {
+    Signature sig = tx->getSignature();
+    if (inline_txs.count(sig) > 0) {
+      out.push_back(kTHIN_TX_INLINE);
+      out.insert(out.end(), sig.getCanonical().begin(), sig.getCanonical().end());
+      std::vector<byte> tx_canon(tx->getCanonical());
+      Uint64ToBin(tx_canon.size(), out);
+      out.insert(out.end(), tx_canon.begin(), tx_canon.end());
+    } else {
+      out.push_back(kTHIN_TX_REFERENCE);
+      out.insert(out.end(), sig.getCanonical().begin(), sig.getCanonical().end());
+    }
+  }
+  out.insert(out.end(), canonical.begin() + header_size + tx_size, canonical.end());
+  return out;
+}
+
+} // namespace
+
+Hash ThinBlock::getBlockId() const {
+  size_t id_offset = (kind == ThinFinalBlock) ? kFINAL_MERKLE_OFFSET : kPROPOSAL_PREV_HASH_OFFSET;
+  Hash id;
+  std::copy_n(header.begin() + id_offset, id.size(), id.begin());
+  return id;
+}
+
+bool IsThinBlockData(const std::vector<byte>& raw) {
+  return (raw.size() >= 3)
+      && (raw.at(0) == kTHIN_BLOCK_MARKER)
+      && (raw.at(1) == kTHIN_BLOCK_FORMAT);
+}
+
+std::vector<byte> EncodeThinBlock(const FinalBlock& block,
+                                  uint32_t origin,
+                                  const std::set<Signature>& inline_txs) {
+  MTR_SCOPE_FUNC();
+  return EncodeThin(ThinFinalBlock, block.getCanonical(), block.getTransactions(), origin, inline_txs);
+}
+
+std::vector<byte> EncodeThinBlock(const ProposedBlock& block,
+                                  uint32_t origin,
+                                  const std::set<Signature>& inline_txs) {
+  MTR_SCOPE_FUNC();
+  return EncodeThin(ThinProposedBlock, block.getCanonical(), block.getTransactions(), origin, inline_txs);
+}
+
+ThinBlock DecodeThinBlock(const std::vector<byte>& raw) {
+  MTR_SCOPE_FUNC();
+  if (!IsThinBlockData(raw)) {
+    throw DeserializationError("Invalid thin block header");
+  }
+  ThinReader reader(raw, 2);
+  ThinBlock thin;
+  byte kind = reader.nextByte();
+  if (kind != ThinFinalBlock && kind != ThinProposedBlock) {
+    throw DeserializationError("Invalid thin block kind: " + std::to_string(kind));
+  }
+  thin.kind = static_cast<eThinBlockKind>(kind);
+  thin.origin = reader.nextUint32();
+  thin.header = reader.nextBytes(HeaderSize(thin.kind));
+
+  uint32_t tx_count = reader.nextUint32();
+  for (uint32_t i = 0; i < tx_count; ++i) {
+    ThinTransaction entry;
+    byte tag = reader.nextByte();
+    entry.sig = reader.nextSignature();
+    if (tag == kTHIN_TX_INLINE) {
+      entry.canonical = reader.nextBytes(reader.nextUint64());
+    } else if (tag != kTHIN_TX_REFERENCE) {
+      throw DeserializationError("Invalid thin block transaction tag: " + std::to_string(tag));
+    }
+    thin.txs.push_back(std::move(entry));
+  }
+  thin.tail.assign(raw.begin() + reader.offset, raw.end());
+  return thin;
+}
+
+std::vector<byte> EncodeThinBlockRequest(const ThinBlockRequest& request) {
+  std::vector<byte> out;
+  out.push_back(request.kind);
+  out.insert(out.end(), request.block_id.begin(), request.block_id.end());
+  Uint32ToBin(request.requester, out);
+  Uint32ToBin(request.sigs.size(), out);
+  for (auto const& sig : request.sigs) {
+    out.insert(out.end(), sig.getCanonical().begin(), sig.getCanonical().end());
+  }
+  return out;
+}
+
+ThinBlockRequest DecodeThinBlockRequest(const std::vector<byte>& raw) {
+  ThinReader reader(raw, 0);
+  ThinBlockRequest request;
+  byte kind = reader.nextByte();
+  if (kind != ThinFinalBlock && kind != ThinProposedBlock) {
+    throw DeserializationError("Invalid thin block request kind: " + std::to_string(kind));
+  }
+  request.kind = static_cast<eThinBlockKind>(kind);
+  std::vector<byte> id(reader.nextBytes(request.block_id.size()));
+  std::copy(id.begin(), id.end(), request.block_id.begin());
+  request.requester = reader.nextUint32();
+  uint32_t sig_count = reader.nextUint32();
+  for (uint32_t i = 0; i < sig_count; ++i) {
+    request.sigs.push_back(reader.nextSignature());
+  }
+  if (reader.offset != raw.size()) {
+    throw DeserializationError("Invalid thin block request, trailing bytes");
+  }
+  return request;
+}
+
+} // namespace Devv
@@ -0,0 +1,153 @@
+/*
+ * primitives/thin_block.h defines a thin wire encoding for
+ * FinalBlocks and ProposedBlocks.
+ *
+ * Validators already hold nearly every Transaction of a block
+ * in their UnrecordedTransactionPool, so a thin block carries
+ * the block header, Summary and Validation verbatim but lists
+ * its Transactions by Signature. Transactions the receiver
+ * is known to be missing may be carried inline. The receiver
+ * reassembles the exact canonical block from its pool.
+ *
+ * @copywrite  2018 Devvio Inc
+ */
+#pragma once
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "primitives/FinalBlock.h"
+
+namespace Devv {
+
+/// First byte of a thin block message. Canonical blocks start with their version.
+static const byte kTHIN_BLOCK_MARKER = 0xDC;
+/// Version of the thin block format
+static const byte kTHIN_BLOCK_FORMAT = 1;
+
+/// Tags of the Transaction entries in a thin block
+static const byte kTHIN_TX_REFERENCE = 0;
+static const byte kTHIN_TX_INLINE = 1;
+
+/**
+ * With thin blocks, validators publish thin FinalBlocks on the shard topic
+ * and the complete blocks on this topic, for subscribers without a pool
+ * like devv-query and devv-psql. It does not start with the shard URI,
+ * so validators subscribed to the shard do not receive it.
+ * @param shard_uri - the URI of the shard
+ * @return the topic of complete FinalBlocks
+ */
+static inline std::string GetArchiveUri(const std::string& shard_uri) {
+  return "archive-" + shard_uri;
+}
+
+/**
+ * Kind of block carried by a thin block message
+ */
+enum eThinBlockKind : byte {
+  ThinFinalBlock = 0,
+  ThinProposedBlock = 1
+};
+
+/**
+ * One Transaction entry of a thin block
+ */
+struct ThinTransaction {
+  /// Signature identifying the Transaction
+  Signature sig;
+  /// canonical Transaction if carried inline, empty otherwise
+  std::vector<byte> canonical;
+};
+
+/**
+ * A decoded thin block
+ */
+struct ThinBlock {
+  /// FinalBlock or ProposedBlock
+  eThinBlockKind kind = ThinFinalBlock;
+  /// Index of the node that sent the block and can fill in missing Transactions
+  uint32_t origin = 0;
+  /// Canonical block header
+  std::vector<byte> header;
+  /// Transactions of the block in block order
+  std::vector<ThinTransaction> txs;
+  /// Canonical Summary and Validation
+  std::vector<byte> tail;
+
+  /**
+   * Returns the hash identifying this block,
+   * the merkle root of a FinalBlock or the previous hash of a ProposedBlock
+   * @return the block id
+   */
+  Hash getBlockId() const;
+};
+
+/**
+ * A request for the Transactions missing from a thin block
+ */
+struct ThinBlockRequest {
+  /// FinalBlock or ProposedBlock
+  eThinBlockKind kind = ThinFinalBlock;
+  /// ThinBlock::getBlockId() of the requested block
+  Hash block_id = {};
+  /// Index of the requesting node
+  uint32_t requester = 0;
+  /// Signatures of the missing Transactions
+  std::vector<Signature> sigs;
+};
+
+/**
+ * Checks if the binary holds a thin block
+ * @param raw
+ * @return true if raw is a thin block message
+ * @return false otherwise
+ */
+bool IsThinBlockData(const std::vector<byte>& raw);
+
+/**
+ * Encode a FinalBlock as a thin block
+ * @param block the block to encode, its Transactions must be set
+ * @param origin index of the sending node
+ * @param inline_txs Signatures of Transactions to carry inline
+ * @return the thin encoding
+ */
+std::vector<byte> EncodeThinBlock(const FinalBlock& block,
+                                  uint32_t origin,
+                                  const std::set<Signature>& inline_txs = {});
+
+/**
+ * Encode a ProposedBlock as a thin block
+ * @param block the block to encode
+ * @param origin index of the sending node
+ * @param inline_txs Signatures of Transactions to carry inline
+ * @return the thin encoding
+ */
+std::vector<byte> EncodeThinBlock(const ProposedBlock& block,
+                                  uint32_t origin,
+                                  const std::set<Signature>& inline_txs = {});
+
+/**
+ * Decode a thin block message.
+ * Throws DeserializationError if the message is malformed.
+ * @param raw a message created by EncodeThinBlock
+ * @return the decoded thin block
+ */
+ThinBlock DecodeThinBlock(const std::vector<byte>& raw);
+
+/**
+ * Serialize a request for missing Transactions
+ * @param request
+ * @return the binary request
+ */
+std::vector<byte> EncodeThinBlockRequest(const ThinBlockRequest& request);
+
+/**
+ * Deserialize a request for missing Transactions.
+ * Throws DeserializationError if the request is malformed.
+ * @param raw
+ * @return the request
+ */
+ThinBlockRequest DecodeThinBlockRequest(const std::vector<byte>& raw);
+
+} // namespace Devv
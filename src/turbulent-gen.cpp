@@ -18,6 +18,7 @@
 #include <boost/program_options.hpp>
 
 #include "common/devv_context.h"
+#include "concurrency/TransactionGenerator.h"
 #include "modules/BlockchainModule.h"
 
 using namespace Devv;
@@ -31,8 +32,13 @@ struct turbulent_options {
   std::string node_keys;
   std::string wallet_keys;
   std::string key_pass;
+  unsigned int key_load_threads = 0;
+  bool verify_keys = true;
+  std::string key_cache_dir;
   unsigned int generate_count;
   uint64_t tx_amount;
+  unsigned int num_threads = 0;
+  uint64_t seed = 0;
   eDebugMode debug_mode;
 };
 
@@ -51,83 +57,82 @@ int main(int argc, char* argv[]) {
 
     DevvContext this_context(options->node_index, options->shard_index, options->mode, options->inn_keys,
                                 options->node_keys, options->key_pass);
+    this_context.set_key_load_threads(options->key_load_threads);
+    this_context.set_verify_keys(options->verify_keys);
+    this_context.set_key_cache_dir(options->key_cache_dir);
 
     KeyRing keys(this_context);
     keys.LoadWallets(options->wallet_keys, options->key_pass);
 
-    std::vector<byte> out;
-    EVP_MD_CTX* ctx;
-    if (!(ctx = EVP_MD_CTX_create())) {
-      LOG_FATAL << "Could not create signature context!";
-      CASH_THROW("Could not create signature context!");
-    }
-
     Address inn_addr = keys.getInnAddr();
 
     size_t addr_count = keys.CountWallets();
+    if (addr_count < 2) {
+      LOG_FATAL << "At least 2 wallets are needed to generate peer transactions.";
+      CASH_THROW("Not enough wallets.");
+    }
 
-    std::srand((unsigned)time(0));
-    size_t counter = 0;
-
-    std::vector<Transfer> xfers;
-    Transfer inn_transfer(inn_addr, 0
-      , -1l*addr_count*(addr_count-1)*options->tx_amount, 0);
-    xfers.push_back(inn_transfer);
+    // Fetch the addresses and keys once, they are shared by all generating threads
+    std::vector<Address> addrs;
+    std::vector<EC_KEY*> wallet_keys;
     for (size_t i = 0; i < addr_count; ++i) {
-      Transfer transfer(keys.getWalletAddr(i), 0
-        , (addr_count-1)*options->tx_amount, 0);
-      xfers.push_back(transfer);
+      addrs.push_back(keys.getWalletAddr(i));
+      wallet_keys.push_back(keys.getWalletKey(i));
     }
-    uint64_t nonce = GetMillisecondsSinceEpoch() + (1000000
-                     * (options->node_index + 1) * (options->tx_amount + 1));
-	std::vector<byte> nonce_bin;
-    Uint64ToBin(nonce, nonce_bin);
-    Tier2Transaction inn_tx(eOpType::Create, xfers, nonce_bin,
-                            keys.getKey(inn_addr), keys);
-    std::vector<byte> inn_canon(inn_tx.getCanonical());
-    out.insert(out.end(), inn_canon.begin(), inn_canon.end());
-    LOG_DEBUG << "GenerateTransactions(): generated inn_tx with sig: " << inn_tx.getSignature().getJSON();
-    counter++;
-
-    while (counter < options->generate_count) {
+    EC_KEY* inn_key = keys.getKey(inn_addr);
+
+    uint64_t tx_amount = options->tx_amount;
+    uint64_t seed = options->seed;
+    uint64_t node_factor = 1000000 * (options->node_index + 1);
+    auto make = [&](size_t index, std::vector<byte>& out) {
+      std::vector<byte> nonce_bin;
+      if (index == 0) {
+        std::vector<Transfer> xfers;
+        Transfer inn_transfer(inn_addr, 0, -1l*addr_count*(addr_count-1)*tx_amount, 0);
+        xfers.push_back(inn_transfer);
         for (size_t i = 0; i < addr_count; ++i) {
-          size_t j = std::rand() % addr_count;
-          size_t amount = std::rand() % options->tx_amount;
-          if (i == j) { continue; }
-          std::vector<Transfer> peer_xfers;
-          Transfer sender(keys.getWalletAddr(i), 0, -1l * amount, 0);
-          peer_xfers.push_back(sender);
-          Transfer receiver(keys.getWalletAddr(j), 0, amount, 0);
-          peer_xfers.push_back(receiver);
-          nonce_bin.clear();
-          nonce = GetMillisecondsSinceEpoch() + (1000000
-                     * (options->node_index + 1) * (i + 1) * (j + 1));
-          Uint64ToBin(nonce, nonce_bin);
-          Tier2Transaction peer_tx(
-              eOpType::Exchange, peer_xfers, nonce_bin,
-              keys.getWalletKey(i), keys);
-          std::vector<byte> peer_canon(peer_tx.getCanonical());
-          out.insert(out.end(), peer_canon.begin(), peer_canon.end());
-          LOG_TRACE << "GenerateTransactions(): generated tx with sig: " << peer_tx.getSignature().getJSON();
-          counter++;
-          if (counter >= options->generate_count) { break; }
-        }  // end for loop
-        if (counter >= options->generate_count) { break; }
-    }  // end counter while
-
-    LOG_INFO << "Generated " << counter << " transactions.";
-
+          Transfer transfer(addrs[i], 0, (addr_count-1)*tx_amount, 0);
+          xfers.push_back(transfer);
+        }
+        Uint64ToBin(seed + node_factor * (tx_amount + 1), nonce_bin);
+        Tier2Transaction inn_tx(eOpType::Create, xfers, nonce_bin, inn_key);
+        const std::vector<byte>& inn_canon = inn_tx.getCanonical();
+        out.insert(out.end(), inn_canon.begin(), inn_canon.end());
+        return;
+      }
+      // Senders take turns, the receiver and amount are drawn from the seed and index
+      size_t i = (index - 1) % addr_count;
+      uint64_t random = TransactionGenerator::Random(seed, index);
+      size_t j = (i + 1 + random % (addr_count - 1)) % addr_count;
+      uint64_t amount = (tx_amount > 0) ? TransactionGenerator::Random(seed, random) % tx_amount : 0;
+      std::vector<Transfer> peer_xfers;
+      Transfer sender(addrs[i], 0, -1l * amount, 0);
+      peer_xfers.push_back(sender);
+      Transfer receiver(addrs[j], 0, amount, 0);
+      peer_xfers.push_back(receiver);
+      Uint64ToBin(seed + node_factor * (i + 1) * (j + 1) + index, nonce_bin);
+      Tier2Transaction peer_tx(eOpType::Exchange, peer_xfers, nonce_bin, wallet_keys[i]);
+      const std::vector<byte>& peer_canon = peer_tx.getCanonical();
+      out.insert(out.end(), peer_canon.begin(), peer_canon.end());
+    };
+
+    std::ofstream out_file;
     if (!options->write_file.empty()) {
-      std::ofstream outFile(options->write_file, std::ios::out | std::ios::binary);
-      if (outFile.is_open()) {
-        outFile.write((const char*)out.data(), out.size());
-        outFile.close();
-      } else {
+      out_file.open(options->write_file, std::ios::out | std::ios::binary);
+      if (!out_file.is_open()) {
         LOG_FATAL << "Failed to open output file '" << options->write_file << "'.";
         return (false);
       }
     }
 
+    TransactionGenerator generator(options->num_threads);
+    size_t bytes = generator.generate(options->generate_count, make
+                                      , out_file.is_open() ? &out_file : nullptr);
+    EC_KEY_free(inn_key);
+
+    LOG_INFO << "Generated " << options->generate_count << " transactions (" << bytes << " bytes) in "
+             << generator.getElapsedMillis() << " ms, " << generator.getRate() << " tx/s.";
+
     return (true);
   }
   CASH_CATCH(...) {
@@ -166,6 +171,9 @@ Required parameters");
         ("node-keys", po::value<std::string>(), "Path to Node key file")
         ("wallet-keys", po::value<std::string>(), "Path to Wallet key file")
         ("key-pass", po::value<std::string>(), "Password for private keys")
+        ("key-load-threads", po::value<unsigned int>(), "Number of threads decoding key files (0 for one per core)")
+        ("skip-key-check", "Do not sign and verify a test message with every loaded key (trusted key files only)")
+        ("key-cache-dir", po::value<std::string>(), "Directory where decoded keys are cached, encrypted with key-pass")
         ("generate-tx", po::value<unsigned int>(), "Generate at least this many Transactions")
         ("tx-amount", po::value<uint64_t>(), "Number of coins to transfer in transaction")
         ;
@@ -173,6 +181,8 @@ Required parameters");
     po::options_description d2("Optional parameters");
     d2.add_options()
         ("help", "produce help message")
+        ("num-threads", po::value<unsigned int>(), "Number of threads generating transactions (0 for one per core)")
+        ("seed", po::value<uint64_t>(), "Seed of the nonces and random choices, the same seed generates the same output")
         ("debug-mode", po::value<std::string>(), "Debug mode (on|off|perf) for testing")
         ;
     desc.add(d2);
@@ -267,6 +277,25 @@ Required parameters");
       LOG_INFO << "Key pass was not set.";
     }
 
+    if (vm.count("key-load-threads")) {
+      options->key_load_threads = vm["key-load-threads"].as<unsigned int>();
+      LOG_INFO << "Key load threads: " << options->key_load_threads;
+    } else {
+      LOG_INFO << "Key load threads were not set (default to one per core).";
+    }
+
+    if (vm.count("skip-key-check")) {
+      options->verify_keys = false;
+      LOG_INFO << "Key self-test disabled.";
+    }
+
+    if (vm.count("key-cache-dir")) {
+      options->key_cache_dir = vm["key-cache-dir"].as<std::string>();
+      LOG_INFO << "Key cache dir: " << options->key_cache_dir;
+    } else {
+      LOG_INFO << "Key cache dir was not set (keys are not cached).";
+    }
+
     if (vm.count("generate-tx")) {
       options->generate_count = vm["generate-tx"].as<unsigned int>();
       LOG_INFO << "Generate Transactions: " << options->generate_count;
@@ -282,6 +311,21 @@ Required parameters");
       options->tx_amount = 3210123;
       LOG_INFO << "Transaction amount was not set, defaulting to " << options->tx_amount;
     }
+
+    if (vm.count("num-threads")) {
+      options->num_threads = vm["num-threads"].as<unsigned int>();
+      LOG_INFO << "Generator threads: " << options->num_threads;
+    } else {
+      LOG_INFO << "Generator threads were not set (default to one per core).";
+    }
+
+    if (vm.count("seed")) {
+      options->seed = vm["seed"].as<uint64_t>();
+      LOG_INFO << "Seed: " << options->seed;
+    } else {
+      options->seed = GetMillisecondsSinceEpoch();
+      LOG_INFO << "Seed was not set, defaulting to the current time " << options->seed;
+    }
   }
   catch (std::exception& e) {
     LOG_ERROR << "error: " << e.what();
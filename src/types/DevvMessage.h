@@ -31,7 +31,9 @@ enum eMessageType {
   REQUEST_BLOCK = 4,
   GET_BLOCKS_SINCE = 5,
   BLOCKS_SINCE = 6,
-  NUM_TYPES = 7
+  REQUEST_TRANSACTIONS = 7,
+  LOAD_REPORT = 8,
+  NUM_TYPES = 9
 };
 
 typedef std::string URI;
@@ -235,6 +237,12 @@ static std::string GetMessageType (const DevvMessage& message) {
   case(eMessageType::BLOCKS_SINCE):
     message_type_string = "BLOCKS_SINCE";
     break;
+  case(eMessageType::REQUEST_TRANSACTIONS):
+    message_type_string = "REQUEST_TRANSACTIONS";
+    break;
+  case(eMessageType::LOAD_REPORT):
+    message_type_string = "LOAD_REPORT";
+    break;
   default:
     message_type_string = "ERROR_DEFAULT";
     break;